@@ -26,25 +26,34 @@
 #ifndef LLVM_ADT_STATISTIC_H
 #define LLVM_ADT_STATISTIC_H
 
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Atomic.h"
 #include "llvm/Support/Compiler.h"
 #include <atomic>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace llvm {
 
 class raw_ostream;
 class raw_fd_ostream;
 
+/// A counter of how often something happened.  The increments are recorded in
+/// per-thread counters, so that statistics bumped concurrently by several
+/// threads do not contend; they are summed up when the value is read.
 class Statistic {
 public:
   const char *DebugType;
   const char *Name;
   const char *Desc;
+  /// The part of the value that is not held by the per-thread counters.
   std::atomic<unsigned> Value;
-  bool Initialized;
+  /// Identifies the per-thread counters of the statistic, 0 until the
+  /// statistic is registered.
+  std::atomic<unsigned> ID;
 
-  unsigned getValue() const { return Value.load(std::memory_order_relaxed); }
+  unsigned getValue() const;
   const char *getDebugType() const { return DebugType; }
   const char *getName() const { return Name; }
   const char *getDesc() const { return Desc; }
@@ -55,61 +64,46 @@ public:
     Name = name;
     Desc = desc;
     Value = 0;
-    Initialized = false;
+    ID = 0;
   }
 
   // Allow use of this class as the value itself.
   operator unsigned() const { return getValue(); }
 
 #if !defined(NDEBUG) || defined(LLVM_ENABLE_STATS)
-   const Statistic &operator=(unsigned Val) {
-    Value.store(Val, std::memory_order_relaxed);
-    return init();
-  }
+  const Statistic &operator=(unsigned Val);
 
-  const Statistic &operator++() {
-    Value.fetch_add(1, std::memory_order_relaxed);
-    return init();
-  }
+  const Statistic &operator++() { return add(1); }
 
+  /// The postfix forms return the previous value, which sums up the
+  /// per-thread counters. Prefer the prefix forms when it is not needed.
   unsigned operator++(int) {
-    init();
-    return Value.fetch_add(1, std::memory_order_relaxed);
+    unsigned Old = getValue();
+    add(1);
+    return Old;
   }
 
-  const Statistic &operator--() {
-    Value.fetch_sub(1, std::memory_order_relaxed);
-    return init();
-  }
+  const Statistic &operator--() { return add(-1u); }
 
   unsigned operator--(int) {
-    init();
-    return Value.fetch_sub(1, std::memory_order_relaxed);
+    unsigned Old = getValue();
+    add(-1u);
+    return Old;
   }
 
   const Statistic &operator+=(unsigned V) {
     if (V == 0)
       return *this;
-    Value.fetch_add(V, std::memory_order_relaxed);
-    return init();
+    return add(V);
   }
 
   const Statistic &operator-=(unsigned V) {
     if (V == 0)
       return *this;
-    Value.fetch_sub(V, std::memory_order_relaxed);
-    return init();
+    return add(-V);
   }
 
-  void updateMax(unsigned V) {
-    unsigned PrevMax = Value.load(std::memory_order_relaxed);
-    // Keep trying to update max until we succeed or another thread produces
-    // a bigger max than us.
-    while (V > PrevMax && !Value.compare_exchange_weak(
-                              PrevMax, V, std::memory_order_relaxed)) {
-    }
-    init();
-  }
+  void updateMax(unsigned V);
 
 #else  // Statistics are disabled in release builds.
 
@@ -147,20 +141,21 @@ public:
 
 protected:
   Statistic &init() {
-    bool tmp = Initialized;
-    sys::MemoryFence();
-    if (!tmp) RegisterStatistic();
-    TsanHappensAfter(this);
+    if (!ID.load(std::memory_order_acquire))
+      RegisterStatistic();
     return *this;
   }
 
+  /// Add \p Delta, modulo 2^32, to the counter of the current thread.
+  Statistic &add(unsigned Delta);
+
   void RegisterStatistic();
 };
 
 // STATISTIC - A macro to make definition of statistics really simple.  This
 // automatically passes the DEBUG_TYPE of the file into the statistic.
 #define STATISTIC(VARNAME, DESC)                                               \
-  static llvm::Statistic VARNAME = {DEBUG_TYPE, #VARNAME, DESC, {0}, false}
+  static llvm::Statistic VARNAME = {DEBUG_TYPE, #VARNAME, DESC, {0}, {0}}
 
 /// \brief Enable the collection and printing of statistics.
 void EnableStatistics(bool PrintOnExit = true);
@@ -183,6 +178,10 @@ void PrintStatistics(raw_ostream &OS);
 /// PrintStatisticsJSON().
 void PrintStatisticsJSON(raw_ostream &OS);
 
+/// \brief Get the registered statistics and their values, sorted by debug type
+/// and name, e.g. to report them to a telemetry system without parsing JSON.
+std::vector<std::pair<StringRef, unsigned>> GetStatistics();
+
 } // end namespace llvm
 
 #endif // LLVM_ADT_STATISTIC_H
@@ -80,7 +80,8 @@ class Module;
     Expected<std::unique_ptr<Module>> getModuleImpl(LLVMContext &Context,
                                                     bool MaterializeAll,
                                                     bool ShouldLazyLoadMetadata,
-                                                    bool IsImporting);
+                                                    bool IsImporting,
+                                                    bool LoadMetadataOnDemand);
 
   public:
     StringRef getBuffer() const {
@@ -99,6 +100,14 @@ class Module;
                                                     bool ShouldLazyLoadMetadata,
                                                     bool IsImporting);
 
+    /// Read the bitcode module for linking into another module, and prepare
+    /// for lazy deserialization of function bodies and metadata. If the module
+    /// has a metadata index, materializeMetadata only reads the named metadata
+    /// and the attachments of declarations, and other module-level metadata is
+    /// loaded as it is referenced by the functions and globals being linked.
+    Expected<std::unique_ptr<Module>>
+    getLazyModuleForLinking(LLVMContext &Context);
+
     /// Read the entire bitcode module and return it.
     Expected<std::unique_ptr<Module>> parseModule(LLVMContext &Context);
 
@@ -109,6 +118,12 @@ class Module;
     /// Parse the specified bitcode buffer, returning the module summary index.
     Expected<std::unique_ptr<ModuleSummaryIndex>> getSummary();
 
+    /// Parse the specified bitcode buffer, returning a module summary index
+    /// whose combined summary records are only decoded when the summaries of
+    /// their GUID are first used. The records are all checked here, so that
+    /// decoding them later cannot fail. The buffer must outlive the index.
+    Expected<std::unique_ptr<ModuleSummaryIndex>> getLazySummary();
+
     /// Parse the specified bitcode buffer and merge its module summary index
     /// into CombinedIndex.
     Error readSummary(ModuleSummaryIndex &CombinedIndex, StringRef ModulePath,
@@ -173,6 +188,13 @@ class Module;
   Expected<std::unique_ptr<ModuleSummaryIndex>>
   getModuleSummaryIndex(MemoryBufferRef Buffer);
 
+  /// Parse the specified bitcode buffer, returning a module summary index
+  /// whose combined summary records are decoded on first use. Malformed
+  /// records are reported here rather than when they are decoded. The buffer
+  /// must outlive the index.
+  Expected<std::unique_ptr<ModuleSummaryIndex>>
+  getLazyModuleSummaryIndex(MemoryBufferRef Buffer);
+
   /// Parse the specified bitcode buffer and merge the index into CombinedIndex.
   Error readModuleSummaryIndex(MemoryBufferRef Buffer,
                                ModuleSummaryIndex &CombinedIndex,
@@ -186,6 +208,12 @@ class Module;
   getModuleSummaryIndexForFile(StringRef Path,
                                bool IgnoreEmptyThinLTOIndexFile = false);
 
+  /// Like getModuleSummaryIndexForFile, but decode the combined summary
+  /// records on first use. The index keeps the file mapped while it needs it.
+  Expected<std::unique_ptr<ModuleSummaryIndex>>
+  getLazyModuleSummaryIndexForFile(StringRef Path,
+                                   bool IgnoreEmptyThinLTOIndexFile = false);
+
   /// isBitcodeWrapper - Return true if the given bytes are the magic bytes
   /// for an LLVM IR bitcode wrapper.
   inline bool isBitcodeWrapper(const unsigned char *BufPtr,
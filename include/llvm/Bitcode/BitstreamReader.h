@@ -97,6 +97,11 @@ private:
   /// [0...bits_of(size_t)-1] inclusive.
   unsigned BitsInCurWord = 0;
 
+protected:
+  /// A copy of CurWord and BitsInCurWord, used to read runs of fields without
+  /// storing the cursor back to memory after each of them.
+  class CachedWord;
+
 public:
   static const size_t MaxChunkSize = sizeof(word_t) * 8;
 
@@ -237,6 +242,20 @@ public:
     }
   }
 
+  /// Read \p NumElts fixed-width fields of \p NumBits bits each, and append
+  /// them to \p Vals.
+  void readFixedArray(unsigned NumBits, size_t NumElts,
+                      SmallVectorImpl<uint64_t> &Vals);
+
+  /// Read \p NumElts VBR fields of \p NumBits bit chunks, and append them to
+  /// \p Vals.
+  void readVBR64Array(unsigned NumBits, size_t NumElts,
+                      SmallVectorImpl<uint64_t> &Vals);
+
+  /// Read \p NumElts char6 fields, and append the characters they encode to
+  /// \p Vals.
+  void readChar6Array(size_t NumElts, SmallVectorImpl<uint64_t> &Vals);
+
   // Read a VBR that may have a value up to 64-bits in size. The chunk size of
   // the VBR must still be <= 32 bits though.
   uint64_t ReadVBR64(unsigned NumBits) {
@@ -351,6 +370,9 @@ public:
   using SimpleBitstreamCursor::Read;
   using SimpleBitstreamCursor::ReadVBR;
   using SimpleBitstreamCursor::ReadVBR64;
+  using SimpleBitstreamCursor::readFixedArray;
+  using SimpleBitstreamCursor::readVBR64Array;
+  using SimpleBitstreamCursor::readChar6Array;
 
   /// Return the number of bits used to encode an abbrev #.
   unsigned getAbbrevIDWidth() const { return CurCodeSize; }
@@ -248,6 +248,28 @@ public:
     BlockScope.pop_back();
   }
 
+  /// EmitEncodedSubblock - Emit a block whose contents were encoded by another
+  /// stream. \p Contents is everything that stream wrote after the size word
+  /// of the block, up to and including its aligned END_BLOCK, so the result is
+  /// the same as if the block had been written to this stream directly.
+  void EmitEncodedSubblock(unsigned BlockID, unsigned CodeLen,
+                           ArrayRef<char> Contents) {
+    assert((Contents.size() & 3) == 0 && "Contents not 32-bit aligned");
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    WriteWord(Contents.size() / 4);
+    Out.append(Contents.begin(), Contents.end());
+  }
+
+  /// CopyBlockInfo - Install the BLOCKINFO abbreviations of \p Other, so that
+  /// blocks encoded by this stream can be emitted into \p Other with
+  /// EmitEncodedSubblock.
+  void CopyBlockInfo(const BitstreamWriter &Other) {
+    BlockInfoRecords = Other.BlockInfoRecords;
+  }
+
   //===--------------------------------------------------------------------===//
   // Record Emission
   //===--------------------------------------------------------------------===//
@@ -142,13 +142,17 @@ struct DIDumpOptions {
     bool DumpEH = false;
     bool SummarizeTypes = false;
     bool Verbose = false;
+    /// Verify units and line tables on several threads. The report is the
+    /// same as when verifying on a single thread.
+    bool ParallelVerify = false;
 };
 
 class DIContext {
 public:
   enum DIContextKind {
     CK_DWARF,
-    CK_PDB
+    CK_PDB,
+    CK_LineIndex
   };
 
   DIContext(DIContextKind K) : Kind(K) {}
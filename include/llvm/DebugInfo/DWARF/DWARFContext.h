@@ -39,6 +39,7 @@
 #include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 
 namespace llvm {
 
@@ -88,6 +89,12 @@ class DWARFContext : public DIContext {
 
   std::unique_ptr<MCRegisterInfo> RegInfo;
 
+  /// Serializes the lazy parsing of the unit headers, so that the units can
+  /// be enumerated from several threads.
+  std::mutex UnitsMutex;
+  /// Guards the line table cache. Tables are parsed outside of the lock.
+  std::mutex LineTablesMutex;
+
   /// Read compile units from the debug_info section (if necessary)
   /// and store them in CUs.
   void parseCompileUnits();
@@ -192,6 +199,11 @@ public:
 
   DWARFCompileUnit *getDWOCompileUnitForHash(uint64_t Hash);
 
+  /// Extract the DIEs of all the units of this context, spreading the units
+  /// across threads. Afterwards, the DIEs of every unit are in memory and can
+  /// be looked up from several threads without further parsing.
+  void extractAllDIEs();
+
   /// Get a DIE given an exact offset.
   DWARFDie getDIEForOffset(uint32_t Offset);
 
@@ -25,11 +25,13 @@
 #include "llvm/DebugInfo/DWARF/DWARFUnitIndex.h"
 #include "llvm/Support/DataExtractor.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -145,6 +147,21 @@ class DWARFUnit {
   /// The compile unit debug information entry items.
   std::vector<DWARFDebugInfoEntry> DieArray;
 
+  /// How much of DieArray has been extracted, and whether AddrDieMap has been
+  /// built from it.
+  enum ExtractionState : uint8_t {
+    NothingExtracted,
+    UnitDIEExtracted,
+    AllDIEsExtracted,
+    AddrDieMapBuilt
+  };
+  std::atomic<uint8_t> Extracted{NothingExtracted};
+
+  /// Serializes the lazy construction of DieArray, AddrDieMap and DWO, so
+  /// that a unit can be used from several threads.
+  std::mutex ExtractMutex;
+  std::mutex DWOMutex;
+
   /// Map from range's start address to end address and corresponding DIE.
   /// IntervalMap does not support range removal, as a result, we use the
   /// std::map::upper_bound for address range lookup.
@@ -345,6 +362,15 @@ public:
     return die_iterator_range(DieArray.begin(), DieArray.end());
   }
 
+  /// Parse all the DIEs of the unit if that hasn't been done yet.
+  ///
+  /// Extraction is thread-safe, so distinct units can be parsed in parallel
+  /// and a unit can be queried from several threads. Note that extracting all
+  /// DIEs after only the unit DIE was extracted invalidates the DWARFDie
+  /// objects handed out so far, so concurrent users should extract the whole
+  /// unit first.
+  void extractDIEs() { extractDIEsIfNeeded(false); }
+
 private:
   /// Size in bytes of the .debug_info data associated with this compile unit.
   size_t getDebugInfoSize() const { return Length + 4 - getHeaderSize(); }
@@ -357,7 +383,8 @@ private:
   void extractDIEsToVector(bool AppendCUDie, bool AppendNonCUDIEs,
                            std::vector<DWARFDebugInfoEntry> &DIEs) const;
 
-  /// clearDIEs - Clear parsed DIEs to keep memory usage low.
+  /// clearDIEs - Clear parsed DIEs to keep memory usage low. This must not
+  /// race with any other use of the unit.
   void clearDIEs(bool KeepCUDie);
 
   /// parseDWO - Parses .dwo file for current compile unit. Returns true if
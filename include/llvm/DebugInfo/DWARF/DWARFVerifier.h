@@ -10,6 +10,7 @@
 #ifndef LLVM_DEBUGINFO_DWARF_DWARFVERIFIER_H
 #define LLVM_DEBUGINFO_DWARF_DWARFVERIFIER_H
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/DebugInfo/DIContext.h"
 
 #include <cstdint>
@@ -76,7 +77,7 @@ class DWARFVerifier {
                         bool &isUnitDWARF64);
 
 
-  bool verifyUnitContents(DWARFUnit Unit);
+  bool verifyUnitContents(DWARFUnit &Unit);
 
   /// Verify that all Die ranges are valid.
   ///
@@ -137,6 +138,20 @@ class DWARFVerifier {
   /// - invalid file indexes
   void verifyDebugLineRows();
 
+  /// Verify the rows of the line table of \p U, see verifyDebugLineRows().
+  void verifyLineTableRows(DWARFUnit &U);
+
+  /// Run \p Check for each of \p NumItems independent items in parallel.
+  ///
+  /// Each item is checked by its own verifier, writing to its own buffer. The
+  /// reports and the state of these verifiers are then merged into this one in
+  /// item order, so the result doesn't depend on the scheduling.
+  ///
+  /// \returns The sum of the values returned by \p Check.
+  unsigned
+  verifyInParallel(size_t NumItems,
+                   function_ref<unsigned(DWARFVerifier &, size_t)> Check);
+
   /// Verify that an Apple-style accelerator table is valid.
   ///
   /// This function currently checks that:
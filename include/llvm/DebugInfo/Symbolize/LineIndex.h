@@ -0,0 +1,97 @@
+//===- LineIndex.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Declaration of the precomputed address to source location index used to
+// speed up symbolization.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DEBUGINFO_SYMBOLIZE_LINEINDEX_H
+#define LLVM_DEBUGINFO_SYMBOLIZE_LINEINDEX_H
+
+#include "llvm/DebugInfo/DIContext.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <cstdint>
+#include <memory>
+
+namespace llvm {
+
+class raw_ostream;
+
+namespace object {
+class ObjectFile;
+}
+
+namespace symbolize {
+
+/// A compact table mapping the code addresses of an object file to the chain
+/// of (possibly inlined) source locations they were generated from.
+///
+/// The index is computed once from the DWARF of the object file, and answers
+/// queries without parsing any debug information. The table is sorted by
+/// address and is used in place, so that opening an index only needs to map
+/// the file. File names are always recorded as absolute paths. The index is
+/// tied to the build ID of the object file, or to a hash of its contents when
+/// it has none.
+class LineIndex : public DIContext {
+public:
+  /// Compute the index of \p Obj and write it to \p OS. \p DWPName is the
+  /// package to search for split DWARF units.
+  static Error write(const object::ObjectFile &Obj, raw_ostream &OS,
+                     StringRef DWPName = "");
+
+  /// Open the index in \p Buffer, which must have been computed for \p Obj
+  /// and have at least one entry.
+  static Expected<std::unique_ptr<LineIndex>>
+  create(std::unique_ptr<MemoryBuffer> Buffer, const object::ObjectFile &Obj);
+
+  static bool classof(const DIContext *DICtx) {
+    return DICtx->getKind() == CK_LineIndex;
+  }
+
+  void dump(raw_ostream &OS, DIDumpOptions DumpOpts) override;
+
+  DILineInfo getLineInfoForAddress(
+      uint64_t Address,
+      DILineInfoSpecifier Specifier = DILineInfoSpecifier()) override;
+  DILineInfoTable getLineInfoForAddressRange(
+      uint64_t Address, uint64_t Size,
+      DILineInfoSpecifier Specifier = DILineInfoSpecifier()) override;
+  DIInliningInfo getInliningInfoForAddress(
+      uint64_t Address,
+      DILineInfoSpecifier Specifier = DILineInfoSpecifier()) override;
+
+  struct Header;
+  struct Entry;
+  struct Frame;
+
+private:
+  explicit LineIndex(std::unique_ptr<MemoryBuffer> Buffer);
+
+  /// Returns the entry covering \p Address, or null if no source location is
+  /// known for it.
+  const Entry *findEntry(uint64_t Address) const;
+  /// Returns true if \p E has frames, and they are all in the frame table.
+  bool hasFrames(const Entry &E) const;
+  DILineInfo getFrame(uint32_t Index, DILineInfoSpecifier Specifier) const;
+  StringRef getString(uint32_t Offset) const;
+
+  std::unique_ptr<MemoryBuffer> Buffer;
+  const Entry *Entries = nullptr;
+  uint32_t NumEntries = 0;
+  const Frame *Frames = nullptr;
+  uint32_t NumFrames = 0;
+  StringRef Strings;
+};
+
+} // end namespace symbolize
+} // end namespace llvm
+
+#endif // LLVM_DEBUGINFO_SYMBOLIZE_LINEINDEX_H
@@ -14,25 +14,40 @@
 #ifndef LLVM_DEBUGINFO_SYMBOLIZE_SYMBOLIZE_H
 #define LLVM_DEBUGINFO_SYMBOLIZE_SYMBOLIZE_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/DebugInfo/Symbolize/SymbolizableModule.h"
 #include "llvm/Object/Binary.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/Threading.h"
 #include <algorithm>
 #include <cstdint>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
 namespace llvm {
+
+class raw_ostream;
+
 namespace symbolize {
 
 using namespace object;
 
 using FunctionNameKind = DILineInfoSpecifier::FunctionNameKind;
 
+/// Symbolizes addresses in object files, caching the loaded modules.
+///
+/// All queries may be issued concurrently from several threads. Modules are
+/// loaded and queried in parallel, while queries to the same module are
+/// serialized. When Options::MaxCacheSize is non-zero, the least recently used
+/// modules that are not being queried are evicted once the size of the cached
+/// object files exceeds it. Modules that failed to load stay cached until
+/// flush().
 class LLVMSymbolizer {
 public:
   struct Options {
@@ -42,6 +57,12 @@ public:
     bool RelativeAddresses : 1;
     std::string DefaultArch;
     std::vector<std::string> DsymHints;
+    /// Approximate budget, in bytes of object file data, for the modules kept
+    /// in the cache. Zero means unbounded.
+    uint64_t MaxCacheSize = 0;
+    /// Symbolize using the line index in "<binary>.lineidx" when there is an
+    /// up-to-date one, instead of parsing the DWARF of the binary.
+    bool UseLineIndex = false;
 
     Options(FunctionNameKind PrintFunctions = FunctionNameKind::LinkageName,
             bool UseSymbolTable = true, bool Demangle = true,
@@ -60,13 +81,26 @@ public:
   Expected<DILineInfo> symbolizeCode(const std::string &ModuleName,
                                      uint64_t ModuleOffset,
                                      StringRef DWPName = "");
+  /// Symbolize each of \p ModuleOffsets in \p ModuleName. The module is
+  /// looked up once for the whole batch and the offsets are resolved in
+  /// increasing address order. Results are in the order of \p ModuleOffsets.
+  Expected<std::vector<DILineInfo>>
+  symbolizeCode(const std::string &ModuleName,
+                ArrayRef<uint64_t> ModuleOffsets, StringRef DWPName = "");
   Expected<DIInliningInfo> symbolizeInlinedCode(const std::string &ModuleName,
                                                 uint64_t ModuleOffset,
                                                 StringRef DWPName = "");
   Expected<DIGlobal> symbolizeData(const std::string &ModuleName,
                                    uint64_t ModuleOffset);
+  /// Drop all the cached modules that are not currently being queried.
   void flush();
 
+  /// Compute the line index of \p ModuleName and write it to \p OS. The index
+  /// is built from the debug info found the same way as when symbolizing the
+  /// module, which may be in a dSYM bundle or a .gnu_debuglink file.
+  Error writeLineIndex(const std::string &ModuleName, raw_ostream &OS,
+                       StringRef DWPName = "");
+
   static std::string
   DemangleName(const std::string &Name,
                const SymbolizableModule *DbiModuleDescriptor);
@@ -76,12 +110,50 @@ private:
   // corresponding debug info. These objects can be the same.
   using ObjectPair = std::pair<ObjectFile *, ObjectFile *>;
 
-  /// Returns a SymbolizableModule or an error if loading debug info failed.
-  /// Only one attempt is made to load a module, and errors during loading are
-  /// only reported once. Subsequent calls to get module info for a module that
-  /// failed to load will return nullptr.
-  Expected<SymbolizableModule *>
-  getOrCreateModuleInfo(const std::string &ModuleName, StringRef DWPName = "");
+  /// A cached module along with the bookkeeping needed to share it between
+  /// threads and to evict it.
+  struct ModuleEntry {
+    /// The module, or null if loading it failed.
+    std::unique_ptr<SymbolizableModule> Module;
+    /// Loads the module once, without holding CacheMutex. Other threads that
+    /// need the module wait for the load to finish.
+    llvm::once_flag Loaded;
+    /// Serializes the queries to Module, whose DIContext is not thread-safe.
+    std::mutex QueryMutex;
+    /// Number of queries currently using the module. Entries in use are never
+    /// evicted.
+    unsigned UseCount = 0;
+    /// Key of the object pair backing the module in ObjectPairForPathArch.
+    std::pair<std::string, std::string> ObjectsKey;
+    /// Size charged against Options::MaxCacheSize.
+    uint64_t Size = 0;
+    /// Position of the module in the LRU list.
+    std::list<std::string>::iterator LRUPos;
+  };
+
+  /// Returns the cache entry for a module, marked as in use until a matching
+  /// call to releaseModule, or an error if loading debug info failed. Only one
+  /// attempt is made to load a module until the next flush(), and errors
+  /// during loading are only reported once. Subsequent calls for a module that failed
+  /// to load return an entry with a null module.
+  Expected<ModuleEntry *> acquireModule(const std::string &ModuleName,
+                                        StringRef DWPName = "");
+  void releaseModule(ModuleEntry *Entry);
+
+  /// Loads a module into \p Entry. Must be called without CacheMutex held.
+  Error loadModule(StringRef DWPName, ModuleEntry &Entry);
+
+  /// Evicts least recently used modules that are not in use until the cache
+  /// fits in \p MaxSize bytes. Modules that failed to load are never evicted.
+  /// Requires CacheMutex to be held.
+  void evictModules(uint64_t MaxSize);
+
+  /// Releases the object files that no cached module refers to anymore.
+  /// Requires CacheMutex to be held, and takes ObjectsMutex.
+  void releaseUnusedObjects();
+
+  DILineInfo symbolizeCodeInModule(SymbolizableModule &Info,
+                                   uint64_t ModuleOffset);
 
   ObjectFile *lookUpDsymFile(const std::string &Path,
                              const MachOObjectFile *ExeObj,
@@ -90,7 +162,8 @@ private:
                                     const ObjectFile *Obj,
                                     const std::string &ArchName);
 
-  /// \brief Returns pair of pointers to object and debug object.
+  /// \brief Returns pair of pointers to object and debug object. This and the
+  /// lookups below require ObjectsMutex to be held.
   Expected<ObjectPair> getOrCreateObjectPair(const std::string &Path,
                                             const std::string &ArchName);
 
@@ -100,7 +173,21 @@ private:
   Expected<ObjectFile *> getOrCreateObject(const std::string &Path,
                                           const std::string &ArchName);
 
-  std::map<std::string, std::unique_ptr<SymbolizableModule>> Modules;
+  /// Guards the module cache. Neither loading nor querying a module happens
+  /// under this lock.
+  std::mutex CacheMutex;
+
+  std::map<std::string, ModuleEntry> Modules;
+
+  /// Names of the cached modules, least recently used first.
+  std::list<std::string> ModulesLRU;
+
+  /// Sum of the sizes of the cached modules.
+  uint64_t CacheSize = 0;
+
+  /// Guards the object file caches below. When both locks are needed,
+  /// CacheMutex is taken first.
+  std::mutex ObjectsMutex;
 
   /// \brief Contains cached results of getOrCreateObjectPair().
   std::map<std::pair<std::string, std::string>, ObjectPair>
@@ -164,6 +164,20 @@ public:
   void enableDebugTypeODRUniquing();
   void disableDebugTypeODRUniquing();
 
+  /// Allow types, constants, metadata nodes and attributes to be uniqued from
+  /// several threads sharing this context. The uniquing tables are then split
+  /// into independently locked shards. Must be called before other threads
+  /// use the context; there is no way back to the single-threaded mode.
+  ///
+  /// Only getting uniqued objects is made safe. Anything else that updates the
+  /// use list of a value shared between threads is not: creating or deleting
+  /// instructions that use constants or globals, for instance, or setting
+  /// global initializers. Metadata attachments, value handles, value names
+  /// and replaceAllUsesWith() are not synchronized either. In particular,
+  /// running passes on several functions of one module at once is not safe.
+  void enableThreadSafeUniquing();
+  bool isThreadSafeUniquing() const;
+
   using InlineAsmDiagHandlerTy = void (*)(const SMDiagnostic&, void *Context,
                                           unsigned LocCookie);
 
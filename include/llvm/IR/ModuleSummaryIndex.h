@@ -20,6 +20,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
@@ -65,14 +66,24 @@ struct CalleeInfo {
 };
 
 class GlobalValueSummary;
+class MemoryBuffer;
+class SummaryMaterializer;
 
-using GlobalValueSummaryList = std::vector<std::unique_ptr<GlobalValueSummary>>;
+/// List of summaries for a single GUID. The vast majority of GUIDs have a
+/// single summary, so keep it inline to avoid one heap allocation per entry in
+/// large combined indexes.
+using GlobalValueSummaryList =
+    SmallVector<std::unique_ptr<GlobalValueSummary>, 1>;
 
 struct GlobalValueSummaryInfo {
   /// The GlobalValue corresponding to this summary. This is only used in
   /// per-module summaries.
   const GlobalValue *GV = nullptr;
 
+  /// In a lazily loaded index, the materializer that decodes SummaryList on
+  /// first use. This is null once the list is complete.
+  SummaryMaterializer *Materializer = nullptr;
+
   /// List of global value summary structures for a particular value held
   /// in the GlobalValueMap. Requires a vector in the case of multiple
   /// COMDAT values of the same name.
@@ -101,11 +112,34 @@ struct ValueInfo {
   GlobalValue::GUID getGUID() const { return Ref->first; }
   const GlobalValue *getValue() const { return Ref->second.GV; }
 
-  ArrayRef<std::unique_ptr<GlobalValueSummary>> getSummaryList() const {
-    return Ref->second.SummaryList;
-  }
+  inline ArrayRef<std::unique_ptr<GlobalValueSummary>> getSummaryList() const;
 };
 
+/// Decodes the summaries of a lazily loaded index on demand. The materializer
+/// is owned by the index, and is attached to each GUID whose summaries have
+/// not been decoded yet. Decoding cannot fail: the materializer must check its
+/// input when the index is loaded.
+class SummaryMaterializer {
+public:
+  virtual ~SummaryMaterializer();
+
+  /// Decode the summaries of \p VI, and detach the materializer from it.
+  virtual void materialize(ValueInfo VI) = 0;
+
+  /// Decode the summaries of every GUID defined in module \p ModulePath.
+  virtual void materializeModule(StringRef ModulePath) = 0;
+
+  /// Decode all the summaries that have not been decoded yet.
+  virtual void materializeAll() = 0;
+};
+
+ArrayRef<std::unique_ptr<GlobalValueSummary>>
+ValueInfo::getSummaryList() const {
+  if (LLVM_UNLIKELY(Ref->second.Materializer))
+    Ref->second.Materializer->materialize(*this);
+  return Ref->second.SummaryList;
+}
+
 template <> struct DenseMapInfo<ValueInfo> {
   static inline ValueInfo getEmptyKey() {
     return ValueInfo((GlobalValueSummaryMapTy::value_type *)-1);
@@ -598,6 +632,13 @@ private:
   std::set<std::string> CfiFunctionDefs;
   std::set<std::string> CfiFunctionDecls;
 
+  /// The buffer a lazily loaded index is decoded from, if the index owns it.
+  std::unique_ptr<MemoryBuffer> OwnedMemoryBuffer;
+
+  /// Decodes the summaries of a lazily loaded index. Iterating over the index
+  /// decodes everything and releases it.
+  mutable std::unique_ptr<SummaryMaterializer> Materializer;
+
   // YAML I/O support.
   friend yaml::MappingTraits<ModuleSummaryIndex>;
 
@@ -607,12 +648,45 @@ private:
   }
 
 public:
-  gvsummary_iterator begin() { return GlobalValueMap.begin(); }
-  const_gvsummary_iterator begin() const { return GlobalValueMap.begin(); }
+  ModuleSummaryIndex();
+  ModuleSummaryIndex(ModuleSummaryIndex &&);
+  ModuleSummaryIndex &operator=(ModuleSummaryIndex &&);
+  ~ModuleSummaryIndex();
+
+  gvsummary_iterator begin() {
+    materializeAll();
+    return GlobalValueMap.begin();
+  }
+  const_gvsummary_iterator begin() const {
+    materializeAll();
+    return GlobalValueMap.begin();
+  }
   gvsummary_iterator end() { return GlobalValueMap.end(); }
   const_gvsummary_iterator end() const { return GlobalValueMap.end(); }
   size_t size() const { return GlobalValueMap.size(); }
 
+  /// Give the index ownership of the buffer it is lazily decoded from.
+  void setOwnedMemoryBuffer(std::unique_ptr<MemoryBuffer> MB);
+
+  /// Decode the summaries of the GUIDs referenced by the index on first use
+  /// through \p M. The materializer is not thread-safe: call materializeAll()
+  /// before sharing the index between threads. The index must not be moved
+  /// while it has a materializer.
+  void setMaterializer(std::unique_ptr<SummaryMaterializer> M) {
+    Materializer = std::move(M);
+  }
+
+  /// Return true if some summaries have not been decoded yet.
+  bool isMaterializable() const { return Materializer != nullptr; }
+
+  /// Decode all the summaries of a lazily loaded index.
+  void materializeAll() const {
+    if (LLVM_UNLIKELY(Materializer)) {
+      Materializer->materializeAll();
+      Materializer.reset();
+    }
+  }
+
   bool withGlobalValueDeadStripping() const {
     return WithGlobalValueDeadStripping;
   }
@@ -677,10 +751,9 @@ public:
                        GlobalValue::GUID OrigGUID) {
     if (OrigGUID == 0 || ValueGUID == OrigGUID)
       return;
-    if (OidGuidMap.count(OrigGUID) && OidGuidMap[OrigGUID] != ValueGUID)
-      OidGuidMap[OrigGUID] = 0;
-    else
-      OidGuidMap[OrigGUID] = ValueGUID;
+    auto Inserted = OidGuidMap.insert({OrigGUID, ValueGUID});
+    if (!Inserted.second && Inserted.first->second != ValueGUID)
+      Inserted.first->second = 0;
   }
 
   /// Find the summary for global \p GUID in module \p ModuleId, or nullptr if
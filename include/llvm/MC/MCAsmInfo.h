@@ -362,6 +362,15 @@ protected:
   /// Compress DWARF debug sections. Defaults to no compression.
   DebugCompressionType CompressDebugSections = DebugCompressionType::None;
 
+  /// How hard to compress DWARF debug sections.
+  DebugCompressionLevel CompressDebugSectionsLevel =
+      DebugCompressionLevel::Default;
+
+  /// Compress large DWARF debug sections in chunks on the threads of the
+  /// parallel algorithms. Defaults to false, which compresses each section
+  /// as a single stream on the calling thread.
+  bool ParallelDebugCompression = false;
+
   /// True if the integrated assembler should interpret 'a >> b' constant
   /// expressions as logical rather than arithmetic.
   bool UseLogicalShr = true;
@@ -611,6 +620,20 @@ public:
     this->CompressDebugSections = CompressDebugSections;
   }
 
+  DebugCompressionLevel debugCompressionLevel() const {
+    return CompressDebugSectionsLevel;
+  }
+
+  void setDebugCompressionLevel(DebugCompressionLevel Level) {
+    CompressDebugSectionsLevel = Level;
+  }
+
+  bool parallelDebugCompression() const { return ParallelDebugCompression; }
+
+  void setParallelDebugCompression(bool Value) {
+    ParallelDebugCompression = Value;
+  }
+
   bool shouldUseLogicalShr() const { return UseLogicalShr; }
 
   bool canRelaxRelocations() const { return RelaxELFRelocations; }
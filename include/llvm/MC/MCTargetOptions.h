@@ -29,6 +29,12 @@ enum class DebugCompressionType {
   Z,    /// zlib style complession
 };
 
+enum class DebugCompressionLevel {
+  Default, /// zlib's default trade-off between speed and size
+  Speed,   /// Compress as fast as possible
+  Size,    /// Compress as much as possible
+};
+
 class StringRef;
 
 class MCTargetOptions {
@@ -37,10 +37,21 @@ struct NewArchiveMember {
                                             bool Deterministic);
 };
 
+/// Write an archive with \p NewMembers to \p ArcName. \p OldArchiveBuf holds
+/// the archive being replaced, if any. The symbol table is computed in
+/// parallel.
+///
+/// If \p UpdateInPlace is set, the old archive is updated in place rather
+/// than replaced by a new file: only the parts that changed, typically the
+/// symbol table and the members from the first modified one on, are written.
+/// This is only done when most of the archive stays in place. It isn't
+/// atomic, so an interrupted update leaves a corrupt archive; callers should
+/// only set it when asked to.
 std::error_code
 writeArchive(StringRef ArcName, std::vector<NewArchiveMember> &NewMembers,
              bool WriteSymtab, object::Archive::Kind Kind, bool Deterministic,
-             bool Thin, std::unique_ptr<MemoryBuffer> OldArchiveBuf = nullptr);
+             bool Thin, std::unique_ptr<MemoryBuffer> OldArchiveBuf = nullptr,
+             bool UpdateInPlace = false);
 }
 
 #endif
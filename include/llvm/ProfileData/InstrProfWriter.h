@@ -86,6 +86,10 @@ public:
                      instrprof_error::unsupported_version);
   }
 
+  /// Return the kind of the profiles added so far, or PF_Unknown if there
+  /// were none.
+  ProfKind getProfileKind() const { return ProfileKind; }
+
   // Internal interface for testing purpose only.
   void setValueProfDataEndianness(support::endianness Endianness);
   void setOutputSparse(bool Sparse);
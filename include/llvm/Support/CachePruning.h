@@ -35,6 +35,12 @@ struct CachePruningPolicy {
   /// expiration-based pruning.
   std::chrono::seconds Expiration = std::chrono::hours(7 * 24); // 1w
 
+  /// The maximum age of the index of the cache directory. An older index is
+  /// discarded and the directory walked again, so that the files the index
+  /// misses, e.g. written by tools that do not record them, are pruned too. A
+  /// value of 0 forces the walk to occur.
+  std::chrono::seconds RescanInterval = std::chrono::hours(24);
+
   /// The maximum size for the cache directory, in terms of percentage of the
   /// available space on the the disk. Set to 100 to indicate no limit, 50 to
   /// indicate that the cache size will not be left over half the available disk
@@ -61,8 +67,22 @@ Expected<CachePruningPolicy> parseCachePruningPolicy(StringRef PolicyStr);
 /// As a safeguard against data loss if the user specifies the wrong directory
 /// as their cache directory, this function will ignore files not matching the
 /// pattern "llvmcache-*".
+///
+/// When the size limits are exceeded, the least recently used files are
+/// removed first. The directory is only walked when its index
+/// ("llvmcache.index") is missing or older than Policy.RescanInterval, in
+/// which case a new index is written. Otherwise the entries are pruned
+/// according to the index, see recordCacheEntryAccess(), and the work done is
+/// proportional to the number of removed and recently recorded entries.
 bool pruneCache(StringRef Path, CachePruningPolicy Policy);
 
+/// Record in the index of the cache directory \p Path, if it has one, that the
+/// entry \p EntryName of \p Size bytes was just added (if \p IsNewEntry) or
+/// used. Producers and consumers of cache entries should call this so that
+/// pruneCache() does not need to walk the cache directory.
+void recordCacheEntryAccess(StringRef Path, StringRef EntryName, uint64_t Size,
+                            bool IsNewEntry);
+
 } // namespace llvm
 
 #endif
@@ -35,6 +35,17 @@ bool isAvailable();
 Error compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer,
                CompressionLevel Level = DefaultCompression);
 
+/// Compress \p InputBuffer into a single zlib stream, like compress(), but
+/// split it in chunks of \p ChunkSize bytes that are compressed concurrently.
+/// Each chunk uses the end of the previous one as dictionary, so the
+/// compression ratio is close to the one of compress(). The output depends on
+/// \p ChunkSize but not on the number of threads, and inputs that fit in a
+/// single chunk are compressed exactly as by compress().
+Error compressChunked(StringRef InputBuffer,
+                      SmallVectorImpl<char> &CompressedBuffer,
+                      CompressionLevel Level = DefaultCompression,
+                      size_t ChunkSize = 1 << 20);
+
 Error uncompress(StringRef InputBuffer, char *UncompressedBuffer,
                  size_t &UncompressedSize);
 
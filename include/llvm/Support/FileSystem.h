@@ -717,6 +717,10 @@ inline OpenFlags &operator|=(OpenFlags &A, OpenFlags B) {
 std::error_code openFileForWrite(const Twine &Name, int &ResultFD,
                                  OpenFlags Flags, unsigned Mode = 0666);
 
+/// Opens the existing file \p Name for reading and writing, without
+/// truncating it.
+std::error_code openFileForReadWrite(const Twine &Name, int &ResultFD);
+
 std::error_code openFileForRead(const Twine &Name, int &ResultFD,
                                 SmallVectorImpl<char> *RealPath = nullptr);
 
@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
 
 #if defined(_MSC_VER) && LLVM_ENABLE_THREADS
@@ -42,6 +43,14 @@ struct is_execution_policy
 constexpr sequential_execution_policy seq{};
 constexpr parallel_execution_policy par{};
 
+/// Set the number of threads used by the parallel algorithms. It must be
+/// called before the first parallel algorithm runs; 0 means one thread per
+/// hardware thread.
+void setThreadCount(unsigned Count);
+
+/// \returns the number of threads used by the parallel algorithms.
+unsigned getThreadCount();
+
 namespace detail {
 
 #if LLVM_ENABLE_THREADS
@@ -73,12 +82,23 @@ public:
 };
 
 class TaskGroup {
+  struct TaskQueue;
+
   Latch L;
+  /// The spawned tasks that did not start yet. It is shared with the
+  /// executor, which may only get to a task after the group is gone.
+  std::shared_ptr<TaskQueue> Pending;
 
 public:
+  TaskGroup();
+  ~TaskGroup() { sync(); }
+
   void spawn(std::function<void()> f);
 
-  void sync() const { L.sync(); }
+  /// Wait for all the spawned tasks to complete. The calling thread runs the
+  /// tasks of this group that did not start yet in the meantime, so that
+  /// tasks can spawn and wait for nested tasks without starving the executor.
+  void sync();
 };
 
 #if defined(_MSC_VER)
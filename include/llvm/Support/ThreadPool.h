@@ -23,16 +23,19 @@
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <utility>
+#include <vector>
 
 namespace llvm {
 
+class ThreadPoolTaskGroup;
+
 /// A ThreadPool for asynchronous parallel execution on a defined number of
 /// threads.
 ///
 /// The pool keeps a vector of threads alive, waiting on a condition variable
-/// for some work to become available.
+/// for some work to become available. Tasks with a higher priority are started
+/// first, tasks with the same priority are started in submission order.
 class ThreadPool {
 public:
   using TaskTy = std::function<void()>;
@@ -64,20 +67,51 @@ public:
     return asyncImpl(std::forward<Function>(F));
   }
 
+  /// Asynchronous submission of a task to the pool, which is started before
+  /// all the queued tasks of a lower priority.
+  template <typename Function>
+  inline std::shared_future<void> asyncWithPriority(unsigned Priority,
+                                                    Function &&F) {
+    return asyncImpl(std::forward<Function>(F), Priority);
+  }
+
   /// Blocking wait for all the threads to complete and the queue to be empty.
   /// It is an error to try to add new tasks while blocking on this call.
   void wait();
 
 private:
+  friend class ThreadPoolTaskGroup;
+
+  struct QueuedTask {
+    PackagedTaskTy Task;
+    unsigned Priority;
+    /// Submission order, to keep the tasks of the same priority FIFO.
+    uint64_t Sequence;
+
+    /// Heap ordering: the task that must run first compares greatest.
+    bool operator<(const QueuedTask &Other) const {
+      if (Priority != Other.Priority)
+        return Priority < Other.Priority;
+      return Sequence > Other.Sequence;
+    }
+  };
+
   /// Asynchronous submission of a task to the pool. The returned future can be
   /// used to wait for the task to finish and is *non-blocking* on destruction.
-  std::shared_future<void> asyncImpl(TaskTy F);
+  std::shared_future<void> asyncImpl(TaskTy F, unsigned Priority = 0);
+
+  /// Push \p Task on the Tasks heap, QueueLock must be held.
+  void pushTask(PackagedTaskTy Task, unsigned Priority);
+
+  /// Pop the task of highest priority, QueueLock must be held.
+  PackagedTaskTy popTask();
 
   /// Threads in flight
   std::vector<llvm::thread> Threads;
 
-  /// Tasks waiting for execution in the pool.
-  std::queue<PackagedTaskTy> Tasks;
+  /// Tasks waiting for execution in the pool, as a max-heap of QueuedTask.
+  std::vector<QueuedTask> Tasks;
+  uint64_t NextSequence = 0;
 
   /// Locking and signaling for accessing the Tasks queue.
   std::mutex QueueLock;
@@ -95,6 +129,46 @@ private:
   bool EnableFlag;
 #endif
 };
+
+/// A set of tasks submitted to a ThreadPool, that can be waited for and
+/// cancelled independently of the other tasks of the pool.
+///
+/// Cancelling the group skips its tasks that have not started yet. The tasks
+/// already running are not interrupted, but they can poll isCancelled() to
+/// stop early. The futures of the skipped tasks are made ready as usual.
+class ThreadPoolTaskGroup {
+public:
+  explicit ThreadPoolTaskGroup(ThreadPool &Pool) : Pool(Pool) {}
+
+  /// Blocking destructor: waits for all the tasks of the group.
+  ~ThreadPoolTaskGroup() { wait(); }
+
+  /// Asynchronous submission of a task to the pool, as part of this group.
+  template <typename Function>
+  inline std::shared_future<void> async(Function &&F, unsigned Priority = 0) {
+    return asyncImpl(std::forward<Function>(F), Priority);
+  }
+
+  /// Blocking wait for the tasks of this group to complete. As for
+  /// ThreadPool::wait(), it must not be called from a task of the same pool.
+  void wait();
+
+  /// Skip the tasks of this group that have not started yet.
+  void cancel() { Cancelled = true; }
+
+  bool isCancelled() const { return Cancelled; }
+
+private:
+  std::shared_future<void> asyncImpl(ThreadPool::TaskTy F, unsigned Priority);
+
+  ThreadPool &Pool;
+  std::atomic<bool> Cancelled{false};
+
+  /// Number of tasks of the group that did not complete yet.
+  unsigned PendingTasks = 0;
+  std::mutex Lock;
+  std::condition_variable Completion;
+};
 }
 
 #endif // LLVM_SUPPORT_THREAD_POOL_H
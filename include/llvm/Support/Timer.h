@@ -12,6 +12,7 @@
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/DataTypes.h"
+#include <atomic>
 #include <cassert>
 #include <string>
 #include <utility>
@@ -28,6 +29,9 @@ class TimeRecord {
   double UserTime;       ///< User time elapsed.
   double SystemTime;     ///< System time elapsed.
   ssize_t MemUsed;       ///< Memory allocated (in bytes).
+
+  friend class Timer;
+
 public:
   TimeRecord() : WallTime(0), UserTime(0), SystemTime(0), MemUsed(0) {}
 
@@ -73,13 +77,22 @@ public:
 /// when the last timer is destroyed, otherwise it is printed when its
 /// TimerGroup is destroyed.  Timers do not print their information if they are
 /// never started.
+///
+/// A Timer can be started and stopped by several threads at the same time, the
+/// calls of each thread must be paired.  The time captured is the sum of the
+/// time spent by all the threads.  When a time trace is enabled (see
+/// writeTimeTrace()), every start/stop pair is also recorded as a scope of the
+/// calling thread.
 class Timer {
-  TimeRecord Time;          ///< The total time captured.
-  TimeRecord StartTime;     ///< The time startTimer() was last called.
+  /// The total time captured, which the threads running the timer add to
+  /// without locking.
+  std::atomic<double> WallTime{0}, UserTime{0}, SystemTime{0};
+  std::atomic<ssize_t> MemUsed{0};
   std::string Name;         ///< The name of this time variable.
   std::string Description;  ///< Description of this time variable.
-  bool Running;             ///< Is the timer currently running?
-  bool Triggered;           ///< Has the timer ever been triggered?
+  /// The number of threads currently running the timer.
+  std::atomic<unsigned> Running{0};
+  std::atomic<bool> Triggered{false}; ///< Has the timer ever been triggered?
   TimerGroup *TG = nullptr; ///< The TimerGroup this Timer is in.
 
   Timer **Prev;             ///< Pointer to \p Next of previous timer in group.
@@ -110,7 +123,7 @@ public:
   bool isInitialized() const { return TG != nullptr; }
 
   /// Check if the timer is currently running.
-  bool isRunning() const { return Running; }
+  bool isRunning() const { return Running != 0; }
 
   /// Check if startTimer() has ever been called on this timer.
   bool hasTriggered() const { return Triggered; }
@@ -127,7 +140,7 @@ public:
   void clear();
 
   /// Return the duration for which this timer has been running.
-  TimeRecord getTotalTime() const { return Time; }
+  TimeRecord getTotalTime() const;
 
 private:
   friend class TimerGroup;
@@ -153,6 +166,19 @@ public:
   }
 };
 
+/// Start recording the scopes timed by all the threads.  This is done on
+/// startup when -time-trace-file is given, and the trace is then written to
+/// that file by llvm_shutdown().
+void enableTimeTrace();
+
+/// Stop recording the scopes, unless -time-trace-file is given.  The scopes
+/// recorded so far are kept.
+void disableTimeTrace();
+
+/// Write the scopes recorded so far as Chrome trace events (to be loaded in
+/// chrome://tracing), with one track per thread.
+void writeTimeTrace(raw_ostream &OS);
+
 /// This class is basically a combination of TimeRegion and Timer.  It allows
 /// you to declare a new timer, AND specify the region to time, all in one
 /// statement.  All timers with the same name are merged.  This is primarily
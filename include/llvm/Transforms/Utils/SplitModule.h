@@ -34,10 +34,15 @@ class StringRef;
 ///   module.
 /// - Internal symbols defined in module-level inline asm should be visible to
 ///   each partition.
+///
+/// If BalanceBySize is set, all the definitions are balanced across the
+/// partitions by their number of instructions, rather than by a hash of their
+/// name, and the internal globals used by a single function stay in the
+/// partition of that function.
 void SplitModule(
     std::unique_ptr<Module> M, unsigned N,
     function_ref<void(std::unique_ptr<Module> MPart)> ModuleCallback,
-    bool PreserveLocals = false);
+    bool PreserveLocals = false, bool BalanceBySize = false);
 
 } // End llvm namespace
 
@@ -14,6 +14,7 @@
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
@@ -70,6 +71,7 @@
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -92,6 +94,11 @@ static cl::opt<bool> PrintSummaryGUIDs(
     cl::desc(
         "Print the global id for each value when reading the module summary"));
 
+static cl::opt<bool> ReadFunctionBodiesInParallel(
+    "parallel-function-body-reading", cl::init(false), cl::Hidden,
+    cl::desc("Decode the records of function bodies in parallel when "
+             "materializing a whole module"));
+
 namespace {
 
 enum {
@@ -437,6 +444,94 @@ BitcodeReaderBase::readNameFromStrtab(ArrayRef<uint64_t> Record) {
 
 namespace {
 
+/// The records of a function block, read ahead of parsing the function so
+/// that the records of several functions can be decoded in parallel. Only the
+/// function block itself is read ahead: nested blocks are left in the stream
+/// and parsed from there when they are reached.
+class PrereadFunctionBlock {
+  struct Entry {
+    BitstreamEntry Kind;
+    /// The code of a record.
+    unsigned Code;
+    /// The operands of a record, in Operands.
+    unsigned OperandsBegin;
+    unsigned NumOperands;
+    /// The position of a nested block, just after its block ID.
+    uint64_t Bit;
+  };
+
+  std::vector<Entry> Entries;
+  std::vector<uint64_t> Operands;
+  size_t NextEntry = 0;
+
+public:
+  /// Read the function block at \p Bit in a copy of \p Stream. Returns false
+  /// if the block is malformed, in which case it must be parsed from the
+  /// stream to diagnose it.
+  bool read(const BitstreamCursor &Stream, uint64_t Bit);
+
+  /// Return the next entry, as BitstreamCursor::advance would. For a nested
+  /// block, \p Stream is moved to the block so that it can be parsed or
+  /// skipped.
+  BitstreamEntry advance(BitstreamCursor &Stream);
+
+  /// Read the record just returned by advance into \p Record, and return its
+  /// code.
+  unsigned readRecord(SmallVectorImpl<uint64_t> &Record);
+};
+
+} // end anonymous namespace
+
+bool PrereadFunctionBlock::read(const BitstreamCursor &Stream, uint64_t Bit) {
+  BitstreamCursor Cursor = Stream;
+  Cursor.JumpToBit(Bit);
+  if (Cursor.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
+    return false;
+
+  SmallVector<uint64_t, 64> Record;
+  while (true) {
+    BitstreamEntry Kind = Cursor.advance();
+    switch (Kind.Kind) {
+    case BitstreamEntry::Error:
+      return false;
+    case BitstreamEntry::EndBlock:
+      Entries.push_back({Kind, 0, 0, 0, 0});
+      return true;
+    case BitstreamEntry::SubBlock:
+      Entries.push_back({Kind, 0, 0, 0, Cursor.GetCurrentBitNo()});
+      if (Cursor.SkipBlock())
+        return false;
+      continue;
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    unsigned Code = Cursor.readRecord(Kind.ID, Record);
+    Entries.push_back({Kind, Code, unsigned(Operands.size()),
+                       unsigned(Record.size()), 0});
+    Operands.insert(Operands.end(), Record.begin(), Record.end());
+  }
+}
+
+BitstreamEntry PrereadFunctionBlock::advance(BitstreamCursor &Stream) {
+  assert(NextEntry < Entries.size() && "Read past the end of the block");
+  const Entry &E = Entries[NextEntry++];
+  if (E.Kind.Kind == BitstreamEntry::SubBlock)
+    Stream.JumpToBit(E.Bit);
+  return E.Kind;
+}
+
+unsigned PrereadFunctionBlock::readRecord(SmallVectorImpl<uint64_t> &Record) {
+  const Entry &E = Entries[NextEntry - 1];
+  assert(E.Kind.Kind == BitstreamEntry::Record && "Not at a record");
+  Record.append(Operands.begin() + E.OperandsBegin,
+                Operands.begin() + E.OperandsBegin + E.NumOperands);
+  return E.Code;
+}
+
+namespace {
+
 class BitcodeReader : public BitcodeReaderBase, public GVMaterializer {
   LLVMContext &Context;
   Module *TheModule = nullptr;
@@ -493,6 +588,9 @@ class BitcodeReader : public BitcodeReaderBase, public GVMaterializer {
   /// where to find deferred function body in the stream.
   DenseMap<Function*, uint64_t> DeferredFunctionInfo;
 
+  /// The function blocks read ahead of materializing their functions.
+  DenseMap<Function *, std::unique_ptr<PrereadFunctionBlock>> PrereadFunctions;
+
   /// When Metadata block is initially scanned when parsing the module, we may
   /// choose to defer parsing of the metadata. This vector contains info about
   /// which Metadata blocks are deferred.
@@ -535,7 +633,8 @@ public:
   /// \brief Main interface to parsing a bitcode buffer.
   /// \returns true if an error occurred.
   Error parseBitcodeInto(Module *M, bool ShouldLazyLoadMetadata = false,
-                         bool IsImporting = false);
+                         bool IsImporting = false,
+                         bool LoadMetadataOnDemand = false);
 
   static uint64_t decodeSignRotatedValue(uint64_t V);
 
@@ -670,7 +769,9 @@ private:
   /// Save the positions of the Metadata blocks and skip parsing the blocks.
   Error rememberAndSkipMetadata();
   Error typeCheckLoadStoreInst(Type *ValType, Type *PtrType);
-  Error parseFunctionBody(Function *F);
+  Error parseFunctionBody(Function *F, PrereadFunctionBlock *Preread);
+  Module::iterator prereadFunctionBodies(Module::iterator I,
+                                         Module::iterator E);
   Error globalCleanup();
   Error resolveGlobalAndIndirectSymbolInits();
   Error parseUseLists();
@@ -683,7 +784,8 @@ private:
 
 /// Class to manage reading and parsing function summary index bitcode
 /// files/sections.
-class ModuleSummaryIndexBitcodeReader : public BitcodeReaderBase {
+class ModuleSummaryIndexBitcodeReader : public BitcodeReaderBase,
+                                        public SummaryMaterializer {
   /// The module index built during parsing.
   ModuleSummaryIndex &TheIndex;
 
@@ -726,13 +828,58 @@ class ModuleSummaryIndexBitcodeReader : public BitcodeReaderBase {
   /// this module by the client.
   unsigned ModuleId;
 
+  /// The version of the summary block, and whether it uses the old profile
+  /// format.
+  uint64_t Version = 0;
+  bool IsOldProfileFormat = false;
+
+  /// The last seen summary, to be used when we see an optional "OriginalName"
+  /// attachment.
+  GlobalValueSummary *LastSeenSummary = nullptr;
+  GlobalValue::GUID LastSeenGUID = 0;
+
+  /// We can expect to see any number of type ID information records before
+  /// each function summary records; these vectors store the information
+  /// collected so far so that it can be used to create the summary object.
+  std::vector<GlobalValue::GUID> PendingTypeTests;
+  std::vector<FunctionSummary::VFuncId> PendingTypeTestAssumeVCalls,
+      PendingTypeCheckedLoadVCalls;
+  std::vector<FunctionSummary::ConstVCall> PendingTypeTestAssumeConstVCalls,
+      PendingTypeCheckedLoadConstVCalls;
+
+  /// Whether to defer decoding the records of a combined summary until the
+  /// summaries of their GUID are first used.
+  bool Lazy;
+
+  /// A cursor inside the summary block, with all its abbreviations, used to
+  /// decode the deferred records.
+  BitstreamCursor LazyStream;
+
+  /// The bit offsets of the deferred summaries, sorted by GUID once the block
+  /// has been read. Each offset points to the first record of a summary,
+  /// which is either the summary record itself or the first type ID record
+  /// preceding it.
+  std::vector<std::pair<ValueInfo, uint64_t>> DeferredSummaries;
+
+  /// The GUIDs with a deferred summary in each module, by module ID.
+  DenseMap<uint64_t, std::vector<ValueInfo>> DeferredModuleValues;
+
 public:
   ModuleSummaryIndexBitcodeReader(BitstreamCursor Stream, StringRef Strtab,
                                   ModuleSummaryIndex &TheIndex,
-                                  StringRef ModulePath, unsigned ModuleId);
+                                  StringRef ModulePath, unsigned ModuleId,
+                                  bool Lazy = false);
 
   Error parseModule();
 
+  /// Return true if some summaries were deferred, in which case the reader
+  /// must stay alive as the materializer of the index.
+  bool hasDeferredSummaries() const { return !DeferredSummaries.empty(); }
+
+  void materialize(ValueInfo VI) override;
+  void materializeModule(StringRef ModulePath) override;
+  void materializeAll() override;
+
 private:
   void setValueGUID(uint64_t ValueID, StringRef ValueName,
                     GlobalValue::LinkageTypes Linkage,
@@ -745,6 +892,9 @@ private:
                                                     bool IsOldProfileFormat,
                                                     bool HasProfile);
   Error parseEntireSummary(unsigned ID);
+  Error parseSummaryRecord(unsigned BitCode, ArrayRef<uint64_t> Record);
+  Error checkDeferredRecord(unsigned BitCode, ArrayRef<uint64_t> Record);
+  Error parseDeferredSummary(uint64_t Bit);
   Error parseModuleStringTable();
 
   std::pair<ValueInfo, GlobalValue::GUID>
@@ -3288,9 +3438,12 @@ Error BitcodeReader::parseModule(uint64_t ResumeBit,
 }
 
 Error BitcodeReader::parseBitcodeInto(Module *M, bool ShouldLazyLoadMetadata,
-                                      bool IsImporting) {
+                                      bool IsImporting,
+                                      bool LoadMetadataOnDemand) {
   TheModule = M;
+  // Metadata imported for ThinLTO is always loaded on demand.
   MDLoader = MetadataLoader(Stream, *M, ValueList, IsImporting,
+                            IsImporting || LoadMetadataOnDemand,
                             [&](unsigned ID) { return getTypeByID(ID); });
   return parseModule(0, ShouldLazyLoadMetadata);
 }
@@ -3308,9 +3461,11 @@ Error BitcodeReader::typeCheckLoadStoreInst(Type *ValType, Type *PtrType) {
   return Error::success();
 }
 
-/// Lazily parse the specified function body block.
-Error BitcodeReader::parseFunctionBody(Function *F) {
-  if (Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
+/// Lazily parse the specified function body block. If \p Preread is set, the
+/// records of the block are read from it instead of the stream.
+Error BitcodeReader::parseFunctionBody(Function *F,
+                                       PrereadFunctionBlock *Preread) {
+  if (!Preread && Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
     return error("Invalid record");
 
   // Unexpected unresolved metadata when parsing function.
@@ -3345,7 +3500,8 @@ Error BitcodeReader::parseFunctionBody(Function *F) {
   SmallVector<uint64_t, 64> Record;
 
   while (true) {
-    BitstreamEntry Entry = Stream.advance();
+    BitstreamEntry Entry =
+        Preread ? Preread->advance(Stream) : Stream.advance();
 
     switch (Entry.Kind) {
     case BitstreamEntry::Error:
@@ -3393,7 +3549,8 @@ Error BitcodeReader::parseFunctionBody(Function *F) {
     // Read a record.
     Record.clear();
     Instruction *I = nullptr;
-    unsigned BitCode = Stream.readRecord(Entry.ID, Record);
+    unsigned BitCode = Preread ? Preread->readRecord(Record)
+                               : Stream.readRecord(Entry.ID, Record);
     switch (BitCode) {
     default: // Default behavior: reject
       return error("Invalid value");
@@ -4649,7 +4806,14 @@ Error BitcodeReader::materialize(GlobalValue *GV) {
   // Move the bit stream to the saved position of the deferred function body.
   Stream.JumpToBit(DFII->second);
 
-  if (Error Err = parseFunctionBody(F))
+  std::unique_ptr<PrereadFunctionBlock> Preread;
+  auto PFI = PrereadFunctions.find(F);
+  if (PFI != PrereadFunctions.end()) {
+    Preread = std::move(PFI->second);
+    PrereadFunctions.erase(PFI);
+  }
+
+  if (Error Err = parseFunctionBody(F, Preread.get()))
     return Err;
   F->setIsMaterializable(false);
 
@@ -4702,9 +4866,13 @@ Error BitcodeReader::materializeModule() {
   WillMaterializeAllForwardRefs = true;
 
   // Iterate over the module, deserializing any functions that are still on
-  // disk.
-  for (Function &F : *TheModule) {
-    if (Error Err = materialize(&F))
+  // disk. If requested, the records of the function bodies are read ahead in
+  // parallel, a window of functions at a time.
+  Module::iterator PrereadEnd = TheModule->begin();
+  for (auto I = TheModule->begin(), E = TheModule->end(); I != E; ++I) {
+    if (ReadFunctionBodiesInParallel && I == PrereadEnd)
+      PrereadEnd = prereadFunctionBodies(I, E);
+    if (Error Err = materialize(&*I))
       return Err;
   }
   // At this point, if there are any function bodies, parse the rest of
@@ -4748,15 +4916,46 @@ Error BitcodeReader::materializeModule() {
   return Error::success();
 }
 
+/// Read ahead the function blocks of the functions from \p I, and return the
+/// end of the functions read. Only the records are decoded, which doesn't
+/// touch the context and can be done in parallel; the functions are then
+/// built one at a time by parseFunctionBody.
+Module::iterator BitcodeReader::prereadFunctionBodies(Module::iterator I,
+                                                      Module::iterator E) {
+  const size_t WindowSize = 16 * parallel::getThreadCount();
+  std::vector<std::pair<Function *, uint64_t>> Bodies;
+  for (; I != E && Bodies.size() < WindowSize; ++I) {
+    if (!I->isMaterializable())
+      continue;
+    // Functions whose body hasn't been found yet are parsed from the stream.
+    auto DFII = DeferredFunctionInfo.find(&*I);
+    if (DFII == DeferredFunctionInfo.end() || DFII->second == 0)
+      continue;
+    Bodies.push_back({&*I, DFII->second});
+  }
+
+  std::vector<std::unique_ptr<PrereadFunctionBlock>> Blocks(Bodies.size());
+  parallel::for_each_n(parallel::par, size_t(0), Bodies.size(), [&](size_t N) {
+    auto Block = llvm::make_unique<PrereadFunctionBlock>();
+    if (Block->read(Stream, Bodies[N].second))
+      Blocks[N] = std::move(Block);
+  });
+
+  for (size_t N = 0, NE = Bodies.size(); N != NE; ++N)
+    if (Blocks[N])
+      PrereadFunctions[Bodies[N].first] = std::move(Blocks[N]);
+  return I;
+}
+
 std::vector<StructType *> BitcodeReader::getIdentifiedStructTypes() const {
   return IdentifiedStructTypes;
 }
 
 ModuleSummaryIndexBitcodeReader::ModuleSummaryIndexBitcodeReader(
     BitstreamCursor Cursor, StringRef Strtab, ModuleSummaryIndex &TheIndex,
-    StringRef ModulePath, unsigned ModuleId)
+    StringRef ModulePath, unsigned ModuleId, bool Lazy)
     : BitcodeReaderBase(std::move(Cursor), Strtab), TheIndex(TheIndex),
-      ModulePath(ModulePath), ModuleId(ModuleId) {}
+      ModulePath(ModulePath), ModuleId(ModuleId), Lazy(Lazy) {}
 
 ModuleSummaryIndex::ModuleInfo *
 ModuleSummaryIndexBitcodeReader::addThisModule() {
@@ -5014,8 +5213,16 @@ ModuleSummaryIndexBitcodeReader::makeRefList(ArrayRef<uint64_t> Record) {
 
 std::vector<FunctionSummary::EdgeTy> ModuleSummaryIndexBitcodeReader::makeCallList(
     ArrayRef<uint64_t> Record, bool IsOldProfileFormat, bool HasProfile) {
+  // Each call is encoded as the callee value id followed by zero, one or two
+  // extra fields; reserve exactly what is needed since these lists are kept
+  // alive for the whole thin link.
+  unsigned Stride = 1;
+  if (IsOldProfileFormat)
+    Stride += HasProfile ? 2 : 1;
+  else if (HasProfile)
+    Stride += 1;
   std::vector<FunctionSummary::EdgeTy> Ret;
-  Ret.reserve(Record.size());
+  Ret.reserve((Record.size() + Stride - 1) / Stride);
   for (unsigned I = 0, E = Record.size(); I != E; ++I) {
     CalleeInfo::HotnessType Hotness = CalleeInfo::HotnessType::Unknown;
     ValueInfo Callee = getValueInfoFromValueId(Record[I]).first;
@@ -5045,35 +5252,45 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
     if (Stream.readRecord(Entry.ID, Record) != bitc::FS_VERSION)
       return error("Invalid Summary Block: version expected");
   }
-  const uint64_t Version = Record[0];
-  const bool IsOldProfileFormat = Version == 1;
+  Version = Record[0];
+  IsOldProfileFormat = Version == 1;
   if (Version < 1 || Version > 4)
     return error("Invalid summary version " + Twine(Version) +
                  ", 1, 2, 3 or 4 expected");
   Record.clear();
 
-  // Keep around the last seen summary to be used when we see an optional
-  // "OriginalName" attachement.
-  GlobalValueSummary *LastSeenSummary = nullptr;
-  GlobalValue::GUID LastSeenGUID = 0;
+  LastSeenSummary = nullptr;
+  LastSeenGUID = 0;
 
-  // We can expect to see any number of type ID information records before
-  // each function summary records; these variables store the information
-  // collected so far so that it can be used to create the summary object.
-  std::vector<GlobalValue::GUID> PendingTypeTests;
-  std::vector<FunctionSummary::VFuncId> PendingTypeTestAssumeVCalls,
-      PendingTypeCheckedLoadVCalls;
-  std::vector<FunctionSummary::ConstVCall> PendingTypeTestAssumeConstVCalls,
-      PendingTypeCheckedLoadConstVCalls;
+  // In lazy mode, the bit offset of the first type ID record preceding the
+  // next summary record, or 0 if there is none.
+  uint64_t TypeIdRecordsBit = 0;
+
+  // In lazy mode, the GUIDs with a deferred summary so far, with their module
+  // ID, so that aliases can be checked against their aliasee.
+  DenseSet<std::pair<GlobalValue::GUID, uint64_t>> DeferredDefinitions;
 
   while (true) {
-    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+    BitstreamEntry Entry =
+        Stream.advanceSkippingSubblocks(BitstreamCursor::AF_DontPopBlockAtEnd);
 
     switch (Entry.Kind) {
     case BitstreamEntry::SubBlock: // Handled for us already.
     case BitstreamEntry::Error:
       return error("Malformed block");
     case BitstreamEntry::EndBlock:
+      // Keep a cursor inside the block, where all its abbreviations are
+      // known, to decode the deferred summaries.
+      if (hasDeferredSummaries()) {
+        LazyStream = Stream;
+        std::stable_sort(DeferredSummaries.begin(), DeferredSummaries.end(),
+                         [](const std::pair<ValueInfo, uint64_t> &L,
+                            const std::pair<ValueInfo, uint64_t> &R) {
+                           return L.first.Ref < R.first.Ref;
+                         });
+      }
+      if (Stream.ReadBlockEnd())
+        return error("Malformed block");
       return Error::success();
     case BitstreamEntry::Record:
       // The interesting case.
@@ -5087,261 +5304,465 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(unsigned ID) {
     // via the bitcode offset of the summary records (which were saved
     // in the combined index VST entries). The records also contain
     // information used for ThinLTO renaming and importing.
+    uint64_t RecordBit = Stream.GetCurrentBitNo() - Stream.getAbbrevIDWidth();
     Record.clear();
     auto BitCode = Stream.readRecord(Entry.ID, Record);
-    switch (BitCode) {
-    default: // Default behavior: ignore.
-      break;
-    case bitc::FS_VALUE_GUID: { // [valueid, refguid]
-      uint64_t ValueID = Record[0];
-      GlobalValue::GUID RefGUID = Record[1];
-      ValueIdToValueInfoMap[ValueID] =
-          std::make_pair(TheIndex.getOrInsertValueInfo(RefGUID), RefGUID);
-      break;
-    }
-    // FS_PERMODULE: [valueid, flags, instcount, fflags, numrefs,
-    //                numrefs x valueid, n x (valueid)]
-    // FS_PERMODULE_PROFILE: [valueid, flags, instcount, fflags, numrefs,
-    //                        numrefs x valueid,
-    //                        n x (valueid, hotness)]
-    case bitc::FS_PERMODULE:
-    case bitc::FS_PERMODULE_PROFILE: {
-      unsigned ValueID = Record[0];
-      uint64_t RawFlags = Record[1];
-      unsigned InstCount = Record[2];
-      uint64_t RawFunFlags = 0;
-      unsigned NumRefs = Record[3];
-      int RefListStartIndex = 4;
-      if (Version >= 4) {
-        RawFunFlags = Record[3];
-        NumRefs = Record[4];
-        RefListStartIndex = 5;
+    if (Lazy) {
+      switch (BitCode) {
+      case bitc::FS_TYPE_TESTS:
+      case bitc::FS_TYPE_TEST_ASSUME_VCALLS:
+      case bitc::FS_TYPE_CHECKED_LOAD_VCALLS:
+      case bitc::FS_TYPE_TEST_ASSUME_CONST_VCALL:
+      case bitc::FS_TYPE_CHECKED_LOAD_CONST_VCALL:
+        // These are decoded again along with a deferred summary, but a
+        // per-module summary needs them now.
+        if (Error Err = checkDeferredRecord(BitCode, Record))
+          return Err;
+        if (!TypeIdRecordsBit)
+          TypeIdRecordsBit = RecordBit;
+        break;
+      case bitc::FS_COMBINED:
+      case bitc::FS_COMBINED_PROFILE:
+      case bitc::FS_COMBINED_ALIAS:
+      case bitc::FS_COMBINED_GLOBALVAR_INIT_REFS: {
+        if (Error Err = checkDeferredRecord(BitCode, Record))
+          return Err;
+        ValueInfo VI = getValueInfoFromValueId(Record[0]).first;
+        if (BitCode == bitc::FS_COMBINED_ALIAS) {
+          GlobalValue::GUID AliaseeGUID =
+              getValueInfoFromValueId(Record[3]).first.getGUID();
+          if (!DeferredDefinitions.count({AliaseeGUID, Record[1]}))
+            return error("Alias expects aliasee summary to be parsed");
+        }
+        DeferredDefinitions.insert({VI.getGUID(), Record[1]});
+        const_cast<GlobalValueSummaryMapTy::value_type *>(VI.Ref)
+            ->second.Materializer = this;
+        DeferredSummaries.push_back(
+            {VI, TypeIdRecordsBit ? TypeIdRecordsBit : RecordBit});
+        DeferredModuleValues[Record[1]].push_back(VI);
+        TypeIdRecordsBit = 0;
+        PendingTypeTests.clear();
+        PendingTypeTestAssumeVCalls.clear();
+        PendingTypeCheckedLoadVCalls.clear();
+        PendingTypeTestAssumeConstVCalls.clear();
+        PendingTypeCheckedLoadConstVCalls.clear();
+        LastSeenGUID = VI.getGUID();
+        continue;
       }
-
-      auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
-      // The module path string ref set in the summary must be owned by the
-      // index's module string table. Since we don't have a module path
-      // string table section in the per-module index, we create a single
-      // module path string table entry with an empty (0) ID to take
-      // ownership.
-      int CallGraphEdgeStartIndex = RefListStartIndex + NumRefs;
-      assert(Record.size() >= RefListStartIndex + NumRefs &&
-             "Record size inconsistent with number of references");
-      std::vector<ValueInfo> Refs = makeRefList(
-          ArrayRef<uint64_t>(Record).slice(RefListStartIndex, NumRefs));
-      bool HasProfile = (BitCode == bitc::FS_PERMODULE_PROFILE);
-      std::vector<FunctionSummary::EdgeTy> Calls = makeCallList(
-          ArrayRef<uint64_t>(Record).slice(CallGraphEdgeStartIndex),
-          IsOldProfileFormat, HasProfile);
-      auto FS = llvm::make_unique<FunctionSummary>(
-          Flags, InstCount, getDecodedFFlags(RawFunFlags), std::move(Refs),
-          std::move(Calls), std::move(PendingTypeTests),
-          std::move(PendingTypeTestAssumeVCalls),
-          std::move(PendingTypeCheckedLoadVCalls),
-          std::move(PendingTypeTestAssumeConstVCalls),
-          std::move(PendingTypeCheckedLoadConstVCalls));
-      PendingTypeTests.clear();
-      PendingTypeTestAssumeVCalls.clear();
-      PendingTypeCheckedLoadVCalls.clear();
-      PendingTypeTestAssumeConstVCalls.clear();
-      PendingTypeCheckedLoadConstVCalls.clear();
-      auto VIAndOriginalGUID = getValueInfoFromValueId(ValueID);
-      FS->setModulePath(addThisModule()->first());
-      FS->setOriginalName(VIAndOriginalGUID.second);
-      TheIndex.addGlobalValueSummary(VIAndOriginalGUID.first, std::move(FS));
-      break;
-    }
-    // FS_ALIAS: [valueid, flags, valueid]
-    // Aliases must be emitted (and parsed) after all FS_PERMODULE entries, as
-    // they expect all aliasee summaries to be available.
-    case bitc::FS_ALIAS: {
-      unsigned ValueID = Record[0];
-      uint64_t RawFlags = Record[1];
-      unsigned AliaseeID = Record[2];
-      auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
-      auto AS = llvm::make_unique<AliasSummary>(Flags);
-      // The module path string ref set in the summary must be owned by the
-      // index's module string table. Since we don't have a module path
-      // string table section in the per-module index, we create a single
-      // module path string table entry with an empty (0) ID to take
-      // ownership.
-      AS->setModulePath(addThisModule()->first());
-
-      GlobalValue::GUID AliaseeGUID =
-          getValueInfoFromValueId(AliaseeID).first.getGUID();
-      auto AliaseeInModule =
-          TheIndex.findSummaryInModule(AliaseeGUID, ModulePath);
-      if (!AliaseeInModule)
-        return error("Alias expects aliasee summary to be parsed");
-      AS->setAliasee(AliaseeInModule);
-
-      auto GUID = getValueInfoFromValueId(ValueID);
-      AS->setOriginalName(GUID.second);
-      TheIndex.addGlobalValueSummary(GUID.first, std::move(AS));
-      break;
-    }
-    // FS_PERMODULE_GLOBALVAR_INIT_REFS: [valueid, flags, n x valueid]
-    case bitc::FS_PERMODULE_GLOBALVAR_INIT_REFS: {
-      unsigned ValueID = Record[0];
-      uint64_t RawFlags = Record[1];
-      auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
-      std::vector<ValueInfo> Refs =
-          makeRefList(ArrayRef<uint64_t>(Record).slice(2));
-      auto FS = llvm::make_unique<GlobalVarSummary>(Flags, std::move(Refs));
-      FS->setModulePath(addThisModule()->first());
-      auto GUID = getValueInfoFromValueId(ValueID);
-      FS->setOriginalName(GUID.second);
-      TheIndex.addGlobalValueSummary(GUID.first, std::move(FS));
-      break;
-    }
-    // FS_COMBINED: [valueid, modid, flags, instcount, fflags, numrefs,
-    //               numrefs x valueid, n x (valueid)]
-    // FS_COMBINED_PROFILE: [valueid, modid, flags, instcount, fflags, numrefs,
-    //                       numrefs x valueid, n x (valueid, hotness)]
-    case bitc::FS_COMBINED:
-    case bitc::FS_COMBINED_PROFILE: {
-      unsigned ValueID = Record[0];
-      uint64_t ModuleId = Record[1];
-      uint64_t RawFlags = Record[2];
-      unsigned InstCount = Record[3];
-      uint64_t RawFunFlags = 0;
-      unsigned NumRefs = Record[4];
-      int RefListStartIndex = 5;
-
-      if (Version >= 4) {
-        RawFunFlags = Record[4];
-        NumRefs = Record[5];
-        RefListStartIndex = 6;
+      case bitc::FS_COMBINED_ORIGINAL_NAME:
+        // The deferred summary picks up its original name when decoded, but
+        // the index needs the mapping now.
+        if (!LastSeenGUID)
+          return error(
+              "Name attachment that does not follow a combined record");
+        TheIndex.addOriginalName(LastSeenGUID, Record[0]);
+        LastSeenGUID = 0;
+        continue;
+      default:
+        TypeIdRecordsBit = 0;
+        break;
       }
-
-      auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
-      int CallGraphEdgeStartIndex = RefListStartIndex + NumRefs;
-      assert(Record.size() >= RefListStartIndex + NumRefs &&
-             "Record size inconsistent with number of references");
-      std::vector<ValueInfo> Refs = makeRefList(
-          ArrayRef<uint64_t>(Record).slice(RefListStartIndex, NumRefs));
-      bool HasProfile = (BitCode == bitc::FS_COMBINED_PROFILE);
-      std::vector<FunctionSummary::EdgeTy> Edges = makeCallList(
-          ArrayRef<uint64_t>(Record).slice(CallGraphEdgeStartIndex),
-          IsOldProfileFormat, HasProfile);
-      ValueInfo VI = getValueInfoFromValueId(ValueID).first;
-      auto FS = llvm::make_unique<FunctionSummary>(
-          Flags, InstCount, getDecodedFFlags(RawFunFlags), std::move(Refs),
-          std::move(Edges), std::move(PendingTypeTests),
-          std::move(PendingTypeTestAssumeVCalls),
-          std::move(PendingTypeCheckedLoadVCalls),
-          std::move(PendingTypeTestAssumeConstVCalls),
-          std::move(PendingTypeCheckedLoadConstVCalls));
-      PendingTypeTests.clear();
-      PendingTypeTestAssumeVCalls.clear();
-      PendingTypeCheckedLoadVCalls.clear();
-      PendingTypeTestAssumeConstVCalls.clear();
-      PendingTypeCheckedLoadConstVCalls.clear();
-      LastSeenSummary = FS.get();
-      LastSeenGUID = VI.getGUID();
-      FS->setModulePath(ModuleIdMap[ModuleId]);
-      TheIndex.addGlobalValueSummary(VI, std::move(FS));
-      break;
-    }
-    // FS_COMBINED_ALIAS: [valueid, modid, flags, valueid]
-    // Aliases must be emitted (and parsed) after all FS_COMBINED entries, as
-    // they expect all aliasee summaries to be available.
-    case bitc::FS_COMBINED_ALIAS: {
-      unsigned ValueID = Record[0];
-      uint64_t ModuleId = Record[1];
-      uint64_t RawFlags = Record[2];
-      unsigned AliaseeValueId = Record[3];
-      auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
-      auto AS = llvm::make_unique<AliasSummary>(Flags);
-      LastSeenSummary = AS.get();
-      AS->setModulePath(ModuleIdMap[ModuleId]);
-
-      auto AliaseeGUID =
-          getValueInfoFromValueId(AliaseeValueId).first.getGUID();
-      auto AliaseeInModule =
-          TheIndex.findSummaryInModule(AliaseeGUID, AS->modulePath());
-      if (!AliaseeInModule)
-        return error("Alias expects aliasee summary to be parsed");
-      AS->setAliasee(AliaseeInModule);
-
-      ValueInfo VI = getValueInfoFromValueId(ValueID).first;
-      LastSeenGUID = VI.getGUID();
-      TheIndex.addGlobalValueSummary(VI, std::move(AS));
-      break;
-    }
-    // FS_COMBINED_GLOBALVAR_INIT_REFS: [valueid, modid, flags, n x valueid]
-    case bitc::FS_COMBINED_GLOBALVAR_INIT_REFS: {
-      unsigned ValueID = Record[0];
-      uint64_t ModuleId = Record[1];
-      uint64_t RawFlags = Record[2];
-      auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
-      std::vector<ValueInfo> Refs =
-          makeRefList(ArrayRef<uint64_t>(Record).slice(3));
-      auto FS = llvm::make_unique<GlobalVarSummary>(Flags, std::move(Refs));
-      LastSeenSummary = FS.get();
-      FS->setModulePath(ModuleIdMap[ModuleId]);
-      ValueInfo VI = getValueInfoFromValueId(ValueID).first;
-      LastSeenGUID = VI.getGUID();
-      TheIndex.addGlobalValueSummary(VI, std::move(FS));
-      break;
     }
-    // FS_COMBINED_ORIGINAL_NAME: [original_name]
-    case bitc::FS_COMBINED_ORIGINAL_NAME: {
-      uint64_t OriginalName = Record[0];
-      if (!LastSeenSummary)
-        return error("Name attachment that does not follow a combined record");
-      LastSeenSummary->setOriginalName(OriginalName);
-      TheIndex.addOriginalName(LastSeenGUID, OriginalName);
-      // Reset the LastSeenSummary
-      LastSeenSummary = nullptr;
-      LastSeenGUID = 0;
-      break;
-    }
-    case bitc::FS_TYPE_TESTS:
-      assert(PendingTypeTests.empty());
-      PendingTypeTests.insert(PendingTypeTests.end(), Record.begin(),
-                              Record.end());
-      break;
+    if (Error Err = parseSummaryRecord(BitCode, Record))
+      return Err;
+  }
+  llvm_unreachable("Exit infinite loop");
+}
 
-    case bitc::FS_TYPE_TEST_ASSUME_VCALLS:
-      assert(PendingTypeTestAssumeVCalls.empty());
-      for (unsigned I = 0; I != Record.size(); I += 2)
-        PendingTypeTestAssumeVCalls.push_back({Record[I], Record[I+1]});
-      break;
+Error ModuleSummaryIndexBitcodeReader::parseSummaryRecord(
+    unsigned BitCode, ArrayRef<uint64_t> Record) {
+  switch (BitCode) {
+  default: // Default behavior: ignore.
+    break;
+  case bitc::FS_VALUE_GUID: { // [valueid, refguid]
+    uint64_t ValueID = Record[0];
+    GlobalValue::GUID RefGUID = Record[1];
+    ValueIdToValueInfoMap[ValueID] =
+        std::make_pair(TheIndex.getOrInsertValueInfo(RefGUID), RefGUID);
+    break;
+  }
+  // FS_PERMODULE: [valueid, flags, instcount, fflags, numrefs,
+  //                numrefs x valueid, n x (valueid)]
+  // FS_PERMODULE_PROFILE: [valueid, flags, instcount, fflags, numrefs,
+  //                        numrefs x valueid,
+  //                        n x (valueid, hotness)]
+  case bitc::FS_PERMODULE:
+  case bitc::FS_PERMODULE_PROFILE: {
+    unsigned ValueID = Record[0];
+    uint64_t RawFlags = Record[1];
+    unsigned InstCount = Record[2];
+    uint64_t RawFunFlags = 0;
+    unsigned NumRefs = Record[3];
+    int RefListStartIndex = 4;
+    if (Version >= 4) {
+      RawFunFlags = Record[3];
+      NumRefs = Record[4];
+      RefListStartIndex = 5;
+    }
+
+    auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
+    // The module path string ref set in the summary must be owned by the
+    // index's module string table. Since we don't have a module path
+    // string table section in the per-module index, we create a single
+    // module path string table entry with an empty (0) ID to take
+    // ownership.
+    int CallGraphEdgeStartIndex = RefListStartIndex + NumRefs;
+    assert(Record.size() >= RefListStartIndex + NumRefs &&
+           "Record size inconsistent with number of references");
+    std::vector<ValueInfo> Refs = makeRefList(
+        ArrayRef<uint64_t>(Record).slice(RefListStartIndex, NumRefs));
+    bool HasProfile = (BitCode == bitc::FS_PERMODULE_PROFILE);
+    std::vector<FunctionSummary::EdgeTy> Calls = makeCallList(
+        ArrayRef<uint64_t>(Record).slice(CallGraphEdgeStartIndex),
+        IsOldProfileFormat, HasProfile);
+    auto FS = llvm::make_unique<FunctionSummary>(
+        Flags, InstCount, getDecodedFFlags(RawFunFlags), std::move(Refs),
+        std::move(Calls), std::move(PendingTypeTests),
+        std::move(PendingTypeTestAssumeVCalls),
+        std::move(PendingTypeCheckedLoadVCalls),
+        std::move(PendingTypeTestAssumeConstVCalls),
+        std::move(PendingTypeCheckedLoadConstVCalls));
+    PendingTypeTests.clear();
+    PendingTypeTestAssumeVCalls.clear();
+    PendingTypeCheckedLoadVCalls.clear();
+    PendingTypeTestAssumeConstVCalls.clear();
+    PendingTypeCheckedLoadConstVCalls.clear();
+    auto VIAndOriginalGUID = getValueInfoFromValueId(ValueID);
+    FS->setModulePath(addThisModule()->first());
+    FS->setOriginalName(VIAndOriginalGUID.second);
+    TheIndex.addGlobalValueSummary(VIAndOriginalGUID.first, std::move(FS));
+    break;
+  }
+  // FS_ALIAS: [valueid, flags, valueid]
+  // Aliases must be emitted (and parsed) after all FS_PERMODULE entries, as
+  // they expect all aliasee summaries to be available.
+  case bitc::FS_ALIAS: {
+    unsigned ValueID = Record[0];
+    uint64_t RawFlags = Record[1];
+    unsigned AliaseeID = Record[2];
+    auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
+    auto AS = llvm::make_unique<AliasSummary>(Flags);
+    // The module path string ref set in the summary must be owned by the
+    // index's module string table. Since we don't have a module path
+    // string table section in the per-module index, we create a single
+    // module path string table entry with an empty (0) ID to take
+    // ownership.
+    AS->setModulePath(addThisModule()->first());
+
+    GlobalValue::GUID AliaseeGUID =
+        getValueInfoFromValueId(AliaseeID).first.getGUID();
+    auto AliaseeInModule =
+        TheIndex.findSummaryInModule(AliaseeGUID, ModulePath);
+    if (!AliaseeInModule)
+      return error("Alias expects aliasee summary to be parsed");
+    AS->setAliasee(AliaseeInModule);
+
+    auto GUID = getValueInfoFromValueId(ValueID);
+    AS->setOriginalName(GUID.second);
+    TheIndex.addGlobalValueSummary(GUID.first, std::move(AS));
+    break;
+  }
+  // FS_PERMODULE_GLOBALVAR_INIT_REFS: [valueid, flags, n x valueid]
+  case bitc::FS_PERMODULE_GLOBALVAR_INIT_REFS: {
+    unsigned ValueID = Record[0];
+    uint64_t RawFlags = Record[1];
+    auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
+    std::vector<ValueInfo> Refs =
+        makeRefList(ArrayRef<uint64_t>(Record).slice(2));
+    auto FS = llvm::make_unique<GlobalVarSummary>(Flags, std::move(Refs));
+    FS->setModulePath(addThisModule()->first());
+    auto GUID = getValueInfoFromValueId(ValueID);
+    FS->setOriginalName(GUID.second);
+    TheIndex.addGlobalValueSummary(GUID.first, std::move(FS));
+    break;
+  }
+  // FS_COMBINED: [valueid, modid, flags, instcount, fflags, numrefs,
+  //               numrefs x valueid, n x (valueid)]
+  // FS_COMBINED_PROFILE: [valueid, modid, flags, instcount, fflags, numrefs,
+  //                       numrefs x valueid, n x (valueid, hotness)]
+  case bitc::FS_COMBINED:
+  case bitc::FS_COMBINED_PROFILE: {
+    unsigned ValueID = Record[0];
+    uint64_t ModuleId = Record[1];
+    uint64_t RawFlags = Record[2];
+    unsigned InstCount = Record[3];
+    uint64_t RawFunFlags = 0;
+    unsigned NumRefs = Record[4];
+    int RefListStartIndex = 5;
+
+    if (Version >= 4) {
+      RawFunFlags = Record[4];
+      NumRefs = Record[5];
+      RefListStartIndex = 6;
+    }
+
+    auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
+    int CallGraphEdgeStartIndex = RefListStartIndex + NumRefs;
+    assert(Record.size() >= RefListStartIndex + NumRefs &&
+           "Record size inconsistent with number of references");
+    std::vector<ValueInfo> Refs = makeRefList(
+        ArrayRef<uint64_t>(Record).slice(RefListStartIndex, NumRefs));
+    bool HasProfile = (BitCode == bitc::FS_COMBINED_PROFILE);
+    std::vector<FunctionSummary::EdgeTy> Edges = makeCallList(
+        ArrayRef<uint64_t>(Record).slice(CallGraphEdgeStartIndex),
+        IsOldProfileFormat, HasProfile);
+    ValueInfo VI = getValueInfoFromValueId(ValueID).first;
+    auto FS = llvm::make_unique<FunctionSummary>(
+        Flags, InstCount, getDecodedFFlags(RawFunFlags), std::move(Refs),
+        std::move(Edges), std::move(PendingTypeTests),
+        std::move(PendingTypeTestAssumeVCalls),
+        std::move(PendingTypeCheckedLoadVCalls),
+        std::move(PendingTypeTestAssumeConstVCalls),
+        std::move(PendingTypeCheckedLoadConstVCalls));
+    PendingTypeTests.clear();
+    PendingTypeTestAssumeVCalls.clear();
+    PendingTypeCheckedLoadVCalls.clear();
+    PendingTypeTestAssumeConstVCalls.clear();
+    PendingTypeCheckedLoadConstVCalls.clear();
+    LastSeenSummary = FS.get();
+    LastSeenGUID = VI.getGUID();
+    FS->setModulePath(ModuleIdMap[ModuleId]);
+    TheIndex.addGlobalValueSummary(VI, std::move(FS));
+    break;
+  }
+  // FS_COMBINED_ALIAS: [valueid, modid, flags, valueid]
+  // Aliases must be emitted (and parsed) after all FS_COMBINED entries, as
+  // they expect all aliasee summaries to be available.
+  case bitc::FS_COMBINED_ALIAS: {
+    unsigned ValueID = Record[0];
+    uint64_t ModuleId = Record[1];
+    uint64_t RawFlags = Record[2];
+    unsigned AliaseeValueId = Record[3];
+    auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
+    auto AS = llvm::make_unique<AliasSummary>(Flags);
+    AS->setModulePath(ModuleIdMap[ModuleId]);
+
+    auto AliaseeGUID =
+        getValueInfoFromValueId(AliaseeValueId).first.getGUID();
+    auto AliaseeInModule =
+        TheIndex.findSummaryInModule(AliaseeGUID, AS->modulePath());
+    if (!AliaseeInModule)
+      return error("Alias expects aliasee summary to be parsed");
+    AS->setAliasee(AliaseeInModule);
+
+    ValueInfo VI = getValueInfoFromValueId(ValueID).first;
+    LastSeenSummary = AS.get();
+    LastSeenGUID = VI.getGUID();
+    TheIndex.addGlobalValueSummary(VI, std::move(AS));
+    break;
+  }
+  // FS_COMBINED_GLOBALVAR_INIT_REFS: [valueid, modid, flags, n x valueid]
+  case bitc::FS_COMBINED_GLOBALVAR_INIT_REFS: {
+    unsigned ValueID = Record[0];
+    uint64_t ModuleId = Record[1];
+    uint64_t RawFlags = Record[2];
+    auto Flags = getDecodedGVSummaryFlags(RawFlags, Version);
+    std::vector<ValueInfo> Refs =
+        makeRefList(ArrayRef<uint64_t>(Record).slice(3));
+    auto FS = llvm::make_unique<GlobalVarSummary>(Flags, std::move(Refs));
+    LastSeenSummary = FS.get();
+    FS->setModulePath(ModuleIdMap[ModuleId]);
+    ValueInfo VI = getValueInfoFromValueId(ValueID).first;
+    LastSeenGUID = VI.getGUID();
+    TheIndex.addGlobalValueSummary(VI, std::move(FS));
+    break;
+  }
+  // FS_COMBINED_ORIGINAL_NAME: [original_name]
+  case bitc::FS_COMBINED_ORIGINAL_NAME: {
+    uint64_t OriginalName = Record[0];
+    if (!LastSeenSummary)
+      return error("Name attachment that does not follow a combined record");
+    LastSeenSummary->setOriginalName(OriginalName);
+    TheIndex.addOriginalName(LastSeenGUID, OriginalName);
+    // Reset the LastSeenSummary
+    LastSeenSummary = nullptr;
+    LastSeenGUID = 0;
+    break;
+  }
+  case bitc::FS_TYPE_TESTS:
+    assert(PendingTypeTests.empty());
+    PendingTypeTests.insert(PendingTypeTests.end(), Record.begin(),
+                            Record.end());
+    break;
 
-    case bitc::FS_TYPE_CHECKED_LOAD_VCALLS:
-      assert(PendingTypeCheckedLoadVCalls.empty());
-      for (unsigned I = 0; I != Record.size(); I += 2)
-        PendingTypeCheckedLoadVCalls.push_back({Record[I], Record[I+1]});
-      break;
+  case bitc::FS_TYPE_TEST_ASSUME_VCALLS:
+    assert(PendingTypeTestAssumeVCalls.empty());
+    for (unsigned I = 0; I != Record.size(); I += 2)
+      PendingTypeTestAssumeVCalls.push_back({Record[I], Record[I+1]});
+    break;
 
-    case bitc::FS_TYPE_TEST_ASSUME_CONST_VCALL:
-      PendingTypeTestAssumeConstVCalls.push_back(
-          {{Record[0], Record[1]}, {Record.begin() + 2, Record.end()}});
-      break;
+  case bitc::FS_TYPE_CHECKED_LOAD_VCALLS:
+    assert(PendingTypeCheckedLoadVCalls.empty());
+    for (unsigned I = 0; I != Record.size(); I += 2)
+      PendingTypeCheckedLoadVCalls.push_back({Record[I], Record[I+1]});
+    break;
 
-    case bitc::FS_TYPE_CHECKED_LOAD_CONST_VCALL:
-      PendingTypeCheckedLoadConstVCalls.push_back(
-          {{Record[0], Record[1]}, {Record.begin() + 2, Record.end()}});
-      break;
+  case bitc::FS_TYPE_TEST_ASSUME_CONST_VCALL:
+    PendingTypeTestAssumeConstVCalls.push_back(
+        {{Record[0], Record[1]}, {Record.begin() + 2, Record.end()}});
+    break;
 
-    case bitc::FS_CFI_FUNCTION_DEFS: {
-      std::set<std::string> &CfiFunctionDefs = TheIndex.cfiFunctionDefs();
-      for (unsigned I = 0; I != Record.size(); I += 2)
-        CfiFunctionDefs.insert(
-            {Strtab.data() + Record[I], static_cast<size_t>(Record[I + 1])});
-      break;
-    }
-    case bitc::FS_CFI_FUNCTION_DECLS: {
-      std::set<std::string> &CfiFunctionDecls = TheIndex.cfiFunctionDecls();
-      for (unsigned I = 0; I != Record.size(); I += 2)
-        CfiFunctionDecls.insert(
-            {Strtab.data() + Record[I], static_cast<size_t>(Record[I + 1])});
+  case bitc::FS_TYPE_CHECKED_LOAD_CONST_VCALL:
+    PendingTypeCheckedLoadConstVCalls.push_back(
+        {{Record[0], Record[1]}, {Record.begin() + 2, Record.end()}});
+    break;
+
+  case bitc::FS_CFI_FUNCTION_DEFS: {
+    std::set<std::string> &CfiFunctionDefs = TheIndex.cfiFunctionDefs();
+    for (unsigned I = 0; I != Record.size(); I += 2)
+      CfiFunctionDefs.insert(
+          {Strtab.data() + Record[I], static_cast<size_t>(Record[I + 1])});
+    break;
+  }
+  case bitc::FS_CFI_FUNCTION_DECLS: {
+    std::set<std::string> &CfiFunctionDecls = TheIndex.cfiFunctionDecls();
+    for (unsigned I = 0; I != Record.size(); I += 2)
+      CfiFunctionDecls.insert(
+          {Strtab.data() + Record[I], static_cast<size_t>(Record[I + 1])});
+    break;
+  }
+  }
+  return Error::success();
+}
+
+// Check a record whose decoding is deferred, so that decoding it later cannot
+// fail: a lazily decoded summary is decoded where there is no way to return an
+// error to the caller.
+Error ModuleSummaryIndexBitcodeReader::checkDeferredRecord(
+    unsigned BitCode, ArrayRef<uint64_t> Record) {
+  auto IsValueId = [&](uint64_t ValueId) {
+    return ValueIdToValueInfoMap.count(ValueId) != 0;
+  };
+  switch (BitCode) {
+  default:
+    break;
+  // FS_COMBINED: [valueid, modid, flags, instcount, fflags, numrefs,
+  //               numrefs x valueid, n x (valueid)]
+  // FS_COMBINED_PROFILE: [valueid, modid, flags, instcount, fflags, numrefs,
+  //                       numrefs x valueid, n x (valueid, hotness)]
+  case bitc::FS_COMBINED:
+  case bitc::FS_COMBINED_PROFILE: {
+    unsigned RefListStartIndex = Version >= 4 ? 6 : 5;
+    if (Record.size() < RefListStartIndex || !IsValueId(Record[0]) ||
+        !ModuleIdMap.count(Record[1]))
+      return error("Invalid record");
+    uint64_t NumRefs = Record[RefListStartIndex - 1];
+    if (Record.size() - RefListStartIndex < NumRefs)
+      return error("Invalid record");
+    if (!llvm::all_of(Record.slice(RefListStartIndex, NumRefs), IsValueId))
+      return error("Invalid record");
+    // Each call is the callee value id followed by the fields skipped or read
+    // by makeCallList().
+    unsigned Stride = 1;
+    if (IsOldProfileFormat)
+      Stride += BitCode == bitc::FS_COMBINED_PROFILE ? 2 : 1;
+    else if (BitCode == bitc::FS_COMBINED_PROFILE)
+      Stride += 1;
+    ArrayRef<uint64_t> Calls = Record.slice(RefListStartIndex + NumRefs);
+    if (Calls.size() % Stride)
+      return error("Invalid record");
+    for (unsigned I = 0, E = Calls.size(); I != E; I += Stride)
+      if (!IsValueId(Calls[I]))
+        return error("Invalid record");
+    break;
+  }
+  // FS_COMBINED_ALIAS: [valueid, modid, flags, valueid]
+  case bitc::FS_COMBINED_ALIAS:
+    if (Record.size() < 4 || !IsValueId(Record[0]) ||
+        !ModuleIdMap.count(Record[1]) || !IsValueId(Record[3]))
+      return error("Invalid record");
+    break;
+  // FS_COMBINED_GLOBALVAR_INIT_REFS: [valueid, modid, flags, n x valueid]
+  case bitc::FS_COMBINED_GLOBALVAR_INIT_REFS:
+    if (Record.size() < 3 || !IsValueId(Record[0]) ||
+        !ModuleIdMap.count(Record[1]) ||
+        !llvm::all_of(Record.slice(3), IsValueId))
+      return error("Invalid record");
+    break;
+  case bitc::FS_TYPE_TEST_ASSUME_VCALLS:
+  case bitc::FS_TYPE_CHECKED_LOAD_VCALLS:
+    if (Record.size() % 2)
+      return error("Invalid record");
+    break;
+  case bitc::FS_TYPE_TEST_ASSUME_CONST_VCALL:
+  case bitc::FS_TYPE_CHECKED_LOAD_CONST_VCALL:
+    if (Record.size() < 2)
+      return error("Invalid record");
+    break;
+  }
+  return Error::success();
+}
+
+// Decode the summary whose first record is at bit offset Bit, along with the
+// original name attached to it.
+Error ModuleSummaryIndexBitcodeReader::parseDeferredSummary(uint64_t Bit) {
+  // Read all the records first: decoding an alias decodes its aliasee, which
+  // moves the cursor.
+  SmallVector<std::pair<unsigned, SmallVector<uint64_t, 64>>, 2> Records;
+  LazyStream.JumpToBit(Bit);
+  while (true) {
+    BitstreamEntry Entry = LazyStream.advanceSkippingSubblocks(
+        BitstreamCursor::AF_DontPopBlockAtEnd);
+    if (Entry.Kind != BitstreamEntry::Record)
+      return error("Malformed block");
+    Records.emplace_back();
+    unsigned BitCode = LazyStream.readRecord(Entry.ID, Records.back().second);
+    Records.back().first = BitCode;
+    if (BitCode == bitc::FS_COMBINED || BitCode == bitc::FS_COMBINED_PROFILE ||
+        BitCode == bitc::FS_COMBINED_ALIAS ||
+        BitCode == bitc::FS_COMBINED_GLOBALVAR_INIT_REFS)
       break;
-    }
-    }
   }
-  llvm_unreachable("Exit infinite loop");
+  BitstreamEntry Entry = LazyStream.advanceSkippingSubblocks(
+      BitstreamCursor::AF_DontPopBlockAtEnd);
+  if (Entry.Kind == BitstreamEntry::Record) {
+    SmallVector<uint64_t, 64> Record;
+    if (LazyStream.readRecord(Entry.ID, Record) ==
+        bitc::FS_COMBINED_ORIGINAL_NAME)
+      Records.push_back({bitc::FS_COMBINED_ORIGINAL_NAME, std::move(Record)});
+  }
+
+  for (auto &R : Records)
+    if (Error Err = parseSummaryRecord(R.first, R.second))
+      return Err;
+  return Error::success();
+}
+
+void ModuleSummaryIndexBitcodeReader::materialize(ValueInfo VI) {
+  const_cast<GlobalValueSummaryMapTy::value_type *>(VI.Ref)
+      ->second.Materializer = nullptr;
+  auto I = std::lower_bound(
+      DeferredSummaries.begin(), DeferredSummaries.end(), VI,
+      [](const std::pair<ValueInfo, uint64_t> &L, ValueInfo R) {
+        return L.first.Ref < R.Ref;
+      });
+  // The records were checked when the summary block was read, so decoding
+  // them again cannot fail.
+  for (; I != DeferredSummaries.end() && I->first.Ref == VI.Ref; ++I)
+    cantFail(parseDeferredSummary(I->second),
+             "Deferred summary records were checked when read");
+}
+
+void ModuleSummaryIndexBitcodeReader::materializeModule(StringRef ModulePath) {
+  for (auto &I : ModuleIdMap) {
+    if (I.second != ModulePath)
+      continue;
+    auto Values = DeferredModuleValues.find(I.first);
+    if (Values == DeferredModuleValues.end())
+      return;
+    for (ValueInfo VI : Values->second)
+      if (VI.Ref->second.Materializer)
+        materialize(VI);
+    DeferredModuleValues.erase(Values);
+    return;
+  }
+}
+
+void ModuleSummaryIndexBitcodeReader::materializeAll() {
+  for (auto &I : DeferredSummaries)
+    if (I.first.Ref->second.Materializer)
+      materialize(I.first);
+  DeferredModuleValues.clear();
 }
 
 // Parse the  module string table block into the Index.
@@ -5584,7 +6005,8 @@ llvm::getBitcodeFileContents(MemoryBufferRef Buffer) {
 /// everything.
 Expected<std::unique_ptr<Module>>
 BitcodeModule::getModuleImpl(LLVMContext &Context, bool MaterializeAll,
-                             bool ShouldLazyLoadMetadata, bool IsImporting) {
+                             bool ShouldLazyLoadMetadata, bool IsImporting,
+                             bool LoadMetadataOnDemand) {
   BitstreamCursor Stream(Buffer);
 
   std::string ProducerIdentification;
@@ -5607,8 +6029,8 @@ BitcodeModule::getModuleImpl(LLVMContext &Context, bool MaterializeAll,
   M->setMaterializer(R);
 
   // Delay parsing Metadata if ShouldLazyLoadMetadata is true.
-  if (Error Err =
-          R->parseBitcodeInto(M.get(), ShouldLazyLoadMetadata, IsImporting))
+  if (Error Err = R->parseBitcodeInto(M.get(), ShouldLazyLoadMetadata,
+                                      IsImporting, LoadMetadataOnDemand))
     return std::move(Err);
 
   if (MaterializeAll) {
@@ -5626,7 +6048,13 @@ BitcodeModule::getModuleImpl(LLVMContext &Context, bool MaterializeAll,
 Expected<std::unique_ptr<Module>>
 BitcodeModule::getLazyModule(LLVMContext &Context, bool ShouldLazyLoadMetadata,
                              bool IsImporting) {
-  return getModuleImpl(Context, false, ShouldLazyLoadMetadata, IsImporting);
+  return getModuleImpl(Context, false, ShouldLazyLoadMetadata, IsImporting,
+                       false);
+}
+
+Expected<std::unique_ptr<Module>>
+BitcodeModule::getLazyModuleForLinking(LLVMContext &Context) {
+  return getModuleImpl(Context, false, true, false, true);
 }
 
 // Parse the specified bitcode buffer and merge the index into CombinedIndex.
@@ -5658,6 +6086,25 @@ Expected<std::unique_ptr<ModuleSummaryIndex>> BitcodeModule::getSummary() {
   return std::move(Index);
 }
 
+// Parse the specified bitcode buffer, deferring the decoding of combined
+// summary records until they are used.
+Expected<std::unique_ptr<ModuleSummaryIndex>>
+BitcodeModule::getLazySummary() {
+  BitstreamCursor Stream(Buffer);
+  Stream.JumpToBit(ModuleBit);
+
+  auto Index = llvm::make_unique<ModuleSummaryIndex>();
+  auto R = llvm::make_unique<ModuleSummaryIndexBitcodeReader>(
+      std::move(Stream), Strtab, *Index, ModuleIdentifier, 0, /*Lazy=*/true);
+
+  if (Error Err = R->parseModule())
+    return std::move(Err);
+
+  if (R->hasDeferredSummaries())
+    Index->setMaterializer(std::move(R));
+  return std::move(Index);
+}
+
 // Check if the given bitcode buffer contains a global value summary block.
 Expected<BitcodeLTOInfo> BitcodeModule::getLTOInfo() {
   BitstreamCursor Stream(Buffer);
@@ -5727,7 +6174,7 @@ Expected<std::unique_ptr<Module>> llvm::getOwningLazyBitcodeModule(
 
 Expected<std::unique_ptr<Module>>
 BitcodeModule::parseModule(LLVMContext &Context) {
-  return getModuleImpl(Context, true, false, false);
+  return getModuleImpl(Context, true, false, false, false);
   // TODO: Restore the use-lists to the in-memory state when the bitcode was
   // written.  We must defer until the Module has been fully materialized.
 }
@@ -5784,6 +6231,15 @@ llvm::getModuleSummaryIndex(MemoryBufferRef Buffer) {
   return BM->getSummary();
 }
 
+Expected<std::unique_ptr<ModuleSummaryIndex>>
+llvm::getLazyModuleSummaryIndex(MemoryBufferRef Buffer) {
+  Expected<BitcodeModule> BM = getSingleModule(Buffer);
+  if (!BM)
+    return BM.takeError();
+
+  return BM->getLazySummary();
+}
+
 Expected<BitcodeLTOInfo> llvm::getBitcodeLTOInfo(MemoryBufferRef Buffer) {
   Expected<BitcodeModule> BM = getSingleModule(Buffer);
   if (!BM)
@@ -5803,3 +6259,18 @@ llvm::getModuleSummaryIndexForFile(StringRef Path,
     return nullptr;
   return getModuleSummaryIndex(**FileOrErr);
 }
+
+Expected<std::unique_ptr<ModuleSummaryIndex>>
+llvm::getLazyModuleSummaryIndexForFile(StringRef Path,
+                                       bool IgnoreEmptyThinLTOIndexFile) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
+      MemoryBuffer::getFileOrSTDIN(Path);
+  if (!FileOrErr)
+    return errorCodeToError(FileOrErr.getError());
+  if (IgnoreEmptyThinLTOIndexFile && !(*FileOrErr)->getBufferSize())
+    return nullptr;
+  auto IndexOrErr = getLazyModuleSummaryIndex(**FileOrErr);
+  if (IndexOrErr && *IndexOrErr && (*IndexOrErr)->isMaterializable())
+    (*IndexOrErr)->setOwnedMemoryBuffer(std::move(*FileOrErr));
+  return IndexOrErr;
+}
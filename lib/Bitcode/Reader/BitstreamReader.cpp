@@ -14,6 +14,131 @@
 
 using namespace llvm;
 
+//===----------------------------------------------------------------------===//
+//  SimpleBitstreamCursor implementation
+//===----------------------------------------------------------------------===//
+
+/// Records are decoded from a local copy of the current word, which the
+/// compiler can keep in registers: the cursor itself could alias the values
+/// being appended to the record, and would be reloaded after each of them.
+/// The copy must be flushed before the cursor is used directly.
+class SimpleBitstreamCursor::CachedWord {
+  SimpleBitstreamCursor &Cursor;
+  word_t Word;
+  unsigned Bits;
+
+public:
+  explicit CachedWord(SimpleBitstreamCursor &Cursor) : Cursor(Cursor) {
+    reload();
+  }
+  ~CachedWord() { flush(); }
+
+  void flush() {
+    Cursor.CurWord = Word;
+    Cursor.BitsInCurWord = Bits;
+  }
+
+  void reload() {
+    Word = Cursor.CurWord;
+    Bits = Cursor.BitsInCurWord;
+  }
+
+  word_t Read(unsigned NumBits) {
+    static const unsigned BitsInWord = MaxChunkSize;
+    static const unsigned Mask = sizeof(word_t) > 4 ? 0x3f : 0x1f;
+
+    if (Bits >= NumBits) {
+      word_t R = Word & (~word_t(0) >> (BitsInWord - NumBits));
+      Word >>= (NumBits & Mask);
+      Bits -= NumBits;
+      return R;
+    }
+
+    // The field straddles the next word: let the cursor refill it.
+    flush();
+    word_t R = Cursor.Read(NumBits);
+    reload();
+    return R;
+  }
+
+  /// Read a VBR into a \p ResultT, as ReadVBR and ReadVBR64 do.
+  template <typename ResultT> ResultT readVBR(unsigned NumBits) {
+    const uint32_t Continue = 1U << (NumBits - 1);
+    uint32_t Piece = Read(NumBits);
+    if ((Piece & Continue) == 0)
+      return ResultT(Piece);
+
+    ResultT Result = 0;
+    unsigned NextBit = 0;
+    while (true) {
+      Result |= ResultT(Piece & (Continue - 1)) << NextBit;
+
+      if ((Piece & Continue) == 0)
+        return Result;
+
+      NextBit += NumBits - 1;
+      Piece = Read(NumBits);
+    }
+  }
+
+  uint32_t ReadVBR(unsigned NumBits) { return readVBR<uint32_t>(NumBits); }
+  uint64_t ReadVBR64(unsigned NumBits) { return readVBR<uint64_t>(NumBits); }
+
+  /// Make room for \p NumElts fields of at least \p NumBits bits each at the
+  /// end of \p Vals, and return where they go.
+  uint64_t *prepareArray(size_t NumElts, unsigned NumBits,
+                         SmallVectorImpl<uint64_t> &Vals) {
+    // Reading the fields would run out of data anyway. Don't try to allocate
+    // room for a bogus number of them first.
+    uint64_t BitsLeft =
+        uint64_t(Cursor.BitcodeBytes.size() - Cursor.NextChar) * 8 + Bits;
+    if (uint64_t(NumElts) * NumBits > BitsLeft)
+      report_fatal_error("Unexpected end of file");
+    Vals.reserve(Vals.size() + NumElts);
+    return Vals.end();
+  }
+
+  void readFixedArray(unsigned NumBits, size_t NumElts,
+                      SmallVectorImpl<uint64_t> &Vals) {
+    assert(NumBits && NumBits <= MaxChunkSize && "Invalid field width");
+    uint64_t *Out = prepareArray(NumElts, NumBits, Vals);
+    for (size_t I = 0; I != NumElts; ++I)
+      Out[I] = Read(NumBits);
+    Vals.set_size(Vals.size() + NumElts);
+  }
+
+  void readVBR64Array(unsigned NumBits, size_t NumElts,
+                      SmallVectorImpl<uint64_t> &Vals) {
+    assert(NumBits && NumBits <= MaxChunkSize && "Invalid field width");
+    uint64_t *Out = prepareArray(NumElts, NumBits, Vals);
+    for (size_t I = 0; I != NumElts; ++I)
+      Out[I] = ReadVBR64(NumBits);
+    Vals.set_size(Vals.size() + NumElts);
+  }
+
+  void readChar6Array(size_t NumElts, SmallVectorImpl<uint64_t> &Vals) {
+    uint64_t *Out = prepareArray(NumElts, 6, Vals);
+    for (size_t I = 0; I != NumElts; ++I)
+      Out[I] = BitCodeAbbrevOp::DecodeChar6(Read(6));
+    Vals.set_size(Vals.size() + NumElts);
+  }
+};
+
+void SimpleBitstreamCursor::readFixedArray(unsigned NumBits, size_t NumElts,
+                                           SmallVectorImpl<uint64_t> &Vals) {
+  CachedWord(*this).readFixedArray(NumBits, NumElts, Vals);
+}
+
+void SimpleBitstreamCursor::readVBR64Array(unsigned NumBits, size_t NumElts,
+                                           SmallVectorImpl<uint64_t> &Vals) {
+  CachedWord(*this).readVBR64Array(NumBits, NumElts, Vals);
+}
+
+void SimpleBitstreamCursor::readChar6Array(size_t NumElts,
+                                           SmallVectorImpl<uint64_t> &Vals) {
+  CachedWord(*this).readChar6Array(NumElts, Vals);
+}
+
 //===----------------------------------------------------------------------===//
 //  BitstreamCursor implementation
 //===----------------------------------------------------------------------===//
@@ -48,7 +173,8 @@ bool BitstreamCursor::EnterSubBlock(unsigned BlockID, unsigned *NumWordsP) {
   return CurCodeSize == 0 || AtEndOfStream();
 }
 
-static uint64_t readAbbreviatedField(BitstreamCursor &Cursor,
+template <typename ReaderT>
+static uint64_t readAbbreviatedField(ReaderT &Cursor,
                                      const BitCodeAbbrevOp &Op) {
   assert(!Op.isLiteral() && "Not to be used with literals!");
 
@@ -58,10 +184,10 @@ static uint64_t readAbbreviatedField(BitstreamCursor &Cursor,
   case BitCodeAbbrevOp::Blob:
     llvm_unreachable("Should not reach here");
   case BitCodeAbbrevOp::Fixed:
-    assert((unsigned)Op.getEncodingData() <= Cursor.MaxChunkSize);
+    assert((unsigned)Op.getEncodingData() <= BitstreamCursor::MaxChunkSize);
     return Cursor.Read((unsigned)Op.getEncodingData());
   case BitCodeAbbrevOp::VBR:
-    assert((unsigned)Op.getEncodingData() <= Cursor.MaxChunkSize);
+    assert((unsigned)Op.getEncodingData() <= BitstreamCursor::MaxChunkSize);
     return Cursor.ReadVBR64((unsigned)Op.getEncodingData());
   case BitCodeAbbrevOp::Char6:
     return BitCodeAbbrevOp::DecodeChar6(Cursor.Read(6));
@@ -179,15 +305,16 @@ unsigned BitstreamCursor::skipRecord(unsigned AbbrevID) {
 unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
                                      SmallVectorImpl<uint64_t> &Vals,
                                      StringRef *Blob) {
+  CachedWord W(*this);
   if (AbbrevID == bitc::UNABBREV_RECORD) {
-    unsigned Code = ReadVBR(6);
-    unsigned NumElts = ReadVBR(6);
-    for (unsigned i = 0; i != NumElts; ++i)
-      Vals.push_back(ReadVBR64(6));
+    unsigned Code = W.ReadVBR(6);
+    unsigned NumElts = W.ReadVBR(6);
+    W.readVBR64Array(6, NumElts, Vals);
     return Code;
   }
 
   const BitCodeAbbrev *Abbv = getAbbrev(AbbrevID);
+  Vals.reserve(Vals.size() + Abbv->getNumOperandInfos());
 
   // Read the record code first.
   assert(Abbv->getNumOperandInfos() != 0 && "no record code in abbreviation?");
@@ -199,7 +326,7 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
     if (CodeOp.getEncoding() == BitCodeAbbrevOp::Array ||
         CodeOp.getEncoding() == BitCodeAbbrevOp::Blob)
       report_fatal_error("Abbreviation starts with an Array or a Blob");
-    Code = readAbbreviatedField(*this, CodeOp);
+    Code = readAbbreviatedField(W, CodeOp);
   }
 
   for (unsigned i = 1, e = Abbv->getNumOperandInfos(); i != e; ++i) {
@@ -211,13 +338,13 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
 
     if (Op.getEncoding() != BitCodeAbbrevOp::Array &&
         Op.getEncoding() != BitCodeAbbrevOp::Blob) {
-      Vals.push_back(readAbbreviatedField(*this, Op));
+      Vals.push_back(readAbbreviatedField(W, Op));
       continue;
     }
 
     if (Op.getEncoding() == BitCodeAbbrevOp::Array) {
       // Array case.  Read the number of elements as a vbr6.
-      unsigned NumElts = ReadVBR(6);
+      unsigned NumElts = W.ReadVBR(6);
 
       // Get the element encoding.
       if (i + 2 != e)
@@ -232,23 +359,21 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
       default:
         report_fatal_error("Array element type can't be an Array or a Blob");
       case BitCodeAbbrevOp::Fixed:
-        for (; NumElts; --NumElts)
-          Vals.push_back(Read((unsigned)EltEnc.getEncodingData()));
+        W.readFixedArray((unsigned)EltEnc.getEncodingData(), NumElts, Vals);
         break;
       case BitCodeAbbrevOp::VBR:
-        for (; NumElts; --NumElts)
-          Vals.push_back(ReadVBR64((unsigned)EltEnc.getEncodingData()));
+        W.readVBR64Array((unsigned)EltEnc.getEncodingData(), NumElts, Vals);
         break;
       case BitCodeAbbrevOp::Char6:
-        for (; NumElts; --NumElts)
-          Vals.push_back(BitCodeAbbrevOp::DecodeChar6(Read(6)));
+        W.readChar6Array(NumElts, Vals);
       }
       continue;
     }
 
     assert(Op.getEncoding() == BitCodeAbbrevOp::Blob);
     // Blob case.  Read the number of bytes as a vbr6.
-    unsigned NumElts = ReadVBR(6);
+    unsigned NumElts = W.ReadVBR(6);
+    W.flush();
     SkipToFourByteBoundary();  // 32-bit alignment
 
     // Figure out where the end of this blob will be including tail padding.
@@ -260,6 +385,7 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
     if (!canSkipToPos(NewEnd/8)) {
       Vals.append(NumElts, 0);
       skipToEnd();
+      W.reload();
       break;
     }
 
@@ -267,6 +393,7 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
     // over tail padding first, in case jumping to NewEnd invalidates the Blob
     // pointer.
     JumpToBit(NewEnd);
+    W.reload();
     const char *Ptr = (const char *)getPointerToBit(CurBitPos, NumElts);
 
     // If we can return a reference to the data, do so to avoid copying it.
@@ -274,8 +401,8 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
       *Blob = StringRef(Ptr, NumElts);
     } else {
       // Otherwise, unpack into Vals with zero extension.
-      for (; NumElts; --NumElts)
-        Vals.push_back((unsigned char)*Ptr++);
+      const unsigned char *UPtr = reinterpret_cast<const unsigned char *>(Ptr);
+      Vals.append(UPtr, UPtr + NumElts);
     }
   }
 
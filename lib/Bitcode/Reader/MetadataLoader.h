@@ -40,8 +40,13 @@ class MetadataLoader {
 
 public:
   ~MetadataLoader();
+  /// If \p IsLoadingOnDemand is true and the module-level metadata block has
+  /// an index, only the named metadata and the attachments of declarations
+  /// are parsed with the block, and other metadata is loaded as it is
+  /// referenced.
   MetadataLoader(BitstreamCursor &Stream, Module &TheModule,
                  BitcodeReaderValueList &ValueList, bool IsImporting,
+                 bool IsLoadingOnDemand,
                  std::function<Type *(unsigned)> getTypeByID);
   MetadataLoader &operator=(MetadataLoader &&);
   MetadataLoader(MetadataLoader &&);
@@ -65,10 +65,12 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/SHA1.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -86,6 +88,10 @@ static cl::opt<unsigned>
                    cl::desc("Number of metadatas above which we emit an index "
                             "to enable lazy-loading"));
 
+static cl::opt<bool> WriteFunctionBlocksInParallel(
+    "parallel-function-block-writing", cl::init(false), cl::Hidden,
+    cl::desc("Encode function blocks in parallel when writing a module"));
+
 namespace {
 
 /// These are manifest constants used by the bitcode writer. They do not need to
@@ -194,6 +200,17 @@ public:
               assignValueId(CallEdge.first.getGUID());
   }
 
+  /// Constructs a ModuleBitcodeWriterBase object that writes function blocks
+  /// of the same module as \p Parent to \p Stream. It shares the module-level
+  /// value enumeration of \p Parent, and only enumerates the function-local
+  /// values itself. Function blocks don't refer to the value ids of the
+  /// summary, so these are not copied.
+  ModuleBitcodeWriterBase(const ModuleBitcodeWriterBase &Parent,
+                          BitstreamWriter &Stream)
+      : BitcodeWriterBase(Stream, Parent.StrtabBuilder), M(Parent.M),
+        VE(&Parent.VE), Index(Parent.Index),
+        GlobalValueId(Parent.GlobalValueId) {}
+
 protected:
   void writePerModuleGlobalValueSummary();
 
@@ -261,6 +278,14 @@ public:
         Buffer(Buffer), GenerateHash(GenerateHash), ModHash(ModHash),
         BitcodeStartBit(Stream.GetCurrentBitNo()) {}
 
+  /// Constructs a ModuleBitcodeWriter object that encodes function blocks of
+  /// the module written by \p Parent into \p Buffer, to be emitted into the
+  /// stream of \p Parent with EmitEncodedSubblock.
+  ModuleBitcodeWriter(const ModuleBitcodeWriter &Parent,
+                      SmallVectorImpl<char> &Buffer, BitstreamWriter &Stream)
+      : ModuleBitcodeWriterBase(Parent, Stream), Buffer(Buffer),
+        GenerateHash(false), ModHash(nullptr), BitcodeStartBit(0) {}
+
   /// Emit the current module to the bitstream.
   void write();
 
@@ -375,6 +400,10 @@ private:
   void
   writeFunction(const Function &F,
                 DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
+  void writeFunctionBlockContents(const Function &F);
+  void writeFunctionsInParallel(
+      ArrayRef<const Function *> Functions,
+      DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
   void writeBlockInfo();
   void writeModuleHash(size_t BlockStartPos);
 
@@ -2176,10 +2205,9 @@ void ModuleBitcodeWriter::writeConstants(unsigned FirstVal, unsigned LastVal,
 
   SmallVector<uint64_t, 64> Record;
 
-  const ValueEnumerator::ValueList &Vals = VE.getValues();
   Type *LastTy = nullptr;
   for (unsigned i = FirstVal; i != LastVal; ++i) {
-    const Value *V = Vals[i].first;
+    const Value *V = VE.getValue(i);
     // If we need to switch types, do so now.
     if (V->getType() != LastTy) {
       LastTy = V->getType();
@@ -2977,6 +3005,13 @@ void ModuleBitcodeWriter::writeFunction(
   FunctionToBitcodeIndex[&F] = Stream.GetCurrentBitNo();
 
   Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
+  writeFunctionBlockContents(F);
+  Stream.ExitBlock();
+}
+
+/// Emit the records and nested blocks of a function block that has just been
+/// entered.
+void ModuleBitcodeWriter::writeFunctionBlockContents(const Function &F) {
   VE.incorporateFunction(F);
 
   SmallVector<unsigned, 64> Vals;
@@ -3043,7 +3078,50 @@ void ModuleBitcodeWriter::writeFunction(
   if (VE.shouldPreserveUseListOrder())
     writeUseListBlock(&F);
   VE.purgeFunction();
-  Stream.ExitBlock();
+}
+
+/// Emit the function blocks of \p Functions, in order. The blocks are encoded
+/// concurrently into separate buffers by writers that share the module-level
+/// value enumeration, and then copied into the stream. The contents of a
+/// function block don't depend on its position, so the output is the same as
+/// writing them one after the other.
+void ModuleBitcodeWriter::writeFunctionsInParallel(
+    ArrayRef<const Function *> Functions,
+    DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex) {
+  struct EncodedFunction {
+    unsigned Worker;
+    size_t Begin, End;
+  };
+  std::vector<EncodedFunction> Encoded(Functions.size());
+  size_t NumWorkers =
+      std::min<size_t>(parallel::getThreadCount(), Functions.size());
+  std::vector<SmallVector<char, 0>> Buffers(NumWorkers);
+
+  // Workers take the next function to encode until there are none left, so
+  // that large functions don't hold up the others.
+  std::atomic<size_t> NextFunction(0);
+  parallel::for_each_n(parallel::par, size_t(0), NumWorkers, [&](size_t W) {
+    SmallVectorImpl<char> &WorkerBuffer = Buffers[W];
+    BitstreamWriter WorkerStream(WorkerBuffer);
+    WorkerStream.CopyBlockInfo(Stream);
+    ModuleBitcodeWriter Writer(*this, WorkerBuffer, WorkerStream);
+    for (size_t I = NextFunction++; I < Functions.size(); I = NextFunction++) {
+      WorkerStream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
+      Encoded[I].Worker = W;
+      Encoded[I].Begin = WorkerBuffer.size();
+      Writer.writeFunctionBlockContents(*Functions[I]);
+      WorkerStream.ExitBlock();
+      Encoded[I].End = WorkerBuffer.size();
+    }
+  });
+
+  for (size_t I = 0, E = Functions.size(); I != E; ++I) {
+    FunctionToBitcodeIndex[Functions[I]] = Stream.GetCurrentBitNo();
+    const EncodedFunction &EF = Encoded[I];
+    Stream.EmitEncodedSubblock(
+        bitc::FUNCTION_BLOCK_ID, 4,
+        makeArrayRef(Buffers[EF.Worker]).slice(EF.Begin, EF.End - EF.Begin));
+  }
 }
 
 // Emit blockinfo, which defines the standard abbreviations etc.
@@ -3824,9 +3902,19 @@ void ModuleBitcodeWriter::write() {
 
   // Emit function bodies.
   DenseMap<const Function *, uint64_t> FunctionToBitcodeIndex;
-  for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
-    if (!F->isDeclaration())
-      writeFunction(*F, FunctionToBitcodeIndex);
+  // Use-list orders are consumed in function order from the value
+  // enumeration, so they can only be written serially.
+  if (WriteFunctionBlocksInParallel && !VE.shouldPreserveUseListOrder()) {
+    std::vector<const Function *> Functions;
+    for (const Function &F : M)
+      if (!F.isDeclaration())
+        Functions.push_back(&F);
+    writeFunctionsInParallel(Functions, FunctionToBitcodeIndex);
+  } else {
+    for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+      if (!F->isDeclaration())
+        writeFunction(*F, FunctionToBitcodeIndex);
+  }
 
   // Need to write after the above call to WriteFunction which populates
   // the summary information in the index.
@@ -440,6 +440,13 @@ ValueEnumerator::ValueEnumerator(const Module &M,
   organizeMetadata();
 }
 
+ValueEnumerator::ValueEnumerator(const ValueEnumerator *Parent)
+    : Parent(Parent), NumParentValues(Parent->Values.size()),
+      NumParentMDs(Parent->MDs.size()),
+      ShouldPreserveUseListOrder(Parent->ShouldPreserveUseListOrder) {
+  assert(!Parent->Parent && "Expected a module-level enumeration");
+}
+
 unsigned ValueEnumerator::getInstructionID(const Instruction *Inst) const {
   InstructionMapType::const_iterator I = InstructionMap.find(Inst);
   assert(I != InstructionMap.end() && "Instruction is not mapped!");
@@ -447,6 +454,8 @@ unsigned ValueEnumerator::getInstructionID(const Instruction *Inst) const {
 }
 
 unsigned ValueEnumerator::getComdatID(const Comdat *C) const {
+  if (Parent)
+    return Parent->getComdatID(C);
   unsigned ComdatID = Comdats.idFor(C);
   assert(ComdatID && "Comdat not found!");
   return ComdatID;
@@ -461,6 +470,8 @@ unsigned ValueEnumerator::getValueID(const Value *V) const {
     return getMetadataID(MD->getMetadata());
 
   ValueMapType::const_iterator I = ValueMap.find(V);
+  if (I == ValueMap.end() && Parent)
+    return Parent->getValueID(V);
   assert(I != ValueMap.end() && "Value not in slotcalculator!");
   return I->second-1;
 }
@@ -524,7 +535,10 @@ void ValueEnumerator::OptimizeConstants(unsigned CstStart, unsigned CstEnd) {
     // Disable it for now when trying to preserve the order.
     return;
 
-  std::stable_sort(Values.begin() + CstStart, Values.begin() + CstEnd,
+  // The range is given in value IDs, which start after those of Parent.
+  auto Begin = Values.begin() + (CstStart - NumParentValues);
+  auto End = Values.begin() + (CstEnd - NumParentValues);
+  std::stable_sort(Begin, End,
                    [this](const std::pair<const Value *, unsigned> &LHS,
                           const std::pair<const Value *, unsigned> &RHS) {
     // Sort by plane.
@@ -537,12 +551,11 @@ void ValueEnumerator::OptimizeConstants(unsigned CstStart, unsigned CstEnd) {
   // Ensure that integer and vector of integer constants are at the start of the
   // constant pool.  This is important so that GEP structure indices come before
   // gep constant exprs.
-  std::stable_partition(Values.begin() + CstStart, Values.begin() + CstEnd,
-                        isIntOrIntVectorValue);
+  std::stable_partition(Begin, End, isIntOrIntVectorValue);
 
   // Rebuild the modified portion of ValueMap.
   for (; CstStart != CstEnd; ++CstStart)
-    ValueMap[Values[CstStart].first] = CstStart+1;
+    ValueMap[Values[CstStart - NumParentValues].first] = CstStart+1;
 }
 
 /// EnumerateValueSymbolTable - Insert all of the values in the specified symbol
@@ -703,7 +716,7 @@ void ValueEnumerator::EnumerateFunctionLocalMetadata(
 
   MDs.push_back(Local);
   Index.F = F;
-  Index.ID = MDs.size();
+  Index.ID = NumParentMDs + MDs.size();
 
   EnumerateValue(Local->getValue());
 }
@@ -796,21 +809,27 @@ void ValueEnumerator::organizeMetadata() {
 void ValueEnumerator::incorporateFunctionMetadata(const Function &F) {
   NumModuleMDs = MDs.size();
 
-  auto R = FunctionMDInfo.lookup(getValueID(&F) + 1);
+  const ValueEnumerator &ModuleVE = Parent ? *Parent : *this;
+  auto R = ModuleVE.FunctionMDInfo.lookup(getValueID(&F) + 1);
   NumMDStrings = R.NumStrings;
-  MDs.insert(MDs.end(), FunctionMDs.begin() + R.First,
-             FunctionMDs.begin() + R.Last);
+  MDs.insert(MDs.end(), ModuleVE.FunctionMDs.begin() + R.First,
+             ModuleVE.FunctionMDs.begin() + R.Last);
 }
 
 void ValueEnumerator::EnumerateValue(const Value *V) {
   assert(!V->getType()->isVoidTy() && "Can't insert void values!");
   assert(!isa<MetadataAsValue>(V) && "EnumerateValue doesn't handle Metadata!");
 
+  // Values of the module are already in. Their use counts only served to
+  // order the module constants, so they are not updated.
+  if (Parent && Parent->ValueMap.count(V))
+    return;
+
   // Check to see if it's already in!
   unsigned &ValueID = ValueMap[V];
   if (ValueID) {
     // Increment use count.
-    Values[ValueID-1].second++;
+    Values[ValueID - NumParentValues - 1].second++;
     return;
   }
 
@@ -841,18 +860,25 @@ void ValueEnumerator::EnumerateValue(const Value *V) {
       // Finally, add the value.  Doing this could make the ValueID reference be
       // dangling, don't reuse it.
       Values.push_back(std::make_pair(V, 1U));
-      ValueMap[V] = Values.size();
+      ValueMap[V] = NumParentValues + Values.size();
       return;
     }
   }
 
   // Add the value.
   Values.push_back(std::make_pair(V, 1U));
-  ValueID = Values.size();
+  ValueID = NumParentValues + Values.size();
 }
 
 
 void ValueEnumerator::EnumerateType(Type *Ty) {
+  // The type table is written before any function, so function bodies can't
+  // introduce new types.
+  if (Parent) {
+    assert(Parent->TypeMap.count(Ty) && "Type not in the module enumeration!");
+    return;
+  }
+
   unsigned *TypeID = &TypeMap[Ty];
 
   // We've already seen this type.
@@ -918,6 +944,10 @@ void ValueEnumerator::EnumerateOperandType(const Value *V) {
 
 void ValueEnumerator::EnumerateAttributes(AttributeList PAL) {
   if (PAL.isEmpty()) return;  // null is always 0.
+  // Likewise, the attributes of functions and calls are written before any
+  // function.
+  if (Parent)
+    return;
 
   // Do a lookup.
   unsigned &Entry = AttributeListMap[PAL];
@@ -953,7 +983,7 @@ void ValueEnumerator::incorporateFunction(const Function &F) {
   for (const auto &I : F.args())
     EnumerateValue(&I);
 
-  FirstFuncConstantID = Values.size();
+  FirstFuncConstantID = NumParentValues + Values.size();
 
   // Add all function-level constants to the value table.
   for (const BasicBlock &BB : F) {
@@ -967,13 +997,13 @@ void ValueEnumerator::incorporateFunction(const Function &F) {
   }
 
   // Optimize the constant layout.
-  OptimizeConstants(FirstFuncConstantID, Values.size());
+  OptimizeConstants(FirstFuncConstantID, NumParentValues + Values.size());
 
   // Add the function's parameter attributes so they are available for use in
   // the function's instruction.
   EnumerateAttributes(F.getAttributes());
 
-  FirstInstID = Values.size();
+  FirstInstID = NumParentValues + Values.size();
 
   SmallVector<LocalAsMetadata *, 8> FnLocalMDVector;
   // Add all of the instructions.
@@ -54,6 +54,16 @@ public:
   UseListOrderStack UseListOrders;
 
 private:
+  /// The enumerator holding the module-level enumeration, for an enumerator
+  /// that only holds the state of the incorporated function. See
+  /// ValueEnumerator(const ValueEnumerator *).
+  const ValueEnumerator *Parent = nullptr;
+
+  /// The number of values and metadata enumerated by Parent. Values and MDs
+  /// only hold the entries that follow them.
+  unsigned NumParentValues = 0;
+  unsigned NumParentMDs = 0;
+
   using TypeMapType = DenseMap<Type *, unsigned>;
   TypeMapType TypeMap;
   TypeList Types;
@@ -139,6 +149,14 @@ private:
 
 public:
   ValueEnumerator(const Module &M, bool ShouldPreserveUseListOrder);
+
+  /// Create an enumerator that incorporates functions on top of the
+  /// module-level enumeration of \p Parent, which is shared rather than
+  /// copied. Several such enumerators can incorporate functions concurrently.
+  /// \p Parent must outlive them, and must not incorporate functions itself
+  /// meanwhile.
+  explicit ValueEnumerator(const ValueEnumerator *Parent);
+
   ValueEnumerator(const ValueEnumerator &) = delete;
   ValueEnumerator &operator=(const ValueEnumerator &) = delete;
 
@@ -156,7 +174,10 @@ public:
   }
 
   unsigned getMetadataOrNullID(const Metadata *MD) const {
-    return MetadataMap.lookup(MD).ID;
+    auto I = MetadataMap.find(MD);
+    if (I == MetadataMap.end())
+      return Parent ? Parent->getMetadataOrNullID(MD) : 0;
+    return I->second.ID;
   }
 
   unsigned numMDs() const { return MDs.size(); }
@@ -164,6 +185,8 @@ public:
   bool shouldPreserveUseListOrder() const { return ShouldPreserveUseListOrder; }
 
   unsigned getTypeID(Type *T) const {
+    if (Parent)
+      return Parent->getTypeID(T);
     TypeMapType::const_iterator I = TypeMap.find(T);
     assert(I != TypeMap.end() && "Type not in ValueEnumerator!");
     return I->second-1;
@@ -174,6 +197,8 @@ public:
 
   unsigned getAttributeListID(AttributeList PAL) const {
     if (PAL.isEmpty()) return 0;  // Null maps to zero.
+    if (Parent)
+      return Parent->getAttributeListID(PAL);
     AttributeListMapType::const_iterator I = AttributeListMap.find(PAL);
     assert(I != AttributeListMap.end() && "Attribute not in ValueEnumerator!");
     return I->second;
@@ -182,6 +207,8 @@ public:
   unsigned getAttributeGroupID(IndexAndAttrSet Group) const {
     if (!Group.second.hasAttributes())
       return 0; // Null maps to zero.
+    if (Parent)
+      return Parent->getAttributeGroupID(Group);
     AttributeGroupMapType::const_iterator I = AttributeGroupMap.find(Group);
     assert(I != AttributeGroupMap.end() && "Attribute not in ValueEnumerator!");
     return I->second;
@@ -194,8 +221,17 @@ public:
     End = FirstInstID;
   }
 
+  /// Return the values of the module. For an enumerator with a parent, only
+  /// return those of the incorporated function.
   const ValueList &getValues() const { return Values; }
 
+  /// Return the value with the given ID.
+  const Value *getValue(unsigned ID) const {
+    if (ID < NumParentValues)
+      return Parent->getValue(ID);
+    return Values[ID - NumParentValues].first;
+  }
+
   /// Check whether the current block has any metadata to emit.
   bool hasMDs() const { return NumModuleMDs < MDs.size(); }
 
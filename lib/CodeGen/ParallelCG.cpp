@@ -93,7 +93,7 @@ std::unique_ptr<Module> llvm::splitCodeGen(
               // copied into the thread's context.
               std::move(BC));
         },
-        PreserveLocals);
+        PreserveLocals, /*BalanceBySize=*/true);
   }
 
   return {};
@@ -41,6 +41,7 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
@@ -258,6 +259,11 @@ void DWARFContext::dump(raw_ostream &OS, DIDumpOptions DumpOpts) {
     getDebugAbbrevDWO()->dump(OS);
   }
 
+  // Parse all the units up front so that the dump below, which has to be
+  // sequential, doesn't also parse them one at a time.
+  if (DumpType & (DIDT_DebugInfo | DIDT_DebugTypes))
+    extractAllDIEs();
+
   if (shouldDump(DIDT_DebugInfo, DObj->getInfoSection().Data)) {
     OS << "\n.debug_info contents:\n";
     for (const auto &CU : compile_units())
@@ -483,6 +489,10 @@ bool DWARFContext::verify(raw_ostream &OS, unsigned DumpType,
   bool Success = true;
   DWARFVerifier verifier(OS, *this, DumpOpts);
 
+  // The checks below look DIEs up across all units.
+  if (DumpType & (DIDT_DebugInfo | DIDT_DebugLine))
+    extractAllDIEs();
+
   Success &= verifier.handleDebugAbbrev();
   if (DumpType & DIDT_DebugInfo)
     Success &= verifier.handleDebugInfo();
@@ -621,9 +631,6 @@ const DWARFDebugMacro *DWARFContext::getDebugMacro() {
 
 const DWARFLineTable *
 DWARFContext::getLineTableForUnit(DWARFUnit *U) {
-  if (!Line)
-    Line.reset(new DWARFDebugLine);
-
   auto UnitDIE = U->getUnitDIE();
   if (!UnitDIE)
     return nullptr;
@@ -633,25 +640,38 @@ DWARFContext::getLineTableForUnit(DWARFUnit *U) {
     return nullptr; // No line table for this compile unit.
 
   uint32_t stmtOffset = *Offset + U->getLineTableOffset();
-  // See if the line table is cached.
-  if (const DWARFLineTable *lt = Line->getLineTable(stmtOffset))
-    return lt;
+  {
+    std::lock_guard<std::mutex> Lock(LineTablesMutex);
+    if (!Line)
+      Line.reset(new DWARFDebugLine);
+    // See if the line table is cached.
+    if (const DWARFLineTable *lt = Line->getLineTable(stmtOffset))
+      return lt;
+  }
 
   // Make sure the offset is good before we try to parse.
   if (stmtOffset >= U->getLineSection().Data.size())
     return nullptr;
 
-  // We have to parse it first.
+  // We have to parse it first. This is done without holding the lock, so that
+  // distinct tables can be parsed concurrently.
   DWARFDataExtractor lineData(*DObj, U->getLineSection(), isLittleEndian(),
                               U->getAddressByteSize());
-  return Line->getOrParseLineTable(lineData, stmtOffset);
+  DWARFLineTable LT;
+  uint32_t ParseOffset = stmtOffset;
+  bool Parsed = LT.parse(lineData, &ParseOffset);
+  std::lock_guard<std::mutex> Lock(LineTablesMutex);
+  const DWARFLineTable *Cached = Line->addLineTable(stmtOffset, std::move(LT));
+  return Parsed ? Cached : nullptr;
 }
 
 void DWARFContext::parseCompileUnits() {
+  std::lock_guard<std::mutex> Lock(UnitsMutex);
   CUs.parse(*this, DObj->getInfoSection());
 }
 
 void DWARFContext::parseTypeUnits() {
+  std::lock_guard<std::mutex> Lock(UnitsMutex);
   if (!TUs.empty())
     return;
   DObj->forEachTypesSections([&](const DWARFSection &S) {
@@ -661,10 +681,12 @@ void DWARFContext::parseTypeUnits() {
 }
 
 void DWARFContext::parseDWOCompileUnits() {
+  std::lock_guard<std::mutex> Lock(UnitsMutex);
   DWOCUs.parseDWO(*this, DObj->getInfoDWOSection());
 }
 
 void DWARFContext::parseDWOTypeUnits() {
+  std::lock_guard<std::mutex> Lock(UnitsMutex);
   if (!DWOTUs.empty())
     return;
   DObj->forEachTypesDWOSections([&](const DWARFSection &S) {
@@ -673,6 +695,31 @@ void DWARFContext::parseDWOTypeUnits() {
   });
 }
 
+void DWARFContext::extractAllDIEs() {
+  // Unit headers are cheap to read and are parsed serially; it is the DIEs
+  // that are worth spreading across threads.
+  std::vector<DWARFUnit *> Units;
+  for (const auto &CU : compile_units())
+    Units.push_back(CU.get());
+  for (const auto &TUS : type_unit_sections())
+    for (const auto &TU : TUS)
+      Units.push_back(TU.get());
+  for (const auto &DWOCU : dwo_compile_units())
+    Units.push_back(DWOCU.get());
+  for (const auto &DWOTUS : dwo_type_unit_sections())
+    for (const auto &DWOTU : DWOTUS)
+      Units.push_back(DWOTU.get());
+
+  // Start with the biggest units so that a large unit parsed last doesn't
+  // leave the other threads idle.
+  std::stable_sort(Units.begin(), Units.end(),
+                   [](const DWARFUnit *A, const DWARFUnit *B) {
+                     return A->getLength() > B->getLength();
+                   });
+  parallel::for_each(parallel::par, Units.begin(), Units.end(),
+                     [](DWARFUnit *U) { U->extractDIEs(); });
+}
+
 DWARFCompileUnit *DWARFContext::getCompileUnitForOffset(uint32_t Offset) {
   parseCompileUnits();
   return CUs.getUnitForOffset(Offset);
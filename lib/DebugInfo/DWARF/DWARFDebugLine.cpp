@@ -312,6 +312,70 @@ void DWARFDebugLine::Row::dump(raw_ostream &OS) const {
      << (EndSequence ? " end_sequence" : "") << '\n';
 }
 
+DWARFDebugLine::RowVector::AttributesKey
+DWARFDebugLine::RowVector::getKey(const Attributes &Attrs) {
+  return {uint64_t(Attrs.Column) | uint64_t(Attrs.File) << 16 |
+              uint64_t(Attrs.Discriminator) << 32,
+          uint32_t(Attrs.Isa) | uint32_t(Attrs.Flags) << 8};
+}
+
+void DWARFDebugLine::RowVector::push_back(const Row &R) {
+  uint8_t Flags = R.IsStmt | R.BasicBlock << 1 | R.EndSequence << 2 |
+                  R.PrologueEnd << 3 | R.EpilogueBegin << 4;
+  Attributes Attrs = {R.Column, R.File, R.Discriminator, R.Isa, Flags};
+  // Rebuild the map dropped by finalize.
+  if (AttributesMap.empty())
+    for (uint32_t I = 0, E = AttributesTable.size(); I != E; ++I)
+      AttributesMap.insert({getKey(AttributesTable[I]), I});
+  auto Inserted = AttributesMap.insert({getKey(Attrs), AttributesTable.size()});
+  if (Inserted.second)
+    AttributesTable.push_back(Attrs);
+  Addresses.push_back(R.Address);
+  Lines.push_back(R.Line);
+  AttributesIndex.push_back(Inserted.first->second);
+}
+
+void DWARFDebugLine::RowVector::reserve(size_t N) {
+  Addresses.reserve(N);
+  Lines.reserve(N);
+  AttributesIndex.reserve(N);
+}
+
+void DWARFDebugLine::RowVector::clear() {
+  Addresses.clear();
+  Lines.clear();
+  AttributesIndex.clear();
+  AttributesTable.clear();
+  AttributesMap.clear();
+}
+
+void DWARFDebugLine::RowVector::finalize() {
+  // Assign an empty map to free the buckets, which clear() would keep.
+  AttributesMap = DenseMap<AttributesKey, uint32_t>();
+  Addresses.shrink_to_fit();
+  Lines.shrink_to_fit();
+  AttributesIndex.shrink_to_fit();
+  AttributesTable.shrink_to_fit();
+}
+
+DWARFDebugLine::Row DWARFDebugLine::RowVector::operator[](size_t Index) const {
+  assert(Index < size() && "row index out of range");
+  const Attributes &Attrs = AttributesTable[AttributesIndex[Index]];
+  Row R;
+  R.Address = Addresses[Index];
+  R.Line = Lines[Index];
+  R.Column = Attrs.Column;
+  R.File = Attrs.File;
+  R.Discriminator = Attrs.Discriminator;
+  R.Isa = Attrs.Isa;
+  R.IsStmt = Attrs.Flags & 1;
+  R.BasicBlock = (Attrs.Flags >> 1) & 1;
+  R.EndSequence = (Attrs.Flags >> 2) & 1;
+  R.PrologueEnd = (Attrs.Flags >> 3) & 1;
+  R.EpilogueBegin = (Attrs.Flags >> 4) & 1;
+  return R;
+}
+
 DWARFDebugLine::Sequence::Sequence() { reset(); }
 
 void DWARFDebugLine::Sequence::reset() {
@@ -393,6 +457,11 @@ DWARFDebugLine::getOrParseLineTable(const DWARFDataExtractor &DebugLineData,
   return LT;
 }
 
+const DWARFDebugLine::LineTable *
+DWARFDebugLine::addLineTable(uint32_t Offset, LineTable &&LT) {
+  return &LineTableMap.emplace(Offset, std::move(LT)).first->second;
+}
+
 bool DWARFDebugLine::LineTable::parse(const DWARFDataExtractor &DebugLineData,
                                       uint32_t *OffsetPtr) {
   const uint32_t DebugLineOffset = *OffsetPtr;
@@ -659,6 +728,7 @@ bool DWARFDebugLine::LineTable::parse(const DWARFDataExtractor &DebugLineData,
     // sometimes .so compiled from multiple object files contains a few
     // rudimentary sequences for address ranges [0x0, 0xsomething).
   }
+  Rows.finalize();
 
   return EndOffset;
 }
@@ -668,20 +738,17 @@ DWARFDebugLine::LineTable::findRowInSeq(const DWARFDebugLine::Sequence &Seq,
                                         uint64_t Address) const {
   if (!Seq.containsPC(Address))
     return UnknownRowIndex;
-  // Search for instruction address in the rows describing the sequence.
-  // Rows are stored in a vector, so we may use arithmetical operations with
-  // iterators.
-  DWARFDebugLine::Row Row;
-  Row.Address = Address;
-  RowIter FirstRow = Rows.begin() + Seq.FirstRowIndex;
-  RowIter LastRow = Rows.begin() + Seq.LastRowIndex;
-  LineTable::RowIter RowPos = std::lower_bound(
-      FirstRow, LastRow, Row, DWARFDebugLine::Row::orderByAddress);
+  // Search for instruction address in the addresses of the rows describing
+  // the sequence.
+  ArrayRef<uint64_t> Addresses = Rows.addresses();
+  const uint64_t *FirstRow = Addresses.begin() + Seq.FirstRowIndex;
+  const uint64_t *LastRow = Addresses.begin() + Seq.LastRowIndex;
+  const uint64_t *RowPos = std::lower_bound(FirstRow, LastRow, Address);
   if (RowPos == LastRow) {
     return Seq.LastRowIndex - 1;
   }
   uint32_t Index = Seq.FirstRowIndex + (RowPos - FirstRow);
-  if (RowPos->Address > Address) {
+  if (*RowPos > Address) {
     if (RowPos == FirstRow)
       return UnknownRowIndex;
     else
@@ -229,10 +229,14 @@ void DWARFUnit::extractDIEsToVector(
 }
 
 size_t DWARFUnit::extractDIEsIfNeeded(bool CUDieOnly) {
-  if ((CUDieOnly && !DieArray.empty()) ||
-      DieArray.size() > 1)
+  uint8_t Needed = CUDieOnly ? UnitDIEExtracted : AllDIEsExtracted;
+  if (Extracted.load(std::memory_order_acquire) >= Needed)
     return 0; // Already parsed.
 
+  std::lock_guard<std::mutex> Lock(ExtractMutex);
+  if (Extracted.load(std::memory_order_relaxed) >= Needed)
+    return 0; // Parsed by another thread in the meantime.
+
   bool HasCUDie = !DieArray.empty();
   extractDIEsToVector(!HasCUDie, !CUDieOnly, DieArray);
 
@@ -241,7 +245,8 @@ size_t DWARFUnit::extractDIEsIfNeeded(bool CUDieOnly) {
 
   // If CU DIE was just parsed, copy several attribute values from it.
   if (!HasCUDie) {
-    DWARFDie UnitDie = getUnitDIE();
+    // Don't go through getUnitDIE(), which would try to take the lock again.
+    DWARFDie UnitDie(this, &DieArray[0]);
     Optional<DWARFFormValue> PC = UnitDie.find({DW_AT_low_pc, DW_AT_entry_pc});
     if (Optional<uint64_t> Addr = toAddress(PC))
         setBaseAddress({*Addr, PC->getSectionIndex()});
@@ -268,12 +273,14 @@ size_t DWARFUnit::extractDIEsIfNeeded(bool CUDieOnly) {
     // skeleton CU DIE, so that DWARF users not aware of it are not broken.
   }
 
+  Extracted.store(Needed, std::memory_order_release);
   return DieArray.size();
 }
 
 bool DWARFUnit::parseDWO() {
   if (isDWO)
     return false;
+  std::lock_guard<std::mutex> Lock(DWOMutex);
   if (DWO.get())
     return false;
   DWARFDie UnitDie = getUnitDIE();
@@ -312,6 +319,8 @@ void DWARFUnit::clearDIEs(bool KeepCUDie) {
     DieArray.resize((unsigned)KeepCUDie);
     DieArray.shrink_to_fit();
   }
+  Extracted.store(DieArray.empty() ? NothingExtracted : UnitDIEExtracted,
+                  std::memory_order_release);
 }
 
 void DWARFUnit::collectAddressRanges(DWARFAddressRangesVector &CURanges) {
@@ -375,9 +384,14 @@ void DWARFUnit::updateAddressDieMap(DWARFDie Die) {
 }
 
 DWARFDie DWARFUnit::getSubroutineForAddress(uint64_t Address) {
-  extractDIEsIfNeeded(false);
-  if (AddrDieMap.empty())
-    updateAddressDieMap(getUnitDIE());
+  if (Extracted.load(std::memory_order_acquire) != AddrDieMapBuilt) {
+    extractDIEsIfNeeded(false);
+    DWARFDie UnitDie = getUnitDIE();
+    std::lock_guard<std::mutex> Lock(ExtractMutex);
+    if (AddrDieMap.empty())
+      updateAddressDieMap(UnitDie);
+    Extracted.store(AddrDieMapBuilt, std::memory_order_release);
+  }
   auto R = AddrDieMap.upper_bound(Address);
   if (R == AddrDieMap.begin())
     return DWARFDie();
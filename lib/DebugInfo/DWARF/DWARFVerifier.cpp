@@ -15,9 +15,11 @@
 #include "llvm/DebugInfo/DWARF/DWARFFormValue.h"
 #include "llvm/DebugInfo/DWARF/DWARFSection.h"
 #include "llvm/DebugInfo/DWARF/DWARFAcceleratorTable.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 using namespace llvm;
@@ -87,7 +89,7 @@ bool DWARFVerifier::verifyUnitHeader(const DWARFDataExtractor DebugInfoData,
   return Success;
 }
 
-bool DWARFVerifier::verifyUnitContents(DWARFUnit Unit) {
+bool DWARFVerifier::verifyUnitContents(DWARFUnit &Unit) {
   uint32_t NumUnitErrors = 0;
   unsigned NumDies = Unit.getNumDIEs();
   for (unsigned I = 0; I < NumDies; ++I) {
@@ -156,11 +158,29 @@ bool DWARFVerifier::handleDebugInfo() {
   bool isUnitDWARF64 = false;
   bool isHeaderChainValid = true;
   bool hasDIE = DebugInfoData.isValidOffset(Offset);
+  // The units refer to these, so they must outlive them.
+  DWARFUnitSection<DWARFTypeUnit> TUSection{};
+  DWARFUnitSection<DWARFCompileUnit> CUSection{};
+  // In parallel mode, the header chain is walked first and the contents of
+  // the units are verified afterwards. Each unit then gets a slot holding
+  // either the unit, or the report for its invalid header, so that the report
+  // comes out in the same order as in serial mode.
+  const bool Parallel = DumpOpts.ParallelVerify;
+  std::vector<std::unique_ptr<DWARFUnit>> Units;
+  std::vector<std::string> HeaderReports;
   while (hasDIE) {
     OffsetStart = Offset;
-    if (!verifyUnitHeader(DebugInfoData, &Offset, UnitIdx, UnitType,
-                          isUnitDWARF64)) {
+    std::string HeaderReport;
+    raw_string_ostream HeaderOS(HeaderReport);
+    DWARFVerifier BufferedVerifier(HeaderOS, DCtx, DumpOpts);
+    DWARFVerifier &HeaderVerifier = Parallel ? BufferedVerifier : *this;
+    if (!HeaderVerifier.verifyUnitHeader(DebugInfoData, &Offset, UnitIdx,
+                                         UnitType, isUnitDWARF64)) {
       isHeaderChainValid = false;
+      if (Parallel) {
+        Units.emplace_back();
+        HeaderReports.push_back(HeaderOS.str());
+      }
       if (isUnitDWARF64)
         break;
     } else {
@@ -168,7 +188,6 @@ bool DWARFVerifier::handleDebugInfo() {
       switch (UnitType) {
       case dwarf::DW_UT_type:
       case dwarf::DW_UT_split_type: {
-        DWARFUnitSection<DWARFTypeUnit> TUSection{};
         Unit.reset(new DWARFTypeUnit(
             DCtx, DObj.getInfoSection(), DCtx.getDebugAbbrev(),
             &DObj.getRangeSection(), DObj.getStringSection(),
@@ -184,7 +203,6 @@ bool DWARFVerifier::handleDebugInfo() {
       // UnitType = 0 means that we are
       // verifying a compile unit in DWARF v4.
       case 0: {
-        DWARFUnitSection<DWARFCompileUnit> CUSection{};
         Unit.reset(new DWARFCompileUnit(
             DCtx, DObj.getInfoSection(), DCtx.getDebugAbbrev(),
             &DObj.getRangeSection(), DObj.getStringSection(),
@@ -196,12 +214,28 @@ bool DWARFVerifier::handleDebugInfo() {
       default: { llvm_unreachable("Invalid UnitType."); }
       }
       Unit->extract(DebugInfoData, &OffsetStart);
-      if (!verifyUnitContents(*Unit))
+      if (Parallel) {
+        Units.push_back(std::move(Unit));
+        HeaderReports.emplace_back();
+      } else if (!verifyUnitContents(*Unit)) {
         ++NumDebugInfoErrors;
+      }
     }
     hasDIE = DebugInfoData.isValidOffset(Offset);
     ++UnitIdx;
   }
+  if (Parallel)
+    NumDebugInfoErrors +=
+        verifyInParallel(Units.size(), [&](DWARFVerifier &V, size_t I) {
+          if (!Units[I]) {
+            V.OS << HeaderReports[I];
+            return 0u;
+          }
+          bool Valid = V.verifyUnitContents(*Units[I]);
+          // Release the DIEs of the unit as soon as possible.
+          Units[I].reset();
+          return Valid ? 0u : 1u;
+        });
   if (UnitIdx == 0 && !hasDIE) {
     OS << "Warning: .debug_info is empty.\n";
     isHeaderChainValid = true;
@@ -365,9 +399,41 @@ unsigned DWARFVerifier::verifyDebugInfoReferences() {
 }
 
 void DWARFVerifier::verifyDebugLineStmtOffsets() {
+  // Look up the line table of every unit. The first lookup of a table parses
+  // it, which is the expensive part. In parallel mode, the first lookups are
+  // done concurrently and the other ones, which only hit the cache, are done
+  // afterwards. This preserves the results of the serial walk.
+  unsigned NumCUs = DCtx.getNumCompileUnits();
+  std::vector<const DWARFDebugLine::LineTable *> LineTables(NumCUs);
+  if (DumpOpts.ParallelVerify) {
+    std::set<uint64_t> SeenOffsets;
+    std::vector<unsigned> FirstLookups, CachedLookups;
+    for (unsigned I = 0; I != NumCUs; ++I) {
+      DWARFCompileUnit *CU = DCtx.getCompileUnitAtIndex(I);
+      auto StmtSectionOffset =
+          toSectionOffset(CU->getUnitDIE().find(DW_AT_stmt_list));
+      if (StmtSectionOffset &&
+          !SeenOffsets.insert(*StmtSectionOffset + CU->getLineTableOffset())
+               .second)
+        CachedLookups.push_back(I);
+      else
+        FirstLookups.push_back(I);
+    }
+    parallel::for_each(parallel::par, FirstLookups.begin(), FirstLookups.end(),
+                       [&](unsigned I) {
+                         LineTables[I] = DCtx.getLineTableForUnit(
+                             DCtx.getCompileUnitAtIndex(I));
+                       });
+    for (unsigned I : CachedLookups)
+      LineTables[I] = DCtx.getLineTableForUnit(DCtx.getCompileUnitAtIndex(I));
+  } else {
+    for (unsigned I = 0; I != NumCUs; ++I)
+      LineTables[I] = DCtx.getLineTableForUnit(DCtx.getCompileUnitAtIndex(I));
+  }
+
   std::map<uint64_t, DWARFDie> StmtListToDie;
-  for (const auto &CU : DCtx.compile_units()) {
-    auto Die = CU->getUnitDIE();
+  for (unsigned I = 0; I != NumCUs; ++I) {
+    auto Die = DCtx.getCompileUnitAtIndex(I)->getUnitDIE();
     // Get the attribute value as a section offset. No need to produce an
     // error here if the encoding isn't correct because we validate this in
     // the .debug_info verifier.
@@ -375,7 +441,7 @@ void DWARFVerifier::verifyDebugLineStmtOffsets() {
     if (!StmtSectionOffset)
       continue;
     const uint32_t LineTableOffset = *StmtSectionOffset;
-    auto LineTable = DCtx.getLineTableForUnit(CU.get());
+    auto LineTable = LineTables[I];
     if (LineTableOffset < DCtx.getDWARFObj().getLineSection().Data.size()) {
       if (!LineTable) {
         ++NumDebugLineErrors;
@@ -410,93 +476,135 @@ void DWARFVerifier::verifyDebugLineStmtOffsets() {
 }
 
 void DWARFVerifier::verifyDebugLineRows() {
-  for (const auto &CU : DCtx.compile_units()) {
-    auto Die = CU->getUnitDIE();
-    auto LineTable = DCtx.getLineTableForUnit(CU.get());
-    // If there is no line table we will have created an error in the
-    // .debug_info verifier or in verifyDebugLineStmtOffsets().
-    if (!LineTable)
-      continue;
-
-    // Verify prologue.
-    uint32_t MaxFileIndex = LineTable->Prologue.FileNames.size();
-    uint32_t MaxDirIndex = LineTable->Prologue.IncludeDirectories.size();
-    uint32_t FileIndex = 1;
-    StringMap<uint16_t> FullPathMap;
-    for (const auto &FileName : LineTable->Prologue.FileNames) {
-      // Verify directory index.
-      if (FileName.DirIdx > MaxDirIndex) {
-        ++NumDebugLineErrors;
-        OS << "error: .debug_line["
-           << format("0x%08" PRIx64,
-                     *toSectionOffset(Die.find(DW_AT_stmt_list)))
-           << "].prologue.file_names[" << FileIndex
-           << "].dir_idx contains an invalid index: " << FileName.DirIdx
-           << "\n";
-      }
+  if (!DumpOpts.ParallelVerify) {
+    for (const auto &CU : DCtx.compile_units())
+      verifyLineTableRows(*CU);
+    return;
+  }
+  verifyInParallel(DCtx.getNumCompileUnits(), [&](DWARFVerifier &V, size_t I) {
+    V.verifyLineTableRows(*DCtx.getCompileUnitAtIndex(I));
+    return 0u;
+  });
+}
 
-      // Check file paths for duplicates.
-      std::string FullPath;
-      const bool HasFullPath = LineTable->getFileNameByIndex(
-          FileIndex, CU->getCompilationDir(),
-          DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath, FullPath);
-      assert(HasFullPath && "Invalid index?");
-      (void)HasFullPath;
-      auto It = FullPathMap.find(FullPath);
-      if (It == FullPathMap.end())
-        FullPathMap[FullPath] = FileIndex;
-      else if (It->second != FileIndex) {
-        OS << "warning: .debug_line["
-           << format("0x%08" PRIx64,
-                     *toSectionOffset(Die.find(DW_AT_stmt_list)))
-           << "].prologue.file_names[" << FileIndex
-           << "] is a duplicate of file_names[" << It->second << "]\n";
-      }
+void DWARFVerifier::verifyLineTableRows(DWARFUnit &U) {
+  auto Die = U.getUnitDIE();
+  auto LineTable = DCtx.getLineTableForUnit(&U);
+  // If there is no line table we will have created an error in the
+  // .debug_info verifier or in verifyDebugLineStmtOffsets().
+  if (!LineTable)
+    return;
+
+  // Verify prologue.
+  uint32_t MaxFileIndex = LineTable->Prologue.FileNames.size();
+  uint32_t MaxDirIndex = LineTable->Prologue.IncludeDirectories.size();
+  uint32_t FileIndex = 1;
+  StringMap<uint16_t> FullPathMap;
+  for (const auto &FileName : LineTable->Prologue.FileNames) {
+    // Verify directory index.
+    if (FileName.DirIdx > MaxDirIndex) {
+      ++NumDebugLineErrors;
+      OS << "error: .debug_line["
+         << format("0x%08" PRIx64,
+                   *toSectionOffset(Die.find(DW_AT_stmt_list)))
+         << "].prologue.file_names[" << FileIndex
+         << "].dir_idx contains an invalid index: " << FileName.DirIdx
+         << "\n";
+    }
 
-      FileIndex++;
+    // Check file paths for duplicates.
+    std::string FullPath;
+    const bool HasFullPath = LineTable->getFileNameByIndex(
+        FileIndex, U.getCompilationDir(),
+        DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath, FullPath);
+    assert(HasFullPath && "Invalid index?");
+    (void)HasFullPath;
+    auto It = FullPathMap.find(FullPath);
+    if (It == FullPathMap.end())
+      FullPathMap[FullPath] = FileIndex;
+    else if (It->second != FileIndex) {
+      OS << "warning: .debug_line["
+         << format("0x%08" PRIx64,
+                   *toSectionOffset(Die.find(DW_AT_stmt_list)))
+         << "].prologue.file_names[" << FileIndex
+         << "] is a duplicate of file_names[" << It->second << "]\n";
     }
 
-    // Verify rows.
-    uint64_t PrevAddress = 0;
-    uint32_t RowIndex = 0;
-    for (const auto &Row : LineTable->Rows) {
-      // Verify row address.
-      if (Row.Address < PrevAddress) {
-        ++NumDebugLineErrors;
-        OS << "error: .debug_line["
-           << format("0x%08" PRIx64,
-                     *toSectionOffset(Die.find(DW_AT_stmt_list)))
-           << "] row[" << RowIndex
-           << "] decreases in address from previous row:\n";
-
-        DWARFDebugLine::Row::dumpTableHeader(OS);
-        if (RowIndex > 0)
-          LineTable->Rows[RowIndex - 1].dump(OS);
-        Row.dump(OS);
-        OS << '\n';
-      }
+    FileIndex++;
+  }
 
-      // Verify file index.
-      if (Row.File > MaxFileIndex) {
-        ++NumDebugLineErrors;
-        OS << "error: .debug_line["
-           << format("0x%08" PRIx64,
-                     *toSectionOffset(Die.find(DW_AT_stmt_list)))
-           << "][" << RowIndex << "] has invalid file index " << Row.File
-           << " (valid values are [1," << MaxFileIndex << "]):\n";
-        DWARFDebugLine::Row::dumpTableHeader(OS);
-        Row.dump(OS);
-        OS << '\n';
-      }
-      if (Row.EndSequence)
-        PrevAddress = 0;
-      else
-        PrevAddress = Row.Address;
-      ++RowIndex;
+  // Verify rows.
+  uint64_t PrevAddress = 0;
+  uint32_t RowIndex = 0;
+  for (const auto &Row : LineTable->Rows) {
+    // Verify row address.
+    if (Row.Address < PrevAddress) {
+      ++NumDebugLineErrors;
+      OS << "error: .debug_line["
+         << format("0x%08" PRIx64,
+                   *toSectionOffset(Die.find(DW_AT_stmt_list)))
+         << "] row[" << RowIndex
+         << "] decreases in address from previous row:\n";
+
+      DWARFDebugLine::Row::dumpTableHeader(OS);
+      if (RowIndex > 0)
+        LineTable->Rows[RowIndex - 1].dump(OS);
+      Row.dump(OS);
+      OS << '\n';
+    }
+
+    // Verify file index.
+    if (Row.File > MaxFileIndex) {
+      ++NumDebugLineErrors;
+      OS << "error: .debug_line["
+         << format("0x%08" PRIx64,
+                   *toSectionOffset(Die.find(DW_AT_stmt_list)))
+         << "][" << RowIndex << "] has invalid file index " << Row.File
+         << " (valid values are [1," << MaxFileIndex << "]):\n";
+      DWARFDebugLine::Row::dumpTableHeader(OS);
+      Row.dump(OS);
+      OS << '\n';
     }
+    if (Row.EndSequence)
+      PrevAddress = 0;
+    else
+      PrevAddress = Row.Address;
+    ++RowIndex;
   }
 }
 
+unsigned DWARFVerifier::verifyInParallel(
+    size_t NumItems, function_ref<unsigned(DWARFVerifier &, size_t)> Check) {
+  struct ItemResult {
+    std::string Report;
+    unsigned NumErrors = 0;
+    uint32_t NumDebugLineErrors = 0;
+    std::map<uint64_t, std::set<uint32_t>> ReferenceToDIEOffsets;
+  };
+  std::vector<ItemResult> Results(NumItems);
+  parallel::for_each_n(parallel::par, size_t(0), NumItems, [&](size_t I) {
+    ItemResult &Result = Results[I];
+    raw_string_ostream ItemOS(Result.Report);
+    DWARFVerifier ItemVerifier(ItemOS, DCtx, DumpOpts);
+    Result.NumErrors = Check(ItemVerifier, I);
+    ItemOS.flush();
+    Result.NumDebugLineErrors = ItemVerifier.NumDebugLineErrors;
+    Result.ReferenceToDIEOffsets =
+        std::move(ItemVerifier.ReferenceToDIEOffsets);
+  });
+
+  unsigned NumErrors = 0;
+  for (ItemResult &Result : Results) {
+    OS << Result.Report;
+    NumErrors += Result.NumErrors;
+    NumDebugLineErrors += Result.NumDebugLineErrors;
+    for (auto &Pair : Result.ReferenceToDIEOffsets)
+      ReferenceToDIEOffsets[Pair.first].insert(Pair.second.begin(),
+                                               Pair.second.end());
+  }
+  return NumErrors;
+}
+
 bool DWARFVerifier::handleDebugLine() {
   NumDebugLineErrors = 0;
   OS << "Verifying .debug_line...\n";
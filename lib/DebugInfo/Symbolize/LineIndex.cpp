@@ -0,0 +1,371 @@
+//===- LineIndex.cpp ------------------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The index is laid out as a header followed by three tables:
+//
+//   Header
+//   Entry   Entries[NumEntries]  sorted by address
+//   Frame   Frames[NumFrames]    inlining chains, innermost frame first
+//   char    Strings[StringTableSize]
+//
+// Each entry covers the addresses up to the next entry and refers to a run of
+// frames. An entry without frames marks addresses with no known location. All
+// fields are little-endian and unaligned, so that the tables can be used in
+// place from a memory mapped file.
+//
+// Opening an index only checks the header and the table sizes, so that it
+// costs the same for any binary. References from entries to frames and from
+// frames to strings are checked when a lookup follows them, and an index with
+// unsorted entries gives unspecified answers, but never reads out of bounds.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DebugInfo/Symbolize/LineIndex.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Object/MachO.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
+#include <vector>
+
+using namespace llvm;
+using namespace symbolize;
+
+static const char IndexMagic[8] = {'L', 'L', 'V', 'M', 'L', 'I', 'D', 'X'};
+static const uint32_t IndexVersion = 2;
+
+struct LineIndex::Header {
+  char Magic[8];
+  support::ulittle32_t Version;
+  support::ulittle32_t NumEntries;
+  support::ulittle32_t NumFrames;
+  support::ulittle32_t StringTableSize;
+  /// Key of the object file the index was computed for, used to detect
+  /// stale indexes. See computeObjectKey.
+  uint8_t ObjectKey[16];
+};
+
+struct LineIndex::Entry {
+  support::ulittle64_t Address;
+  support::ulittle32_t FirstFrame;
+  support::ulittle32_t NumFrames;
+};
+
+struct LineIndex::Frame {
+  /// Offsets in the string table.
+  support::ulittle32_t LinkageName;
+  support::ulittle32_t ShortName;
+  support::ulittle32_t FileName;
+  support::ulittle32_t Line;
+  support::ulittle32_t Column;
+  support::ulittle32_t StartLine;
+  support::ulittle32_t Discriminator;
+};
+
+static Error createIndexError(const Twine &Msg) {
+  return make_error<StringError>(Msg, inconvertibleErrorCode());
+}
+
+/// Identify \p Obj by a hash of its build ID when it has one, and of its
+/// whole contents otherwise.
+static MD5::MD5Result computeObjectKey(const object::ObjectFile &Obj) {
+  StringRef Identity = Obj.getData();
+  if (const auto *MachO = dyn_cast<object::MachOObjectFile>(&Obj)) {
+    ArrayRef<uint8_t> UUID = MachO->getUuid();
+    if (!UUID.empty())
+      Identity = StringRef(reinterpret_cast<const char *>(UUID.data()),
+                           UUID.size());
+  } else if (isa<object::ELFObjectFileBase>(&Obj)) {
+    for (const object::SectionRef &Section : Obj.sections()) {
+      StringRef Name, Contents;
+      if (!Section.getName(Name) && Name == ".note.gnu.build-id" &&
+          !Section.getContents(Contents) && !Contents.empty()) {
+        Identity = Contents;
+        break;
+      }
+    }
+  }
+
+  MD5 Hash;
+  Hash.update(Identity);
+  MD5::MD5Result Key;
+  Hash.final(Key);
+  return Key;
+}
+
+Error LineIndex::write(const object::ObjectFile &Obj, raw_ostream &OS,
+                       StringRef DWPName) {
+  std::unique_ptr<DWARFContext> DICtx = DWARFContext::create(
+      Obj, nullptr, DWARFContext::defaultErrorHandler, DWPName);
+
+  // The source location of an address can only change where a line table row
+  // starts or where the range of a function or inlined call begins or ends.
+  std::vector<uint64_t> Boundaries;
+  for (const auto &CU : DICtx->compile_units()) {
+    if (const auto *LineTable = DICtx->getLineTableForUnit(CU.get()))
+      for (const DWARFDebugLine::Row &Row : LineTable->Rows)
+        Boundaries.push_back(Row.Address);
+    for (const DWARFDebugInfoEntry &E : CU->dies()) {
+      DWARFDie Die(CU.get(), &E);
+      dwarf::Tag Tag = Die.getTag();
+      if (Tag != dwarf::DW_TAG_compile_unit &&
+          Tag != dwarf::DW_TAG_subprogram &&
+          Tag != dwarf::DW_TAG_inlined_subroutine)
+        continue;
+      for (const DWARFAddressRange &Range : Die.getAddressRanges()) {
+        Boundaries.push_back(Range.LowPC);
+        Boundaries.push_back(Range.HighPC);
+      }
+    }
+  }
+  std::sort(Boundaries.begin(), Boundaries.end());
+  Boundaries.erase(std::unique(Boundaries.begin(), Boundaries.end()),
+                   Boundaries.end());
+
+  StringMap<uint32_t> StringOffsets;
+  std::string StringTable;
+  auto AddString = [&](StringRef S) -> uint32_t {
+    auto Inserted = StringOffsets.insert({S, StringTable.size()});
+    if (Inserted.second) {
+      StringTable += S;
+      StringTable += '\0';
+    }
+    return Inserted.first->second;
+  };
+
+  // Identical inlining chains are stored once.
+  using FrameFields = std::array<uint32_t, 7>;
+  std::vector<FrameFields> AllFrames;
+  std::map<std::vector<FrameFields>, uint32_t> FrameListOffsets;
+  std::vector<std::array<uint64_t, 3>> AllEntries;
+
+  DILineInfoSpecifier LinkageSpec(
+      DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath,
+      DILineInfoSpecifier::FunctionNameKind::LinkageName);
+  DILineInfoSpecifier ShortSpec(
+      DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath,
+      DILineInfoSpecifier::FunctionNameKind::ShortName);
+  for (uint64_t Address : Boundaries) {
+    DIInliningInfo Linkage =
+        DICtx->getInliningInfoForAddress(Address, LinkageSpec);
+    DIInliningInfo Short = DICtx->getInliningInfoForAddress(Address, ShortSpec);
+    assert(Linkage.getNumberOfFrames() == Short.getNumberOfFrames() &&
+           "Inlining chain depends on the function name kind");
+
+    std::vector<FrameFields> FrameList;
+    for (uint32_t I = 0, E = Linkage.getNumberOfFrames(); I != E; ++I) {
+      DILineInfo Frame = Linkage.getFrame(I);
+      FrameList.push_back({{AddString(Frame.FunctionName),
+                            AddString(Short.getFrame(I).FunctionName),
+                            AddString(Frame.FileName), Frame.Line,
+                            Frame.Column, Frame.StartLine,
+                            Frame.Discriminator}});
+    }
+
+    uint64_t FirstFrame = 0;
+    if (!FrameList.empty()) {
+      auto Inserted = FrameListOffsets.insert({FrameList, AllFrames.size()});
+      if (Inserted.second)
+        AllFrames.insert(AllFrames.end(), FrameList.begin(), FrameList.end());
+      FirstFrame = Inserted.first->second;
+    }
+    uint64_t NumFrames = FrameList.size();
+
+    // Extend the previous range if this one resolves to the same locations,
+    // and don't start the table with a gap.
+    if (AllEntries.empty() ? NumFrames == 0
+                           : (AllEntries.back()[1] == FirstFrame &&
+                              AllEntries.back()[2] == NumFrames))
+      continue;
+    AllEntries.push_back({{Address, FirstFrame, NumFrames}});
+  }
+  // Terminate the last range.
+  if (!AllEntries.empty() && AllEntries.back()[2] != 0)
+    AllEntries.push_back({{Boundaries.back() + 1, 0, 0}});
+
+  Header H;
+  memcpy(H.Magic, IndexMagic, sizeof(IndexMagic));
+  H.Version = IndexVersion;
+  H.NumEntries = AllEntries.size();
+  H.NumFrames = AllFrames.size();
+  H.StringTableSize = StringTable.size();
+  MD5::MD5Result Key = computeObjectKey(Obj);
+  memcpy(H.ObjectKey, Key.Bytes.data(), sizeof(H.ObjectKey));
+  OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+
+  for (const auto &Fields : AllEntries) {
+    Entry E;
+    E.Address = Fields[0];
+    E.FirstFrame = Fields[1];
+    E.NumFrames = Fields[2];
+    OS.write(reinterpret_cast<const char *>(&E), sizeof(E));
+  }
+  for (const FrameFields &Fields : AllFrames) {
+    Frame F;
+    F.LinkageName = Fields[0];
+    F.ShortName = Fields[1];
+    F.FileName = Fields[2];
+    F.Line = Fields[3];
+    F.Column = Fields[4];
+    F.StartLine = Fields[5];
+    F.Discriminator = Fields[6];
+    OS.write(reinterpret_cast<const char *>(&F), sizeof(F));
+  }
+  OS << StringTable;
+  return Error::success();
+}
+
+LineIndex::LineIndex(std::unique_ptr<MemoryBuffer> Buffer)
+    : DIContext(CK_LineIndex), Buffer(std::move(Buffer)) {}
+
+Expected<std::unique_ptr<LineIndex>>
+LineIndex::create(std::unique_ptr<MemoryBuffer> Buffer,
+                  const object::ObjectFile &Obj) {
+  StringRef Data = Buffer->getBuffer();
+  if (Data.size() < sizeof(Header))
+    return createIndexError("line index is truncated");
+  const auto *H = reinterpret_cast<const Header *>(Data.data());
+  if (memcmp(H->Magic, IndexMagic, sizeof(IndexMagic)) != 0)
+    return createIndexError("not a line index");
+  if (H->Version != IndexVersion)
+    return createIndexError("unsupported line index version");
+  MD5::MD5Result Key = computeObjectKey(Obj);
+  if (memcmp(H->ObjectKey, Key.Bytes.data(), sizeof(H->ObjectKey)) != 0)
+    return createIndexError("line index does not match the object file");
+
+  uint64_t EntriesSize = uint64_t(H->NumEntries) * sizeof(Entry);
+  uint64_t FramesSize = uint64_t(H->NumFrames) * sizeof(Frame);
+  if (Data.size() !=
+      sizeof(Header) + EntriesSize + FramesSize + H->StringTableSize)
+    return createIndexError("line index is malformed");
+  // An index computed from an object file without line information would
+  // hide the debug info found some other way.
+  if (H->NumEntries == 0)
+    return createIndexError("line index is empty");
+
+  std::unique_ptr<LineIndex> Index(new LineIndex(std::move(Buffer)));
+  const char *Ptr = Data.data() + sizeof(Header);
+  Index->Entries = reinterpret_cast<const Entry *>(Ptr);
+  Index->NumEntries = H->NumEntries;
+  Ptr += EntriesSize;
+  Index->Frames = reinterpret_cast<const Frame *>(Ptr);
+  Index->NumFrames = H->NumFrames;
+  Ptr += FramesSize;
+  Index->Strings = StringRef(Ptr, H->StringTableSize);
+
+  // Every string read from the table stops at this terminator.
+  if (!Index->Strings.empty() && Index->Strings.back() != '\0')
+    return createIndexError("line index is malformed");
+  return Index;
+}
+
+const LineIndex::Entry *LineIndex::findEntry(uint64_t Address) const {
+  const Entry *End = Entries + NumEntries;
+  const Entry *I = std::upper_bound(
+      Entries, End, Address,
+      [](uint64_t Address, const Entry &E) { return Address < E.Address; });
+  if (I == Entries)
+    return nullptr;
+  --I;
+  return hasFrames(*I) ? I : nullptr;
+}
+
+bool LineIndex::hasFrames(const Entry &E) const {
+  return E.NumFrames && uint64_t(E.FirstFrame) + E.NumFrames <= NumFrames;
+}
+
+StringRef LineIndex::getString(uint32_t Offset) const {
+  if (Offset >= Strings.size())
+    return StringRef();
+  return Strings.data() + Offset;
+}
+
+DILineInfo LineIndex::getFrame(uint32_t Index,
+                               DILineInfoSpecifier Specifier) const {
+  using FunctionNameKind = DILineInfoSpecifier::FunctionNameKind;
+  const Frame &F = Frames[Index];
+  DILineInfo Result;
+  if (Specifier.FNKind == FunctionNameKind::LinkageName)
+    Result.FunctionName = getString(F.LinkageName);
+  else if (Specifier.FNKind == FunctionNameKind::ShortName)
+    Result.FunctionName = getString(F.ShortName);
+  Result.StartLine = F.StartLine;
+  if (Specifier.FLIKind != DILineInfoSpecifier::FileLineInfoKind::None) {
+    Result.FileName = getString(F.FileName);
+    Result.Line = F.Line;
+    Result.Column = F.Column;
+    Result.Discriminator = F.Discriminator;
+  }
+  return Result;
+}
+
+void LineIndex::dump(raw_ostream &OS, DIDumpOptions DumpOpts) {
+  DILineInfoSpecifier Spec;
+  for (uint32_t I = 0; I != NumEntries; ++I) {
+    const Entry &E = Entries[I];
+    OS << format("0x%016" PRIx64, uint64_t(E.Address));
+    if (!hasFrames(E)) {
+      OS << " <none>\n";
+      continue;
+    }
+    for (uint32_t F = E.FirstFrame, FE = E.FirstFrame + E.NumFrames; F != FE;
+         ++F) {
+      DILineInfo Frame = getFrame(F, Spec);
+      OS << ' ' << Frame.FunctionName << " at " << Frame.FileName << ':'
+         << Frame.Line << ':' << Frame.Column;
+    }
+    OS << '\n';
+  }
+}
+
+DILineInfo LineIndex::getLineInfoForAddress(uint64_t Address,
+                                            DILineInfoSpecifier Specifier) {
+  // The innermost frame holds the location from the line table along with the
+  // name of the innermost function, as DWARFContext would return.
+  if (const Entry *E = findEntry(Address))
+    return getFrame(E->FirstFrame, Specifier);
+  return DILineInfo();
+}
+
+DILineInfoTable
+LineIndex::getLineInfoForAddressRange(uint64_t Address, uint64_t Size,
+                                      DILineInfoSpecifier Specifier) {
+  DILineInfoTable Lines;
+  if (!Size)
+    return Lines;
+  uint64_t End = Address + Size;
+  if (const Entry *E = findEntry(Address))
+    Lines.push_back({Address, getFrame(E->FirstFrame, Specifier)});
+  const Entry *I = std::upper_bound(
+      Entries, Entries + NumEntries, Address,
+      [](uint64_t Address, const Entry &E) { return Address < E.Address; });
+  for (; I != Entries + NumEntries && I->Address < End; ++I)
+    if (hasFrames(*I))
+      Lines.push_back({I->Address, getFrame(I->FirstFrame, Specifier)});
+  return Lines;
+}
+
+DIInliningInfo
+LineIndex::getInliningInfoForAddress(uint64_t Address,
+                                     DILineInfoSpecifier Specifier) {
+  DIInliningInfo InliningInfo;
+  if (const Entry *E = findEntry(Address))
+    for (uint32_t I = E->FirstFrame, IE = E->FirstFrame + E->NumFrames;
+         I != IE; ++I)
+      InliningInfo.addFrame(getFrame(I, Specifier));
+  return InliningInfo;
+}
@@ -17,6 +17,7 @@
 #include "llvm/ADT/Triple.h"
 #include "llvm/BinaryFormat/COFF.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/DebugInfo/Symbolize/LineIndex.h"
 #include "llvm/DebugInfo/Symbolize/SymbolizableModule.h"
 #include "llvm/Object/COFF.h"
 #include "llvm/Object/ObjectFile.h"
@@ -210,12 +211,14 @@ bool SymbolizableObjectFile::getNameFromSymbolTable(SymbolRef::Type Type,
 
 bool SymbolizableObjectFile::shouldOverrideWithSymbolTable(
     FunctionNameKind FNKind, bool UseSymbolTable) const {
-  // When DWARF is used with -gline-tables-only / -gmlt, the symbol table gives
+  // When DWARF (or a line index computed from it) is used with
+  // -gline-tables-only / -gmlt, the symbol table gives
   // better answers for linkage names than the DIContext. Otherwise, we are
   // probably using PEs and PDBs, and we shouldn't do the override. PE files
   // generally only contain the names of exported symbols.
   return FNKind == FunctionNameKind::LinkageName && UseSymbolTable &&
-         isa<DWARFContext>(DebugInfoContext.get());
+         (isa<DWARFContext>(DebugInfoContext.get()) ||
+          isa<LineIndex>(DebugInfoContext.get()));
 }
 
 DILineInfo SymbolizableObjectFile::symbolizeCode(uint64_t ModuleOffset,
@@ -16,11 +16,14 @@
 #include "SymbolizableObjectFile.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/BinaryFormat/COFF.h"
 #include "llvm/Config/config.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
 #include "llvm/DebugInfo/PDB/PDB.h"
 #include "llvm/DebugInfo/PDB/PDBContext.h"
+#include "llvm/DebugInfo/Symbolize/LineIndex.h"
 #include "llvm/Object/COFF.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/MachO.h"
@@ -36,6 +39,8 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <numeric>
+#include <set>
 
 #if defined(_MSC_VER)
 #include <Windows.h>
@@ -53,74 +58,139 @@
 namespace llvm {
 namespace symbolize {
 
+DILineInfo LLVMSymbolizer::symbolizeCodeInModule(SymbolizableModule &Info,
+                                                 uint64_t ModuleOffset) {
+  // If the user is giving us relative addresses, add the preferred base of the
+  // object to the offset before we do the query. It's what DIContext expects.
+  if (Opts.RelativeAddresses)
+    ModuleOffset += Info.getModulePreferredBase();
+
+  return Info.symbolizeCode(ModuleOffset, Opts.PrintFunctions,
+                            Opts.UseSymbolTable);
+}
+
 Expected<DILineInfo>
 LLVMSymbolizer::symbolizeCode(const std::string &ModuleName,
                               uint64_t ModuleOffset, StringRef DWPName) {
-  SymbolizableModule *Info;
-  if (auto InfoOrErr = getOrCreateModuleInfo(ModuleName, DWPName))
-    Info = InfoOrErr.get();
+  ModuleEntry *Entry;
+  if (auto EntryOrErr = acquireModule(ModuleName, DWPName))
+    Entry = EntryOrErr.get();
   else
-    return InfoOrErr.takeError();
+    return EntryOrErr.takeError();
 
   // A null module means an error has already been reported. Return an empty
   // result.
-  if (!Info)
-    return DILineInfo();
-
-  // If the user is giving us relative addresses, add the preferred base of the
-  // object to the offset before we do the query. It's what DIContext expects.
-  if (Opts.RelativeAddresses)
-    ModuleOffset += Info->getModulePreferredBase();
-
-  DILineInfo LineInfo = Info->symbolizeCode(ModuleOffset, Opts.PrintFunctions,
-                                            Opts.UseSymbolTable);
-  if (Opts.Demangle)
-    LineInfo.FunctionName = DemangleName(LineInfo.FunctionName, Info);
+  DILineInfo LineInfo;
+  if (SymbolizableModule *Info = Entry->Module.get()) {
+    {
+      std::lock_guard<std::mutex> Lock(Entry->QueryMutex);
+      LineInfo = symbolizeCodeInModule(*Info, ModuleOffset);
+    }
+    if (Opts.Demangle)
+      LineInfo.FunctionName = DemangleName(LineInfo.FunctionName, Info);
+  }
+  releaseModule(Entry);
   return LineInfo;
 }
 
+Expected<std::vector<DILineInfo>>
+LLVMSymbolizer::symbolizeCode(const std::string &ModuleName,
+                              ArrayRef<uint64_t> ModuleOffsets,
+                              StringRef DWPName) {
+  ModuleEntry *Entry;
+  if (auto EntryOrErr = acquireModule(ModuleName, DWPName))
+    Entry = EntryOrErr.get();
+  else
+    return EntryOrErr.takeError();
+
+  // A null module means an error has already been reported. Return empty
+  // results.
+  std::vector<DILineInfo> LineInfos(ModuleOffsets.size());
+  if (SymbolizableModule *Info = Entry->Module.get()) {
+    // Resolve the offsets in address order so that consecutive lookups hit the
+    // same compile units and line tables, and resolve duplicates only once.
+    std::vector<unsigned> Order(ModuleOffsets.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    std::sort(Order.begin(), Order.end(), [&](unsigned L, unsigned R) {
+      return ModuleOffsets[L] < ModuleOffsets[R];
+    });
+    {
+      std::lock_guard<std::mutex> Lock(Entry->QueryMutex);
+      for (unsigned I = 0, E = Order.size(); I != E; ++I) {
+        if (I && ModuleOffsets[Order[I]] == ModuleOffsets[Order[I - 1]])
+          LineInfos[Order[I]] = LineInfos[Order[I - 1]];
+        else
+          LineInfos[Order[I]] =
+              symbolizeCodeInModule(*Info, ModuleOffsets[Order[I]]);
+      }
+    }
+    if (Opts.Demangle) {
+      StringMap<std::string> DemangledNames;
+      for (DILineInfo &LineInfo : LineInfos) {
+        auto Inserted = DemangledNames.insert({LineInfo.FunctionName, ""});
+        if (Inserted.second)
+          Inserted.first->second = DemangleName(LineInfo.FunctionName, Info);
+        LineInfo.FunctionName = Inserted.first->second;
+      }
+    }
+  }
+  releaseModule(Entry);
+  return std::move(LineInfos);
+}
+
 Expected<DIInliningInfo>
 LLVMSymbolizer::symbolizeInlinedCode(const std::string &ModuleName,
                                      uint64_t ModuleOffset, StringRef DWPName) {
-  SymbolizableModule *Info;
-  if (auto InfoOrErr = getOrCreateModuleInfo(ModuleName, DWPName))
-    Info = InfoOrErr.get();
+  ModuleEntry *Entry;
+  if (auto EntryOrErr = acquireModule(ModuleName, DWPName))
+    Entry = EntryOrErr.get();
   else
-    return InfoOrErr.takeError();
+    return EntryOrErr.takeError();
 
   // A null module means an error has already been reported. Return an empty
   // result.
-  if (!Info)
+  SymbolizableModule *Info = Entry->Module.get();
+  if (!Info) {
+    releaseModule(Entry);
     return DIInliningInfo();
+  }
 
   // If the user is giving us relative addresses, add the preferred base of the
   // object to the offset before we do the query. It's what DIContext expects.
   if (Opts.RelativeAddresses)
     ModuleOffset += Info->getModulePreferredBase();
 
-  DIInliningInfo InlinedContext = Info->symbolizeInlinedCode(
-      ModuleOffset, Opts.PrintFunctions, Opts.UseSymbolTable);
+  DIInliningInfo InlinedContext;
+  {
+    std::lock_guard<std::mutex> Lock(Entry->QueryMutex);
+    InlinedContext = Info->symbolizeInlinedCode(
+        ModuleOffset, Opts.PrintFunctions, Opts.UseSymbolTable);
+  }
   if (Opts.Demangle) {
     for (int i = 0, n = InlinedContext.getNumberOfFrames(); i < n; i++) {
       auto *Frame = InlinedContext.getMutableFrame(i);
       Frame->FunctionName = DemangleName(Frame->FunctionName, Info);
     }
   }
+  releaseModule(Entry);
   return InlinedContext;
 }
 
 Expected<DIGlobal> LLVMSymbolizer::symbolizeData(const std::string &ModuleName,
                                                  uint64_t ModuleOffset) {
-  SymbolizableModule *Info;
-  if (auto InfoOrErr = getOrCreateModuleInfo(ModuleName))
-    Info = InfoOrErr.get();
+  ModuleEntry *Entry;
+  if (auto EntryOrErr = acquireModule(ModuleName))
+    Entry = EntryOrErr.get();
   else
-    return InfoOrErr.takeError();
+    return EntryOrErr.takeError();
 
   // A null module means an error has already been reported. Return an empty
   // result.
-  if (!Info)
+  SymbolizableModule *Info = Entry->Module.get();
+  if (!Info) {
+    releaseModule(Entry);
     return DIGlobal();
+  }
 
   // If the user is giving us relative addresses, add the preferred base of
   // the object to the offset before we do the query. It's what DIContext
@@ -128,17 +198,108 @@ Expected<DIGlobal> LLVMSymbolizer::symbolizeData(const std::string &ModuleName,
   if (Opts.RelativeAddresses)
     ModuleOffset += Info->getModulePreferredBase();
 
-  DIGlobal Global = Info->symbolizeData(ModuleOffset);
+  DIGlobal Global;
+  {
+    std::lock_guard<std::mutex> Lock(Entry->QueryMutex);
+    Global = Info->symbolizeData(ModuleOffset);
+  }
   if (Opts.Demangle)
     Global.Name = DemangleName(Global.Name, Info);
+  releaseModule(Entry);
   return Global;
 }
 
 void LLVMSymbolizer::flush() {
-  ObjectForUBPathAndArch.clear();
-  BinaryForPath.clear();
-  ObjectPairForPathArch.clear();
-  Modules.clear();
+  std::lock_guard<std::mutex> Lock(CacheMutex);
+  for (auto It = ModulesLRU.begin(), E = ModulesLRU.end(); It != E;) {
+    auto ModIt = Modules.find(*It);
+    assert(ModIt != Modules.end() && "LRU list out of sync with the cache");
+    if (ModIt->second.UseCount) {
+      ++It;
+      continue;
+    }
+    CacheSize -= ModIt->second.Size;
+    Modules.erase(ModIt);
+    It = ModulesLRU.erase(It);
+  }
+  releaseUnusedObjects();
+}
+
+Error LLVMSymbolizer::writeLineIndex(const std::string &ModuleName,
+                                     raw_ostream &OS, StringRef DWPName) {
+  ObjectPair Objects;
+  {
+    std::lock_guard<std::mutex> Lock(ObjectsMutex);
+    auto ObjectsOrErr = getOrCreateObjectPair(ModuleName, Opts.DefaultArch);
+    if (!ObjectsOrErr)
+      return ObjectsOrErr.takeError();
+    Objects = ObjectsOrErr.get();
+  }
+  // The index replaces the debug info, so it is keyed on the debug object.
+  return LineIndex::write(*Objects.second, OS, DWPName);
+}
+
+void LLVMSymbolizer::evictModules(uint64_t MaxSize) {
+  bool Evicted = false;
+  for (auto It = ModulesLRU.begin(), E = ModulesLRU.end();
+       It != E && CacheSize > MaxSize;) {
+    auto ModIt = Modules.find(*It);
+    assert(ModIt != Modules.end() && "LRU list out of sync with the cache");
+    // Modules that failed to load cost nothing, and are kept so that the
+    // error is not reported again.
+    if (ModIt->second.UseCount || !ModIt->second.Module) {
+      ++It;
+      continue;
+    }
+    CacheSize -= ModIt->second.Size;
+    Modules.erase(ModIt);
+    It = ModulesLRU.erase(It);
+    Evicted = true;
+  }
+  if (Evicted)
+    releaseUnusedObjects();
+}
+
+void LLVMSymbolizer::releaseUnusedObjects() {
+  // Modules still being loaded are in the cache, so the objects they are
+  // loading from stay alive.
+  std::set<std::pair<std::string, std::string>> LiveKeys;
+  for (const auto &M : Modules)
+    LiveKeys.insert(M.second.ObjectsKey);
+
+  std::lock_guard<std::mutex> Lock(ObjectsMutex);
+
+  SmallPtrSet<const Binary *, 16> LiveObjects;
+  for (auto It = ObjectPairForPathArch.begin();
+       It != ObjectPairForPathArch.end();) {
+    if (!LiveKeys.count(It->first)) {
+      It = ObjectPairForPathArch.erase(It);
+      continue;
+    }
+    LiveObjects.insert(It->second.first);
+    LiveObjects.insert(It->second.second);
+    ++It;
+  }
+
+  // Objects extracted from a universal binary keep the binary alive.
+  std::set<std::string> LiveUniversalPaths;
+  for (auto It = ObjectForUBPathAndArch.begin();
+       It != ObjectForUBPathAndArch.end();) {
+    if (!LiveObjects.count(It->second.get())) {
+      It = ObjectForUBPathAndArch.erase(It);
+      continue;
+    }
+    LiveUniversalPaths.insert(It->first.first);
+    ++It;
+  }
+
+  for (auto It = BinaryForPath.begin(); It != BinaryForPath.end();) {
+    if (!LiveObjects.count(It->second.getBinary()) &&
+        !LiveUniversalPaths.count(It->first))
+      It = BinaryForPath.erase(It);
+    else
+      ++It;
+  }
 }
 
 namespace {
@@ -364,32 +525,77 @@ LLVMSymbolizer::getOrCreateObject(const std::string &Path,
   return errorCodeToError(object_error::arch_not_found);
 }
 
-Expected<SymbolizableModule *>
-LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName,
-                                      StringRef DWPName) {
-  const auto &I = Modules.find(ModuleName);
-  if (I != Modules.end()) {
-    return I->second.get();
-  }
-  std::string BinaryName = ModuleName;
-  std::string ArchName = Opts.DefaultArch;
-  size_t ColonPos = ModuleName.find_last_of(':');
-  // Verify that substring after colon form a valid arch name.
-  if (ColonPos != std::string::npos) {
-    std::string ArchStr = ModuleName.substr(ColonPos + 1);
-    if (Triple(ArchStr).getArch() != Triple::UnknownArch) {
-      BinaryName = ModuleName.substr(0, ColonPos);
-      ArchName = ArchStr;
+Expected<LLVMSymbolizer::ModuleEntry *>
+LLVMSymbolizer::acquireModule(const std::string &ModuleName,
+                              StringRef DWPName) {
+  ModuleEntry *Entry;
+  {
+    std::lock_guard<std::mutex> Lock(CacheMutex);
+    auto I = Modules.find(ModuleName);
+    if (I != Modules.end()) {
+      Entry = &I->second;
+      ModulesLRU.splice(ModulesLRU.end(), ModulesLRU, Entry->LRUPos);
+    } else {
+      Entry = &Modules[ModuleName];
+      Entry->LRUPos = ModulesLRU.insert(ModulesLRU.end(), ModuleName);
+      std::string BinaryName = ModuleName;
+      std::string ArchName = Opts.DefaultArch;
+      size_t ColonPos = ModuleName.find_last_of(':');
+      // Verify that substring after colon form a valid arch name.
+      if (ColonPos != std::string::npos) {
+        std::string ArchStr = ModuleName.substr(ColonPos + 1);
+        if (Triple(ArchStr).getArch() != Triple::UnknownArch) {
+          BinaryName = ModuleName.substr(0, ColonPos);
+          ArchName = ArchStr;
+        }
+      }
+      Entry->ObjectsKey = std::make_pair(BinaryName, ArchName);
     }
+    // Entries in use are not evicted, including while they are loading.
+    ++Entry->UseCount;
+  }
+
+  // The first thread to need the module loads it while the others wait, and
+  // only that thread reports the error if loading fails.
+  Error Err = Error::success();
+  llvm::call_once(Entry->Loaded, [&] {
+    ErrorAsOutParameter EAO(&Err);
+    Err = loadModule(DWPName, *Entry);
+    std::lock_guard<std::mutex> Lock(CacheMutex);
+    CacheSize += Entry->Size;
+    // The new module is in use, so this only evicts other modules.
+    if (Opts.MaxCacheSize)
+      evictModules(Opts.MaxCacheSize);
+  });
+  if (Err) {
+    releaseModule(Entry);
+    return std::move(Err);
   }
-  auto ObjectsOrErr = getOrCreateObjectPair(BinaryName, ArchName);
-  if (!ObjectsOrErr) {
-    // Failed to find valid object file.
-    Modules.insert(
-        std::make_pair(ModuleName, std::unique_ptr<SymbolizableModule>()));
-    return ObjectsOrErr.takeError();
+  return Entry;
+}
+
+void LLVMSymbolizer::releaseModule(ModuleEntry *Entry) {
+  std::lock_guard<std::mutex> Lock(CacheMutex);
+  assert(Entry->UseCount && "Releasing a module that is not in use");
+  --Entry->UseCount;
+  // Modules in use could not be evicted when the cache last grew.
+  if (Opts.MaxCacheSize && CacheSize > Opts.MaxCacheSize)
+    evictModules(Opts.MaxCacheSize);
+}
+
+Error LLVMSymbolizer::loadModule(StringRef DWPName, ModuleEntry &Entry) {
+  const std::string &BinaryName = Entry.ObjectsKey.first;
+  ObjectPair Objects;
+  {
+    std::lock_guard<std::mutex> Lock(ObjectsMutex);
+    auto ObjectsOrErr =
+        getOrCreateObjectPair(BinaryName, Entry.ObjectsKey.second);
+    if (!ObjectsOrErr) {
+      // Failed to find valid object file.
+      return ObjectsOrErr.takeError();
+    }
+    Objects = ObjectsOrErr.get();
   }
-  ObjectPair Objects = ObjectsOrErr.get();
 
   std::unique_ptr<DIContext> Context;
   // If this is a COFF object containing PDB info, use a PDBContext to
@@ -402,29 +608,42 @@ LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName,
       using namespace pdb;
       std::unique_ptr<IPDBSession> Session;
       if (auto Err = loadDataForEXE(PDB_ReaderType::DIA,
-                                    Objects.first->getFileName(), Session)) {
-        Modules.insert(
-            std::make_pair(ModuleName, std::unique_ptr<SymbolizableModule>()));
-        return std::move(Err);
-      }
+                                    Objects.first->getFileName(), Session))
+        return Err;
       Context.reset(new PDBContext(*CoffObject, std::move(Session)));
     }
   }
+  if (!Context && Opts.UseLineIndex) {
+    // An index that is missing or out of date is not an error, we just fall
+    // back to the debug info.
+    auto BufOrErr = MemoryBuffer::getFile(BinaryName + ".lineidx", -1,
+                                          /*RequiresNullTerminator=*/false);
+    if (BufOrErr) {
+      auto IndexOrErr =
+          LineIndex::create(std::move(*BufOrErr), *Objects.second);
+      if (IndexOrErr)
+        Context = std::move(*IndexOrErr);
+      else
+        consumeError(IndexOrErr.takeError());
+    }
+  }
   if (!Context)
     Context = DWARFContext::create(*Objects.second, nullptr,
                                    DWARFContext::defaultErrorHandler, DWPName);
   assert(Context);
   auto InfoOrErr =
       SymbolizableObjectFile::create(Objects.first, std::move(Context));
-  std::unique_ptr<SymbolizableModule> SymMod;
-  if (InfoOrErr)
-    SymMod = std::move(InfoOrErr.get());
-  auto InsertResult =
-      Modules.insert(std::make_pair(ModuleName, std::move(SymMod)));
-  assert(InsertResult.second);
   if (auto EC = InfoOrErr.getError())
     return errorCodeToError(EC);
-  return InsertResult.first->second.get();
+  Entry.Module = std::move(InfoOrErr.get());
+
+  // Charge the module for the object files backing it. Object files shared by
+  // several modules are charged to each of them, which errs on the side of
+  // evicting early.
+  Entry.Size = Objects.first->getData().size();
+  if (Objects.second != Objects.first)
+    Entry.Size += Objects.second->getData().size();
+  return Error::success();
 }
 
 namespace {
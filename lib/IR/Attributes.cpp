@@ -85,8 +85,9 @@ Attribute Attribute::get(LLVMContext &Context, Attribute::AttrKind Kind,
   ID.AddInteger(Kind);
   if (Val) ID.AddInteger(Val);
 
+  auto Shard = pImpl->AttrsSet.getShardFor(ID);
   void *InsertPoint;
-  AttributeImpl *PA = pImpl->AttrsSet.FindNodeOrInsertPos(ID, InsertPoint);
+  AttributeImpl *PA = Shard->FindNodeOrInsertPos(ID, InsertPoint);
 
   if (!PA) {
     // If we didn't find any existing attributes of the same shape then create a
@@ -95,7 +96,7 @@ Attribute Attribute::get(LLVMContext &Context, Attribute::AttrKind Kind,
       PA = new EnumAttributeImpl(Kind);
     else
       PA = new IntAttributeImpl(Kind, Val);
-    pImpl->AttrsSet.InsertNode(PA, InsertPoint);
+    Shard->InsertNode(PA, InsertPoint);
   }
 
   // Return the Attribute that we found or created.
@@ -108,14 +109,15 @@ Attribute Attribute::get(LLVMContext &Context, StringRef Kind, StringRef Val) {
   ID.AddString(Kind);
   if (!Val.empty()) ID.AddString(Val);
 
+  auto Shard = pImpl->AttrsSet.getShardFor(ID);
   void *InsertPoint;
-  AttributeImpl *PA = pImpl->AttrsSet.FindNodeOrInsertPos(ID, InsertPoint);
+  AttributeImpl *PA = Shard->FindNodeOrInsertPos(ID, InsertPoint);
 
   if (!PA) {
     // If we didn't find any existing attributes of the same shape then create a
     // new one and insert it.
     PA = new StringAttributeImpl(Kind, Val);
-    pImpl->AttrsSet.InsertNode(PA, InsertPoint);
+    Shard->InsertNode(PA, InsertPoint);
   }
 
   // Return the Attribute that we found or created.
@@ -658,9 +660,9 @@ AttributeSetNode *AttributeSetNode::get(LLVMContext &C,
   for (Attribute Attr : SortedAttrs)
     Attr.Profile(ID);
 
+  auto Shard = pImpl->AttrsSetNodes.getShardFor(ID);
   void *InsertPoint;
-  AttributeSetNode *PA =
-    pImpl->AttrsSetNodes.FindNodeOrInsertPos(ID, InsertPoint);
+  AttributeSetNode *PA = Shard->FindNodeOrInsertPos(ID, InsertPoint);
 
   // If we didn't find any existing attributes of the same shape then create a
   // new one and insert it.
@@ -668,7 +670,7 @@ AttributeSetNode *AttributeSetNode::get(LLVMContext &C,
     // Coallocate entries after the AttributeSetNode itself.
     void *Mem = ::operator new(totalSizeToAlloc<Attribute>(SortedAttrs.size()));
     PA = new (Mem) AttributeSetNode(SortedAttrs);
-    pImpl->AttrsSetNodes.InsertNode(PA, InsertPoint);
+    Shard->InsertNode(PA, InsertPoint);
   }
 
   // Return the AttributeSetNode that we found or created.
@@ -848,9 +850,9 @@ AttributeList AttributeList::getImpl(LLVMContext &C,
   FoldingSetNodeID ID;
   AttributeListImpl::Profile(ID, AttrSets);
 
+  auto Shard = pImpl->AttrsLists.getShardFor(ID);
   void *InsertPoint;
-  AttributeListImpl *PA =
-      pImpl->AttrsLists.FindNodeOrInsertPos(ID, InsertPoint);
+  AttributeListImpl *PA = Shard->FindNodeOrInsertPos(ID, InsertPoint);
 
   // If we didn't find any existing attributes of the same shape then
   // create a new one and insert it.
@@ -859,7 +861,7 @@ AttributeList AttributeList::getImpl(LLVMContext &C,
     void *Mem = ::operator new(
         AttributeListImpl::totalSizeToAlloc<AttributeSet>(AttrSets.size()));
     PA = new (Mem) AttributeListImpl(C, AttrSets);
-    pImpl->AttrsLists.InsertNode(PA, InsertPoint);
+    Shard->InsertNode(PA, InsertPoint);
   }
 
   // Return the AttributesList that we found or created.
@@ -547,6 +547,7 @@ Constant *ConstantInt::getFalse(Type *Ty) {
 ConstantInt *ConstantInt::get(LLVMContext &Context, const APInt &V) {
   // get an existing value or the insertion position
   LLVMContextImpl *pImpl = Context.pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
   std::unique_ptr<ConstantInt> &Slot = pImpl->IntConstants[V];
   if (!Slot) {
     // Get the corresponding integer type for the bit width of the value.
@@ -684,6 +685,7 @@ Constant *ConstantFP::getZeroValueForNegation(Type *Ty) {
 // ConstantFP accessors.
 ConstantFP* ConstantFP::get(LLVMContext &Context, const APFloat& V) {
   LLVMContextImpl* pImpl = Context.pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
 
   std::unique_ptr<ConstantFP> &Slot = pImpl->FPConstants[V];
 
@@ -1238,8 +1240,9 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
   assert((Ty->isStructTy() || Ty->isArrayTy() || Ty->isVectorTy()) &&
          "Cannot create an aggregate zero of non-aggregate type!");
 
-  std::unique_ptr<ConstantAggregateZero> &Entry =
-      Ty->getContext().pImpl->CAZConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
+  std::unique_ptr<ConstantAggregateZero> &Entry = pImpl->CAZConstants[Ty];
   if (!Entry)
     Entry.reset(new ConstantAggregateZero(Ty));
 
@@ -1248,7 +1251,9 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
 
 /// Remove the constant from the constant table.
 void ConstantAggregateZero::destroyConstantImpl() {
-  getContext().pImpl->CAZConstants.erase(getType());
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
+  pImpl->CAZConstants.erase(getType());
 }
 
 /// Remove the constant from the constant table.
@@ -1304,8 +1309,9 @@ const APInt &Constant::getUniqueInteger() const {
 //
 
 ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
-  std::unique_ptr<ConstantPointerNull> &Entry =
-      Ty->getContext().pImpl->CPNConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
+  std::unique_ptr<ConstantPointerNull> &Entry = pImpl->CPNConstants[Ty];
   if (!Entry)
     Entry.reset(new ConstantPointerNull(Ty));
 
@@ -1314,11 +1320,15 @@ ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
 
 /// Remove the constant from the constant table.
 void ConstantPointerNull::destroyConstantImpl() {
-  getContext().pImpl->CPNConstants.erase(getType());
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
+  pImpl->CPNConstants.erase(getType());
 }
 
 UndefValue *UndefValue::get(Type *Ty) {
-  std::unique_ptr<UndefValue> &Entry = Ty->getContext().pImpl->UVConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
+  std::unique_ptr<UndefValue> &Entry = pImpl->UVConstants[Ty];
   if (!Entry)
     Entry.reset(new UndefValue(Ty));
 
@@ -1328,7 +1338,9 @@ UndefValue *UndefValue::get(Type *Ty) {
 /// Remove the constant from the constant table.
 void UndefValue::destroyConstantImpl() {
   // Free the constant and any dangling references to it.
-  getContext().pImpl->UVConstants.erase(getType());
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
+  pImpl->UVConstants.erase(getType());
 }
 
 BlockAddress *BlockAddress::get(BasicBlock *BB) {
@@ -1337,8 +1349,9 @@ BlockAddress *BlockAddress::get(BasicBlock *BB) {
 }
 
 BlockAddress *BlockAddress::get(Function *F, BasicBlock *BB) {
-  BlockAddress *&BA =
-    F->getContext().pImpl->BlockAddresses[std::make_pair(F, BB)];
+  LLVMContextImpl *pImpl = F->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantOperandLock);
+  BlockAddress *&BA = pImpl->BlockAddresses[std::make_pair(F, BB)];
   if (!BA)
     BA = new BlockAddress(F, BB);
 
@@ -1360,16 +1373,18 @@ BlockAddress *BlockAddress::lookup(const BasicBlock *BB) {
 
   const Function *F = BB->getParent();
   assert(F && "Block must have a parent");
-  BlockAddress *BA =
-      F->getContext().pImpl->BlockAddresses.lookup(std::make_pair(F, BB));
+  LLVMContextImpl *pImpl = F->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantOperandLock);
+  BlockAddress *BA = pImpl->BlockAddresses.lookup(std::make_pair(F, BB));
   assert(BA && "Refcount and block address map disagree!");
   return BA;
 }
 
 /// Remove the constant from the constant table.
 void BlockAddress::destroyConstantImpl() {
-  getFunction()->getType()->getContext().pImpl
-    ->BlockAddresses.erase(std::make_pair(getFunction(), getBasicBlock()));
+  LLVMContextImpl *pImpl = getFunction()->getType()->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantOperandLock);
+  pImpl->BlockAddresses.erase(std::make_pair(getFunction(), getBasicBlock()));
   getBasicBlock()->AdjustBlockAddressRefCount(-1);
 }
 
@@ -1388,8 +1403,9 @@ Value *BlockAddress::handleOperandChangeImpl(Value *From, Value *To) {
 
   // See if the 'new' entry already exists, if not, just update this in place
   // and return early.
-  BlockAddress *&NewBA =
-    getContext().pImpl->BlockAddresses[std::make_pair(NewF, NewBB)];
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantOperandLock);
+  BlockAddress *&NewBA = pImpl->BlockAddresses[std::make_pair(NewF, NewBB)];
   if (NewBA)
     return NewBA;
 
@@ -1397,8 +1413,7 @@ Value *BlockAddress::handleOperandChangeImpl(Value *From, Value *To) {
 
   // Remove the old entry, this can't cause the map to rehash (just a
   // tombstone will get added).
-  getContext().pImpl->BlockAddresses.erase(std::make_pair(getFunction(),
-                                                          getBasicBlock()));
+  pImpl->BlockAddresses.erase(std::make_pair(getFunction(), getBasicBlock()));
   NewBA = this;
   setOperand(0, NewF);
   setOperand(1, NewBB);
@@ -2329,10 +2344,10 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
     return ConstantAggregateZero::get(Ty);
 
   // Do a lookup to see if we have already formed one of these.
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
   auto &Slot =
-      *Ty->getContext()
-           .pImpl->CDSConstants.insert(std::make_pair(Elements, nullptr))
-           .first;
+      *pImpl->CDSConstants.insert(std::make_pair(Elements, nullptr)).first;
 
   // The bucket can point to a linked list of different CDS's that have the same
   // body but different types.  For example, 0,0,0,1 could be a 4 element array
@@ -2355,8 +2370,9 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
 
 void ConstantDataSequential::destroyConstantImpl() {
   // Remove the constant from the StringMap.
-  StringMap<ConstantDataSequential*> &CDSConstants = 
-    getType()->getContext().pImpl->CDSConstants;
+  LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->ConstantLock);
+  StringMap<ConstantDataSequential*> &CDSConstants = pImpl->CDSConstants;
 
   StringMap<ConstantDataSequential*>::iterator Slot =
     CDSConstants.find(getRawDataValues());
@@ -2370,7 +2386,7 @@ void ConstantDataSequential::destroyConstantImpl() {
     // If there is only one value in the bucket (common case) it must be this
     // entry, and removing the entry should remove the bucket completely.
     assert((*Entry) == this && "Hash mismatch in ConstantDataSequential");
-    getContext().pImpl->CDSConstants.erase(Slot);
+    CDSConstants.erase(Slot);
   } else {
     // Otherwise, there are multiple entries linked off the bucket, unlink the 
     // node we care about but keep the bucket around.
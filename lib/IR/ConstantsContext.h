@@ -15,6 +15,7 @@
 #ifndef LLVM_LIB_IR_CONSTANTSCONTEXT_H
 #define LLVM_LIB_IR_CONSTANTSCONTEXT_H
 
+#include "ShardedUniquingTable.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMapInfo.h"
 #include "llvm/ADT/DenseSet.h"
@@ -35,6 +36,7 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
 #include <utility>
 
 #define DEBUG_TYPE "ir"
@@ -616,11 +618,15 @@ private:
   };
 
 public:
-  using MapTy = DenseSet<ConstantClass *, MapInfo>;
+  using MapTy = ShardedDenseSet<ConstantClass *, MapInfo>;
 
 private:
   MapTy Map;
 
+  /// Guards the use lists of the operands of new constants in thread-safe
+  /// mode, since constants in different shards may share an operand.
+  std::mutex *OperandLock = nullptr;
+
 public:
   typename MapTy::iterator begin() { return Map.begin(); }
   typename MapTy::iterator end() { return Map.end(); }
@@ -630,12 +636,27 @@ public:
       delete I; // Asserts that use_empty().
   }
 
+  /// Allow getOrCreate() to be called from several threads at once. New
+  /// constants are added to the use lists of their operands under \p Lock,
+  /// if any.
+  void makeThreadSafe(std::mutex *Lock = nullptr) {
+    Map.makeThreadSafe();
+    OperandLock = Lock;
+  }
+
 private:
-  ConstantClass *create(TypeClass *Ty, ValType V, LookupKeyHashed &HashKey) {
-    ConstantClass *Result = V.create(Ty);
+  ConstantClass *create(TypeClass *Ty, ValType V, LookupKeyHashed &HashKey,
+                        typename MapTy::Shard &Shard) {
+    ConstantClass *Result;
+    if (OperandLock) {
+      std::lock_guard<std::mutex> Lock(*OperandLock);
+      Result = V.create(Ty);
+    } else {
+      Result = V.create(Ty);
+    }
 
     assert(Result->getType() == Ty && "Type specified is not correct!");
-    Map.insert_as(Result, HashKey);
+    Shard->insert_as(Result, HashKey);
 
     return Result;
   }
@@ -649,9 +670,10 @@ public:
 
     ConstantClass *Result = nullptr;
 
-    auto I = Map.find_as(Lookup);
-    if (I == Map.end())
-      Result = create(Ty, V, Lookup);
+    auto Shard = Map.getShardForHash(Lookup.first);
+    auto I = Shard->find_as(Lookup);
+    if (I == Shard->end())
+      Result = create(Ty, V, Lookup, Shard);
     else
       Result = *I;
     assert(Result && "Unexpected nullptr");
@@ -661,12 +683,15 @@ public:
 
   /// Remove this constant from the map
   void remove(ConstantClass *CP) {
-    typename MapTy::iterator I = Map.find(CP);
-    assert(I != Map.end() && "Constant not found in constant table!");
+    auto Shard = Map.getShardFor(CP);
+    auto I = Shard->find(CP);
+    assert(I != Shard->end() && "Constant not found in constant table!");
     assert(*I == CP && "Didn't find correct element?");
-    Map.erase(I);
+    Shard->erase(I);
   }
 
+  /// Mutating a constant in place is not synchronized with other threads
+  /// using it; only the table itself is kept consistent.
   ConstantClass *replaceOperandsInPlace(ArrayRef<Constant *> Operands,
                                         ConstantClass *CP, Value *From,
                                         Constant *To, unsigned NumUpdated = 0,
@@ -675,9 +700,12 @@ public:
     /// Hash once, and reuse it for the lookup and the insertion if needed.
     LookupKeyHashed Lookup(MapInfo::getHashValue(Key), Key);
 
-    auto I = Map.find_as(Lookup);
-    if (I != Map.end())
-      return *I;
+    {
+      auto Shard = Map.getShardForHash(Lookup.first);
+      auto I = Shard->find_as(Lookup);
+      if (I != Shard->end())
+        return *I;
+    }
 
     // Update to the new value.  Optimize for the case when we have a single
     // operand that we're changing, but handle bulk updates efficiently.
@@ -691,7 +719,7 @@ public:
         if (CP->getOperand(I) == From)
           CP->setOperand(I, To);
     }
-    Map.insert_as(CP, Lookup);
+    Map.getShardForHash(Lookup.first)->insert_as(CP, Lookup);
     return nullptr;
   }
 
@@ -294,6 +294,7 @@ DICompositeType *DICompositeType::buildODRType(
   assert(!Identifier.getString().empty() && "Expected valid identifier");
   if (!Context.isODRUniquingDebugTypes())
     return nullptr;
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->DITypeMapLock);
   auto *&CT = (*Context.pImpl->DITypeMap)[&Identifier];
   if (!CT)
     return CT = DICompositeType::getDistinct(
@@ -328,6 +329,7 @@ DICompositeType *DICompositeType::getODRType(
   assert(!Identifier.getString().empty() && "Expected valid identifier");
   if (!Context.isODRUniquingDebugTypes())
     return nullptr;
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->DITypeMapLock);
   auto *&CT = (*Context.pImpl->DITypeMap)[&Identifier];
   if (!CT)
     CT = DICompositeType::getDistinct(
@@ -342,6 +344,7 @@ DICompositeType *DICompositeType::getODRTypeIfExists(LLVMContext &Context,
   assert(!Identifier.getString().empty() && "Expected valid identifier");
   if (!Context.isODRUniquingDebugTypes())
     return nullptr;
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->DITypeMapLock);
   return Context.pImpl->DITypeMap->lookup(&Identifier);
 }
 
@@ -308,6 +308,14 @@ void LLVMContext::enableDebugTypeODRUniquing() {
 
 void LLVMContext::disableDebugTypeODRUniquing() { pImpl->DITypeMap.reset(); }
 
+void LLVMContext::enableThreadSafeUniquing() {
+  pImpl->enableThreadSafeUniquing();
+}
+
+bool LLVMContext::isThreadSafeUniquing() const {
+  return pImpl->ThreadSafeUniquing;
+}
+
 void LLVMContext::setDiscardValueNames(bool Discard) {
   pImpl->DiscardValueNames = Discard;
 }
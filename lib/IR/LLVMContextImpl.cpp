@@ -96,24 +96,20 @@ LLVMContextImpl::~LLVMContextImpl() {
   CDSConstants.clear();
 
   // Destroy attributes.
-  for (FoldingSetIterator<AttributeImpl> I = AttrsSet.begin(),
-         E = AttrsSet.end(); I != E; ) {
-    FoldingSetIterator<AttributeImpl> Elem = I++;
+  for (auto I = AttrsSet.begin(), E = AttrsSet.end(); I != E; ) {
+    auto Elem = I++;
     delete &*Elem;
   }
 
   // Destroy attribute lists.
-  for (FoldingSetIterator<AttributeListImpl> I = AttrsLists.begin(),
-                                             E = AttrsLists.end();
-       I != E;) {
-    FoldingSetIterator<AttributeListImpl> Elem = I++;
+  for (auto I = AttrsLists.begin(), E = AttrsLists.end(); I != E;) {
+    auto Elem = I++;
     delete &*Elem;
   }
 
   // Destroy attribute node lists.
-  for (FoldingSetIterator<AttributeSetNode> I = AttrsSetNodes.begin(),
-         E = AttrsSetNodes.end(); I != E; ) {
-    FoldingSetIterator<AttributeSetNode> Elem = I++;
+  for (auto I = AttrsSetNodes.begin(), E = AttrsSetNodes.end(); I != E; ) {
+    auto Elem = I++;
     delete &*Elem;
   }
 
@@ -148,6 +144,33 @@ void LLVMContextImpl::dropTriviallyDeadConstantArrays() {
   } while (Changed);
 }
 
+void LLVMContextImpl::enableThreadSafeUniquing() {
+  if (ThreadSafeUniquing)
+    return;
+
+  // Create the lazily initialized singletons up front, so that other threads
+  // only ever read them.
+  LLVMContext &C = VoidTy.getContext();
+  ConstantInt::getTrue(C);
+  ConstantInt::getFalse(C);
+  ConstantTokenNone::get(C);
+
+  AttrsSet.makeThreadSafe();
+  AttrsLists.makeThreadSafe();
+  AttrsSetNodes.makeThreadSafe();
+#define HANDLE_MDNODE_LEAF_UNIQUABLE(CLASS) CLASS##s.makeThreadSafe();
+#include "llvm/IR/Metadata.def"
+  ArrayConstants.makeThreadSafe(&ConstantOperandLock);
+  StructConstants.makeThreadSafe(&ConstantOperandLock);
+  VectorConstants.makeThreadSafe(&ConstantOperandLock);
+  ExprConstants.makeThreadSafe(&ConstantOperandLock);
+  InlineAsms.makeThreadSafe();
+  FunctionTypes.makeThreadSafe();
+  AnonStructTypes.makeThreadSafe();
+
+  ThreadSafeUniquing = true;
+}
+
 void Module::dropTriviallyDeadConstantArrays() {
   Context.pImpl->dropTriviallyDeadConstantArrays();
 }
@@ -17,6 +17,7 @@
 
 #include "AttributeImpl.h"
 #include "ConstantsContext.h"
+#include "ShardedUniquingTable.h"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/ArrayRef.h"
@@ -47,6 +48,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -1186,9 +1188,9 @@ public:
       DenseMap<APFloat, std::unique_ptr<ConstantFP>, DenseMapAPFloatKeyInfo>;
   FPMapTy FPConstants;
 
-  FoldingSet<AttributeImpl> AttrsSet;
-  FoldingSet<AttributeListImpl> AttrsLists;
-  FoldingSet<AttributeSetNode> AttrsSetNodes;
+  ShardedFoldingSet<AttributeImpl> AttrsSet;
+  ShardedFoldingSet<AttributeListImpl> AttrsLists;
+  ShardedFoldingSet<AttributeSetNode> AttrsSetNodes;
 
   StringMap<MDString, BumpPtrAllocator> MDStringCache;
   DenseMap<Value *, ValueAsMetadata *> ValuesAsMetadata;
@@ -1197,7 +1199,7 @@ public:
   DenseMap<const Value*, ValueName*> ValueNames;
 
 #define HANDLE_MDNODE_LEAF_UNIQUABLE(CLASS)                                    \
-  DenseSet<CLASS *, CLASS##Info> CLASS##s;
+  ShardedDenseSet<CLASS *, CLASS##Info> CLASS##s;
 #include "llvm/IR/Metadata.def"
 
   // Optional map for looking up composite types by identifier.
@@ -1248,9 +1250,10 @@ public:
   
   DenseMap<unsigned, IntegerType*> IntegerTypes;
 
-  using FunctionTypeSet = DenseSet<FunctionType *, FunctionTypeKeyInfo>;
+  using FunctionTypeSet =
+      ShardedDenseSet<FunctionType *, FunctionTypeKeyInfo>;
   FunctionTypeSet FunctionTypes;
-  using StructTypeSet = DenseSet<StructType *, AnonStructTypeKeyInfo>;
+  using StructTypeSet = ShardedDenseSet<StructType *, AnonStructTypeKeyInfo>;
   StructTypeSet AnonStructTypes;
   StringMap<StructType*> NamedStructTypes;
   unsigned NamedStructTypesUniqueID = 0;
@@ -1324,6 +1327,37 @@ public:
   /// not.
   bool DiscardValueNames = false;
 
+  /// Whether the uniquing tables may be used from several threads at once.
+  /// The hash-based tables are sharded and lock each shard on their own; the
+  /// locks below guard the remaining ones, and are only taken in this mode.
+  bool ThreadSafeUniquing = false;
+
+  /// Guards the non-sharded type tables and TypeAllocator.
+  std::mutex TypeLock;
+
+  /// Guards the non-sharded constant tables.
+  std::mutex ConstantLock;
+
+  /// Guards BlockAddresses, and the use lists of the operands of constants
+  /// being created, which threads uniquing different constants may share.
+  std::mutex ConstantOperandLock;
+
+  /// Guards MDStringCache, the Value/Metadata bridges, DistinctMDNodes, and
+  /// the use maps of ValueAsMetadata.
+  std::mutex MetadataLock;
+
+  /// Guards DITypeMap, whose users create distinct nodes under it.
+  std::mutex DITypeMapLock;
+
+  /// Lock \p M if the context is in thread-safe uniquing mode.
+  std::unique_lock<std::mutex> lockIfThreadSafe(std::mutex &M) {
+    if (!ThreadSafeUniquing)
+      return std::unique_lock<std::mutex>();
+    return std::unique_lock<std::mutex>(M);
+  }
+
+  void enableThreadSafeUniquing();
+
   LLVMContextImpl(LLVMContext &C);
   ~LLVMContextImpl();
 
@@ -61,12 +61,14 @@
 using namespace llvm;
 
 MetadataAsValue::MetadataAsValue(Type *Ty, Metadata *MD)
-    : Value(Ty, MetadataAsValueVal), MD(MD) {
-  track();
-}
+    : Value(Ty, MetadataAsValueVal), MD(MD) {}
 
 MetadataAsValue::~MetadataAsValue() {
-  getType()->getContext().pImpl->MetadataAsValues.erase(MD);
+  LLVMContextImpl *pImpl = getType()->getContext().pImpl;
+  {
+    auto Lock = pImpl->lockIfThreadSafe(pImpl->MetadataLock);
+    pImpl->MetadataAsValues.erase(MD);
+  }
   untrack();
 }
 
@@ -105,15 +107,25 @@ static Metadata *canonicalizeMetadataForValue(LLVMContext &Context,
 
 MetadataAsValue *MetadataAsValue::get(LLVMContext &Context, Metadata *MD) {
   MD = canonicalizeMetadataForValue(Context, MD);
-  auto *&Entry = Context.pImpl->MetadataAsValues[MD];
-  if (!Entry)
-    Entry = new MetadataAsValue(Type::getMetadataTy(Context), MD);
-  return Entry;
+  Type *Ty = Type::getMetadataTy(Context);
+  MetadataAsValue *MAV;
+  {
+    auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->MetadataLock);
+    auto *&Entry = Context.pImpl->MetadataAsValues[MD];
+    if (Entry)
+      return Entry;
+    MAV = Entry = new MetadataAsValue(Ty, MD);
+  }
+
+  // Tracking takes the lock too.
+  MAV->track();
+  return MAV;
 }
 
 MetadataAsValue *MetadataAsValue::getIfExists(LLVMContext &Context,
                                               Metadata *MD) {
   MD = canonicalizeMetadataForValue(Context, MD);
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->MetadataLock);
   auto &Store = Context.pImpl->MetadataAsValues;
   return Store.lookup(MD);
 }
@@ -196,6 +208,9 @@ bool MetadataTracking::isReplaceable(const Metadata &MD) {
 }
 
 void ReplaceableMetadataImpl::addRef(void *Ref, OwnerTy Owner) {
+  // Threads share the use maps of constants. Uniquing a node with a constant
+  // operand, for one, adds a reference to it.
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->MetadataLock);
   bool WasInserted =
       UseMap.insert(std::make_pair(Ref, std::make_pair(Owner, NextIndex)))
           .second;
@@ -207,6 +222,7 @@ void ReplaceableMetadataImpl::addRef(void *Ref, OwnerTy Owner) {
 }
 
 void ReplaceableMetadataImpl::dropRef(void *Ref) {
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->MetadataLock);
   bool WasErased = UseMap.erase(Ref);
   (void)WasErased;
   assert(WasErased && "Expected to drop a reference");
@@ -214,6 +230,7 @@ void ReplaceableMetadataImpl::dropRef(void *Ref) {
 
 void ReplaceableMetadataImpl::moveRef(void *Ref, void *New,
                                       const Metadata &MD) {
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->MetadataLock);
   auto I = UseMap.find(Ref);
   assert(I != UseMap.end() && "Expected to move a reference");
   auto OwnerAndIndex = I->second;
@@ -342,6 +359,7 @@ ValueAsMetadata *ValueAsMetadata::get(Value *V) {
   assert(V && "Unexpected null Value");
 
   auto &Context = V->getContext();
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->MetadataLock);
   auto *&Entry = Context.pImpl->ValuesAsMetadata[V];
   if (!Entry) {
     assert((isa<Constant>(V) || isa<Argument>(V) || isa<Instruction>(V)) &&
@@ -359,22 +377,29 @@ ValueAsMetadata *ValueAsMetadata::get(Value *V) {
 
 ValueAsMetadata *ValueAsMetadata::getIfExists(Value *V) {
   assert(V && "Unexpected null Value");
-  return V->getContext().pImpl->ValuesAsMetadata.lookup(V);
+  LLVMContextImpl *pImpl = V->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->MetadataLock);
+  return pImpl->ValuesAsMetadata.lookup(V);
 }
 
 void ValueAsMetadata::handleDeletion(Value *V) {
   assert(V && "Expected valid value");
 
-  auto &Store = V->getType()->getContext().pImpl->ValuesAsMetadata;
-  auto I = Store.find(V);
-  if (I == Store.end())
-    return;
+  LLVMContextImpl *pImpl = V->getType()->getContext().pImpl;
+  ValueAsMetadata *MD;
+  {
+    auto Lock = pImpl->lockIfThreadSafe(pImpl->MetadataLock);
+    auto &Store = pImpl->ValuesAsMetadata;
+    auto I = Store.find(V);
+    if (I == Store.end())
+      return;
 
-  // Remove old entry from the map.
-  ValueAsMetadata *MD = I->second;
-  assert(MD && "Expected valid metadata");
-  assert(MD->getValue() == V && "Expected valid mapping");
-  Store.erase(I);
+    // Remove old entry from the map.
+    MD = I->second;
+    assert(MD && "Expected valid metadata");
+    assert(MD->getValue() == V && "Expected valid mapping");
+    Store.erase(I);
+  }
 
   // Delete the metadata.
   MD->replaceAllUsesWith(nullptr);
@@ -444,6 +469,7 @@ void ValueAsMetadata::handleRAUW(Value *From, Value *To) {
 //
 
 MDString *MDString::get(LLVMContext &Context, StringRef Str) {
+  auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->MetadataLock);
   auto &Store = Context.pImpl->MDStringCache;
   auto I = Store.try_emplace(Str);
   auto &MapEntry = I.first->getValue();
@@ -751,11 +777,13 @@ void MDNode::deleteAsSubclass() {
 }
 
 template <class T, class InfoT>
-static T *uniquifyImpl(T *N, DenseSet<T *, InfoT> &Store) {
-  if (T *U = getUniqued(Store, N))
-    return U;
+static T *uniquifyImpl(T *N, ShardedDenseSet<T *, InfoT> &Store) {
+  auto Shard = Store.getShardFor(N);
+  auto I = Shard->find_as(typename InfoT::KeyTy(N));
+  if (I != Shard->end())
+    return *I;
 
-  Store.insert(N);
+  Shard->insert(N);
   return N;
 }
 
@@ -796,7 +824,8 @@ void MDNode::eraseFromStore() {
     llvm_unreachable("Invalid or non-uniquable subclass of MDNode");
 #define HANDLE_MDNODE_LEAF_UNIQUABLE(CLASS)                                    \
   case CLASS##Kind:                                                            \
-    getContext().pImpl->CLASS##s.erase(cast<CLASS>(this));                     \
+    getContext().pImpl->CLASS##s.getShardFor(cast<CLASS>(this))->erase(        \
+        cast<CLASS>(this));                                                    \
     break;
 #include "llvm/IR/Metadata.def"
   }
@@ -845,7 +874,9 @@ void MDNode::storeDistinctInContext() {
 #include "llvm/IR/Metadata.def"
   }
 
-  getContext().pImpl->DistinctMDNodes.push_back(this);
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->MetadataLock);
+  pImpl->DistinctMDNodes.push_back(this);
 }
 
 void MDNode::replaceOperandWith(unsigned I, Metadata *New) {
@@ -14,16 +14,17 @@
 #ifndef LLVM_IR_METADATAIMPL_H
 #define LLVM_IR_METADATAIMPL_H
 
-#include "llvm/ADT/DenseSet.h"
+#include "ShardedUniquingTable.h"
 #include "llvm/IR/Metadata.h"
 
 namespace llvm {
 
 template <class T, class InfoT>
-static T *getUniqued(DenseSet<T *, InfoT> &Store,
+static T *getUniqued(ShardedDenseSet<T *, InfoT> &Store,
                      const typename InfoT::KeyTy &Key) {
-  auto I = Store.find_as(Key);
-  return I == Store.end() ? nullptr : *I;
+  auto Shard = Store.getShardFor(Key);
+  auto I = Shard->find_as(Key);
+  return I == Shard->end() ? nullptr : *I;
 }
 
 template <class T> T *MDNode::storeImpl(T *N, StorageType Storage) {
@@ -42,9 +43,22 @@ template <class T> T *MDNode::storeImpl(T *N, StorageType Storage) {
 template <class T, class StoreT>
 T *MDNode::storeImpl(T *N, StorageType Storage, StoreT &Store) {
   switch (Storage) {
-  case Uniqued:
-    Store.insert(N);
+  case Uniqued: {
+    auto Shard = Store.getShardFor(N);
+    if (Store.isThreadSafe()) {
+      // Another thread may have stored an equal node since the caller looked
+      // it up. Keep that one, so that the node stays unique.
+      using KeyTy = typename StoreT::InfoTy::KeyTy;
+      auto I = Shard->find_as(KeyTy(N));
+      if (I != Shard->end()) {
+        N->dropAllReferences();
+        N->deleteAsSubclass();
+        return *I;
+      }
+    }
+    Shard->insert(N);
     break;
+  }
   case Distinct:
     N->storeDistinctInContext();
     break;
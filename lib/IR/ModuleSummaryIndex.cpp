@@ -14,13 +14,34 @@
 
 #include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
 using namespace llvm;
 
+SummaryMaterializer::~SummaryMaterializer() = default;
+
+ModuleSummaryIndex::ModuleSummaryIndex() = default;
+
+ModuleSummaryIndex::ModuleSummaryIndex(ModuleSummaryIndex &&) = default;
+
+ModuleSummaryIndex &ModuleSummaryIndex::
+operator=(ModuleSummaryIndex &&) = default;
+
+ModuleSummaryIndex::~ModuleSummaryIndex() = default;
+
+void ModuleSummaryIndex::setOwnedMemoryBuffer(
+    std::unique_ptr<MemoryBuffer> MB) {
+  OwnedMemoryBuffer = std::move(MB);
+}
+
 // Collect for the given module the list of function it defines
 // (GUID -> Summary).
 void ModuleSummaryIndex::collectDefinedFunctionsForModule(
     StringRef ModulePath, GVSummaryMapTy &GVSummaryMap) const {
-  for (auto &GlobalList : *this) {
+  // Only decode the summaries of a lazily loaded index that can belong to
+  // this module; the other GUIDs cannot have a summary in it.
+  if (Materializer)
+    Materializer->materializeModule(ModulePath);
+  for (auto &GlobalList : GlobalValueMap) {
     auto GUID = GlobalList.first;
     for (auto &GlobSummary : GlobalList.second.SummaryList) {
       auto *Summary = dyn_cast_or_null<FunctionSummary>(GlobSummary.get());
@@ -0,0 +1,239 @@
+//===- ShardedUniquingTable.h - Lock-striped uniquing tables ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the uniquing tables used by LLVMContextImpl for types,
+// constants, metadata and attributes. Each table is split into shards selected
+// by the hash of the key, and each shard has its own lock, so that threads
+// sharing a context in thread-safe uniquing mode rarely contend.
+//
+// In the default single-threaded mode only the first shard exists: every entry
+// lives in it, no hash is computed to pick it, and no lock is taken. The other
+// shards and the locks are allocated when switching to thread-safe mode.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_IR_SHARDEDUNIQUINGTABLE_H
+#define LLVM_LIB_IR_SHARDEDUNIQUINGTABLE_H
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/FoldingSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace llvm {
+
+template <typename TableTy> class ShardedUniquingTable {
+protected:
+  enum : unsigned { Log2NumShards = 4, NumShards = 1u << Log2NumShards };
+
+  /// The shards after the first one, and the locks of all shards. They are
+  /// only allocated in thread-safe mode, so that the single-threaded mode costs
+  /// no more memory than a plain table.
+  struct ThreadSafeShards {
+    TableTy Tables[NumShards - 1];
+    std::mutex Locks[NumShards];
+  };
+
+  TableTy FirstTable;
+  std::unique_ptr<ThreadSafeShards> OtherShards;
+
+  /// Pick a shard from the high bits of the scrambled hash; the tables
+  /// themselves use the low bits to pick a bucket.
+  static unsigned getShardIndex(unsigned Hash) {
+    return (Hash * 0x9E3779B9u) >> (32 - Log2NumShards);
+  }
+
+  unsigned getNumShards() const { return OtherShards ? NumShards : 1; }
+
+  TableTy &getTable(unsigned Idx) {
+    return Idx ? OtherShards->Tables[Idx - 1] : FirstTable;
+  }
+  const TableTy &getTable(unsigned Idx) const {
+    return Idx ? OtherShards->Tables[Idx - 1] : FirstTable;
+  }
+
+  /// Allocate the other shards, which switches to thread-safe mode. Returns
+  /// false if the table is already in this mode.
+  bool allocateShards() {
+    if (OtherShards)
+      return false;
+    OtherShards.reset(new ThreadSafeShards());
+    return true;
+  }
+
+public:
+  /// Exclusive access to one shard of the table, for as long as the handle
+  /// lives. The lock is only taken in thread-safe mode.
+  class Shard {
+    std::unique_lock<std::mutex> Lock;
+    TableTy *Table;
+
+  public:
+    Shard(std::mutex *M, TableTy &Table) : Table(&Table) {
+      if (M)
+        Lock = std::unique_lock<std::mutex>(*M);
+    }
+
+    TableTy *operator->() const { return Table; }
+    TableTy &operator*() const { return *Table; }
+  };
+
+  /// Iterate over the entries of all shards. Iteration is not synchronized:
+  /// it is only valid while no other thread uses the table. Like the iterators
+  /// of the underlying tables, it stays valid when an entry is erased.
+  template <typename InnerIterTy> class shard_iterator {
+    friend class ShardedUniquingTable;
+
+    ShardedUniquingTable *Parent;
+    unsigned Idx;
+    InnerIterTy I;
+
+    shard_iterator(ShardedUniquingTable *Parent, unsigned Idx, InnerIterTy I)
+        : Parent(Parent), Idx(Idx), I(I) {
+      skipEmptyShards();
+    }
+
+    void skipEmptyShards() {
+      while (Idx + 1 < Parent->getNumShards() &&
+             I == Parent->getTable(Idx).end())
+        I = Parent->getTable(++Idx).begin();
+    }
+
+  public:
+    auto operator*() const -> decltype(*I) { return *I; }
+
+    shard_iterator &operator++() {
+      ++I;
+      skipEmptyShards();
+      return *this;
+    }
+    shard_iterator operator++(int) {
+      shard_iterator Tmp = *this;
+      ++*this;
+      return Tmp;
+    }
+
+    bool operator==(const shard_iterator &RHS) const {
+      return Idx == RHS.Idx && I == RHS.I;
+    }
+    bool operator!=(const shard_iterator &RHS) const { return !(*this == RHS); }
+  };
+
+  using iterator = shard_iterator<typename TableTy::iterator>;
+
+  iterator begin() { return iterator(this, 0, FirstTable.begin()); }
+  iterator end() {
+    unsigned Last = getNumShards() - 1;
+    return iterator(this, Last, getTable(Last).end());
+  }
+
+  /// Return the number of entries in all shards. Like iteration, this is only
+  /// valid while no other thread uses the table.
+  unsigned size() const {
+    unsigned Size = 0;
+    for (unsigned Idx = 0, E = getNumShards(); Idx != E; ++Idx)
+      Size += getTable(Idx).size();
+    return Size;
+  }
+
+  bool isThreadSafe() const { return OtherShards != nullptr; }
+
+  /// Return the shard holding the entries with the given hash.
+  Shard getShardForHash(unsigned Hash) {
+    if (!OtherShards)
+      return Shard(nullptr, FirstTable);
+    unsigned Idx = getShardIndex(Hash);
+    return Shard(&OtherShards->Locks[Idx], getTable(Idx));
+  }
+
+  /// Return the shard holding the entries whose hash is computed by
+  /// \p ComputeHash. The hash is only computed in thread-safe mode.
+  template <typename HashFnTy> Shard getShard(HashFnTy ComputeHash) {
+    if (!OtherShards)
+      return Shard(nullptr, FirstTable);
+    unsigned Idx = getShardIndex(ComputeHash());
+    return Shard(&OtherShards->Locks[Idx], getTable(Idx));
+  }
+};
+
+/// A DenseSet of uniqued pointers split into shards by \p InfoT's hash.
+template <typename ValueT, typename InfoT>
+class ShardedDenseSet : public ShardedUniquingTable<DenseSet<ValueT, InfoT>> {
+  using BaseTy = ShardedUniquingTable<DenseSet<ValueT, InfoT>>;
+
+public:
+  using InfoTy = InfoT;
+  using Shard = typename BaseTy::Shard;
+
+  /// Return the shard holding \p Key, which is either an entry or any lookup
+  /// key that \p InfoT can hash.
+  template <typename LookupKeyT> Shard getShardFor(const LookupKeyT &Key) {
+    return this->getShard([&] { return InfoT::getHashValue(Key); });
+  }
+
+  /// Switch to thread-safe mode, moving the entries created so far to the
+  /// shards their hash selects. Must be called before other threads use the
+  /// table.
+  void makeThreadSafe() {
+    if (!this->allocateShards())
+      return;
+
+    auto &First = this->FirstTable;
+    SmallVector<ValueT, 16> Moved;
+    for (const ValueT &V : First)
+      if (this->getShardIndex(InfoT::getHashValue(V)))
+        Moved.push_back(V);
+    for (const ValueT &V : Moved) {
+      First.erase(V);
+      this->getTable(this->getShardIndex(InfoT::getHashValue(V))).insert(V);
+    }
+  }
+};
+
+/// A FoldingSet split into shards by the hash of the node profile.
+template <typename T>
+class ShardedFoldingSet : public ShardedUniquingTable<FoldingSet<T>> {
+  using BaseTy = ShardedUniquingTable<FoldingSet<T>>;
+
+public:
+  using Shard = typename BaseTy::Shard;
+
+  /// Return the shard holding the nodes with profile \p ID.
+  Shard getShardFor(const FoldingSetNodeID &ID) {
+    return this->getShard([&] { return ID.ComputeHash(); });
+  }
+
+  /// Switch to thread-safe mode, moving the nodes created so far to the
+  /// shards their profile selects. Must be called before other threads use
+  /// the table.
+  void makeThreadSafe() {
+    if (!this->allocateShards())
+      return;
+
+    auto &First = this->FirstTable;
+    SmallVector<T *, 16> Nodes;
+    for (T &N : First)
+      Nodes.push_back(&N);
+    for (T *N : Nodes) {
+      FoldingSetNodeID ID;
+      FoldingSetTrait<T>::Profile(*N, ID);
+      unsigned Idx = this->getShardIndex(ID.ComputeHash());
+      if (!Idx)
+        continue;
+      First.RemoveNode(N);
+      this->getTable(Idx).InsertNode(N);
+    }
+  }
+};
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_IR_SHARDEDUNIQUINGTABLE_H
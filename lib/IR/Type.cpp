@@ -253,6 +253,7 @@ IntegerType *IntegerType::get(LLVMContext &C, unsigned NumBits) {
     break;
   }
   
+  auto Lock = C.pImpl->lockIfThreadSafe(C.pImpl->TypeLock);
   IntegerType *&Entry = C.pImpl->IntegerTypes[NumBits];
 
   if (!Entry)
@@ -298,15 +299,19 @@ FunctionType *FunctionType::get(Type *ReturnType,
                                 ArrayRef<Type*> Params, bool isVarArg) {
   LLVMContextImpl *pImpl = ReturnType->getContext().pImpl;
   FunctionTypeKeyInfo::KeyTy Key(ReturnType, Params, isVarArg);
-  auto I = pImpl->FunctionTypes.find_as(Key);
+  auto Shard = pImpl->FunctionTypes.getShardFor(Key);
+  auto I = Shard->find_as(Key);
   FunctionType *FT;
 
-  if (I == pImpl->FunctionTypes.end()) {
-    FT = (FunctionType *)pImpl->TypeAllocator.Allocate(
-        sizeof(FunctionType) + sizeof(Type *) * (Params.size() + 1),
-        alignof(FunctionType));
+  if (I == Shard->end()) {
+    {
+      auto Lock = pImpl->lockIfThreadSafe(pImpl->TypeLock);
+      FT = (FunctionType *)pImpl->TypeAllocator.Allocate(
+          sizeof(FunctionType) + sizeof(Type *) * (Params.size() + 1),
+          alignof(FunctionType));
+    }
     new (FT) FunctionType(ReturnType, Params, isVarArg);
-    pImpl->FunctionTypes.insert(FT);
+    Shard->insert(FT);
   } else {
     FT = *I;
   }
@@ -337,15 +342,19 @@ StructType *StructType::get(LLVMContext &Context, ArrayRef<Type*> ETypes,
                             bool isPacked) {
   LLVMContextImpl *pImpl = Context.pImpl;
   AnonStructTypeKeyInfo::KeyTy Key(ETypes, isPacked);
-  auto I = pImpl->AnonStructTypes.find_as(Key);
+  auto Shard = pImpl->AnonStructTypes.getShardFor(Key);
+  auto I = Shard->find_as(Key);
   StructType *ST;
 
-  if (I == pImpl->AnonStructTypes.end()) {
+  if (I == Shard->end()) {
     // Value not found.  Create a new type!
-    ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+    {
+      auto Lock = pImpl->lockIfThreadSafe(pImpl->TypeLock);
+      ST = new (pImpl->TypeAllocator) StructType(Context);
+    }
     ST->setSubclassData(SCDB_IsLiteral);  // Literal struct.
     ST->setBody(ETypes, isPacked);
-    Context.pImpl->AnonStructTypes.insert(ST);
+    Shard->insert(ST);
   } else {
     ST = *I;
   }
@@ -367,13 +376,17 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
     return;
   }
 
-  ContainedTys = Elements.copy(getContext().pImpl->TypeAllocator).data();
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->TypeLock);
+  ContainedTys = Elements.copy(pImpl->TypeAllocator).data();
 }
 
 void StructType::setName(StringRef Name) {
   if (Name == getName()) return;
 
-  StringMap<StructType *> &SymbolTable = getContext().pImpl->NamedStructTypes;
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->TypeLock);
+  StringMap<StructType *> &SymbolTable = pImpl->NamedStructTypes;
 
   using EntryTy = StringMap<StructType *>::MapEntryTy;
 
@@ -422,7 +435,11 @@ void StructType::setName(StringRef Name) {
 // StructType Helper functions.
 
 StructType *StructType::create(LLVMContext &Context, StringRef Name) {
-  StructType *ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+  StructType *ST;
+  {
+    auto Lock = Context.pImpl->lockIfThreadSafe(Context.pImpl->TypeLock);
+    ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+  }
   if (!Name.empty())
     ST->setName(Name);
   return ST;
@@ -507,7 +524,9 @@ bool StructType::isLayoutIdentical(StructType *Other) const {
 }
 
 StructType *Module::getTypeByName(StringRef Name) const {
-  return getContext().pImpl->NamedStructTypes.lookup(Name);
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->TypeLock);
+  return pImpl->NamedStructTypes.lookup(Name);
 }
 
 //===----------------------------------------------------------------------===//
@@ -569,6 +588,7 @@ ArrayType *ArrayType::get(Type *ElementType, uint64_t NumElements) {
   assert(isValidElementType(ElementType) && "Invalid type for array element!");
 
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->TypeLock);
   ArrayType *&Entry = 
     pImpl->ArrayTypes[std::make_pair(ElementType, NumElements)];
 
@@ -597,6 +617,7 @@ VectorType *VectorType::get(Type *ElementType, unsigned NumElements) {
                                             "pointer type.");
 
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  auto Lock = pImpl->lockIfThreadSafe(pImpl->TypeLock);
   VectorType *&Entry = ElementType->getContext().pImpl
     ->VectorTypes[std::make_pair(ElementType, NumElements)];
 
@@ -619,7 +640,8 @@ PointerType *PointerType::get(Type *EltTy, unsigned AddressSpace) {
   assert(isValidElementType(EltTy) && "Invalid type for pointer element!");
   
   LLVMContextImpl *CImpl = EltTy->getContext().pImpl;
-  
+  auto Lock = CImpl->lockIfThreadSafe(CImpl->TypeLock);
+
   // Since AddressSpace #0 is the common case, we special case it.
   PointerType *&Entry = AddressSpace == 0 ? CImpl->PointerTypes[EltTy]
      : CImpl->ASPointerTypes[std::make_pair(EltTy, AddressSpace)];
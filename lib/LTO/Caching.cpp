@@ -13,6 +13,7 @@
 
 #include "llvm/LTO/Caching.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CachePruning.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -36,6 +37,10 @@ Expected<NativeObjectCache> lto::localCache(StringRef CacheDirectoryPath,
     ErrorOr<std::unique_ptr<MemoryBuffer>> MBOrErr =
         MemoryBuffer::getFile(EntryPath);
     if (MBOrErr) {
+      recordCacheEntryAccess(CacheDirectoryPath,
+                             sys::path::filename(EntryPath),
+                             (*MBOrErr)->getBufferSize(),
+                             /*IsNewEntry=*/false);
       AddBuffer(Task, std::move(*MBOrErr), EntryPath);
       return AddStreamFn();
     }
@@ -75,6 +80,10 @@ Expected<NativeObjectCache> lto::localCache(StringRef CacheDirectoryPath,
         if (!MBOrErr)
           report_fatal_error(Twine("Failed to open cache file ") + EntryPath +
                              ": " + MBOrErr.getError().message() + "\n");
+        recordCacheEntryAccess(sys::path::parent_path(EntryPath),
+                               sys::path::filename(EntryPath),
+                               (*MBOrErr)->getBufferSize(),
+                               /*IsNewEntry=*/true);
         AddBuffer(Task, std::move(*MBOrErr), EntryPath);
       }
     };
@@ -28,6 +28,7 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SHA1.h"
 #include "llvm/Support/SourceMgr.h"
@@ -42,6 +43,7 @@
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Utils/SplitModule.h"
 
+#include <limits>
 #include <set>
 
 using namespace llvm;
@@ -339,12 +341,20 @@ static void thinLTOInternalizeAndPromoteGUID(
 }
 
 // Update the linkages in the given \p Index to mark exported values
-// as external and non-exported values as internal.
+// as external and non-exported values as internal. Each GUID is updated
+// independently, so the entries are processed in parallel.
 void llvm::thinLTOInternalizeAndPromoteInIndex(
     ModuleSummaryIndex &Index,
     function_ref<bool(StringRef, GlobalValue::GUID)> isExported) {
+  std::vector<GlobalValueSummaryMapTy::value_type *> Entries;
+  Entries.reserve(Index.size());
   for (auto &I : Index)
-    thinLTOInternalizeAndPromoteGUID(I.second.SummaryList, I.first, isExported);
+    Entries.push_back(&I);
+  parallel::for_each(parallel::par, Entries.begin(), Entries.end(),
+                     [&](GlobalValueSummaryMapTy::value_type *I) {
+                       thinLTOInternalizeAndPromoteGUID(I->second.SummaryList,
+                                                        I->first, isExported);
+                     });
 }
 
 // Requires a destructor for std::vector<InputModule>.
@@ -548,9 +558,10 @@ LTO::addRegularLTO(BitcodeModule BM, ArrayRef<InputFile::Symbol> Syms,
                    const SymbolResolution *&ResI,
                    const SymbolResolution *ResE) {
   RegularLTOState::AddedModule Mod;
+  // Module-level metadata is loaded on demand, so that the IRMover only reads
+  // the metadata reached from the values it links.
   Expected<std::unique_ptr<Module>> MOrErr =
-      BM.getLazyModule(RegularLTO.Ctx, /*ShouldLazyLoadMetadata*/ true,
-                       /*IsImporting*/ false);
+      BM.getLazyModuleForLinking(RegularLTO.Ctx);
   if (!MOrErr)
     return MOrErr.takeError();
   Module &M = **MOrErr;
@@ -847,6 +858,9 @@ public:
 namespace {
 class InProcessThinBackend : public ThinBackendProc {
   ThreadPool BackendThreadPool;
+  /// The backends submitted to BackendThreadPool, cancelled on the first
+  /// error.
+  ThreadPoolTaskGroup Backends;
   AddStreamFn AddStream;
   NativeObjectCache Cache;
   TypeIdSummariesByGuidTy TypeIdSummariesByGuid;
@@ -864,7 +878,8 @@ public:
       AddStreamFn AddStream, NativeObjectCache Cache)
       : ThinBackendProc(Conf, CombinedIndex, ModuleToDefinedGVSummaries),
         BackendThreadPool(ThinLTOParallelismLevel),
-        AddStream(std::move(AddStream)), Cache(std::move(Cache)) {
+        Backends(BackendThreadPool), AddStream(std::move(AddStream)),
+        Cache(std::move(Cache)) {
     // Create a mapping from type identifier GUIDs to type identifier summaries.
     // This allows backends to use the type identifier GUIDs stored in the
     // function summaries to determine which type identifier summaries affect
@@ -928,34 +943,60 @@ public:
     assert(ModuleToDefinedGVSummaries.count(ModulePath));
     const GVSummaryMapTy &DefinedGlobals =
         ModuleToDefinedGVSummaries.find(ModulePath)->second;
-    BackendThreadPool.async(
-        [=](BitcodeModule BM, ModuleSummaryIndex &CombinedIndex,
-            const FunctionImporter::ImportMapTy &ImportList,
-            const FunctionImporter::ExportSetTy &ExportList,
-            const std::map<GlobalValue::GUID, GlobalValue::LinkageTypes>
-                &ResolvedODR,
-            const GVSummaryMapTy &DefinedGlobals,
-            MapVector<StringRef, BitcodeModule> &ModuleMap,
-            const TypeIdSummariesByGuidTy &TypeIdSummariesByGuid) {
-          Error E = runThinLTOBackendThread(
-              AddStream, Cache, Task, BM, CombinedIndex, ImportList, ExportList,
-              ResolvedODR, DefinedGlobals, ModuleMap, TypeIdSummariesByGuid);
-          if (E) {
-            std::unique_lock<std::mutex> L(ErrMu);
-            if (Err)
-              Err = joinErrors(std::move(*Err), std::move(E));
-            else
-              Err = std::move(E);
-          }
-        },
-        BM, std::ref(CombinedIndex), std::ref(ImportList), std::ref(ExportList),
-        std::ref(ResolvedODR), std::ref(DefinedGlobals), std::ref(ModuleMap),
-        std::ref(TypeIdSummariesByGuid));
+    // Start the most expensive backends first, so that a large module is not
+    // left alone running at the end.
+    Backends.async(
+        std::bind(
+          [=](BitcodeModule BM, ModuleSummaryIndex &CombinedIndex,
+              const FunctionImporter::ImportMapTy &ImportList,
+              const FunctionImporter::ExportSetTy &ExportList,
+              const std::map<GlobalValue::GUID, GlobalValue::LinkageTypes>
+                  &ResolvedODR,
+              const GVSummaryMapTy &DefinedGlobals,
+              MapVector<StringRef, BitcodeModule> &ModuleMap,
+              const TypeIdSummariesByGuidTy &TypeIdSummariesByGuid) {
+            Error E = runThinLTOBackendThread(
+                AddStream, Cache, Task, BM, CombinedIndex, ImportList,
+                ExportList, ResolvedODR, DefinedGlobals, ModuleMap,
+                TypeIdSummariesByGuid);
+            if (E) {
+              Backends.cancel();
+              std::unique_lock<std::mutex> L(ErrMu);
+              if (Err)
+                Err = joinErrors(std::move(*Err), std::move(E));
+              else
+                Err = std::move(E);
+            }
+          },
+          BM, std::ref(CombinedIndex), std::ref(ImportList),
+          std::ref(ExportList), std::ref(ResolvedODR), std::ref(DefinedGlobals),
+          std::ref(ModuleMap), std::ref(TypeIdSummariesByGuid)),
+        estimateBackendCost(CombinedIndex, DefinedGlobals, ImportList));
     return Error::success();
   }
 
+  /// Estimate the cost of a backend as the number of instructions of the
+  /// functions it defines and imports. Aliases are skipped, as their aliasee
+  /// is counted already.
+  static unsigned
+  estimateBackendCost(const ModuleSummaryIndex &CombinedIndex,
+                      const GVSummaryMapTy &DefinedGlobals,
+                      const FunctionImporter::ImportMapTy &ImportList) {
+    uint64_t Cost = 0;
+    for (auto &Def : DefinedGlobals)
+      if (auto *FS = dyn_cast<FunctionSummary>(Def.second))
+        Cost += FS->instCount();
+    for (auto &ImportedModule : ImportList)
+      for (auto &Imported : ImportedModule.second)
+        if (auto *FS = dyn_cast_or_null<FunctionSummary>(
+                CombinedIndex.findSummaryInModule(Imported.first,
+                                                  ImportedModule.first())))
+          Cost += FS->instCount();
+    return std::min<uint64_t>(Cost, std::numeric_limits<unsigned>::max());
+  }
+
   Error wait() override {
-    BackendThreadPool.wait();
+    Backends.wait();
     if (Err)
       return std::move(*Err);
     else
@@ -392,7 +392,13 @@ public:
   ErrorOr<std::unique_ptr<MemoryBuffer>> tryLoadingBuffer() {
     if (EntryPath.empty())
       return std::error_code();
-    return MemoryBuffer::getFile(EntryPath);
+    auto BufOrErr = MemoryBuffer::getFile(EntryPath);
+    if (BufOrErr)
+      recordCacheEntryAccess(sys::path::parent_path(EntryPath),
+                             sys::path::filename(EntryPath),
+                             (*BufOrErr)->getBufferSize(),
+                             /*IsNewEntry=*/false);
+    return BufOrErr;
   }
 
   // Cache the Produced object file
@@ -423,6 +429,10 @@ public:
                            " to save cached entry\n");
       OS << OutputBuffer.getBuffer();
     }
+    recordCacheEntryAccess(sys::path::parent_path(EntryPath),
+                           sys::path::filename(EntryPath),
+                           OutputBuffer.getBufferSize(),
+                           /*IsNewEntry=*/true);
   }
 };
 
@@ -1273,7 +1273,10 @@ static std::string adjustInlineAsm(const std::string &InlineAsm,
 }
 
 Error IRLinker::run() {
-  // Ensure metadata materialized before value mapping.
+  // Ensure metadata materialized before value mapping. When the source module
+  // is loading metadata on demand, this only reads the named metadata and the
+  // attachments of declarations, and the rest is loaded as the mapped values
+  // reference it.
   if (SrcM->getMaterializer())
     if (Error Err = SrcM->getMaterializer()->materializeMetadata())
       return Err;
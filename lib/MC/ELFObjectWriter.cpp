@@ -1046,10 +1046,25 @@ void ELFObjectWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
   Asm.writeSectionData(&Section, Layout);
   setStream(OldStream);
 
+  zlib::CompressionLevel Level = zlib::DefaultCompression;
+  switch (MAI->debugCompressionLevel()) {
+  case DebugCompressionLevel::Default:
+    break;
+  case DebugCompressionLevel::Speed:
+    Level = zlib::BestSpeedCompression;
+    break;
+  case DebugCompressionLevel::Size:
+    Level = zlib::BestSizeCompression;
+    break;
+  }
+
+  // When enabled, large sections are compressed in chunks on several threads.
   SmallVector<char, 128> CompressedContents;
-  if (Error E = zlib::compress(
-          StringRef(UncompressedData.data(), UncompressedData.size()),
-          CompressedContents)) {
+  StringRef Uncompressed(UncompressedData.data(), UncompressedData.size());
+  if (Error E = MAI->parallelDebugCompression()
+                    ? zlib::compressChunked(Uncompressed, CompressedContents,
+                                            Level)
+                    : zlib::compress(Uncompressed, CompressedContents, Level)) {
     consumeError(std::move(E));
     getStream() << UncompressedData;
     return;
@@ -15,14 +15,18 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/BinaryFormat/Magic.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Object/Archive.h"
+#include "llvm/Object/IRObjectFile.h"
+#include "llvm/Object/IRSymtab.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Object/SymbolicFile.h"
 #include "llvm/Support/EndianStream.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
@@ -111,19 +115,19 @@ Expected<NewArchiveMember> NewArchiveMember::getFile(StringRef FileName,
 }
 
 template <typename T>
-static void printWithSpacePadding(raw_fd_ostream &OS, T Data, unsigned Size,
+static void printWithSpacePadding(raw_ostream &OS, T Data, unsigned Size,
                                   bool MayTruncate = false) {
-  uint64_t OldPos = OS.tell();
-  OS << Data;
-  unsigned SizeSoFar = OS.tell() - OldPos;
-  if (Size > SizeSoFar) {
-    OS.indent(Size - SizeSoFar);
-  } else if (Size < SizeSoFar) {
+  SmallString<16> Buf;
+  raw_svector_ostream BufOS(Buf);
+  BufOS << Data;
+  if (Buf.size() > Size) {
     assert(MayTruncate && "Data doesn't fit in Size");
     // Some of the data this is used for (like UID) can be larger than the
     // space available in the archive format. Truncate in that case.
-    OS.seek(OldPos + Size);
+    Buf.resize(Size);
   }
+  OS << Buf;
+  OS.indent(Size - Buf.size());
 }
 
 static bool isBSDLike(object::Archive::Kind Kind) {
@@ -149,8 +153,15 @@ static void print32(raw_ostream &Out, object::Archive::Kind Kind,
     support::endian::Writer<support::big>(Out).write(Val);
 }
 
+static void write32(char *P, object::Archive::Kind Kind, uint32_t Val) {
+  if (isBSDLike(Kind))
+    support::endian::write32le(P, Val);
+  else
+    support::endian::write32be(P, Val);
+}
+
 static void printRestOfMemberHeader(
-    raw_fd_ostream &Out, const sys::TimePoint<std::chrono::seconds> &ModTime,
+    raw_ostream &Out, const sys::TimePoint<std::chrono::seconds> &ModTime,
     unsigned UID, unsigned GID, unsigned Perms, unsigned Size) {
   printWithSpacePadding(Out, sys::toTimeT(ModTime), 12);
   printWithSpacePadding(Out, UID, 6, true);
@@ -161,7 +172,7 @@ static void printRestOfMemberHeader(
 }
 
 static void
-printGNUSmallMemberHeader(raw_fd_ostream &Out, StringRef Name,
+printGNUSmallMemberHeader(raw_ostream &Out, StringRef Name,
                           const sys::TimePoint<std::chrono::seconds> &ModTime,
                           unsigned UID, unsigned GID, unsigned Perms,
                           unsigned Size) {
@@ -169,12 +180,13 @@ printGNUSmallMemberHeader(raw_fd_ostream &Out, StringRef Name,
   printRestOfMemberHeader(Out, ModTime, UID, GID, Perms, Size);
 }
 
+// Pos is the offset of the header in the archive.
 static void
-printBSDMemberHeader(raw_fd_ostream &Out, StringRef Name,
+printBSDMemberHeader(raw_ostream &Out, uint64_t Pos, StringRef Name,
                      const sys::TimePoint<std::chrono::seconds> &ModTime,
                      unsigned UID, unsigned GID, unsigned Perms,
                      unsigned Size) {
-  uint64_t PosAfterHeader = Out.tell() + 60 + Name.size();
+  uint64_t PosAfterHeader = Pos + 60 + Name.size();
   // Pad so that even 64 bit object files are aligned.
   unsigned Pad = OffsetToAlignment(PosAfterHeader, 8);
   unsigned NameWithPadding = Name.size() + Pad;
@@ -182,7 +194,6 @@ printBSDMemberHeader(raw_fd_ostream &Out, StringRef Name,
   printRestOfMemberHeader(Out, ModTime, UID, GID, Perms,
                           NameWithPadding + Size);
   Out << Name;
-  assert(PosAfterHeader == Out.tell());
   while (Pad--)
     Out.write(uint8_t(0));
 }
@@ -192,13 +203,14 @@ static bool useStringTable(bool Thin, StringRef Name) {
 }
 
 static void
-printMemberHeader(raw_fd_ostream &Out, object::Archive::Kind Kind, bool Thin,
-                  StringRef Name,
+printMemberHeader(raw_ostream &Out, uint64_t Pos, object::Archive::Kind Kind,
+                  bool Thin, StringRef Name,
                   std::vector<unsigned>::iterator &StringMapIndexIter,
                   const sys::TimePoint<std::chrono::seconds> &ModTime,
                   unsigned UID, unsigned GID, unsigned Perms, unsigned Size) {
   if (isBSDLike(Kind))
-    return printBSDMemberHeader(Out, Name, ModTime, UID, GID, Perms, Size);
+    return printBSDMemberHeader(Out, Pos, Name, ModTime, UID, GID, Perms,
+                                Size);
   if (!useStringTable(Thin, Name))
     return printGNUSmallMemberHeader(Out, Name, ModTime, UID, GID, Perms, Size);
   Out << '/';
@@ -235,22 +247,18 @@ static std::string computeRelativePath(StringRef From, StringRef To) {
   return Relative.str();
 }
 
-static void writeStringTable(raw_fd_ostream &Out, StringRef ArcName,
+static void writeStringTable(SmallVectorImpl<char> &Head, StringRef ArcName,
                              ArrayRef<NewArchiveMember> Members,
                              std::vector<unsigned> &StringMapIndexes,
                              bool Thin) {
-  unsigned StartOffset = 0;
+  SmallString<128> Table;
+  raw_svector_ostream Out(Table);
   for (const NewArchiveMember &M : Members) {
     StringRef Path = M.Buf->getBufferIdentifier();
     StringRef Name = M.MemberName;
     if (!useStringTable(Thin, Name))
       continue;
-    if (StartOffset == 0) {
-      printWithSpacePadding(Out, "//", 58);
-      Out << "`\n";
-      StartOffset = Out.tell();
-    }
-    StringMapIndexes.push_back(Out.tell() - StartOffset);
+    StringMapIndexes.push_back(Out.tell());
 
     if (Thin) {
       if (M.IsNew)
@@ -262,14 +270,15 @@ static void writeStringTable(raw_fd_ostream &Out, StringRef ArcName,
 
     Out << "/\n";
   }
-  if (StartOffset == 0)
+  if (Table.empty())
     return;
-  if (Out.tell() % 2)
+  if (Table.size() % 2)
     Out << '\n';
-  int Pos = Out.tell();
-  Out.seek(StartOffset - 12);
-  printWithSpacePadding(Out, Pos - StartOffset, 10);
-  Out.seek(Pos);
+
+  raw_svector_ostream HeadOS(Head);
+  printWithSpacePadding(HeadOS, "//", 48);
+  printWithSpacePadding(HeadOS, Table.size(), 10);
+  HeadOS << "`\n" << Table;
 }
 
 static sys::TimePoint<std::chrono::seconds> now(bool Deterministic) {
@@ -280,55 +289,143 @@ static sys::TimePoint<std::chrono::seconds> now(bool Deterministic) {
   return sys::TimePoint<seconds>();
 }
 
+namespace {
+
+/// The symbols an archive member contributes to the archive symbol table.
+struct MemberSymbols {
+  /// Whether the member is an object file. Other members have no symbols, and
+  /// an archive without object files gets no symbol table.
+  bool IsObject = false;
+  /// The names of the symbols, each followed by a NUL.
+  std::string Names;
+  std::error_code EC;
+};
+
+/// A member of the archive being written, laid out at its final offset.
+struct MemberData {
+  std::string Header;
+  StringRef Data;
+  StringRef Padding;
+};
+
+} // end anonymous namespace
+
+static std::error_code addSymbols(const object::SymbolicFile &Obj,
+                                  MemberSymbols &Syms) {
+  raw_string_ostream NameOS(Syms.Names);
+  for (const object::BasicSymbolRef &S : Obj.symbols()) {
+    uint32_t Symflags = S.getFlags();
+    if (Symflags & object::SymbolRef::SF_FormatSpecific)
+      continue;
+    if (!(Symflags & object::SymbolRef::SF_Global))
+      continue;
+    if (Symflags & object::SymbolRef::SF_Undefined &&
+        !(Symflags & object::SymbolRef::SF_Indirect))
+      continue;
+
+    if (auto EC = S.printName(NameOS))
+      return EC;
+    NameOS << '\0';
+  }
+  return std::error_code();
+}
+
+// Bitcode members are read through their irsymtab, which doesn't need the
+// module to be materialized in an LLVMContext.
+static void computeIRSymbols(MemoryBufferRef Buf, MemberSymbols &Syms) {
+  Expected<object::IRSymtabFile> FOrErr = object::readIRSymtab(Buf);
+  if (FOrErr) {
+    Syms.IsObject = true;
+    raw_string_ostream NameOS(Syms.Names);
+    for (const irsymtab::Reader::SymbolRef &S : FOrErr->TheReader.symbols()) {
+      if (S.isFormatSpecific() || !S.isGlobal())
+        continue;
+      if (S.isUndefined() && !S.isIndirect())
+        continue;
+      NameOS << S.getName() << '\0';
+    }
+    return;
+  }
+  consumeError(FOrErr.takeError());
+
+  // No irsymtab can be built for some modules, such as those without a data
+  // layout. Fall back to reading them as an IRObjectFile.
+  LLVMContext Context;
+  Expected<std::unique_ptr<object::IRObjectFile>> ObjOrErr =
+      object::IRObjectFile::create(Buf, Context);
+  if (!ObjOrErr) {
+    consumeError(ObjOrErr.takeError());
+    return;
+  }
+  Syms.IsObject = true;
+  Syms.EC = addSymbols(**ObjOrErr, Syms);
+}
+
+// Computes the symbols of a member the way SymbolicFile::createSymbolicFile
+// would read it given an LLVMContext. This is safe to call concurrently.
+static void computeSymbols(MemoryBufferRef Buf, MemberSymbols &Syms) {
+  file_magic Type = identify_magic(Buf.getBuffer());
+  if (Type == file_magic::bitcode)
+    return computeIRSymbols(Buf, Syms);
+
+  Expected<std::unique_ptr<object::SymbolicFile>> ObjOrErr =
+      object::SymbolicFile::createSymbolicFile(Buf, Type, nullptr);
+  if (!ObjOrErr) {
+    // FIXME: check only for "not an object file" errors.
+    consumeError(ObjOrErr.takeError());
+    return;
+  }
+
+  // Relocatable objects may carry the bitcode they were compiled from.
+  if (Type == file_magic::elf_relocatable ||
+      Type == file_magic::macho_object || Type == file_magic::coff_object) {
+    ErrorOr<MemoryBufferRef> BCData = object::IRObjectFile::findBitcodeInObject(
+        cast<object::ObjectFile>(**ObjOrErr));
+    if (BCData)
+      return computeIRSymbols(
+          MemoryBufferRef(BCData->getBuffer(), Buf.getBufferIdentifier()),
+          Syms);
+  }
+
+  Syms.IsObject = true;
+  Syms.EC = addSymbols(**ObjOrErr, Syms);
+}
+
 // Returns the offset of the first reference to a member offset.
 static ErrorOr<unsigned>
-writeSymbolTable(raw_fd_ostream &Out, object::Archive::Kind Kind,
-                 ArrayRef<NewArchiveMember> Members,
+writeSymbolTable(SmallVectorImpl<char> &Head, object::Archive::Kind Kind,
+                 ArrayRef<MemberSymbols> Symbols,
                  std::vector<unsigned> &MemberOffsetRefs, bool Deterministic) {
+  raw_svector_ostream Out(Head);
   unsigned HeaderStartOffset = 0;
   unsigned BodyStartOffset = 0;
   SmallString<128> NameBuf;
   raw_svector_ostream NameOS(NameBuf);
-  LLVMContext Context;
-  for (unsigned MemberNum = 0, N = Members.size(); MemberNum < N; ++MemberNum) {
-    MemoryBufferRef MemberBuffer = Members[MemberNum].Buf->getMemBufferRef();
-    Expected<std::unique_ptr<object::SymbolicFile>> ObjOrErr =
-        object::SymbolicFile::createSymbolicFile(
-            MemberBuffer, llvm::file_magic::unknown, &Context);
-    if (!ObjOrErr) {
-      // FIXME: check only for "not an object file" errors.
-      consumeError(ObjOrErr.takeError());
+  for (unsigned MemberNum = 0, N = Symbols.size(); MemberNum < N; ++MemberNum) {
+    const MemberSymbols &Syms = Symbols[MemberNum];
+    if (!Syms.IsObject)
       continue;
-    }
-    object::SymbolicFile &Obj = *ObjOrErr.get();
+    if (Syms.EC)
+      return Syms.EC;
 
     if (!HeaderStartOffset) {
       HeaderStartOffset = Out.tell();
       if (isBSDLike(Kind))
-        printBSDMemberHeader(Out, "__.SYMDEF", now(Deterministic), 0, 0, 0, 0);
+        printBSDMemberHeader(Out, HeaderStartOffset, "__.SYMDEF",
+                             now(Deterministic), 0, 0, 0, 0);
       else
         printGNUSmallMemberHeader(Out, "", now(Deterministic), 0, 0, 0, 0);
       BodyStartOffset = Out.tell();
       print32(Out, Kind, 0); // number of entries or bytes
     }
 
-    for (const object::BasicSymbolRef &S : Obj.symbols()) {
-      uint32_t Symflags = S.getFlags();
-      if (Symflags & object::SymbolRef::SF_FormatSpecific)
-        continue;
-      if (!(Symflags & object::SymbolRef::SF_Global))
-        continue;
-      if (Symflags & object::SymbolRef::SF_Undefined &&
-          !(Symflags & object::SymbolRef::SF_Indirect))
-        continue;
-
-      unsigned NameOffset = NameOS.tell();
-      if (auto EC = S.printName(NameOS))
-        return EC;
-      NameOS << '\0';
+    StringRef Names = Syms.Names;
+    unsigned NamesOffset = NameOS.tell();
+    NameOS << Names;
+    for (size_t I = 0; I != Names.size(); I = Names.find('\0', I) + 1) {
       MemberOffsetRefs.push_back(MemberNum);
       if (isBSDLike(Kind))
-        print32(Out, Kind, NameOffset);
+        print32(Out, Kind, NamesOffset + I);
       print32(Out, Kind, 0); // member offset
     }
   }
@@ -361,46 +458,130 @@ writeSymbolTable(raw_fd_ostream &Out, object::Archive::Kind Kind,
   // Patch up the size of the symbol table now that we know how big it is.
   unsigned Pos = Out.tell();
   const unsigned MemberHeaderSize = 60;
-  Out.seek(HeaderStartOffset + 48); // offset of the size field.
-  printWithSpacePadding(Out, Pos - MemberHeaderSize - HeaderStartOffset, 10);
+  SmallString<10> SizeField;
+  raw_svector_ostream SizeOS(SizeField);
+  printWithSpacePadding(SizeOS, Pos - MemberHeaderSize - HeaderStartOffset, 10);
+  std::copy(SizeField.begin(), SizeField.end(),
+            Head.begin() + HeaderStartOffset + 48); // offset of the size field.
 
   // Patch up the number of symbols.
-  Out.seek(BodyStartOffset);
   unsigned NumSyms = MemberOffsetRefs.size();
   if (isBSDLike(Kind))
-    print32(Out, Kind, NumSyms * 8);
+    write32(&Head[BodyStartOffset], Kind, NumSyms * 8);
   else
-    print32(Out, Kind, NumSyms);
+    write32(&Head[BodyStartOffset], Kind, NumSyms);
 
-  Out.seek(Pos);
   return BodyStartOffset + 4;
 }
 
+// Overwrites the parts of the archive file that differ from the new contents,
+// leaving the old members that keep their offset untouched. Returns false
+// without writing anything if most of the archive would move, since writing a
+// new copy is then as cheap and, unlike an update in place, atomic.
+static ErrorOr<bool>
+updateArchiveInPlace(StringRef ArcName, StringRef Head,
+                     ArrayRef<MemberData> Members,
+                     std::unique_ptr<MemoryBuffer> &OldArchiveBuf) {
+  StringRef Old = OldArchiveBuf->getBuffer();
+  auto IsOld = [&](StringRef Contents) {
+    return Contents.data() >= Old.begin() && Contents.data() < Old.end();
+  };
+
+  struct Chunk {
+    uint64_t Offset;
+    StringRef Contents;
+  };
+  // The head is always rewritten. It is small, and writing it also updates
+  // the modification time of the archive when nothing else changed.
+  std::vector<Chunk> Dirty = {{0, Head}};
+  uint64_t Pos = Head.size();
+  uint64_t MovedSize = 0;
+  auto Visit = [&](StringRef Contents) {
+    uint64_t Offset = Pos;
+    Pos += Contents.size();
+    if (Contents.empty())
+      return;
+    if (Offset < Old.size() && Contents.data() == Old.data() + Offset)
+      return;
+    if (Old.substr(Offset, Contents.size()) == Contents)
+      return;
+    if (IsOld(Contents))
+      MovedSize += Contents.size();
+    Dirty.push_back({Offset, Contents});
+  };
+  for (const MemberData &M : Members) {
+    Visit(M.Header);
+    Visit(M.Data);
+    Visit(M.Padding);
+  }
+  if (MovedSize > Old.size() / 2)
+    return false;
+
+  // The old contents are about to be overwritten; save those that move first.
+  std::string Moved;
+  Moved.reserve(MovedSize);
+  for (Chunk &C : Dirty) {
+    if (!IsOld(C.Contents))
+      continue;
+    size_t Start = Moved.size();
+    Moved += C.Contents;
+    C.Contents = StringRef(Moved.data() + Start, C.Contents.size());
+  }
+
+  int FD;
+  if (std::error_code EC = sys::fs::openFileForReadWrite(ArcName, FD))
+    return EC;
+
+  raw_fd_ostream Out(FD, /*shouldClose=*/true);
+  for (const Chunk &C : Dirty) {
+    Out.seek(C.Offset);
+    Out << C.Contents;
+  }
+  Out.flush();
+
+  // A mapped file can't be resized on Windows.
+  OldArchiveBuf.reset();
+  std::error_code EC = sys::fs::resize_file(FD, Pos);
+  Out.close();
+  if (Out.has_error()) {
+    EC = make_error_code(errc::io_error);
+    Out.clear_error();
+  }
+  if (EC)
+    return EC;
+  return true;
+}
+
 std::error_code
 llvm::writeArchive(StringRef ArcName, std::vector<NewArchiveMember> &NewMembers,
                    bool WriteSymtab, object::Archive::Kind Kind,
                    bool Deterministic, bool Thin,
-                   std::unique_ptr<MemoryBuffer> OldArchiveBuf) {
+                   std::unique_ptr<MemoryBuffer> OldArchiveBuf,
+                   bool UpdateInPlace) {
   assert((!Thin || !isBSDLike(Kind)) && "Only the gnu format has a thin mode");
-  SmallString<128> TmpArchive;
-  int TmpArchiveFD;
-  if (auto EC = sys::fs::createUniqueFile(ArcName + ".temp-archive-%%%%%%%.a",
-                                          TmpArchiveFD, TmpArchive))
-    return EC;
-
-  tool_output_file Output(TmpArchive, TmpArchiveFD);
-  raw_fd_ostream &Out = Output.os();
+  // The archive is laid out in memory, except for the contents of the
+  // members, before anything is written. The head holds the magic string, the
+  // symbol table and the string table.
+  SmallString<0> Head;
   if (Thin)
-    Out << "!<thin>\n";
+    Head = "!<thin>\n";
   else
-    Out << "!<arch>\n";
+    Head = "!<arch>\n";
 
   std::vector<unsigned> MemberOffsetRefs;
 
   unsigned MemberReferenceOffset = 0;
   if (WriteSymtab) {
+    // Reading the members is the expensive part of building the symbol table,
+    // so it is done in parallel. The table itself is written in member order.
+    std::vector<MemberSymbols> Symbols(NewMembers.size());
+    parallel::for_each_n(parallel::par, size_t(0), NewMembers.size(),
+                         [&](size_t I) {
+                           computeSymbols(NewMembers[I].Buf->getMemBufferRef(),
+                                          Symbols[I]);
+                         });
     ErrorOr<unsigned> MemberReferenceOffsetOrErr = writeSymbolTable(
-        Out, Kind, NewMembers, MemberOffsetRefs, Deterministic);
+        Head, Kind, Symbols, MemberOffsetRefs, Deterministic);
     if (auto EC = MemberReferenceOffsetOrErr.getError())
       return EC;
     MemberReferenceOffset = MemberReferenceOffsetOrErr.get();
@@ -408,15 +589,20 @@ llvm::writeArchive(StringRef ArcName, std::vector<NewArchiveMember> &NewMembers,
 
   std::vector<unsigned> StringMapIndexes;
   if (!isBSDLike(Kind))
-    writeStringTable(Out, ArcName, NewMembers, StringMapIndexes, Thin);
+    writeStringTable(Head, ArcName, NewMembers, StringMapIndexes, Thin);
 
+  static const char PaddingData[8] = {'\n', '\n', '\n', '\n',
+                                      '\n', '\n', '\n', '\n'};
   std::vector<unsigned>::iterator StringMapIndexIter = StringMapIndexes.begin();
   std::vector<unsigned> MemberOffset;
-  for (const NewArchiveMember &M : NewMembers) {
-    MemoryBufferRef File = M.Buf->getMemBufferRef();
+  std::vector<MemberData> Members(NewMembers.size());
+  uint64_t Pos = Head.size();
+  for (unsigned MemberNum = 0, N = NewMembers.size(); MemberNum < N;
+       ++MemberNum) {
+    const NewArchiveMember &M = NewMembers[MemberNum];
+    MemberData &Data = Members[MemberNum];
     unsigned Padding = 0;
 
-    unsigned Pos = Out.tell();
     MemberOffset.push_back(Pos);
 
     // ld64 expects the members to be 8-byte aligned for 64-bit content and at
@@ -426,28 +612,54 @@ llvm::writeArchive(StringRef ArcName, std::vector<NewArchiveMember> &NewMembers,
     if (Kind == object::Archive::K_DARWIN)
       Padding = OffsetToAlignment(M.Buf->getBufferSize(), 8);
 
-    printMemberHeader(Out, Kind, Thin, M.MemberName, StringMapIndexIter,
-                      M.ModTime, M.UID, M.GID, M.Perms,
+    raw_string_ostream HeaderOS(Data.Header);
+    printMemberHeader(HeaderOS, Pos, Kind, Thin, M.MemberName,
+                      StringMapIndexIter, M.ModTime, M.UID, M.GID, M.Perms,
                       M.Buf->getBufferSize() + Padding);
+    HeaderOS.flush();
 
     if (!Thin)
-      Out << File.getBuffer();
+      Data.Data = M.Buf->getBuffer();
 
-    while (Padding--)
-      Out << '\n';
-    if (Out.tell() % 2)
-      Out << '\n';
+    Pos += Data.Header.size() + Data.Data.size() + Padding;
+    if (Pos % 2) {
+      ++Padding;
+      ++Pos;
+    }
+    Data.Padding = StringRef(PaddingData, Padding);
   }
 
   if (MemberReferenceOffset) {
-    Out.seek(MemberReferenceOffset);
+    unsigned Offset = MemberReferenceOffset;
     for (unsigned MemberNum : MemberOffsetRefs) {
       if (isBSDLike(Kind))
-        Out.seek(Out.tell() + 4); // skip over the string offset
-      print32(Out, Kind, MemberOffset[MemberNum]);
+        Offset += 4; // skip over the string offset
+      write32(&Head[Offset], Kind, MemberOffset[MemberNum]);
+      Offset += 4;
     }
   }
 
+  if (UpdateInPlace && OldArchiveBuf) {
+    ErrorOr<bool> UpdatedOrErr =
+        updateArchiveInPlace(ArcName, Head, Members, OldArchiveBuf);
+    if (auto EC = UpdatedOrErr.getError())
+      return EC;
+    if (*UpdatedOrErr)
+      return std::error_code();
+  }
+
+  SmallString<128> TmpArchive;
+  int TmpArchiveFD;
+  if (auto EC = sys::fs::createUniqueFile(ArcName + ".temp-archive-%%%%%%%.a",
+                                          TmpArchiveFD, TmpArchive))
+    return EC;
+
+  tool_output_file Output(TmpArchive, TmpArchiveFD);
+  raw_fd_ostream &Out = Output.os();
+  Out << Head;
+  for (const MemberData &M : Members)
+    Out << M.Header << M.Data << M.Padding;
+
   Output.keep();
   Out.close();
 
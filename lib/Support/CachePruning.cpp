@@ -17,16 +17,411 @@
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LockFileManager.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 
 #define DEBUG_TYPE "cache-pruning"
 
-#include <set>
+#include <algorithm>
+#include <limits>
 #include <system_error>
+#include <vector>
 
 using namespace llvm;
 
+/// The cache index is a text file made of a header line:
+///   LLVMCACHEINDEX2 <rescan time> <snapshot length> <snapshot size>
+/// followed by a snapshot of the entries as of the last rescan or compaction,
+/// from the least to the most recently accessed one:
+///   A <access time> <size> <entry name>
+/// followed by a journal of the records appended since then, each time an
+/// entry is added, used or removed:
+///   N <access time> <size> <entry name>
+///   A <access time> <size> <entry name>
+///   R <size> <entry name>
+/// Times are in seconds since the epoch. The snapshot length is in bytes, and
+/// the snapshot size is the total size of its entries.
+///
+/// The pruner reads the journal, which gives the size of the cache and the
+/// entries whose snapshot record is outdated, then walks the snapshot from its
+/// least recently used entry and stops as soon as the policy is met. Its work
+/// is thus proportional to the length of the journal and to the number of
+/// removed entries. When the journal gets long, it is folded into a new
+/// snapshot. The index misses the entries written by tools that do not record
+/// them, so the directory is rescanned and a new index written when the index
+/// is older than the rescan interval of the policy.
+///
+/// The index is only rewritten under a lock file, and the records appended to
+/// the old index while it is rewritten are carried over to the new one.
+static const char CacheIndexMagic[] = "LLVMCACHEINDEX2";
+
+namespace {
+struct CacheEntry {
+  std::string Name;
+  uint64_t Size;
+  uint64_t LastAccess;
+};
+
+/// The latest journal record of an entry.
+struct JournalRecord {
+  uint64_t Size;
+  uint64_t LastAccess;
+  bool Removed;
+};
+
+/// The content of a cache index.
+struct CacheIndex {
+  std::unique_ptr<MemoryBuffer> Buffer;
+  sys::fs::UniqueID ID;
+  uint64_t RescanTime = 0;
+  /// The records of the snapshot, which are only parsed as needed.
+  StringRef Snapshot;
+  /// The length of the journal, in bytes.
+  size_t JournalLength = 0;
+  StringMap<JournalRecord> Journal;
+  /// The total size of the entries, according to the snapshot and journal.
+  uint64_t TotalSize = 0;
+};
+} // end anonymous namespace
+
+static uint64_t toSeconds(std::chrono::system_clock::time_point Time) {
+  using namespace std::chrono;
+  return duration_cast<seconds>(Time.time_since_epoch()).count();
+}
+
+static void getCacheIndexPath(StringRef Path, SmallVectorImpl<char> &Result) {
+  Result.assign(Path.begin(), Path.end());
+  sys::path::append(Result, "llvmcache.index");
+}
+
+/// Parse a record of the index, returns false if it is malformed, for instance
+/// because of an interrupted write.
+static bool parseCacheIndexRecord(StringRef Line, char &Kind, uint64_t &Access,
+                                  uint64_t &Size, StringRef &Name) {
+  StringRef KindStr, AccessStr, SizeStr;
+  std::tie(KindStr, Line) = Line.split(' ');
+  if (KindStr.size() != 1)
+    return false;
+  Kind = KindStr[0];
+  Access = 0;
+  if (Kind != 'R') {
+    std::tie(AccessStr, Line) = Line.split(' ');
+    if ((Kind != 'A' && Kind != 'N') || AccessStr.getAsInteger(10, Access))
+      return false;
+  }
+  std::tie(SizeStr, Name) = Line.split(' ');
+  return !SizeStr.getAsInteger(10, Size) && Name.startswith("llvmcache-");
+}
+
+/// Read the header and the journal of the index at IndexPath, returns false if
+/// there is no valid index.
+static bool readCacheIndex(StringRef IndexPath, CacheIndex &Index) {
+  int FD;
+  if (sys::fs::openFileForRead(IndexPath, FD))
+    return false;
+  sys::fs::file_status Status;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufOrErr = std::error_code();
+  if (!sys::fs::status(FD, Status))
+    BufOrErr = MemoryBuffer::getOpenFile(FD, IndexPath, Status.getSize(),
+                                         /*RequiresNullTerminator=*/false);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!BufOrErr)
+    return false;
+  Index.Buffer = std::move(*BufOrErr);
+  Index.ID = Status.getUniqueID();
+
+  StringRef Line, Rest = Index.Buffer->getBuffer();
+  std::tie(Line, Rest) = Rest.split('\n');
+  SmallVector<StringRef, 4> Fields;
+  Line.split(Fields, ' ');
+  uint64_t SnapshotLength;
+  if (Fields.size() != 4 || Fields[0] != CacheIndexMagic ||
+      Fields[1].getAsInteger(10, Index.RescanTime) ||
+      Fields[2].getAsInteger(10, SnapshotLength) ||
+      Fields[3].getAsInteger(10, Index.TotalSize) ||
+      SnapshotLength > Rest.size())
+    return false;
+  Index.Snapshot = Rest.take_front(SnapshotLength);
+  Rest = Rest.drop_front(SnapshotLength);
+  Index.JournalLength = Rest.size();
+
+  while (!Rest.empty()) {
+    std::tie(Line, Rest) = Rest.split('\n');
+    char Kind;
+    uint64_t Access, Size;
+    StringRef Name;
+    if (!parseCacheIndexRecord(Line, Kind, Access, Size, Name))
+      continue;
+    // Only additions and removals change the size of the cache.
+    if (Kind == 'N')
+      Index.TotalSize += Size;
+    else if (Kind == 'R')
+      Index.TotalSize -= std::min(Size, Index.TotalSize);
+    Index.Journal[Name] = {Size, Access, Kind == 'R'};
+  }
+  return true;
+}
+
+/// Read the complete records appended to the file FD past Offset, and advance
+/// Offset past them.
+static std::string readCacheIndexTail(int FD, uint64_t &Offset) {
+  sys::fs::file_status Status;
+  if (sys::fs::status(FD, Status) || Status.getSize() <= Offset)
+    return std::string();
+  auto BufOrErr = MemoryBuffer::getOpenFileSlice(
+      FD, "llvmcache.index", Status.getSize() - Offset, Offset);
+  if (!BufOrErr)
+    return std::string();
+  StringRef Tail = (*BufOrErr)->getBuffer();
+  Tail = Tail.take_front(Tail.rfind('\n') + 1);
+  Offset += Tail.size();
+  return Tail;
+}
+
+/// Append Records to an existing index, in a single write so that concurrent
+/// appends from other processes do not interleave.
+static void appendToCacheIndex(StringRef IndexPath, StringRef Records) {
+  // The index may be replaced while we append to it. The process replacing it
+  // carries over what was appended to the old index until it is replaced, so
+  // only append again if the old index was already replaced by then.
+  for (unsigned Attempt = 0; Attempt != 3; ++Attempt) {
+    int FD;
+    if (!sys::fs::exists(IndexPath) ||
+        sys::fs::openFileForWrite(IndexPath, FD, sys::fs::F_Append))
+      return;
+    raw_fd_ostream OS(FD, /*shouldClose=*/true, /*unbuffered=*/true);
+    OS << Records;
+    sys::fs::file_status Written, Current;
+    if (sys::fs::status(FD, Written) || sys::fs::status(IndexPath, Current) ||
+        sys::fs::equivalent(Written, Current))
+      return;
+  }
+}
+
+/// Replace the index of the cache directory Path, whose first OldLength bytes
+/// are superseded, with one holding Entries sorted from the least recently
+/// used. OldID identifies the index the caller read, if any. Returns false if
+/// the index was not replaced, because another process is rewriting it or did
+/// since the caller read it.
+static bool writeCacheIndex(StringRef Path, uint64_t RescanTime,
+                            ArrayRef<CacheEntry> Entries, uint64_t OldLength,
+                            const sys::fs::UniqueID *OldID) {
+  SmallString<128> IndexPath;
+  getCacheIndexPath(Path, IndexPath);
+  LockFileManager Lock(IndexPath);
+  if (Lock.getState() != LockFileManager::LFS_Owned)
+    return false;
+
+  int OldFD = -1;
+  if (OldID) {
+    sys::fs::file_status Status;
+    if (sys::fs::openFileForRead(IndexPath, OldFD))
+      return false;
+    if (sys::fs::status(OldFD, Status) || Status.getUniqueID() != *OldID) {
+      sys::Process::SafelyCloseFileDescriptor(OldFD);
+      return false;
+    }
+  }
+
+  std::string Snapshot;
+  raw_string_ostream SnapshotOS(Snapshot);
+  uint64_t TotalSize = 0;
+  for (const CacheEntry &Entry : Entries) {
+    SnapshotOS << "A " << Entry.LastAccess << ' ' << Entry.Size << ' '
+               << Entry.Name << '\n';
+    TotalSize += Entry.Size;
+  }
+  SnapshotOS.flush();
+
+  SmallString<128> TempModel, TempPath;
+  sys::path::append(TempModel, Path, "llvmcache.index-%%%%%%.tmp");
+  int FD;
+  bool Replaced = false;
+  if (!sys::fs::createUniqueFile(TempModel, FD, TempPath)) {
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      OS << CacheIndexMagic << ' ' << RescanTime << ' ' << Snapshot.size()
+         << ' ' << TotalSize << '\n'
+         << Snapshot;
+      if (OldFD != -1)
+        OS << readCacheIndexTail(OldFD, OldLength);
+    }
+    Replaced = !sys::fs::rename(TempPath, IndexPath);
+    if (!Replaced)
+      sys::fs::remove(TempPath);
+  }
+  if (OldFD != -1) {
+    // Carry over what was appended to the old index until it was replaced.
+    if (Replaced) {
+      std::string Tail = readCacheIndexTail(OldFD, OldLength);
+      if (!Tail.empty())
+        appendToCacheIndex(IndexPath, Tail);
+    }
+    sys::Process::SafelyCloseFileDescriptor(OldFD);
+  }
+  return Replaced;
+}
+
+void llvm::recordCacheEntryAccess(StringRef Path, StringRef EntryName,
+                                  uint64_t Size, bool IsNewEntry) {
+  SmallString<128> IndexPath;
+  getCacheIndexPath(Path, IndexPath);
+  std::string Record;
+  raw_string_ostream(Record)
+      << (IsNewEntry ? "N " : "A ")
+      << toSeconds(std::chrono::system_clock::now()) << ' ' << Size << ' '
+      << EntryName << '\n';
+  appendToCacheIndex(IndexPath, Record);
+}
+
+/// Return the size the cache should be pruned to according to Policy, given
+/// its current TotalSize.
+static uint64_t getCacheSizeTarget(StringRef Path, CachePruningPolicy Policy,
+                                   uint64_t TotalSize) {
+  auto ErrOrSpaceInfo = sys::fs::disk_space(Path);
+  if (!ErrOrSpaceInfo) {
+    report_fatal_error("Can't get available size");
+  }
+  sys::fs::space_info SpaceInfo = ErrOrSpaceInfo.get();
+  auto AvailableSpace = TotalSize + SpaceInfo.free;
+
+  if (Policy.MaxSizePercentageOfAvailableSpace == 0)
+    Policy.MaxSizePercentageOfAvailableSpace = 100;
+  if (Policy.MaxSizeBytes == 0)
+    Policy.MaxSizeBytes = AvailableSpace;
+  auto TotalSizeTarget = std::min<uint64_t>(
+      AvailableSpace * Policy.MaxSizePercentageOfAvailableSpace / 100ull,
+      Policy.MaxSizeBytes);
+
+  DEBUG(dbgs() << "Occupancy: " << ((100 * TotalSize) / AvailableSpace)
+               << "% target is: " << Policy.MaxSizePercentageOfAvailableSpace
+               << "%, " << Policy.MaxSizeBytes << " bytes\n");
+  return TotalSizeTarget;
+}
+
+/// Order the entries from the least recently used, and the largest first among
+/// the entries accessed at the same time.
+static void sortCacheEntries(std::vector<CacheEntry> &Entries) {
+  std::sort(Entries.begin(), Entries.end(),
+            [](const CacheEntry &A, const CacheEntry &B) {
+              if (A.LastAccess != B.LastAccess)
+                return A.LastAccess < B.LastAccess;
+              if (A.Size != B.Size)
+                return A.Size > B.Size;
+              return A.Name < B.Name;
+            });
+}
+
+/// Remove the least recently used entries until the cache fits the size limits
+/// of Policy. Entries must be sorted by sortCacheEntries(), the removed entries
+/// are erased from it.
+static void pruneCacheForSize(StringRef Path, CachePruningPolicy Policy,
+                              std::vector<CacheEntry> &Entries) {
+  uint64_t TotalSize = 0;
+  for (const CacheEntry &Entry : Entries)
+    TotalSize += Entry.Size;
+  uint64_t TotalSizeTarget = getCacheSizeTarget(Path, Policy, TotalSize);
+
+  // Remove the oldest accessed files first, till we get below the threshold
+  auto I = Entries.begin();
+  for (; TotalSize > TotalSizeTarget && I != Entries.end(); ++I) {
+    SmallString<128> EntryPath(Path);
+    sys::path::append(EntryPath, I->Name);
+    sys::fs::remove(EntryPath);
+    TotalSize -= I->Size;
+    DEBUG(dbgs() << " - Remove " << EntryPath << " (size " << I->Size
+                 << "), new occupancy is " << TotalSize << "%\n");
+  }
+  Entries.erase(Entries.begin(), I);
+}
+
+/// Prune the cache using its index rather than scanning the directory.
+static void pruneCacheWithIndex(StringRef Path, StringRef IndexPath,
+                                CacheIndex &Index, CachePruningPolicy Policy,
+                                uint64_t CurrentTime) {
+  uint64_t TotalSizeTarget = std::numeric_limits<uint64_t>::max();
+  if (Policy.MaxSizePercentageOfAvailableSpace > 0 || Policy.MaxSizeBytes > 0)
+    TotalSizeTarget = getCacheSizeTarget(Path, Policy, Index.TotalSize);
+
+  auto ShouldRemove = [&](uint64_t LastAccess) {
+    if (Policy.Expiration != std::chrono::seconds(0) &&
+        CurrentTime > LastAccess + uint64_t(Policy.Expiration.count()))
+      return true;
+    return Index.TotalSize > TotalSizeTarget;
+  };
+  std::string Removed;
+  raw_string_ostream RemovedOS(Removed);
+  auto Remove = [&](StringRef Name, uint64_t Size, uint64_t LastAccess) {
+    SmallString<128> EntryPath(Path);
+    sys::path::append(EntryPath, Name);
+    DEBUG(dbgs() << "Remove " << EntryPath << " (size " << Size << ", "
+                 << (CurrentTime - std::min(LastAccess, CurrentTime))
+                 << "s old)\n");
+    sys::fs::remove(EntryPath);
+    RemovedOS << "R " << Size << ' ' << Name << '\n';
+    Index.TotalSize -= std::min(Size, Index.TotalSize);
+  };
+
+  // Walk the snapshot from its least recently used entry, and stop at the
+  // first one that should stay. The entries that have a journal record are
+  // skipped: they are more recent than the whole snapshot.
+  StringRef Rest = Index.Snapshot;
+  while (!Rest.empty()) {
+    StringRef Line, Next;
+    std::tie(Line, Next) = Rest.split('\n');
+    char Kind;
+    uint64_t Access, Size;
+    StringRef Name;
+    if (parseCacheIndexRecord(Line, Kind, Access, Size, Name) &&
+        !Index.Journal.count(Name)) {
+      if (!ShouldRemove(Access))
+        break;
+      Remove(Name, Size, Access);
+    }
+    Rest = Next;
+  }
+
+  // Then prune the entries of the journal the same way.
+  std::vector<CacheEntry> JournalEntries;
+  for (auto &Record : Index.Journal)
+    if (!Record.second.Removed)
+      JournalEntries.push_back(
+          {Record.first(), Record.second.Size, Record.second.LastAccess});
+  sortCacheEntries(JournalEntries);
+  auto I = JournalEntries.begin();
+  for (; I != JournalEntries.end() && ShouldRemove(I->LastAccess); ++I)
+    Remove(I->Name, I->Size, I->LastAccess);
+  JournalEntries.erase(JournalEntries.begin(), I);
+  RemovedOS.flush();
+
+  // Fold the journal into a new snapshot when it gets long compared to the
+  // snapshot. This reads the rest of the snapshot, which is amortized by the
+  // length of the journal.
+  if (Index.JournalLength > Index.Snapshot.size() / 2 + 64 * 1024) {
+    std::vector<CacheEntry> Entries;
+    while (!Rest.empty()) {
+      StringRef Line;
+      std::tie(Line, Rest) = Rest.split('\n');
+      char Kind;
+      uint64_t Access, Size;
+      StringRef Name;
+      if (parseCacheIndexRecord(Line, Kind, Access, Size, Name) &&
+          !Index.Journal.count(Name))
+        Entries.push_back({Name, Size, Access});
+    }
+    // The snapshot is sorted already, and older than the journal.
+    Entries.insert(Entries.end(), JournalEntries.begin(), JournalEntries.end());
+    if (writeCacheIndex(Path, Index.RescanTime, Entries,
+                        Index.Buffer->getBufferSize(), &Index.ID))
+      return;
+  }
+  if (!Removed.empty())
+    appendToCacheIndex(IndexPath, Removed);
+}
+
 /// Write a new timestamp file with the given path. This is used for the pruning
 /// interval option.
 static void writeTimestampFile(StringRef TimestampFile) {
@@ -73,6 +468,11 @@ llvm::parseCachePruningPolicy(StringRef PolicyStr) {
       if (!DurationOrErr)
         return DurationOrErr.takeError();
       Policy.Interval = *DurationOrErr;
+    } else if (Key == "rescan_interval") {
+      auto DurationOrErr = parseDuration(Value);
+      if (!DurationOrErr)
+        return DurationOrErr.takeError();
+      Policy.RescanInterval = *DurationOrErr;
     } else if (Key == "prune_after") {
       auto DurationOrErr = parseDuration(Value);
       if (!DurationOrErr)
@@ -179,22 +579,25 @@ bool llvm::pruneCache(StringRef Path, CachePruningPolicy Policy) {
     writeTimestampFile(TimestampFile);
   }
 
+  // Use the index of the cache if it is recent enough, rather than walking the
+  // whole directory.
+  SmallString<128> IndexFile;
+  getCacheIndexPath(Path, IndexFile);
+  CacheIndex Index;
+  bool HasIndex = readCacheIndex(IndexFile, Index);
+  uint64_t RescanTime =
+      Index.RescanTime + uint64_t(Policy.RescanInterval.count());
+  if (HasIndex && toSeconds(CurrentTime) < RescanTime) {
+    pruneCacheWithIndex(Path, IndexFile, Index, Policy,
+                        toSeconds(CurrentTime));
+    return true;
+  }
+
   bool ShouldComputeSize =
       (Policy.MaxSizePercentageOfAvailableSpace > 0 || Policy.MaxSizeBytes > 0);
 
-  // Keep track of space
-  std::set<std::pair<uint64_t, std::string>> FileSizes;
-  uint64_t TotalSize = 0;
-  // Helper to add a path to the set of files to consider for size-based
-  // pruning, sorted by size.
-  auto AddToFileListForSizePruning =
-      [&](StringRef Path) {
-        if (!ShouldComputeSize)
-          return;
-        TotalSize += FileStatus.getSize();
-        FileSizes.insert(
-            std::make_pair(FileStatus.getSize(), std::string(Path)));
-      };
+  // The entries that are left after the expiration, to build the new index.
+  std::vector<CacheEntry> Entries;
 
   // Walk the entire directory cache, looking for unused files.
   std::error_code EC;
@@ -220,50 +623,30 @@ bool llvm::pruneCache(StringRef Path, CachePruningPolicy Policy) {
     // If the file hasn't been used recently enough, delete it
     const auto FileAccessTime = FileStatus.getLastAccessedTime();
     auto FileAge = CurrentTime - FileAccessTime;
-    if (FileAge > Policy.Expiration) {
+    if (Policy.Expiration != seconds(0) && FileAge > Policy.Expiration) {
       DEBUG(dbgs() << "Remove " << File->path() << " ("
                    << duration_cast<seconds>(FileAge).count() << "s old)\n");
       sys::fs::remove(File->path());
       continue;
     }
 
-    // Leave it here for now, but add it to the list of size-based pruning.
-    AddToFileListForSizePruning(File->path());
+    // Leave it here for now, but keep it in the index and consider it for
+    // size-based pruning.
+    Entries.push_back({sys::path::filename(File->path()), FileStatus.getSize(),
+                       toSeconds(FileAccessTime)});
   }
 
   // Prune for size now if needed
-  if (ShouldComputeSize) {
-    auto ErrOrSpaceInfo = sys::fs::disk_space(Path);
-    if (!ErrOrSpaceInfo) {
-      report_fatal_error("Can't get available size");
-    }
-    sys::fs::space_info SpaceInfo = ErrOrSpaceInfo.get();
-    auto AvailableSpace = TotalSize + SpaceInfo.free;
-
-    if (Policy.MaxSizePercentageOfAvailableSpace == 0)
-      Policy.MaxSizePercentageOfAvailableSpace = 100;
-    if (Policy.MaxSizeBytes == 0)
-      Policy.MaxSizeBytes = AvailableSpace;
-    auto TotalSizeTarget = std::min<uint64_t>(
-        AvailableSpace * Policy.MaxSizePercentageOfAvailableSpace / 100ull,
-        Policy.MaxSizeBytes);
-
-    DEBUG(dbgs() << "Occupancy: " << ((100 * TotalSize) / AvailableSpace)
-                 << "% target is: " << Policy.MaxSizePercentageOfAvailableSpace
-                 << "%, " << Policy.MaxSizeBytes << " bytes\n");
-
-    auto FileAndSize = FileSizes.rbegin();
-    // Remove the oldest accessed files first, till we get below the threshold
-    while (TotalSize > TotalSizeTarget && FileAndSize != FileSizes.rend()) {
-      // Remove the file.
-      sys::fs::remove(FileAndSize->second);
-      // Update size
-      TotalSize -= FileAndSize->first;
-      DEBUG(dbgs() << " - Remove " << FileAndSize->second << " (size "
-                   << FileAndSize->first << "), new occupancy is " << TotalSize
-                   << "%\n");
-      ++FileAndSize;
-    }
-  }
+  sortCacheEntries(Entries);
+  if (ShouldComputeSize)
+    pruneCacheForSize(Path, Policy, Entries);
+
+  // An empty cache is cheap to walk, do not bother writing an index for it.
+  // Otherwise the new index supersedes the one that was read, if any, but not
+  // the records appended to it during the walk.
+  if (!Entries.empty())
+    writeCacheIndex(Path, toSeconds(CurrentTime), Entries,
+                    HasIndex ? Index.Buffer->getBufferSize() : 0,
+                    HasIndex ? &Index.ID : nullptr);
   return true;
 }
@@ -18,6 +18,9 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Parallel.h"
+#include <algorithm>
+#include <vector>
 #if LLVM_ENABLE_ZLIB == 1 && HAVE_ZLIB_H
 #include <zlib.h>
 #endif
@@ -73,6 +76,98 @@ Error zlib::compress(StringRef InputBuffer,
   return Res ? createError(convertZlibCodeToString(Res)) : Error::success();
 }
 
+Error zlib::compressChunked(StringRef InputBuffer,
+                            SmallVectorImpl<char> &CompressedBuffer,
+                            CompressionLevel Level, size_t ChunkSize) {
+  assert(ChunkSize > 0 && "chunks cannot be empty");
+  if (InputBuffer.size() <= ChunkSize)
+    return compress(InputBuffer, CompressedBuffer, Level);
+
+  // Each chunk is compressed to a raw deflate stream, which is ended by a
+  // sync flush, except for the last chunk. The concatenation of these
+  // streams is a valid deflate stream, which gets the zlib header and
+  // checksum. Back-references into the previous chunk are allowed by using
+  // its last 32K, the size of the deflate window, as dictionary.
+  const size_t WindowSize = 1 << 15;
+  int CLevel = encodeZlibCompressionLevel(Level);
+  size_t NumChunks = (InputBuffer.size() + ChunkSize - 1) / ChunkSize;
+  std::vector<SmallVector<char, 0>> Chunks(NumChunks);
+  std::vector<int> Results(NumChunks, Z_OK);
+  std::vector<uLong> Checksums(NumChunks);
+  parallel::for_each_n(parallel::par, size_t(0), NumChunks, [&](size_t I) {
+    StringRef Input = InputBuffer.substr(I * ChunkSize, ChunkSize);
+    bool IsLast = I + 1 == NumChunks;
+    Checksums[I] =
+        ::adler32(1, (const Bytef *)Input.data(), (uInt)Input.size());
+
+    z_stream Stream = {};
+    int Res = deflateInit2(&Stream, CLevel, Z_DEFLATED, -15, 8,
+                           Z_DEFAULT_STRATEGY);
+    if (Res != Z_OK) {
+      Results[I] = Res;
+      return;
+    }
+    if (I > 0) {
+      StringRef Dictionary =
+          InputBuffer.substr(0, I * ChunkSize).take_back(WindowSize);
+      Res = deflateSetDictionary(&Stream, (const Bytef *)Dictionary.data(),
+                                 (uInt)Dictionary.size());
+      if (Res != Z_OK) {
+        deflateEnd(&Stream);
+        Results[I] = Res;
+        return;
+      }
+    }
+    // deflateBound() doesn't account for the empty block of the sync flush.
+    SmallVector<char, 0> &Output = Chunks[I];
+    Output.resize(deflateBound(&Stream, Input.size()) + 16);
+    Stream.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(Input.data()));
+    Stream.avail_in = Input.size();
+    Stream.next_out = (Bytef *)Output.data();
+    Stream.avail_out = Output.size();
+    Res = deflate(&Stream, IsLast ? Z_FINISH : Z_SYNC_FLUSH);
+    if (Res == (IsLast ? Z_STREAM_END : Z_OK) && Stream.avail_in == 0)
+      Res = Z_OK;
+    else if (Res == Z_OK || Res == Z_STREAM_END)
+      Res = Z_BUF_ERROR;
+    __msan_unpoison(Output.data(), Stream.total_out);
+    Output.resize(Stream.total_out);
+    deflateEnd(&Stream);
+    Results[I] = Res;
+  });
+
+  for (int Res : Results)
+    if (Res != Z_OK)
+      return createError(convertZlibCodeToString(Res));
+
+  // The zlib header records the 32K window and, for information only, the
+  // compression level, as computed by deflate().
+  unsigned LevelFlags = 3;
+  if (CLevel == Z_DEFAULT_COMPRESSION || CLevel == 6)
+    LevelFlags = 2;
+  else if (CLevel < 2)
+    LevelFlags = 0;
+  else if (CLevel < 6)
+    LevelFlags = 1;
+  unsigned Header = (Z_DEFLATED + ((15 - 8) << 4)) << 8 | LevelFlags << 6;
+  Header += 31 - Header % 31;
+  uLong Checksum = Checksums[0];
+  for (size_t I = 1; I != NumChunks; ++I)
+    Checksum = ::adler32_combine(
+        Checksum, Checksums[I],
+        (z_off_t)std::min(ChunkSize, InputBuffer.size() - I * ChunkSize));
+
+  CompressedBuffer.clear();
+  CompressedBuffer.push_back(Header >> 8);
+  CompressedBuffer.push_back(Header & 0xff);
+  for (const SmallVector<char, 0> &Chunk : Chunks)
+    CompressedBuffer.append(Chunk.begin(), Chunk.end());
+  for (int Shift = 24; Shift >= 0; Shift -= 8)
+    CompressedBuffer.push_back((Checksum >> Shift) & 0xff);
+  return Error::success();
+}
+
 Error zlib::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
                        size_t &UncompressedSize) {
   int Res =
@@ -105,6 +200,11 @@ Error zlib::compress(StringRef InputBuffer,
                      CompressionLevel Level) {
   llvm_unreachable("zlib::compress is unavailable");
 }
+Error zlib::compressChunked(StringRef InputBuffer,
+                            SmallVectorImpl<char> &CompressedBuffer,
+                            CompressionLevel Level, size_t ChunkSize) {
+  llvm_unreachable("zlib::compressChunked is unavailable");
+}
 Error zlib::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
                        size_t &UncompressedSize) {
   llvm_unreachable("zlib::uncompress is unavailable");
@@ -10,9 +10,14 @@
 #include "llvm/Support/Parallel.h"
 #include "llvm/Config/llvm-config.h"
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Compiler.h"
+
+#include <algorithm>
 #include <atomic>
-#include <stack>
+#include <deque>
 #include <thread>
+#include <vector>
 
 using namespace llvm;
 
@@ -66,73 +71,201 @@ Executor *Executor::getDefaultExecutor() {
 }
 
 #else
-/// \brief An implementation of an Executor that runs closures on a thread pool
-///   in filo order.
+/// \brief An implementation of an Executor that runs closures on a pool of
+///   work-stealing threads.
+///
+/// Every worker owns a deque of tasks. The tasks added by a worker go at the
+/// back of its own deque, and it takes its next task from there too (filo
+/// order, which keeps nested tasks hot in the cache). When its deque is
+/// empty, a worker steals the oldest task of another worker. The tasks
+/// added from outside the pool are distributed round-robin. Compared to a
+/// single shared stack, this removes the contention on one lock when many
+/// fine-grained tasks are scheduled.
+///
+/// The threads are detached and never stopped: the executor lives until the
+/// process exits.
 class ThreadPoolExecutor : public Executor {
 public:
-  explicit ThreadPoolExecutor(
-      unsigned ThreadCount = std::thread::hardware_concurrency())
-      : Done(ThreadCount) {
+  explicit ThreadPoolExecutor(unsigned ThreadCount) : Workers(ThreadCount) {
+    for (auto &W : Workers)
+      W = llvm::make_unique<Worker>();
     // Spawn all but one of the threads in another thread as spawning threads
     // can take a while.
     std::thread([&, ThreadCount] {
-      for (size_t i = 1; i < ThreadCount; ++i) {
-        std::thread([=] { work(); }).detach();
+      for (size_t I = 1; I < ThreadCount; ++I) {
+        std::thread([=] { work(I); }).detach();
       }
-      work();
+      work(0);
     }).detach();
   }
 
-  ~ThreadPoolExecutor() override {
-    std::unique_lock<std::mutex> Lock(Mutex);
-    Stop = true;
-    Lock.unlock();
-    Cond.notify_all();
-    // Wait for ~Latch.
-  }
-
   void add(std::function<void()> F) override {
-    std::unique_lock<std::mutex> Lock(Mutex);
-    WorkStack.push(F);
-    Lock.unlock();
-    Cond.notify_one();
+    Worker *W = CurrentWorker;
+    if (!W)
+      W = Workers[NextWorker++ % Workers.size()].get();
+    ++PendingTasks;
+    {
+      std::lock_guard<std::mutex> Lock(W->Mutex);
+      W->Tasks.push_back(std::move(F));
+    }
+    // Only take the sleep lock if somebody may be waiting on it. Both
+    // counters are sequentially consistent, thus either we see the
+    // sleeper or the sleeper sees the new task before going to sleep.
+    if (NumSleeping) {
+      { std::lock_guard<std::mutex> Lock(SleepMutex); }
+      SleepCond.notify_one();
+    }
   }
 
 private:
-  void work() {
+  struct Worker {
+    std::mutex Mutex;
+    std::deque<std::function<void()>> Tasks;
+  };
+
+  /// Take the next task of the calling thread: the newest task of its own
+  /// deque if it is a worker, otherwise the oldest task of another worker.
+  bool takeTask(std::function<void()> &Task) {
+    size_t Self = 0;
+    if (CurrentWorker) {
+      Worker &W = *CurrentWorker;
+      std::lock_guard<std::mutex> Lock(W.Mutex);
+      if (!W.Tasks.empty()) {
+        Task = std::move(W.Tasks.back());
+        W.Tasks.pop_back();
+        --PendingTasks;
+        return true;
+      }
+      Self = CurrentWorkerIndex;
+    }
+
+    if (!PendingTasks)
+      return false;
+    for (size_t I = 1, E = Workers.size(); I <= E; ++I) {
+      Worker &Victim = *Workers[(Self + I) % E];
+      std::lock_guard<std::mutex> Lock(Victim.Mutex);
+      if (Victim.Tasks.empty())
+        continue;
+      Task = std::move(Victim.Tasks.front());
+      Victim.Tasks.pop_front();
+      --PendingTasks;
+      return true;
+    }
+    return false;
+  }
+
+  void work(size_t Index) {
+    CurrentWorker = Workers[Index].get();
+    CurrentWorkerIndex = Index;
     while (true) {
-      std::unique_lock<std::mutex> Lock(Mutex);
-      Cond.wait(Lock, [&] { return Stop || !WorkStack.empty(); });
-      if (Stop)
-        break;
-      auto Task = WorkStack.top();
-      WorkStack.pop();
-      Lock.unlock();
-      Task();
+      std::function<void()> Task;
+      if (takeTask(Task)) {
+        Task();
+        continue;
+      }
+      std::unique_lock<std::mutex> Lock(SleepMutex);
+      ++NumSleeping;
+      SleepCond.wait(Lock, [&] { return PendingTasks != 0; });
+      --NumSleeping;
     }
-    Done.dec();
   }
 
-  std::atomic<bool> Stop{false};
-  std::stack<std::function<void()>> WorkStack;
-  std::mutex Mutex;
-  std::condition_variable Cond;
-  parallel::detail::Latch Done;
+  /// The worker (and its index) the current thread is running, if any.
+  static LLVM_THREAD_LOCAL Worker *CurrentWorker;
+  static LLVM_THREAD_LOCAL size_t CurrentWorkerIndex;
+
+  std::vector<std::unique_ptr<Worker>> Workers;
+  /// Where to put the next task added from outside the pool.
+  std::atomic<size_t> NextWorker{0};
+  /// Number of tasks that were added but not started yet.
+  std::atomic<size_t> PendingTasks{0};
+  std::atomic<unsigned> NumSleeping{0};
+  std::mutex SleepMutex;
+  std::condition_variable SleepCond;
 };
 
+LLVM_THREAD_LOCAL ThreadPoolExecutor::Worker *
+    ThreadPoolExecutor::CurrentWorker = nullptr;
+LLVM_THREAD_LOCAL size_t ThreadPoolExecutor::CurrentWorkerIndex = 0;
+
 Executor *Executor::getDefaultExecutor() {
-  static ThreadPoolExecutor exec;
-  return &exec;
+  // The executor is deliberately leaked. Destroying it at exit would have to
+  // wait for the workers, which hangs when they are gone: for instance in a
+  // child process forked after the pool was started, which only has the
+  // forking thread.
+  static ThreadPoolExecutor *Exec =
+      new ThreadPoolExecutor(parallel::getThreadCount());
+  return Exec;
+}
+#endif
 }
+
+static unsigned ThreadCount = 0;
+
+void parallel::setThreadCount(unsigned Count) { ThreadCount = Count; }
+
+unsigned parallel::getThreadCount() {
+  if (ThreadCount)
+    return ThreadCount;
+#if LLVM_ENABLE_THREADS
+  return std::max(1u, std::thread::hardware_concurrency());
+#else
+  return 1;
 #endif
 }
 
 #if LLVM_ENABLE_THREADS
+struct parallel::detail::TaskGroup::TaskQueue {
+  std::mutex Mutex;
+  std::deque<std::function<void()>> Tasks;
+
+  /// Take the newest task if \p Newest, the oldest one otherwise.
+  bool take(std::function<void()> &Task, bool Newest) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (Tasks.empty())
+      return false;
+    if (Newest) {
+      Task = std::move(Tasks.back());
+      Tasks.pop_back();
+    } else {
+      Task = std::move(Tasks.front());
+      Tasks.pop_front();
+    }
+    return true;
+  }
+};
+
+parallel::detail::TaskGroup::TaskGroup()
+    : Pending(std::make_shared<TaskQueue>()) {}
+
 void parallel::detail::TaskGroup::spawn(std::function<void()> F) {
   L.inc();
-  Executor::getDefaultExecutor()->add([&, F] {
-    F();
+  {
+    std::lock_guard<std::mutex> Lock(Pending->Mutex);
+    Pending->Tasks.push_back(std::move(F));
+  }
+  // The executor runs the oldest task of the group that is still pending by
+  // then, if sync() did not run them all already. In that case the group may
+  // be gone, so only the queue is touched.
+  std::shared_ptr<TaskQueue> Queue = Pending;
+  Executor::getDefaultExecutor()->add([this, Queue] {
+    std::function<void()> Task;
+    if (!Queue->take(Task, /*Newest=*/false))
+      return;
+    Task();
     L.dec();
   });
 }
+
+void parallel::detail::TaskGroup::sync() {
+  // Rather than blocking right away, run the tasks of this group that no
+  // thread started yet. A task that waits for its nested tasks thus does not
+  // keep its thread idle, and never picks up unrelated work.
+  std::function<void()> Task;
+  while (Pending->take(Task, /*Newest=*/true)) {
+    Task();
+    L.dec();
+  }
+  L.sync();
+}
 #endif
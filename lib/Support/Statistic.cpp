@@ -58,6 +58,7 @@ class StatisticInfo {
   friend void llvm::PrintStatistics();
   friend void llvm::PrintStatistics(raw_ostream &OS);
   friend void llvm::PrintStatisticsJSON(raw_ostream &OS);
+  friend std::vector<std::pair<StringRef, unsigned>> llvm::GetStatistics();
 
   /// Sort statistics by debugtype,name,description.
   void sort();
@@ -74,28 +75,189 @@ public:
 static ManagedStatic<StatisticInfo> StatInfo;
 static ManagedStatic<sys::SmartMutex<true> > StatLock;
 
+namespace {
+/// The counters of the statistics bumped by one thread, indexed by statistic
+/// ID. Only the owning thread writes them, with relaxed loads and stores
+/// rather than read-modify-write operations; the other threads only read them
+/// when they compute a statistic value. The chunks of counters are allocated on
+/// demand.
+struct StatisticShard {
+  static const unsigned ChunkSize = 256;
+  static const unsigned MaxChunks = 64;
+
+  std::atomic<std::atomic<unsigned> *> Chunks[MaxChunks];
+  /// The shard registered before this one. Set before the shard is published.
+  StatisticShard *Next = nullptr;
+
+  StatisticShard() {
+    for (auto &Chunk : Chunks)
+      Chunk.store(nullptr, std::memory_order_relaxed);
+  }
+
+  ~StatisticShard() {
+    for (std::atomic<unsigned> *Chunk : ChunkCache)
+      delete[] Chunk;
+  }
+
+  /// Get the counter at Index for the owning thread.
+  std::atomic<unsigned> &getCounter(unsigned Index) {
+    std::atomic<unsigned> *&Chunk = ChunkCache[Index / ChunkSize];
+    if (!Chunk) {
+      Chunk = new std::atomic<unsigned>[ChunkSize]();
+      Chunks[Index / ChunkSize].store(Chunk, std::memory_order_release);
+    }
+    return Chunk[Index % ChunkSize];
+  }
+
+  /// Read the counter at Index from any thread.
+  unsigned getValue(unsigned Index) const {
+    std::atomic<unsigned> *Chunk =
+        Chunks[Index / ChunkSize].load(std::memory_order_acquire);
+    if (!Chunk)
+      return 0;
+    return Chunk[Index % ChunkSize].load(std::memory_order_relaxed);
+  }
+
+private:
+  /// The chunks as seen by the owning thread.
+  std::atomic<unsigned> *ChunkCache[MaxChunks] = {};
+};
+
+/// The shards of all the threads that bumped a statistic. Shards are only
+/// added, under StatLock, so that readers can walk the list without locking.
+/// The counts of the threads that exited thus stay in it, until llvm_shutdown()
+/// frees it.
+struct StatisticShardList {
+  std::atomic<StatisticShard *> Head;
+
+  StatisticShardList() : Head(nullptr) {}
+  ~StatisticShardList();
+};
+} // end anonymous namespace
+
+static ManagedStatic<StatisticShardList> StatShards;
+
+/// Bumped when the shards are freed, which invalidates the current shard of
+/// every thread.
+static std::atomic<unsigned> ShardGeneration(0);
+
+static LLVM_THREAD_LOCAL StatisticShard *CurrentShard = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentShardGeneration = 0;
+
+StatisticShardList::~StatisticShardList() {
+  ShardGeneration.fetch_add(1, std::memory_order_relaxed);
+  StatisticShard *Shard = Head.load(std::memory_order_relaxed);
+  while (Shard) {
+    StatisticShard *Next = Shard->Next;
+    delete Shard;
+    Shard = Next;
+  }
+}
+
+/// Get the shard of the current thread, creating it on first use.
+static StatisticShard &getCurrentShard() {
+  unsigned Generation = ShardGeneration.load(std::memory_order_relaxed);
+  if (LLVM_LIKELY(CurrentShard && CurrentShardGeneration == Generation))
+    return *CurrentShard;
+
+  auto *Shard = new StatisticShard();
+  {
+    sys::SmartScopedLock<true> Writer(*StatLock);
+    StatisticShardList &Shards = *StatShards;
+    Shard->Next = Shards.Head.load(std::memory_order_relaxed);
+    Shards.Head.store(Shard, std::memory_order_release);
+  }
+  CurrentShard = Shard;
+  CurrentShardGeneration = Generation;
+  return *Shard;
+}
+
+/// The next statistic ID, which are 1-based.
+static std::atomic<unsigned> NextStatisticID(1);
+
+static const unsigned MaxShardedStatistics =
+    StatisticShard::ChunkSize * StatisticShard::MaxChunks;
+
+/// Sum the counters of the statistic ID of all the threads.
+static unsigned getShardsValue(unsigned ID) {
+  if (!ID || ID > MaxShardedStatistics)
+    return 0;
+  unsigned Value = 0;
+  for (StatisticShard *Shard = StatShards->Head.load(std::memory_order_acquire);
+       Shard; Shard = Shard->Next)
+    Value += Shard->getValue(ID - 1);
+  return Value;
+}
+
 /// RegisterStatistic - The first time a statistic is bumped, this method is
 /// called.
 void Statistic::RegisterStatistic() {
+  // Several threads may race to register the statistic, only the first one
+  // to set its ID registers it.
+  unsigned NewID = NextStatisticID.fetch_add(1, std::memory_order_relaxed);
+  unsigned Unregistered = 0;
+  if (!ID.compare_exchange_strong(Unregistered, NewID,
+                                  std::memory_order_acq_rel))
+    return;
+
   // If stats are enabled, inform StatInfo that this statistic should be
   // printed.
-  sys::SmartScopedLock<true> Writer(*StatLock);
-  if (!Initialized) {
-    if (Stats || Enabled)
-      StatInfo->addStatistic(this);
-
-    TsanHappensBefore(this);
-    sys::MemoryFence();
-    // Remember we have been registered.
-    TsanIgnoreWritesBegin();
-    Initialized = true;
-    TsanIgnoreWritesEnd();
+  if (Stats || Enabled) {
+    sys::SmartScopedLock<true> Writer(*StatLock);
+    StatInfo->addStatistic(this);
+  }
+}
+
+unsigned Statistic::getValue() const {
+  return Value.load(std::memory_order_relaxed) +
+         getShardsValue(ID.load(std::memory_order_acquire));
+}
+
+Statistic &Statistic::add(unsigned Delta) {
+  init();
+  unsigned Index = ID.load(std::memory_order_relaxed) - 1;
+  if (Index >= MaxShardedStatistics) {
+    Value.fetch_add(Delta, std::memory_order_relaxed);
+    return *this;
+  }
+
+  std::atomic<unsigned> &Counter = getCurrentShard().getCounter(Index);
+  Counter.store(Counter.load(std::memory_order_relaxed) + Delta,
+                std::memory_order_relaxed);
+  return *this;
+}
+
+#if !defined(NDEBUG) || defined(LLVM_ENABLE_STATS)
+const Statistic &Statistic::operator=(unsigned Val) {
+  init();
+  // The per-thread counters are left untouched, adjust the base value so that
+  // the sum is Val.
+  Value.store(Val - getShardsValue(ID.load(std::memory_order_relaxed)),
+              std::memory_order_relaxed);
+  return *this;
+}
+
+void Statistic::updateMax(unsigned V) {
+  init();
+  unsigned Base = Value.load(std::memory_order_relaxed);
+  // Keep trying to update max until we succeed or another thread produces
+  // a bigger max than us.
+  while (true) {
+    unsigned Current =
+        Base + getShardsValue(ID.load(std::memory_order_relaxed));
+    if (V <= Current ||
+        Value.compare_exchange_weak(Base, Base + (V - Current),
+                                    std::memory_order_relaxed))
+      return;
   }
 }
+#endif
 
 StatisticInfo::StatisticInfo() {
   // Ensure timergroup lists are created first so they are destructed after us.
   TimerGroup::ConstructTimerLists();
+  // Likewise for the shards, which hold the values printed on destruction.
+  (void)*StatShards;
 }
 
 // Print information when destroyed, iff command line option is specified.
@@ -180,6 +342,17 @@ void llvm::PrintStatisticsJSON(raw_ostream &OS) {
   OS.flush();
 }
 
+std::vector<std::pair<StringRef, unsigned>> llvm::GetStatistics() {
+  sys::SmartScopedLock<true> Reader(*StatLock);
+  StatisticInfo &Stats = *StatInfo;
+  Stats.sort();
+
+  std::vector<std::pair<StringRef, unsigned>> ReturnStats;
+  for (const Statistic *Stat : Stats.Stats)
+    ReturnStats.emplace_back(Stat->getName(), Stat->getValue());
+  return ReturnStats;
+}
+
 void llvm::PrintStatistics() {
 #if !defined(NDEBUG) || defined(LLVM_ENABLE_STATS)
   StatisticInfo &Stats = *StatInfo;
@@ -16,8 +16,48 @@
 #include "llvm/Config/llvm-config.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+
 using namespace llvm;
 
+void ThreadPool::pushTask(PackagedTaskTy Task, unsigned Priority) {
+  Tasks.push_back({std::move(Task), Priority, NextSequence++});
+  std::push_heap(Tasks.begin(), Tasks.end());
+}
+
+ThreadPool::PackagedTaskTy ThreadPool::popTask() {
+  std::pop_heap(Tasks.begin(), Tasks.end());
+  PackagedTaskTy Task = std::move(Tasks.back().Task);
+  Tasks.pop_back();
+  return Task;
+}
+
+std::shared_future<void> ThreadPoolTaskGroup::asyncImpl(ThreadPool::TaskTy F,
+                                                        unsigned Priority) {
+  {
+    std::unique_lock<std::mutex> LockGuard(Lock);
+    ++PendingTasks;
+  }
+  return Pool.asyncImpl(
+      [this, F] {
+        if (!Cancelled)
+          F();
+        std::unique_lock<std::mutex> LockGuard(Lock);
+        if (--PendingTasks == 0)
+          Completion.notify_all();
+      },
+      Priority);
+}
+
+void ThreadPoolTaskGroup::wait() {
+#if !LLVM_ENABLE_THREADS
+  // The tasks only run when waited for.
+  Pool.wait();
+#endif
+  std::unique_lock<std::mutex> LockGuard(Lock);
+  Completion.wait(LockGuard, [&] { return PendingTasks == 0; });
+}
+
 #if LLVM_ENABLE_THREADS
 
 // Default to std::thread::hardware_concurrency
@@ -49,8 +89,7 @@ ThreadPool::ThreadPool(unsigned ThreadCount)
             ++ActiveThreads;
             std::unique_lock<std::mutex> LockGuard(CompletionLock);
           }
-          Task = std::move(Tasks.front());
-          Tasks.pop();
+          Task = popTask();
         }
         // Run the task we just grabbed
         Task();
@@ -78,7 +117,8 @@ void ThreadPool::wait() {
                            [&] { return !ActiveThreads && Tasks.empty(); });
 }
 
-std::shared_future<void> ThreadPool::asyncImpl(TaskTy Task) {
+std::shared_future<void> ThreadPool::asyncImpl(TaskTy Task,
+                                               unsigned Priority) {
   /// Wrap the Task in a packaged_task to return a future object.
   PackagedTaskTy PackagedTask(std::move(Task));
   auto Future = PackagedTask.get_future();
@@ -89,7 +129,7 @@ std::shared_future<void> ThreadPool::asyncImpl(TaskTy Task) {
     // Don't allow enqueueing after disabling the pool
     assert(EnableFlag && "Queuing a thread during ThreadPool destruction");
 
-    Tasks.push(std::move(PackagedTask));
+    pushTask(std::move(PackagedTask), Priority);
   }
   QueueCondition.notify_one();
   return Future.share();
@@ -122,19 +162,19 @@ ThreadPool::ThreadPool(unsigned ThreadCount)
 void ThreadPool::wait() {
   // Sequential implementation running the tasks
   while (!Tasks.empty()) {
-    auto Task = std::move(Tasks.front());
-    Tasks.pop();
+    auto Task = popTask();
     Task();
   }
 }
 
-std::shared_future<void> ThreadPool::asyncImpl(TaskTy Task) {
+std::shared_future<void> ThreadPool::asyncImpl(TaskTy Task,
+                                               unsigned Priority) {
   // Get a Future with launch::deferred execution using std::async
   auto Future = std::async(std::launch::deferred, std::move(Task)).share();
   // Wrap the future so that both ThreadPool::wait() can operate and the
   // returned future can be sync'ed on.
   PackagedTaskTy PackagedTask([Future]() { Future.get(); });
-  Tasks.push(std::move(PackagedTask));
+  pushTask(std::move(PackagedTask), Priority);
   return Future;
 }
 
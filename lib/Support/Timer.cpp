@@ -14,14 +14,19 @@
 #include "llvm/Support/Timer.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compiler.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <mutex>
 using namespace llvm;
 
 // This ugly hack is brought to you courtesy of constructor/destructor ordering
@@ -48,6 +53,12 @@ namespace {
   InfoOutputFilename("info-output-file", cl::value_desc("filename"),
                      cl::desc("File to append -stats and -timer output to"),
                    cl::Hidden, cl::location(getLibSupportInfoOutputFilename()));
+
+  static cl::opt<std::string>
+  TimeTraceFile("time-trace-file", cl::value_desc("filename"),
+                cl::desc("Write the scopes timed by all the threads (e.g. with "
+                         "-time-passes) to this file, as a Chrome trace"),
+                cl::Hidden);
 }
 
 std::unique_ptr<raw_fd_ostream> llvm::CreateInfoOutputFile() {
@@ -82,6 +93,152 @@ struct CreateDefaultTimerGroup {
 static ManagedStatic<TimerGroup, CreateDefaultTimerGroup> DefaultTimerGroup;
 static TimerGroup *getDefaultTimerGroup() { return &*DefaultTimerGroup; }
 
+//===----------------------------------------------------------------------===//
+// Per-thread timing state
+//===----------------------------------------------------------------------===//
+
+static std::atomic<bool> TimeTraceEnabled(false);
+
+static bool isTimeTraceEnabled() {
+  return TimeTraceEnabled || !TimeTraceFile.empty();
+}
+
+namespace {
+/// A scope timed by a thread.
+struct TraceEvent {
+  std::string Name;
+  std::string Category;
+  double StartTime; ///< Wall clock time, in seconds.
+  double Duration;
+};
+
+/// The scopes recorded by a thread for the time trace.
+struct ThreadTrace {
+  uint64_t ThreadID;
+  std::vector<TraceEvent> Events;
+};
+
+/// The timing state of a thread. Only the owning thread modifies it. Its lock
+/// is only contended while the trace is written.
+struct TimerThreadState {
+  /// The timers currently started by this thread, and their start time.
+  SmallVector<std::pair<Timer *, TimeRecord>, 8> RunningTimers;
+  std::mutex TraceMutex;
+  ThreadTrace Trace;
+
+  void addEvent(TraceEvent Event) {
+    std::lock_guard<std::mutex> Lock(TraceMutex);
+    Trace.Events.push_back(std::move(Event));
+  }
+};
+
+/// The state of all the threads that used timers. It outlives the threads, so
+/// that their scopes are kept for the trace, and is freed by llvm_shutdown().
+class TimerThreadStates {
+  std::mutex Mutex;
+  std::vector<std::unique_ptr<TimerThreadState>> States;
+
+public:
+  TimerThreadState *create();
+  void writeTrace(raw_ostream &OS);
+};
+
+/// Writes the time trace to the -time-trace-file on llvm_shutdown().
+struct TimeTraceFileWriter {
+  ~TimeTraceFileWriter();
+};
+} // namespace
+
+static ManagedStatic<TimerThreadStates> ThreadStates;
+static ManagedStatic<TimeTraceFileWriter> TimeTraceWriter;
+
+/// The timing state of the current thread, owned by ThreadStates. States are
+/// never handed back, since threads have no portable exit hook.
+static LLVM_THREAD_LOCAL TimerThreadState *CurrentThreadState;
+
+static TimerThreadState &getThreadState() {
+  if (!CurrentThreadState)
+    CurrentThreadState = ThreadStates->create();
+  return *CurrentThreadState;
+}
+
+TimerThreadState *TimerThreadStates::create() {
+  // Make sure the trace gets written. It is constructed after this, so it is
+  // destroyed before.
+  if (!TimeTraceFile.empty())
+    (void)*TimeTraceWriter;
+  auto *State = new TimerThreadState();
+  State->Trace.ThreadID = get_threadid();
+  std::lock_guard<std::mutex> Lock(Mutex);
+  States.emplace_back(State);
+  return State;
+}
+
+static void printJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char C : Str) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (static_cast<unsigned char>(C) < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+void TimerThreadStates::writeTrace(raw_ostream &OS) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  std::vector<std::unique_lock<std::mutex>> TraceLocks;
+  std::vector<const ThreadTrace *> Traces;
+  for (const auto &State : States) {
+    TraceLocks.emplace_back(State->TraceMutex);
+    Traces.push_back(&State->Trace);
+  }
+
+  // Make the timestamps relative to the first recorded scope.
+  double Origin = 0;
+  bool HasOrigin = false;
+  for (const ThreadTrace *Trace : Traces)
+    for (const TraceEvent &E : Trace->Events)
+      if (!HasOrigin || E.StartTime < Origin) {
+        Origin = E.StartTime;
+        HasOrigin = true;
+      }
+
+  OS << "{\"traceEvents\":[";
+  const char *Delim = "\n";
+  for (const ThreadTrace *Trace : Traces)
+    for (const TraceEvent &E : Trace->Events) {
+      OS << Delim << "{\"name\":";
+      printJSONString(OS, E.Name);
+      OS << ",\"cat\":";
+      printJSONString(OS, E.Category);
+      OS << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << Trace->ThreadID
+         << format(",\"ts\":%.3f,\"dur\":%.3f}",
+                   (E.StartTime - Origin) * 1e6, E.Duration * 1e6);
+      Delim = ",\n";
+    }
+  OS << "\n]}\n";
+}
+
+TimeTraceFileWriter::~TimeTraceFileWriter() {
+  std::error_code EC;
+  raw_fd_ostream OS(TimeTraceFile, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "Error opening time trace file '" << TimeTraceFile
+           << "': " << EC.message() << '\n';
+    return;
+  }
+  ThreadStates->writeTrace(OS);
+}
+
+void llvm::enableTimeTrace() { TimeTraceEnabled = true; }
+
+void llvm::disableTimeTrace() { TimeTraceEnabled = false; }
+
+void llvm::writeTimeTrace(raw_ostream &OS) { ThreadStates->writeTrace(OS); }
+
 //===----------------------------------------------------------------------===//
 // Timer Implementation
 //===----------------------------------------------------------------------===//
@@ -94,7 +251,8 @@ void Timer::init(StringRef Name, StringRef Description, TimerGroup &tg) {
   assert(!TG && "Timer already initialized");
   this->Name.assign(Name.begin(), Name.end());
   this->Description.assign(Description.begin(), Description.end());
-  Running = Triggered = false;
+  Running = 0;
+  Triggered = false;
   TG = &tg;
   TG->addTimer(*this);
 }
@@ -129,22 +287,66 @@ TimeRecord TimeRecord::getCurrentTime(bool Start) {
   return Result;
 }
 
+/// Add \p Value to \p Sum, which has no fetch_add().
+static void atomicAdd(std::atomic<double> &Sum, double Value) {
+  double Old = Sum.load(std::memory_order_relaxed);
+  while (!Sum.compare_exchange_weak(Old, Old + Value,
+                                    std::memory_order_relaxed))
+    ;
+}
+
 void Timer::startTimer() {
-  assert(!Running && "Cannot start a running timer");
-  Running = Triggered = true;
-  StartTime = TimeRecord::getCurrentTime(true);
+  auto &RunningTimers = getThreadState().RunningTimers;
+  assert(find_if(RunningTimers,
+                 [&](const std::pair<Timer *, TimeRecord> &Entry) {
+                   return Entry.first == this;
+                 }) == RunningTimers.end() &&
+         "Cannot start a running timer");
+  ++Running;
+  Triggered = true;
+  RunningTimers.push_back(
+      std::make_pair(this, TimeRecord::getCurrentTime(true)));
 }
 
 void Timer::stopTimer() {
-  assert(Running && "Cannot stop a paused timer");
-  Running = false;
-  Time += TimeRecord::getCurrentTime(false);
-  Time -= StartTime;
+  TimeRecord EndTime = TimeRecord::getCurrentTime(false);
+  TimerThreadState &State = getThreadState();
+  // Timers are usually stopped in the reverse order they were started.
+  auto I = std::find_if(State.RunningTimers.rbegin(),
+                        State.RunningTimers.rend(),
+                        [&](const std::pair<Timer *, TimeRecord> &Entry) {
+                          return Entry.first == this;
+                        });
+  assert(I != State.RunningTimers.rend() && "Cannot stop a paused timer");
+  TimeRecord Elapsed = EndTime;
+  Elapsed -= I->second;
+  State.RunningTimers.erase(std::next(I).base());
+  --Running;
+
+  if (isTimeTraceEnabled())
+    State.addEvent({Description, TG ? TG->Name : std::string(),
+                    EndTime.getWallTime() - Elapsed.getWallTime(),
+                    Elapsed.getWallTime()});
+
+  atomicAdd(WallTime, Elapsed.getWallTime());
+  atomicAdd(UserTime, Elapsed.getUserTime());
+  atomicAdd(SystemTime, Elapsed.getSystemTime());
+  MemUsed += Elapsed.getMemUsed();
 }
 
 void Timer::clear() {
-  Running = Triggered = false;
-  Time = StartTime = TimeRecord();
+  Triggered = false;
+  WallTime = UserTime = SystemTime = 0;
+  MemUsed = 0;
+}
+
+TimeRecord Timer::getTotalTime() const {
+  TimeRecord Result;
+  Result.WallTime = WallTime;
+  Result.UserTime = UserTime;
+  Result.SystemTime = SystemTime;
+  Result.MemUsed = MemUsed;
+  return Result;
 }
 
 static void printVal(double Val, double Total, raw_ostream &OS) {
@@ -253,7 +455,7 @@ void TimerGroup::removeTimer(Timer &T) {
 
   // If the timer was started, move its data to TimersToPrint.
   if (T.hasTriggered())
-    TimersToPrint.emplace_back(T.Time, T.Name, T.Description);
+    TimersToPrint.emplace_back(T.getTotalTime(), T.Name, T.Description);
 
   T.TG = nullptr;
 
@@ -336,7 +538,7 @@ void TimerGroup::prepareToPrintList() {
   // reset them.
   for (Timer *T = FirstTimer; T; T = T->Next) {
     if (!T->hasTriggered()) continue;
-    TimersToPrint.emplace_back(T->Time, T->Name, T->Description);
+    TimersToPrint.emplace_back(T->getTotalTime(), T->Name, T->Description);
 
     // Clear out the time.
     T->clear();
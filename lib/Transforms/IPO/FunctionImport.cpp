@@ -28,6 +28,7 @@
 #include "llvm/Object/IRObjectFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Transforms/IPO/Internalize.h"
 #include "llvm/Transforms/Utils/FunctionImportUtils.h"
@@ -111,6 +112,21 @@ static std::unique_ptr<Module> loadFile(const std::string &FileName,
 
 namespace {
 
+/// Exports induced by the imports into a single module, keyed by the module
+/// they are exported from. Besides the sets, the order in which each GUID was
+/// first exported is recorded so that merging the exports of all modules in a
+/// fixed order reproduces the export lists built by a sequential walk, down to
+/// their iteration order (which feeds into the ThinLTO cache keys).
+struct ModuleExports {
+  StringMap<FunctionImporter::ExportSetTy> Seen;
+  std::vector<std::pair<StringRef, GlobalValue::GUID>> Order;
+
+  void insert(StringRef ModulePath, GlobalValue::GUID GUID) {
+    if (Seen[ModulePath].insert(GUID).second)
+      Order.emplace_back(ModulePath, GUID);
+  }
+};
+
 /// Given a list of possible callee implementation for a call site, select one
 /// that fits the \p Threshold.
 ///
@@ -210,7 +226,7 @@ static void computeImportForFunction(
     const unsigned Threshold, const GVSummaryMapTy &DefinedGVSummaries,
     SmallVectorImpl<EdgeInfo> &Worklist,
     FunctionImporter::ImportMapTy &ImportList,
-    StringMap<FunctionImporter::ExportSetTy> *ExportLists = nullptr) {
+    ModuleExports *Exports = nullptr) {
   for (auto &Edge : Summary.calls()) {
     ValueInfo VI = Edge.first;
     DEBUG(dbgs() << " edge -> " << VI.getGUID() << " Threshold:" << Threshold
@@ -280,9 +296,8 @@ static void computeImportForFunction(
     ProcessedThreshold = AdjThreshold;
 
     // Make exports in the source module.
-    if (ExportLists) {
-      auto &ExportList = (*ExportLists)[ExportModulePath];
-      ExportList.insert(VI.getGUID());
+    if (Exports) {
+      Exports->insert(ExportModulePath, VI.getGUID());
       if (!PreviouslyImported) {
         // This is the first time this function was exported from its source
         // module, so mark all functions and globals it references as exported
@@ -292,11 +307,11 @@ static void computeImportForFunction(
         // defined in the module later in a single pass.
         for (auto &Edge : ResolvedCalleeSummary->calls()) {
           auto CalleeGUID = Edge.first.getGUID();
-          ExportList.insert(CalleeGUID);
+          Exports->insert(ExportModulePath, CalleeGUID);
         }
         for (auto &Ref : ResolvedCalleeSummary->refs()) {
           auto GUID = Ref.getGUID();
-          ExportList.insert(GUID);
+          Exports->insert(ExportModulePath, GUID);
         }
       }
     }
@@ -312,7 +327,7 @@ static void computeImportForFunction(
 static void ComputeImportForModule(
     const GVSummaryMapTy &DefinedGVSummaries, const ModuleSummaryIndex &Index,
     FunctionImporter::ImportMapTy &ImportList,
-    StringMap<FunctionImporter::ExportSetTy> *ExportLists = nullptr) {
+    ModuleExports *Exports = nullptr) {
   // Worklist contains the list of function imported in this module, for which
   // we will analyse the callees and may import further down the callgraph.
   SmallVector<EdgeInfo, 128> Worklist;
@@ -332,7 +347,7 @@ static void ComputeImportForModule(
     DEBUG(dbgs() << "Initialize import for " << GVSummary.first << "\n");
     computeImportForFunction(*FuncSummary, Index, ImportInstrLimit,
                              DefinedGVSummaries, Worklist, ImportList,
-                             ExportLists);
+                             Exports);
   }
 
   // Process the newly imported functions and add callees to the worklist.
@@ -350,7 +365,7 @@ static void ComputeImportForModule(
       continue;
 
     computeImportForFunction(*Summary, Index, Threshold, DefinedGVSummaries,
-                             Worklist, ImportList, ExportLists);
+                             Worklist, ImportList, Exports);
   }
 }
 
@@ -363,29 +378,68 @@ void llvm::ComputeCrossModuleImport(
     StringMap<FunctionImporter::ImportMapTy> &ImportLists,
     StringMap<FunctionImporter::ExportSetTy> &ExportLists) {
   // For each module that has function defined, compute the import/export lists.
-  for (auto &DefinedGVSummaries : ModuleToDefinedGVSummaries) {
-    auto &ImportList = ImportLists[DefinedGVSummaries.first()];
-    DEBUG(dbgs() << "Computing import for Module '"
-                 << DefinedGVSummaries.first() << "'\n");
-    ComputeImportForModule(DefinedGVSummaries.second, Index, ImportList,
-                           &ExportLists);
+  // The walk of a module only reads the index and writes to the module's own
+  // import list and exports, so modules are processed in parallel. The
+  // exports are then merged in module order to keep the result deterministic.
+  struct ModuleImportState {
+    StringRef ModulePath;
+    const GVSummaryMapTy *DefinedGVSummaries;
+    FunctionImporter::ImportMapTy *ImportList;
+    ModuleExports Exports;
+  };
+  std::vector<ModuleImportState> States;
+  States.reserve(ModuleToDefinedGVSummaries.size());
+  for (auto &DefinedGVSummaries : ModuleToDefinedGVSummaries)
+    States.push_back({DefinedGVSummaries.first(), &DefinedGVSummaries.second,
+                      &ImportLists[DefinedGVSummaries.first()],
+                      ModuleExports()});
+
+  auto ComputeImports = [&](size_t I) {
+    ModuleImportState &State = States[I];
+    DEBUG(dbgs() << "Computing import for Module '" << State.ModulePath
+                 << "'\n");
+    ComputeImportForModule(*State.DefinedGVSummaries, Index, *State.ImportList,
+                           &State.Exports);
+    // Only the insertion order is needed for the merge.
+    State.Exports.Seen.clear();
+  };
+  // Keep the debug output of the walks from interleaving.
+  if (DebugFlag)
+    for (size_t I = 0, E = States.size(); I != E; ++I)
+      ComputeImports(I);
+  else
+    parallel::for_each_n(parallel::par, size_t(0), States.size(),
+                         ComputeImports);
+
+  for (auto &State : States) {
+    for (auto &Export : State.Exports.Order)
+      ExportLists[Export.first].insert(Export.second);
+    State.Exports.Order.clear();
+    State.Exports.Order.shrink_to_fit();
   }
 
   // When computing imports we added all GUIDs referenced by anything
   // imported from the module to its ExportList. Now we prune each ExportList
   // of any not defined in that module. This is more efficient than checking
   // while computing imports because some of the summary lists may be long
-  // due to linkonce (comdat) copies.
-  for (auto &ELI : ExportLists) {
-    const auto &DefinedGVSummaries =
-        ModuleToDefinedGVSummaries.lookup(ELI.first());
-    for (auto EI = ELI.second.begin(); EI != ELI.second.end();) {
-      if (!DefinedGVSummaries.count(*EI))
-        EI = ELI.second.erase(EI);
-      else
-        ++EI;
-    }
-  }
+  // due to linkonce (comdat) copies. Each list is pruned independently.
+  std::vector<StringMapEntry<FunctionImporter::ExportSetTy> *> ExportEntries;
+  ExportEntries.reserve(ExportLists.size());
+  for (auto &ELI : ExportLists)
+    ExportEntries.push_back(&ELI);
+  parallel::for_each(
+      parallel::par, ExportEntries.begin(), ExportEntries.end(),
+      [&](StringMapEntry<FunctionImporter::ExportSetTy> *ELI) {
+        auto DefinedIt = ModuleToDefinedGVSummaries.find(ELI->first());
+        auto &ExportList = ELI->second;
+        for (auto EI = ExportList.begin(); EI != ExportList.end();) {
+          if (DefinedIt == ModuleToDefinedGVSummaries.end() ||
+              !DefinedIt->second.count(*EI))
+            EI = ExportList.erase(EI);
+          else
+            ++EI;
+        }
+      });
 
 #ifndef NDEBUG
   DEBUG(dbgs() << "Import/Export lists for " << ImportLists.size()
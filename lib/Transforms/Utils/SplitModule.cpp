@@ -40,24 +40,22 @@ typedef DenseMap<const Comdat *, const GlobalValue *> ComdatMembersType;
 typedef DenseMap<const GlobalValue *, unsigned> ClusterIDMapType;
 }
 
-static void addNonConstUser(ClusterMapType &GVtoClusterMap,
-                            const GlobalValue *GV, const User *U) {
+// Returns the GlobalValue a non-constant user belongs to.
+static const GlobalValue *getNonConstUserGlobalValue(const User *U) {
   assert((!isa<Constant>(U) || isa<GlobalValue>(U)) && "Bad user");
 
-  if (const Instruction *I = dyn_cast<Instruction>(U)) {
-    const GlobalValue *F = I->getParent()->getParent();
-    GVtoClusterMap.unionSets(GV, F);
-  } else if (isa<GlobalIndirectSymbol>(U) || isa<Function>(U) ||
-             isa<GlobalVariable>(U)) {
-    GVtoClusterMap.unionSets(GV, cast<GlobalValue>(U));
-  } else {
-    llvm_unreachable("Underimplemented use case");
-  }
+  if (const Instruction *I = dyn_cast<Instruction>(U))
+    return I->getParent()->getParent();
+  if (isa<GlobalIndirectSymbol>(U) || isa<Function>(U) ||
+      isa<GlobalVariable>(U))
+    return cast<GlobalValue>(U);
+  llvm_unreachable("Underimplemented use case");
 }
 
-// Adds all GlobalValue users of V to the same cluster as GV.
-static void addAllGlobalValueUsers(ClusterMapType &GVtoClusterMap,
-                                   const GlobalValue *GV, const Value *V) {
+// Calls Fn on the GlobalValue of every user of V.
+static void
+forEachGlobalValueUser(const Value *V,
+                       function_ref<void(const GlobalValue *)> Fn) {
   for (auto *U : V->users()) {
     SmallVector<const User *, 4> Worklist;
     Worklist.push_back(U);
@@ -68,17 +66,56 @@ static void addAllGlobalValueUsers(ClusterMapType &GVtoClusterMap,
         Worklist.append(UU->user_begin(), UU->user_end());
         continue;
       }
-      addNonConstUser(GVtoClusterMap, GV, UU);
+      Fn(getNonConstUserGlobalValue(UU));
     }
   }
 }
 
+// Adds all GlobalValue users of V to the same cluster as GV.
+static void addAllGlobalValueUsers(ClusterMapType &GVtoClusterMap,
+                                   const GlobalValue *GV, const Value *V) {
+  forEachGlobalValueUser(V, [&](const GlobalValue *User) {
+    GVtoClusterMap.unionSets(GV, User);
+  });
+}
+
+// Adds GV to the same cluster as its user if it has a single one.
+static void addSoleGlobalValueUser(ClusterMapType &GVtoClusterMap,
+                                   const GlobalValue *GV) {
+  const GlobalValue *SoleUser = nullptr;
+  bool HasSeveralUsers = false;
+  forEachGlobalValueUser(GV, [&](const GlobalValue *User) {
+    if (SoleUser && SoleUser != User)
+      HasSeveralUsers = true;
+    SoleUser = User;
+  });
+  if (SoleUser && !HasSeveralUsers)
+    GVtoClusterMap.unionSets(GV, SoleUser);
+}
+
+// Returns the weight of GV when balancing the partitions: the number of
+// instructions of a function, 1 for the other globals.
+static unsigned getWeight(const GlobalValue *GV) {
+  const Function *F = dyn_cast<Function>(GV);
+  if (!F)
+    return 1;
+  unsigned Weight = 0;
+  for (const BasicBlock &BB : *F)
+    Weight += BB.size();
+  return std::max(Weight, 1u);
+}
+
 // Find partitions for module in the way that no locals need to be
 // globalized.
 // Try to balance pack those partitions into N files since this roughly equals
 // thread balancing for the backend codegen step.
+// With BalanceBySize, every definition is clustered and the clusters are
+// weighted by their number of instructions rather than by their number of
+// globals. Unless PreserveLocals is set, the locals are then only kept with
+// their user when they have a single one.
 static void findPartitions(Module *M, ClusterIDMapType &ClusterIDMap,
-                           unsigned N) {
+                           unsigned N, bool PreserveLocals,
+                           bool BalanceBySize) {
   // At this point module should have the proper mix of globals and locals.
   // As we attempt to partition this module, we must not change any
   // locals to globals.
@@ -86,13 +123,17 @@ static void findPartitions(Module *M, ClusterIDMapType &ClusterIDMap,
   ClusterMapType GVtoClusterMap;
   ComdatMembersType ComdatMembers;
 
-  auto recordGVSet = [&GVtoClusterMap, &ComdatMembers](GlobalValue &GV) {
+  auto recordGVSet = [&GVtoClusterMap, &ComdatMembers, PreserveLocals,
+                      BalanceBySize](GlobalValue &GV) {
     if (GV.isDeclaration())
       return;
 
     if (!GV.hasName())
       GV.setName("__llvmsplit_unnamed");
 
+    if (BalanceBySize)
+      GVtoClusterMap.insert(&GV);
+
     // Comdat groups must not be partitioned. For comdat groups that contain
     // locals, record all their members here so we can keep them together.
     // Comdat groups that only contain external globals are already handled by
@@ -121,8 +162,12 @@ static void findPartitions(Module *M, ClusterIDMapType &ClusterIDMap,
       }
     }
 
-    if (GV.hasLocalLinkage())
-      addAllGlobalValueUsers(GVtoClusterMap, &GV, &GV);
+    if (GV.hasLocalLinkage()) {
+      if (BalanceBySize && !PreserveLocals)
+        addSoleGlobalValueUser(GVtoClusterMap, &GV);
+      else
+        addAllGlobalValueUsers(GVtoClusterMap, &GV, &GV);
+    }
   };
 
   std::for_each(M->begin(), M->end(), recordGVSet);
@@ -154,11 +199,15 @@ static void findPartitions(Module *M, ClusterIDMapType &ClusterIDMap,
   // To guarantee determinism, we have to sort SCC according to size.
   // When size is the same, use leader's name.
   for (ClusterMapType::iterator I = GVtoClusterMap.begin(),
-                                E = GVtoClusterMap.end(); I != E; ++I)
-    if (I->isLeader())
-      Sets.push_back(
-          std::make_pair(std::distance(GVtoClusterMap.member_begin(I),
-                                       GVtoClusterMap.member_end()), I));
+                                E = GVtoClusterMap.end(); I != E; ++I) {
+    if (!I->isLeader())
+      continue;
+    unsigned Size = 0;
+    for (ClusterMapType::member_iterator MI = GVtoClusterMap.member_begin(I);
+         MI != GVtoClusterMap.member_end(); ++MI)
+      Size += BalanceBySize ? getWeight(*MI) : 1;
+    Sets.push_back(std::make_pair(Size, I));
+  }
 
   std::sort(Sets.begin(), Sets.end(), [](const SortType &a, const SortType &b) {
     if (a.first == b.first)
@@ -184,7 +233,7 @@ static void findPartitions(Module *M, ClusterIDMapType &ClusterIDMap,
                    << ((*MI)->hasLocalLinkage() ? " l " : " e ") << "\n");
       Visited.insert(*MI);
       ClusterIDMap[*MI] = CurrentClusterID;
-      CurrentClusterSize++;
+      CurrentClusterSize += BalanceBySize ? getWeight(*MI) : 1;
     }
     // Add this set size to the number of entries in this cluster.
     BalancinQueue.push(std::make_pair(CurrentClusterID, CurrentClusterSize));
@@ -228,7 +277,14 @@ static bool isInPartition(const GlobalValue *GV, unsigned I, unsigned N) {
 void llvm::SplitModule(
     std::unique_ptr<Module> M, unsigned N,
     function_ref<void(std::unique_ptr<Module> MPart)> ModuleCallback,
-    bool PreserveLocals) {
+    bool PreserveLocals, bool BalanceBySize) {
+  // This performs splitting without a need for externalization, which might not
+  // always be possible. When balancing by size, the partitions are computed
+  // before the externalization, so that the locals stay close to their users.
+  ClusterIDMapType ClusterIDMap;
+  if (BalanceBySize)
+    findPartitions(M.get(), ClusterIDMap, N, PreserveLocals, BalanceBySize);
+
   if (!PreserveLocals) {
     for (Function &F : *M)
       externalize(&F);
@@ -240,10 +296,8 @@ void llvm::SplitModule(
       externalize(&GIF);
   }
 
-  // This performs splitting without a need for externalization, which might not
-  // always be possible.
-  ClusterIDMapType ClusterIDMap;
-  findPartitions(M.get(), ClusterIDMap, N);
+  if (!BalanceBySize)
+    findPartitions(M.get(), ClusterIDMap, N, PreserveLocals, BalanceBySize);
 
   // FIXME: We should be able to reuse M as the last partition instead of
   // cloning it.
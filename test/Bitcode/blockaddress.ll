@@ -1,4 +1,9 @@
 ; RUN: llvm-as < %s | llvm-dis | FileCheck %s
+; RUN: llvm-as < %s | llvm-dis -parallel-function-body-reading | FileCheck %s
+; RUN: llvm-as -preserve-bc-uselistorder=false < %s > %t.bc
+; RUN: llvm-as -preserve-bc-uselistorder=false \
+; RUN:   -parallel-function-block-writing < %s > %t.parallel.bc
+; RUN: cmp %t.bc %t.parallel.bc
 ; RUN: verify-uselistorder < %s
 ; PR9857
 
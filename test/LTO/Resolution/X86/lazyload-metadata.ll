@@ -0,0 +1,54 @@
+; RUN: llvm-as %s -o %t.bc -bitcode-mdindex-threshold=0
+; REQUIRES: asserts
+
+; Check that linking @globalfunc1 into the regular LTO module does not load
+; the global metadata only used by @globalfunc2 and @globalfunc3, which are
+; dropped from the link.
+
+; RUN: llvm-lto2 run %t.bc -O0 -save-temps -o %t2 -r %t.bc,globalfunc1,px \
+; RUN:   -stats 2>&1 | FileCheck %s -check-prefix=LAZY
+; LAZY: 28 bitcode-reader  - Number of Metadata records loaded
+; LAZY: 1 bitcode-reader  - Number of MDStrings loaded
+
+; RUN: llvm-lto2 run %t.bc -O0 -o %t3 -r %t.bc,globalfunc1,px \
+; RUN:   -disable-ondemand-mds-loading -stats \
+; RUN:   2>&1 | FileCheck %s -check-prefix=NOTLAZY
+; NOTLAZY: 37 bitcode-reader  - Number of Metadata records loaded
+; NOTLAZY: 6 bitcode-reader  - Number of MDStrings loaded
+
+; The metadata reached from @globalfunc1 is linked.
+; RUN: llvm-dis %t2.0.0.preopt.bc -o - | FileCheck %s
+; CHECK: define void @globalfunc1(i32 %arg) {
+; CHECK-NEXT: %tmp = add i32 %arg, 0, !metadata [[MD:![0-9]+]]
+; CHECK-NOT: define
+; CHECK: [[MD]] = !{!"Hello World"}
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @globalfunc1(i32 %arg) {
+  %tmp = add i32 %arg, 0, !metadata !2
+  ret void
+}
+
+; Both functions reference the same metadata, so that it is emitted in the
+; global metadata block and not in the function specific metadata.
+define internal void @globalfunc2(i32 %arg) {
+  %tmp = add i32 %arg, 0, !metadata !1
+  ret void
+}
+
+define internal void @globalfunc3(i32 %arg) {
+  %tmp = add i32 %arg, 0, !metadata !1
+  ret void
+}
+
+!1 = !{!2, !3, !4, !5, !6, !7, !8, !9}
+!2 = !{!"Hello World"}
+!3 = !{!"3"}
+!4 = !{!"4"}
+!5 = !{!"5"}
+!6 = !{!9}
+!7 = !{!"7"}
+!8 = !{!"8"}
+!9 = !{!6}
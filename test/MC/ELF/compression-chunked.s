@@ -0,0 +1,33 @@
+// With -parallel-debug-compression, sections larger than a compression chunk
+// are compressed in several pieces, which must decompress to the original
+// contents.
+// RUN: llvm-mc -filetype=obj -compress-debug-sections=zlib -triple x86_64-pc-linux-gnu < %s -o %t
+// RUN: llvm-readobj -sections %t | FileCheck --check-prefix=FLAGS %s
+// RUN: llvm-dwarfdump -debug-str %t | FileCheck --check-prefix=STR %s
+// RUN: llvm-mc -filetype=obj -compress-debug-sections=zlib -parallel-debug-compression \
+// RUN:     -triple x86_64-pc-linux-gnu < %s -o %t
+// RUN: llvm-readobj -sections %t | FileCheck --check-prefix=FLAGS %s
+// RUN: llvm-dwarfdump -debug-str %t | FileCheck --check-prefix=STR %s
+// RUN: llvm-mc -filetype=obj -compress-debug-sections=zlib-gnu -debug-compression-level=speed \
+// RUN:     -parallel-debug-compression -triple x86_64-pc-linux-gnu < %s -o %t
+// RUN: llvm-dwarfdump -debug-str %t | FileCheck --check-prefix=STR %s
+// RUN: llvm-mc -filetype=obj -compress-debug-sections=zlib -debug-compression-level=size \
+// RUN:     -triple x86_64-pc-linux-gnu < %s -o %t
+// RUN: llvm-dwarfdump -debug-str %t | FileCheck --check-prefix=STR %s
+
+// REQUIRES: zlib
+
+// FLAGS:      Name: .debug_str
+// FLAGS-NEXT: Type: SHT_PROGBITS
+// FLAGS-NEXT: Flags [
+// FLAGS-NEXT:   SHF_COMPRESSED
+
+// STR: 0x00000000: "first string"
+// STR-NEXT: 0x0000000d: "{{a+}}middle string{{b+}}last string"
+
+	.section	.debug_str,"",@progbits
+	.asciz	"first string"
+	.fill	0x180000, 1, 0x61
+	.ascii	"middle string"
+	.fill	0x180000, 1, 0x62
+	.asciz	"last string"
@@ -1,5 +1,12 @@
 ; RUN: llvm-as %s -o - | llvm-nm - | FileCheck %s
 
+; RUN: llvm-as %s -o %t.bc
+; RUN: rm -f %t.a %t.thin.a
+; RUN: llvm-ar rc %t.a %t.bc
+; RUN: llvm-nm --num-threads=2 %t.a | FileCheck %s
+; RUN: llvm-ar rcT %t.thin.a %t.bc
+; RUN: llvm-nm --num-threads=2 %t.thin.a | FileCheck %s
+
 ; CHECK: D a1
 ; CHECK-NEXT: d a2
 ; CHECK-NEXT: T f1
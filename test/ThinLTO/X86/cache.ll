@@ -28,12 +28,21 @@
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
 ; RUN: touch -t 197001011200 %t.cache/llvmcache-foo %t.cache/foo
 ; RUN: llvm-lto -thinlto-action=run -exported-symbol=globalfunc %t2.bc  %t.bc -thinlto-cache-dir %t.cache
-; RUN: ls %t.cache | count 4
+; RUN: ls %t.cache | count 5
 ; RUN: ls %t.cache/llvmcache.timestamp
+; RUN: ls %t.cache/llvmcache.index
 ; RUN: ls %t.cache/foo
 ; RUN: not ls %t.cache/llvmcache-foo
 ; RUN: ls %t.cache/llvmcache-* | count 2
 
+; Verify that once the cache has an index, the pruner removes the entries that
+; the index records as expired.
+; RUN: touch %t.cache/llvmcache-bar
+; RUN: echo "A 0 0 llvmcache-bar" >> %t.cache/llvmcache.index
+; RUN: llvm-lto -thinlto-action=run -exported-symbol=globalfunc %t2.bc  %t.bc -thinlto-cache-dir %t.cache
+; RUN: not ls %t.cache/llvmcache-bar
+; RUN: ls %t.cache/llvmcache-* | count 2
+
 ; Verify that enabling caching is working with llvm-lto2
 ; RUN: rm -Rf %t.cache
 ; RUN: llvm-lto2 run -o %t.o %t2.bc  %t.bc -cache-dir %t.cache \
@@ -5,7 +5,8 @@
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
 ; RUN: llvm-lto -thinlto-action=run %t2.bc  %t.bc -exported-symbol=main -thinlto-cache-dir %t.cache
 ; RUN: ls %t.cache/llvmcache.timestamp
-; RUN: ls %t.cache | count 3
+; RUN: ls %t.cache/llvmcache.index
+; RUN: ls %t.cache | count 4
 
 ; Verify that enabling caching is working with llvm-lto2
 ; RUN: rm -Rf %t.cache
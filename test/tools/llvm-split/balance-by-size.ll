@@ -0,0 +1,52 @@
+; The largest function gets a partition of its own, and the internal function
+; with a single caller stays in the partition of its caller.
+
+; RUN: llvm-split -j=2 -balance-by-size -o %t %s
+; RUN: llvm-dis -o - %t0 | FileCheck --check-prefix=CHECK0 %s
+; RUN: llvm-dis -o - %t1 | FileCheck --check-prefix=CHECK1 %s
+
+; CHECK0: define i32 @big
+; CHECK1: declare i32 @big
+define i32 @big(i32 %a) {
+  %1 = add i32 %a, 1
+  %2 = add i32 %1, 2
+  %3 = add i32 %2, 3
+  %4 = add i32 %3, 4
+  %5 = add i32 %4, 5
+  %6 = add i32 %5, 6
+  %7 = add i32 %6, 7
+  ret i32 %7
+}
+
+; CHECK0: declare i32 @small1
+; CHECK1: define i32 @small1
+define i32 @small1() {
+  %x = call i32 @helper()
+  ret i32 %x
+}
+
+; CHECK0: declare hidden i32 @helper
+; CHECK1: define hidden i32 @helper
+define internal i32 @helper() {
+  ret i32 0
+}
+
+; CHECK0: declare i32 @small2
+; CHECK1: define i32 @small2
+define i32 @small2() {
+  %x = call i32 @shared()
+  ret i32 %x
+}
+
+; CHECK0: declare i32 @small3
+; CHECK1: define i32 @small3
+define i32 @small3() {
+  %x = call i32 @shared()
+  ret i32 %x
+}
+
+; CHECK0: declare hidden i32 @shared
+; CHECK1: define hidden i32 @shared
+define internal i32 @shared() {
+  ret i32 0
+}
@@ -35,9 +35,13 @@
 #include "llvm/Object/MachO.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <tuple>
 
@@ -99,6 +103,7 @@ class DeclContext {
   uint32_t ByteSize = 0;
   uint16_t Tag = dwarf::DW_TAG_compile_unit;
   unsigned DefinedInClangModule : 1;
+  unsigned HasCanonicalDIE : 1;
   StringRef Name;
   StringRef File;
   const DeclContext &Parent;
@@ -111,13 +116,15 @@ class DeclContext {
 public:
   typedef DenseSet<DeclContext *, DeclMapInfo> Map;
 
-  DeclContext() : DefinedInClangModule(0), Parent(*this) {}
+  DeclContext()
+      : DefinedInClangModule(0), HasCanonicalDIE(0), Parent(*this) {}
 
   DeclContext(unsigned Hash, uint32_t Line, uint32_t ByteSize, uint16_t Tag,
               StringRef Name, StringRef File, const DeclContext &Parent,
               DWARFDie LastSeenDIE = DWARFDie(), unsigned CUId = 0)
       : QualifiedNameHash(Hash), Line(Line), ByteSize(ByteSize), Tag(Tag),
-        DefinedInClangModule(0), Name(Name), File(File), Parent(Parent),
+        DefinedInClangModule(0), HasCanonicalDIE(0), Name(Name), File(File),
+        Parent(Parent),
         LastSeenDIE(LastSeenDIE), LastSeenCompileUnitID(CUId) {}
 
   uint32_t getQualifiedNameHash() const { return QualifiedNameHash; }
@@ -127,6 +134,14 @@ public:
   uint32_t getCanonicalDIEOffset() const { return CanonicalDIEOffset; }
   void setCanonicalDIEOffset(uint32_t Offset) { CanonicalDIEOffset = Offset; }
 
+  /// Whether an object file that has already been analyzed will emit
+  /// the canonical DIE for this context. Contrary to the canonical
+  /// offset (which is only known once the DIE has been cloned), this
+  /// is set during the analysis phase, thus the analysis of an object
+  /// file doesn't need to wait for the cloning of the previous ones.
+  bool hasCanonicalDIE() const { return HasCanonicalDIE; }
+  void setHasCanonicalDIE() { HasCanonicalDIE = 1; }
+
   bool isDefinedInClangModule() const { return DefinedInClangModule; }
   void setDefinedInClangModule(bool Val) { DefinedInClangModule = Val; }
 
@@ -1117,12 +1132,25 @@ public:
   /// Link the contents of the DebugMap.
   bool link(const DebugMap &);
 
-  void reportWarning(const Twine &Warning,
+  /// Report a warning about the object file \p DMO, optionally
+  /// including information about a specific \p DIE.
+  void reportWarning(const Twine &Warning, const DebugMapObject &DMO,
                      const DWARFDie *DIE = nullptr) const;
 
 private:
+  using UnitListTy = std::vector<std::unique_ptr<CompileUnit>>;
+
+  /// This map is keyed by the entry PC of functions in a debug object
+  /// and the associated value is a pair storing the corresponding end
+  /// PC and the offset to apply to get the linked address.
+  ///
+  /// See startDebugObject() for a more complete description of its use.
+  using RangesTy = std::map<uint64_t, std::pair<uint64_t, int64_t>>;
+
+  struct LinkContext;
+
   /// Called at the start of a debug object link.
-  void startDebugObject(DWARFContext &, DebugMapObject &);
+  void startDebugObject(LinkContext &Context);
 
   /// Called at the end of a debug object link.
   void endDebugObject();
@@ -1194,6 +1222,56 @@ private:
                           bool isLittleEndian);
   };
 
+  /// A clang module referenced by an object file. The module is
+  /// analyzed along with the object file, but only cloned right before
+  /// the object's own compile units.
+  struct ModuleUnit {
+    std::unique_ptr<BinaryHolder> BinHolder;
+    std::unique_ptr<DWARFContext> DwarfContext;
+    UnitListTy CompileUnits;
+  };
+
+  /// Everything that is needed to link one DebugMapObject. This state
+  /// is created when the object is loaded and released once it has
+  /// been emitted, which allows different objects to be at different
+  /// stages of the link at the same time.
+  struct LinkContext {
+    DebugMapObject &DMO;
+    BinaryHolder BinHolder;
+    RelocationManager RelocMgr;
+    std::unique_ptr<DWARFContext> DwarfContext;
+    RangesTy Ranges;
+    UnitListTy CompileUnits;
+    std::vector<ModuleUnit> ModuleUnits;
+    /// Set when there is nothing to link in this object.
+    bool Skip = false;
+
+    LinkContext(DwarfLinker &Linker, DebugMapObject &DMO, bool Verbose)
+        : DMO(DMO), BinHolder(Verbose), RelocMgr(Linker) {}
+  };
+
+  /// \defgroup LinkPhases The phases of the link of a DebugMapObject.
+  ///
+  /// The load phase is independent from the other objects and can run
+  /// concurrently for several objects. The analysis and the cloning
+  /// phases have to process the objects in debug map order to produce
+  /// a deterministic output, but the cloning of an object can run
+  /// concurrently with the analysis of the next ones.
+  ///
+  /// @{
+  /// Load the object file, find its valid relocations and extract
+  /// all its DIEs.
+  void loadObjectForLinking(LinkContext &Context, const DebugMap &Map);
+
+  /// Register the compile units and the clang modules of the object
+  /// and select the DIEs to keep.
+  void analyzeObject(LinkContext &Context, DebugMap &ModuleMap);
+
+  /// Clone the kept DIEs and emit all the debug information of the
+  /// object into the output.
+  void cloneObject(LinkContext &Context);
+  /// @}
+
   /// \defgroup FindRootDIEs Find DIEs corresponding to debug map entries.
   ///
   /// @{
@@ -1201,7 +1279,8 @@ private:
   /// keep. Store that information in \p CU's DIEInfo.
   ///
   /// The return value indicates whether the DIE is incomplete.
-  bool lookForDIEsToKeep(RelocationManager &RelocMgr, const DWARFDie &DIE,
+  bool lookForDIEsToKeep(RelocationManager &RelocMgr, RangesTy &Ranges,
+                         UnitListTy &Units, const DWARFDie &DIE,
                          const DebugMapObject &DMO, CompileUnit &CU,
                          unsigned Flags);
 
@@ -1213,14 +1292,15 @@ private:
   /// hash.
   bool registerModuleReference(const DWARFDie &CUDie,
                                const DWARFUnit &Unit, DebugMap &ModuleMap,
-                               unsigned Indent = 0);
+                               LinkContext &Context, unsigned Indent = 0);
 
   /// Recursively add the debug info in this clang module .pcm
   /// file (and all the modules imported by it in a bottom-up fashion)
-  /// to Units.
+  /// to the ModuleUnits of \p Context.
   void loadClangModule(StringRef Filename, StringRef ModulePath,
                        StringRef ModuleName, uint64_t DwoId,
-                       DebugMap &ModuleMap, unsigned Indent = 0);
+                       DebugMap &ModuleMap, LinkContext &Context,
+                       unsigned Indent = 0);
 
   /// Flags passed to DwarfLinker::lookForDIEsToKeep
   enum TravesalFlags {
@@ -1233,14 +1313,14 @@ private:
   };
 
   /// Mark the passed DIE as well as all the ones it depends on as kept.
-  void keepDIEAndDependencies(RelocationManager &RelocMgr,
-                               const DWARFDie &DIE,
-                               CompileUnit::DIEInfo &MyInfo,
-                               const DebugMapObject &DMO, CompileUnit &CU,
-                               bool UseODR);
-
-  unsigned shouldKeepDIE(RelocationManager &RelocMgr,
-                         const DWARFDie &DIE,
+  void keepDIEAndDependencies(RelocationManager &RelocMgr, RangesTy &Ranges,
+                              UnitListTy &Units, const DWARFDie &DIE,
+                              CompileUnit::DIEInfo &MyInfo,
+                              const DebugMapObject &DMO, CompileUnit &CU,
+                              bool UseODR);
+
+  unsigned shouldKeepDIE(RelocationManager &RelocMgr, RangesTy &Ranges,
+                         const DWARFDie &DIE, const DebugMapObject &DMO,
                          CompileUnit &Unit, CompileUnit::DIEInfo &MyInfo,
                          unsigned Flags);
 
@@ -1250,7 +1330,8 @@ private:
                                  CompileUnit::DIEInfo &MyInfo, unsigned Flags);
 
   unsigned shouldKeepSubprogramDIE(RelocationManager &RelocMgr,
-                                   const DWARFDie &DIE,
+                                   RangesTy &Ranges, const DWARFDie &DIE,
+                                   const DebugMapObject &DMO,
                                    CompileUnit &Unit,
                                    CompileUnit::DIEInfo &MyInfo,
                                    unsigned Flags);
@@ -1269,15 +1350,17 @@ private:
     /// Allocator used for all the DIEValue objects.
     BumpPtrAllocator &DIEAlloc;
     std::vector<std::unique_ptr<CompileUnit>> &CompileUnits;
+    /// The object file the units are cloned for (used for diagnostics).
+    const DebugMapObject &DMO;
     LinkOptions Options;
 
   public:
     DIECloner(DwarfLinker &Linker, RelocationManager &RelocMgr,
               BumpPtrAllocator &DIEAlloc,
               std::vector<std::unique_ptr<CompileUnit>> &CompileUnits,
-              LinkOptions &Options)
+              const DebugMapObject &DMO, LinkOptions &Options)
         : Linker(Linker), RelocMgr(RelocMgr), DIEAlloc(DIEAlloc),
-          CompileUnits(CompileUnits), Options(Options) {}
+          CompileUnits(CompileUnits), DMO(DMO), Options(Options) {}
 
     /// Recursively clone \p InputDIE into an tree of DIE objects
     /// where useless (as decided by lookForDIEsToKeep()) bits have been
@@ -1297,7 +1380,7 @@ private:
     /// Construct the output DIE tree by cloning the DIEs we
     /// chose to keep above. If there are no valid relocs, then there's
     /// nothing to clone/emit.
-    void cloneAllCompileUnits(DWARFContext &DwarfContext);
+    void cloneAllCompileUnits(DWARFContext &DwarfContext, RangesTy &Ranges);
 
   private:
     typedef DWARFAbbreviationDeclaration::AttributeSpec AttributeSpec;
@@ -1388,7 +1471,8 @@ private:
 
   /// Compute and emit debug_ranges section for \p Unit, and
   /// patch the attributes referencing it.
-  void patchRangesForUnit(const CompileUnit &Unit, DWARFContext &Dwarf) const;
+  void patchRangesForUnit(const CompileUnit &Unit, DWARFContext &Dwarf,
+                          const DebugMapObject &DMO) const;
 
   /// Generate and emit the DW_AT_ranges attribute for a
   /// compile_unit if it had one.
@@ -1397,14 +1481,15 @@ private:
   /// Extract the line tables fromt he original dwarf, extract
   /// the relevant parts according to the linked function ranges and
   /// emit the result in the debug_line section.
-  void patchLineTableForUnit(CompileUnit &Unit, DWARFContext &OrigDwarf);
+  void patchLineTableForUnit(CompileUnit &Unit, DWARFContext &OrigDwarf,
+                             RangesTy &Ranges, const DebugMapObject &DMO);
 
   /// Emit the accelerator entries for \p Unit.
   void emitAcceleratorEntriesForUnit(CompileUnit &Unit);
 
   /// Patch the frame info for an object file and emit it.
-  void patchFrameInfoForObject(const DebugMapObject &, DWARFContext &,
-                               unsigned AddressSize);
+  void patchFrameInfoForObject(const DebugMapObject &, RangesTy &Ranges,
+                               DWARFContext &, unsigned AddressSize);
 
   /// DIELoc objects that need to be destructed (but not freed!).
   std::vector<DIELoc *> DIELocs;
@@ -1436,24 +1521,10 @@ private:
   unsigned UnitID; ///< A unique ID that identifies each compile unit.
   unsigned MaxDwarfVersion = 0;
 
-  /// The units of the current debug map object.
-  std::vector<std::unique_ptr<CompileUnit>> Units;
-
-
-  /// The debug map object currently under consideration.
-  DebugMapObject *CurrentDebugObject;
-
-  /// The Dwarf string pool.
+  /// The Dwarf string pool. The analysis phase interns strings in it
+  /// while the cloning phase assigns the string offsets.
   NonRelocatableStringpool StringPool;
 
-  /// This map is keyed by the entry PC of functions in that
-  /// debug object and the associated value is a pair storing the
-  /// corresponding end PC and the offset to apply to get the linked
-  /// address.
-  ///
-  /// See startDebugObject() for a more complete description of its use.
-  std::map<uint64_t, std::pair<uint64_t, int64_t>> Ranges;
-
   /// The CIEs that have been emitted in the output
   /// section. The actual CIE data serves a the key to this StringMap,
   /// this takes care of comparing the semantics of CIEs defined in
@@ -1488,7 +1559,8 @@ static CompileUnit *getUnitForOffset(
 /// CompileUnit which is stored into \p ReferencedCU.
 /// \returns null if resolving fails for any reason.
 static DWARFDie resolveDIEReference(
-    const DwarfLinker &Linker, std::vector<std::unique_ptr<CompileUnit>> &Units,
+    const DwarfLinker &Linker, const DebugMapObject &DMO,
+    std::vector<std::unique_ptr<CompileUnit>> &Units,
     const DWARFFormValue &RefValue, const DWARFUnit &Unit,
     const DWARFDie &DIE, CompileUnit *&RefCU) {
   assert(RefValue.isFormClass(DWARFFormValue::FC_Reference));
@@ -1498,7 +1570,7 @@ static DWARFDie resolveDIEReference(
     if (const auto RefDie = RefCU->getOrigUnit().getDIEForOffset(RefOffset))
       return RefDie;
 
-  Linker.reportWarning("could not find referenced DIE", &DIE);
+  Linker.reportWarning("could not find referenced DIE", DMO, &DIE);
   return DWARFDie();
 }
 
@@ -1733,11 +1805,9 @@ bool DwarfLinker::DIECloner::getDIENames(const DWARFDie &Die,
 
 /// Report a warning to the user, optionaly including
 /// information about a specific \p DIE related to the warning.
-void DwarfLinker::reportWarning(const Twine &Warning,
+void DwarfLinker::reportWarning(const Twine &Warning, const DebugMapObject &DMO,
                                 const DWARFDie *DIE) const {
-  StringRef Context = "<debug map>";
-  if (CurrentDebugObject)
-    Context = CurrentDebugObject->getObjectFilename();
+  StringRef Context = DMO.getObjectFilename();
   warn(Warning, Context);
 
   if (!Options.Verbose || !DIE)
@@ -1820,11 +1890,30 @@ static bool analyzeContextInfo(const DWARFDie &DIE,
       dwarf::toUnsigned(DIE.find(dwarf::DW_AT_declaration), 0);
 
   // Don't prune it if there is no definition for the DIE.
-  Info.Prune &= Info.Ctxt && Info.Ctxt->getCanonicalDIEOffset();
+  Info.Prune &= Info.Ctxt && Info.Ctxt->hasCanonicalDIE();
 
   return Info.Prune;
 }
 
+/// Recursive helper to flag the DeclContexts for which the kept DIEs
+/// of \p CU will provide the canonical definition. This mirrors the
+/// logic cloneDIE() uses to assign the canonical DIE offsets, so that
+/// the analysis of the following object files can be done before \p CU
+/// is actually cloned.
+static void markODRCanonicalDIEs(const DWARFDie &DIE, CompileUnit &CU) {
+  CompileUnit::DIEInfo &Info = CU.getInfo(CU.getOrigUnit().getDIEIndex(DIE));
+  if (!Info.Keep)
+    return;
+
+  if ((CU.hasODR() || CU.isClangModule()) && !Info.Incomplete &&
+      DIE.getTag() != dwarf::DW_TAG_namespace && Info.Ctxt &&
+      Info.Ctxt != CU.getInfo(Info.ParentIdx).Ctxt)
+    Info.Ctxt->setHasCanonicalDIE();
+
+  for (auto Child : DIE.children())
+    markODRCanonicalDIEs(Child, CU);
+}
+
 static bool dieNeedsChildrenToBeMeaningful(uint32_t Tag) {
   switch (Tag) {
   default:
@@ -1840,7 +1929,7 @@ static bool dieNeedsChildrenToBeMeaningful(uint32_t Tag) {
   llvm_unreachable("Invalid Tag");
 }
 
-void DwarfLinker::startDebugObject(DWARFContext &Dwarf, DebugMapObject &Obj) {
+void DwarfLinker::startDebugObject(LinkContext &Context) {
   // Iterate over the debug map entries and put all the ones that are
   // functions (because they have a size) into the Ranges map. This
   // map is very similar to the FunctionRanges that are stored in each
@@ -1855,19 +1944,16 @@ void DwarfLinker::startDebugObject(DWARFContext &Dwarf, DebugMapObject &Obj) {
   // FIXME: Once we understood exactly if that information is needed,
   // maybe totally remove this (or try to use it to do a real
   // -gline-tables-only on Darwin.
-  for (const auto &Entry : Obj.symbols()) {
+  for (const auto &Entry : Context.DMO.symbols()) {
     const auto &Mapping = Entry.getValue();
     if (Mapping.Size && Mapping.ObjectAddress)
-      Ranges[*Mapping.ObjectAddress] = std::make_pair(
+      Context.Ranges[*Mapping.ObjectAddress] = std::make_pair(
           *Mapping.ObjectAddress + Mapping.Size,
           int64_t(Mapping.BinaryAddress) - *Mapping.ObjectAddress);
   }
 }
 
 void DwarfLinker::endDebugObject() {
-  Units.clear();
-  Ranges.clear();
-
   for (auto I = DIEBlocks.begin(), E = DIEBlocks.end(); I != E; ++I)
     (*I)->~DIEBlock();
   for (auto I = DIELocs.begin(), E = DIELocs.end(); I != E; ++I)
@@ -1922,14 +2008,16 @@ findValidRelocsMachO(const object::SectionRef &Section,
     if (isMachOPairedReloc(Obj.getAnyRelocationType(MachOReloc),
                            Obj.getArch())) {
       SkipNext = true;
-      Linker.reportWarning(" unsupported relocation in debug_info section.");
+      Linker.reportWarning(" unsupported relocation in debug_info section.",
+                           DMO);
       continue;
     }
 
     unsigned RelocSize = 1 << Obj.getAnyRelocationLength(MachOReloc);
     uint64_t Offset64 = Reloc.getOffset();
     if ((RelocSize != 4 && RelocSize != 8)) {
-      Linker.reportWarning(" unsupported relocation in debug_info section.");
+      Linker.reportWarning(" unsupported relocation in debug_info section.",
+                           DMO);
       continue;
     }
     uint32_t Offset = Offset64;
@@ -1954,7 +2042,7 @@ findValidRelocsMachO(const object::SectionRef &Section,
       Expected<StringRef> SymbolName = Sym->getName();
       if (!SymbolName) {
         consumeError(SymbolName.takeError());
-        Linker.reportWarning("error getting relocation symbol name.");
+        Linker.reportWarning("error getting relocation symbol name.", DMO);
         continue;
       }
       if (const auto *Mapping = DMO.lookupSymbol(*SymbolName))
@@ -1978,7 +2066,8 @@ bool DwarfLinker::RelocationManager::findValidRelocs(
     findValidRelocsMachO(Section, *MachOObj, DMO);
   else
     Linker.reportWarning(Twine("unsupported object file type: ") +
-                         Obj.getFileName());
+                             Obj.getFileName(),
+                         DMO);
 
   if (ValidRelocs.empty())
     return false;
@@ -2122,9 +2211,9 @@ unsigned DwarfLinker::shouldKeepVariableDIE(RelocationManager &RelocMgr,
 /// Check if a function describing DIE should be kept.
 /// \returns updated TraversalFlags.
 unsigned DwarfLinker::shouldKeepSubprogramDIE(
-    RelocationManager &RelocMgr,
-    const DWARFDie &DIE, CompileUnit &Unit,
-    CompileUnit::DIEInfo &MyInfo, unsigned Flags) {
+    RelocationManager &RelocMgr, RangesTy &Ranges, const DWARFDie &DIE,
+    const DebugMapObject &DMO, CompileUnit &Unit, CompileUnit::DIEInfo &MyInfo,
+    unsigned Flags) {
   const auto *Abbrev = DIE.getAbbreviationDeclarationPtr();
 
   Flags |= TF_InFunctionScope;
@@ -2155,7 +2244,7 @@ unsigned DwarfLinker::shouldKeepSubprogramDIE(
 
   Optional<uint64_t> HighPc = DIE.getHighPC(*LowPc);
   if (!HighPc) {
-    reportWarning("Function without high_pc. Range will be discarded.\n",
+    reportWarning("Function without high_pc. Range will be discarded.\n", DMO,
                   &DIE);
     return Flags;
   }
@@ -2169,7 +2258,8 @@ unsigned DwarfLinker::shouldKeepSubprogramDIE(
 /// Check if a DIE should be kept.
 /// \returns updated TraversalFlags.
 unsigned DwarfLinker::shouldKeepDIE(RelocationManager &RelocMgr,
-                                    const DWARFDie &DIE,
+                                    RangesTy &Ranges, const DWARFDie &DIE,
+                                    const DebugMapObject &DMO,
                                     CompileUnit &Unit,
                                     CompileUnit::DIEInfo &MyInfo,
                                     unsigned Flags) {
@@ -2178,7 +2268,8 @@ unsigned DwarfLinker::shouldKeepDIE(RelocationManager &RelocMgr,
   case dwarf::DW_TAG_variable:
     return shouldKeepVariableDIE(RelocMgr, DIE, Unit, MyInfo, Flags);
   case dwarf::DW_TAG_subprogram:
-    return shouldKeepSubprogramDIE(RelocMgr, DIE, Unit, MyInfo, Flags);
+    return shouldKeepSubprogramDIE(RelocMgr, Ranges, DIE, DMO, Unit, MyInfo,
+                                   Flags);
   case dwarf::DW_TAG_imported_module:
   case dwarf::DW_TAG_imported_declaration:
   case dwarf::DW_TAG_imported_unit:
@@ -2200,10 +2291,11 @@ unsigned DwarfLinker::shouldKeepDIE(RelocationManager &RelocMgr,
 /// TraversalFlags to inform it that it's not doing the primary DIE
 /// tree walk.
 void DwarfLinker::keepDIEAndDependencies(RelocationManager &RelocMgr,
-                                          const DWARFDie &Die,
-                                          CompileUnit::DIEInfo &MyInfo,
-                                          const DebugMapObject &DMO,
-                                          CompileUnit &CU, bool UseODR) {
+                                         RangesTy &Ranges, UnitListTy &Units,
+                                         const DWARFDie &Die,
+                                         CompileUnit::DIEInfo &MyInfo,
+                                         const DebugMapObject &DMO,
+                                         CompileUnit &CU, bool UseODR) {
   DWARFUnit &Unit = CU.getOrigUnit();
   MyInfo.Keep = true;
 
@@ -2216,7 +2308,8 @@ void DwarfLinker::keepDIEAndDependencies(RelocationManager &RelocMgr,
   unsigned AncestorIdx = MyInfo.ParentIdx;
   while (!CU.getInfo(AncestorIdx).Keep) {
     unsigned ODRFlag = UseODR ? TF_ODR : 0;
-    lookForDIEsToKeep(RelocMgr, Unit.getDIEAtIndex(AncestorIdx), DMO, CU,
+    lookForDIEsToKeep(RelocMgr, Ranges, Units, Unit.getDIEAtIndex(AncestorIdx),
+                      DMO, CU,
                       TF_ParentWalk | TF_Keep | TF_DependencyWalk | ODRFlag);
     AncestorIdx = CU.getInfo(AncestorIdx).ParentIdx;
   }
@@ -2239,11 +2332,11 @@ void DwarfLinker::keepDIEAndDependencies(RelocationManager &RelocMgr,
 
     Val.extractValue(Data, &Offset, &Unit);
     CompileUnit *ReferencedCU;
-    if (auto RefDie =
-            resolveDIEReference(*this, Units, Val, Unit, Die, ReferencedCU)) {
+    if (auto RefDie = resolveDIEReference(*this, DMO, Units, Val, Unit, Die,
+                                          ReferencedCU)) {
       uint32_t RefIdx = ReferencedCU->getOrigUnit().getDIEIndex(RefDie);
       CompileUnit::DIEInfo &Info = ReferencedCU->getInfo(RefIdx);
-      bool IsModuleRef = Info.Ctxt && Info.Ctxt->getCanonicalDIEOffset() &&
+      bool IsModuleRef = Info.Ctxt && Info.Ctxt->hasCanonicalDIE() &&
                          Info.Ctxt->isDefinedInClangModule();
       // If the referenced DIE has a DeclContext that has already been
       // emitted, then do not keep the one in this CU. We'll link to
@@ -2256,16 +2349,16 @@ void DwarfLinker::keepDIEAndDependencies(RelocationManager &RelocMgr,
       if (AttrSpec.Form != dwarf::DW_FORM_ref_addr && (UseODR || IsModuleRef) &&
           Info.Ctxt &&
           Info.Ctxt != ReferencedCU->getInfo(Info.ParentIdx).Ctxt &&
-          Info.Ctxt->getCanonicalDIEOffset() && isODRAttribute(AttrSpec.Attr))
+          Info.Ctxt->hasCanonicalDIE() && isODRAttribute(AttrSpec.Attr))
         continue;
 
       // Keep a module forward declaration if there is no definition.
       if (!(isODRAttribute(AttrSpec.Attr) && Info.Ctxt &&
-            Info.Ctxt->getCanonicalDIEOffset()))
+            Info.Ctxt->hasCanonicalDIE()))
         Info.Prune = false;
 
       unsigned ODRFlag = UseODR ? TF_ODR : 0;
-      lookForDIEsToKeep(RelocMgr, RefDie, DMO, *ReferencedCU,
+      lookForDIEsToKeep(RelocMgr, Ranges, Units, RefDie, DMO, *ReferencedCU,
                         TF_Keep | TF_DependencyWalk | ODRFlag);
 
       // The incomplete property is propagated if the current DIE is complete
@@ -2296,6 +2389,7 @@ void DwarfLinker::keepDIEAndDependencies(RelocationManager &RelocMgr,
 ///
 /// The return value indicates whether the DIE is incomplete.
 bool DwarfLinker::lookForDIEsToKeep(RelocationManager &RelocMgr,
+                                    RangesTy &Ranges, UnitListTy &Units,
                                     const DWARFDie &Die,
                                     const DebugMapObject &DMO, CompileUnit &CU,
                                     unsigned Flags) {
@@ -2314,12 +2408,13 @@ bool DwarfLinker::lookForDIEsToKeep(RelocationManager &RelocMgr,
   // We must not call shouldKeepDIE while called from keepDIEAndDependencies,
   // because it would screw up the relocation finding logic.
   if (!(Flags & TF_DependencyWalk))
-    Flags = shouldKeepDIE(RelocMgr, Die, CU, MyInfo, Flags);
+    Flags = shouldKeepDIE(RelocMgr, Ranges, Die, DMO, CU, MyInfo, Flags);
 
   // If it is a newly kept DIE mark it as well as all its dependencies as kept.
   if (!AlreadyKept && (Flags & TF_Keep)) {
     bool UseOdr = (Flags & TF_DependencyWalk) ? (Flags & TF_ODR) : CU.hasODR();
-    keepDIEAndDependencies(RelocMgr, Die, MyInfo, DMO, CU, UseOdr);
+    keepDIEAndDependencies(RelocMgr, Ranges, Units, Die, MyInfo, DMO, CU,
+                           UseOdr);
   }
   // The TF_ParentWalk flag tells us that we are currently walking up
   // the parent chain of a required DIE, and we don't want to mark all
@@ -2335,7 +2430,8 @@ bool DwarfLinker::lookForDIEsToKeep(RelocationManager &RelocMgr,
 
   bool Incomplete = false;
   for (auto Child : Die.children()) {
-    Incomplete |= lookForDIEsToKeep(RelocMgr, Child, DMO, CU, Flags);
+    Incomplete |=
+        lookForDIEsToKeep(RelocMgr, Ranges, Units, Child, DMO, CU, Flags);
 
     // If any of the members are incomplete we propagate the incompleteness.
     if (!MyInfo.Incomplete && Incomplete &&
@@ -2398,8 +2494,8 @@ unsigned DwarfLinker::DIECloner::cloneDieReferenceAttribute(
   CompileUnit *RefUnit = nullptr;
   DeclContext *Ctxt = nullptr;
 
-  DWARFDie RefDie = resolveDIEReference(Linker, CompileUnits, Val, U, InputDIE,
-                                        RefUnit);
+  DWARFDie RefDie = resolveDIEReference(Linker, DMO, CompileUnits, Val, U,
+                                        InputDIE, RefUnit);
 
   // If the referenced DIE is not found,  drop the attribute.
   if (!RefDie)
@@ -2558,7 +2654,7 @@ unsigned DwarfLinker::DIECloner::cloneScalarAttribute(
     Value = *OptionalValue;
   else {
     Linker.reportWarning(
-        "Unsupported scalar attribute form. Dropping attribute.",
+        "Unsupported scalar attribute form. Dropping attribute.", DMO,
         &InputDIE);
     return 0;
   }
@@ -2621,7 +2717,8 @@ unsigned DwarfLinker::DIECloner::cloneAttribute(
                                 Info);
   default:
     Linker.reportWarning(
-        "Unsupported attribute form in cloneAttribute. Dropping.", &InputDIE);
+        "Unsupported attribute form in cloneAttribute. Dropping.", DMO,
+        &InputDIE);
   }
 
   return 0;
@@ -2904,7 +3001,8 @@ DIE *DwarfLinker::DIECloner::cloneDIE(
 /// and emit them in the output file. Update the relevant attributes
 /// to point at the new entries.
 void DwarfLinker::patchRangesForUnit(const CompileUnit &Unit,
-                                     DWARFContext &OrigDwarf) const {
+                                     DWARFContext &OrigDwarf,
+                                     const DebugMapObject &DMO) const {
   DWARFDebugRangeList RangeList;
   const auto &FunctionRanges = Unit.getFunctionRanges();
   unsigned AddressSize = Unit.getOrigUnit().getAddressByteSize();
@@ -2935,7 +3033,7 @@ void DwarfLinker::patchRangesForUnit(const CompileUnit &Unit,
         CurrRange = FunctionRanges.find(First.StartAddress + OrigLowPc);
         if (CurrRange == InvalidRange ||
             CurrRange.start() > First.StartAddress + OrigLowPc) {
-          reportWarning("no mapping for range.");
+          reportWarning("no mapping for range.", DMO);
           continue;
         }
       }
@@ -3007,7 +3105,9 @@ static void patchStmtList(DIE &Die, DIEInteger Offset) {
 /// recreate a relocated version of these for the address ranges that
 /// are present in the binary.
 void DwarfLinker::patchLineTableForUnit(CompileUnit &Unit,
-                                        DWARFContext &OrigDwarf) {
+                                        DWARFContext &OrigDwarf,
+                                        RangesTy &Ranges,
+                                        const DebugMapObject &DMO) {
   DWARFDie CUDie = Unit.getOrigUnit().getUnitDIE();
   auto StmtList = dwarf::toSectionOffset(CUDie.find(dwarf::DW_AT_stmt_list));
   if (!StmtList)
@@ -3046,7 +3146,7 @@ void DwarfLinker::patchLineTableForUnit(CompileUnit &Unit,
 
   // Iterate over the object file line info and extract the sequences
   // that correspond to linked functions.
-  for (auto &Row : LineTable.Rows) {
+  for (DWARFDebugLine::Row Row : LineTable.Rows) {
     // Check wether we stepped out of the range. The range is
     // half-open, but consider accept the end address of the range if
     // it is marked as end_sequence in the input (because in that
@@ -3120,7 +3220,7 @@ void DwarfLinker::patchLineTableForUnit(CompileUnit &Unit,
   if (LineTable.Prologue.getVersion() != 2 ||
       LineTable.Prologue.DefaultIsStmt != DWARF2_LINE_DEFAULT_IS_STMT ||
       LineTable.Prologue.OpcodeBase > 13)
-    reportWarning("line table parameters mismatch. Cannot emit.");
+    reportWarning("line table parameters mismatch. Cannot emit.", DMO);
   else {
     StringRef LineData = OrigDwarf.getDWARFObj().getLineSection().Data;
     MCDwarfLineTableParams Params;
@@ -3146,6 +3246,7 @@ void DwarfLinker::emitAcceleratorEntriesForUnit(CompileUnit &Unit) {
 /// be considered as black boxes and moved as is. The only thing to do
 /// is to patch the addresses in the headers.
 void DwarfLinker::patchFrameInfoForObject(const DebugMapObject &DMO,
+                                          RangesTy &Ranges,
                                           DWARFContext &OrigDwarf,
                                           unsigned AddrSize) {
   StringRef FrameData = OrigDwarf.getDWARFObj().getDebugFrameSection();
@@ -3163,7 +3264,7 @@ void DwarfLinker::patchFrameInfoForObject(const DebugMapObject &DMO,
     uint32_t EntryOffset = InputOffset;
     uint32_t InitialLength = Data.getU32(&InputOffset);
     if (InitialLength == 0xFFFFFFFF)
-      return reportWarning("Dwarf64 bits no supported");
+      return reportWarning("Dwarf64 bits no supported", DMO);
 
     uint32_t CIEId = Data.getU32(&InputOffset);
     if (CIEId == 0xFFFFFFFF) {
@@ -3195,7 +3296,7 @@ void DwarfLinker::patchFrameInfoForObject(const DebugMapObject &DMO,
     // Have we already emitted a corresponding CIE?
     StringRef CIEData = LocalCIES[CIEId];
     if (CIEData.empty())
-      return reportWarning("Inconsistent debug_frame content. Dropping.");
+      return reportWarning("Inconsistent debug_frame content. Dropping.", DMO);
 
     // Look if we already emitted a CIE that corresponds to the
     // referenced one (the CIE data is the key of that lookup).
@@ -3250,7 +3351,7 @@ static uint64_t getDwoId(const DWARFDie &CUDie,
 
 bool DwarfLinker::registerModuleReference(
     const DWARFDie &CUDie, const DWARFUnit &Unit,
-    DebugMap &ModuleMap, unsigned Indent) {
+    DebugMap &ModuleMap, LinkContext &Context, unsigned Indent) {
   std::string PCMfile =
       dwarf::toString(CUDie.find({dwarf::DW_AT_dwo_name,
                                   dwarf::DW_AT_GNU_dwo_name}), "");
@@ -3263,7 +3364,7 @@ bool DwarfLinker::registerModuleReference(
 
   std::string Name = dwarf::toString(CUDie.find(dwarf::DW_AT_name), "");
   if (Name.empty()) {
-    reportWarning("Anonymous module skeleton CU for " + PCMfile);
+    reportWarning("Anonymous module skeleton CU for " + PCMfile, Context.DMO);
     return true;
   }
 
@@ -3279,7 +3380,8 @@ bool DwarfLinker::registerModuleReference(
     // ASTFileSignatures will change randomly when a module is rebuilt.
     if (Options.Verbose && (Cached->second != DwoId))
       reportWarning(Twine("hash mismatch: this object file was built against a "
-                          "different version of the module ") + PCMfile);
+                          "different version of the module ") + PCMfile,
+                    Context.DMO);
     if (Options.Verbose)
       outs() << " [cached].\n";
     return true;
@@ -3290,7 +3392,8 @@ bool DwarfLinker::registerModuleReference(
   // Cyclic dependencies are disallowed by Clang, but we still
   // shouldn't run into an infinite loop, so mark it as processed now.
   ClangModules.insert({PCMfile, DwoId});
-  loadClangModule(PCMfile, PCMpath, Name, DwoId, ModuleMap, Indent + 2);
+  loadClangModule(PCMfile, PCMpath, Name, DwoId, ModuleMap, Context,
+                  Indent + 2);
   return true;
 }
 
@@ -3300,30 +3403,31 @@ DwarfLinker::loadObject(BinaryHolder &BinaryHolder, DebugMapObject &Obj,
   auto ErrOrObjs =
       BinaryHolder.GetObjectFiles(Obj.getObjectFilename(), Obj.getTimestamp());
   if (std::error_code EC = ErrOrObjs.getError()) {
-    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message());
+    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message(), Obj);
     return EC;
   }
   auto ErrOrObj = BinaryHolder.Get(Map.getTriple());
   if (std::error_code EC = ErrOrObj.getError())
-    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message());
+    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message(), Obj);
   return ErrOrObj;
 }
 
 void DwarfLinker::loadClangModule(StringRef Filename, StringRef ModulePath,
                                   StringRef ModuleName, uint64_t DwoId,
-                                  DebugMap &ModuleMap, unsigned Indent) {
+                                  DebugMap &ModuleMap, LinkContext &Context,
+                                  unsigned Indent) {
   SmallString<80> Path(Options.PrependPath);
   if (sys::path::is_relative(Filename))
     sys::path::append(Path, ModulePath, Filename);
   else
     sys::path::append(Path, Filename);
-  BinaryHolder ObjHolder(Options.Verbose);
+  auto ObjHolder = llvm::make_unique<BinaryHolder>(Options.Verbose);
   auto &Obj =
       ModuleMap.addDebugMapObject(Path, sys::TimePoint<std::chrono::seconds>());
-  auto ErrOrObj = loadObject(ObjHolder, Obj, ModuleMap);
+  auto ErrOrObj = loadObject(*ObjHolder, Obj, ModuleMap);
   if (!ErrOrObj) {
     // Try and emit more helpful warnings by applying some heuristics.
-    StringRef ObjFile = CurrentDebugObject->getObjectFilename();
+    StringRef ObjFile = Context.DMO.getObjectFilename();
     bool isClangModule = sys::path::extension(Filename).equals(".pcm");
     bool isArchive = ObjFile.endswith(")");
     if (isClangModule) {
@@ -3360,13 +3464,12 @@ void DwarfLinker::loadClangModule(StringRef Filename, StringRef ModulePath,
 
   // Setup access to the debug info.
   auto DwarfContext = DWARFContext::create(*ErrOrObj);
-  RelocationManager RelocMgr(*this);
   for (const auto &CU : DwarfContext->compile_units()) {
     maybeUpdateMaxDwarfVersion(CU->getVersion());
 
     // Recursively get all modules imported by this one.
     auto CUDie = CU->getUnitDIE(false);
-    if (!registerModuleReference(CUDie, *CU, ModuleMap, Indent)) {
+    if (!registerModuleReference(CUDie, *CU, ModuleMap, Context, Indent)) {
       if (Unit) {
         errs() << Filename << ": Clang modules are expected to have exactly"
                << " 1 compile unit.\n";
@@ -3380,7 +3483,8 @@ void DwarfLinker::loadClangModule(StringRef Filename, StringRef ModulePath,
         if (Options.Verbose)
           reportWarning(
               Twine("hash mismatch: this object file was built against a "
-                    "different version of the module ") + Filename);
+                    "different version of the module ") + Filename,
+              Context.DMO);
         // Update the cache entry with the DwoId of the module loaded from disk.
         ClangModules[Filename] = PCMDwoId;
       }
@@ -3402,13 +3506,21 @@ void DwarfLinker::loadClangModule(StringRef Filename, StringRef ModulePath,
     outs() << "cloning .debug_info from " << Filename << "\n";
   }
 
-  std::vector<std::unique_ptr<CompileUnit>> CompileUnits;
-  CompileUnits.push_back(std::move(Unit));
-  DIECloner(*this, RelocMgr, DIEAlloc, CompileUnits, Options)
-      .cloneAllCompileUnits(*DwarfContext);
+  // The cloning of the module is delayed until the cloning of the
+  // referencing object, but the ODR contexts it defines need to be
+  // known by the analysis of that object.
+  if (Streamer)
+    markODRCanonicalDIEs(Unit->getOrigUnit().getUnitDIE(), *Unit);
+
+  ModuleUnit Module;
+  Module.BinHolder = std::move(ObjHolder);
+  Module.DwarfContext = std::move(DwarfContext);
+  Module.CompileUnits.push_back(std::move(Unit));
+  Context.ModuleUnits.push_back(std::move(Module));
 }
 
-void DwarfLinker::DIECloner::cloneAllCompileUnits(DWARFContext &DwarfContext) {
+void DwarfLinker::DIECloner::cloneAllCompileUnits(DWARFContext &DwarfContext,
+                                                  RangesTy &Ranges) {
   if (!Linker.Streamer)
     return;
 
@@ -3428,8 +3540,8 @@ void DwarfLinker::DIECloner::cloneAllCompileUnits(DWARFContext &DwarfContext) {
     // FIXME: for compatibility with the classic dsymutil, we emit
     // an empty line table for the unit, even if the unit doesn't
     // actually exist in the DIE tree.
-    Linker.patchLineTableForUnit(*CurrentUnit, DwarfContext);
-    Linker.patchRangesForUnit(*CurrentUnit, DwarfContext);
+    Linker.patchLineTableForUnit(*CurrentUnit, DwarfContext, Ranges, DMO);
+    Linker.patchRangesForUnit(*CurrentUnit, DwarfContext, DMO);
     Linker.Streamer->emitLocationsForUnit(*CurrentUnit, DwarfContext);
     Linker.emitAcceleratorEntriesForUnit(*CurrentUnit);
   }
@@ -3448,6 +3560,108 @@ void DwarfLinker::DIECloner::cloneAllCompileUnits(DWARFContext &DwarfContext) {
   }
 }
 
+void DwarfLinker::loadObjectForLinking(LinkContext &Context,
+                                       const DebugMap &Map) {
+  DebugMapObject &Obj = Context.DMO;
+  if (Options.Verbose)
+    outs() << "DEBUG MAP OBJECT: " << Obj.getObjectFilename() << "\n";
+  auto ErrOrObj = loadObject(Context.BinHolder, Obj, Map);
+  if (!ErrOrObj) {
+    Context.Skip = true;
+    return;
+  }
+
+  // Look for relocations that correspond to debug map entries.
+  if (!Context.RelocMgr.findValidRelocsInDebugInfo(*ErrOrObj, Obj)) {
+    if (Options.Verbose)
+      outs() << "No valid relocations found. Skipping.\n";
+    Context.Skip = true;
+    return;
+  }
+
+  // Setup access to the debug info.
+  Context.DwarfContext = DWARFContext::create(*ErrOrObj);
+  startDebugObject(Context);
+
+  // Extracting the DIEs is the most expensive part of the loading, do
+  // it here so that it happens in parallel with the other objects.
+  for (const auto &CU : Context.DwarfContext->compile_units())
+    CU->getUnitDIE(false);
+}
+
+void DwarfLinker::analyzeObject(LinkContext &Context, DebugMap &ModuleMap) {
+  if (Context.Skip)
+    return;
+
+  // In a first phase, just read in the debug info and load all clang modules.
+  for (const auto &CU : Context.DwarfContext->compile_units()) {
+    auto CUDie = CU->getUnitDIE(false);
+    if (Options.Verbose) {
+      outs() << "Input compilation unit:";
+      DIDumpOptions DumpOpts;
+      DumpOpts.Verbose = Options.Verbose;
+      CUDie.dump(outs(), 0, 0, DumpOpts);
+    }
+
+    if (!registerModuleReference(CUDie, *CU, ModuleMap, Context)) {
+      Context.CompileUnits.push_back(llvm::make_unique<CompileUnit>(
+          *CU, UnitID++, !Options.NoODR, ""));
+      maybeUpdateMaxDwarfVersion(CU->getVersion());
+    }
+  }
+
+  // Now build the DIE parent links that we will use during the next phase.
+  for (auto &CurrentUnit : Context.CompileUnits)
+    analyzeContextInfo(CurrentUnit->getOrigUnit().getUnitDIE(), 0, *CurrentUnit,
+                       &ODRContexts.getRoot(), StringPool, ODRContexts);
+
+  // Then mark all the DIEs that need to be present in the linked
+  // output and collect some information about them. Note that this
+  // loop can not be merged with the previous one becaue cross-cu
+  // references require the ParentIdx to be setup for every CU in
+  // the object file before calling this.
+  for (auto &CurrentUnit : Context.CompileUnits)
+    lookForDIEsToKeep(Context.RelocMgr, Context.Ranges, Context.CompileUnits,
+                      CurrentUnit->getOrigUnit().getUnitDIE(), Context.DMO,
+                      *CurrentUnit, 0);
+
+  // Finally record the ODR contexts that this object will define, so
+  // that the analysis of the next objects can reference them.
+  if (Streamer)
+    for (auto &CurrentUnit : Context.CompileUnits)
+      markODRCanonicalDIEs(CurrentUnit->getOrigUnit().getUnitDIE(),
+                           *CurrentUnit);
+}
+
+void DwarfLinker::cloneObject(LinkContext &Context) {
+  if (Context.Skip)
+    return;
+
+  // Emit the clang modules imported by this object first.
+  for (auto &Module : Context.ModuleUnits) {
+    RelocationManager RelocMgr(*this);
+    DIECloner(*this, RelocMgr, DIEAlloc, Module.CompileUnits, Context.DMO,
+              Options)
+        .cloneAllCompileUnits(*Module.DwarfContext, Context.Ranges);
+  }
+
+  // The calls to applyValidRelocs inside cloneDIE will walk the
+  // reloc array again (in the same way findValidRelocsInDebugInfo()
+  // did). We need to reset the NextValidReloc index to the beginning.
+  Context.RelocMgr.resetValidRelocs();
+  if (Context.RelocMgr.hasValidRelocs())
+    DIECloner(*this, Context.RelocMgr, DIEAlloc, Context.CompileUnits,
+              Context.DMO, Options)
+        .cloneAllCompileUnits(*Context.DwarfContext, Context.Ranges);
+  if (!Options.NoOutput && !Context.CompileUnits.empty())
+    patchFrameInfoForObject(
+        Context.DMO, Context.Ranges, *Context.DwarfContext,
+        Context.CompileUnits[0]->getOrigUnit().getAddressByteSize());
+
+  // Clean-up before starting working on the next object.
+  endDebugObject();
+}
+
 bool DwarfLinker::link(const DebugMap &Map) {
 
   if (!createStreamer(Map.getTriple(), OutputFilename))
@@ -3459,71 +3673,76 @@ bool DwarfLinker::link(const DebugMap &Map) {
   UnitID = 0;
   DebugMap ModuleMap(Map.getTriple(), Map.getBinaryPath());
 
-  for (const auto &Obj : Map.objects()) {
-    CurrentDebugObject = Obj.get();
-
-    if (Options.Verbose)
-      outs() << "DEBUG MAP OBJECT: " << Obj->getObjectFilename() << "\n";
-    auto ErrOrObj = loadObject(BinHolder, *Obj, Map);
-    if (!ErrOrObj)
-      continue;
-
-    // Look for relocations that correspond to debug map entries.
-    RelocationManager RelocMgr(*this);
-    if (!RelocMgr.findValidRelocsInDebugInfo(*ErrOrObj, *Obj)) {
-      if (Options.Verbose)
-        outs() << "No valid relocations found. Skipping.\n";
-      continue;
+  std::vector<std::unique_ptr<LinkContext>> ObjectContexts;
+  for (const auto &Obj : Map.objects())
+    ObjectContexts.push_back(
+        llvm::make_unique<LinkContext>(*this, *Obj, Options.Verbose));
+  unsigned NumObjects = ObjectContexts.size();
+
+  if (Options.Threads <= 1 || NumObjects <= 1 || !llvm_is_multithreaded()) {
+    // Link the objects one after the other, this keeps only one of them
+    // in memory at any given time.
+    for (auto &Context : ObjectContexts) {
+      loadObjectForLinking(*Context, Map);
+      analyzeObject(*Context, ModuleMap);
+      cloneObject(*Context);
+      Context.reset();
     }
+  } else {
+    // The objects are loaded on the thread pool, a few of them ahead of
+    // the analysis. The analysis runs on this thread and the cloning on
+    // a dedicated pool thread. Both process the objects in order and
+    // are synchronized through NumAnalyzed.
+    ThreadPool Pool(Options.Threads);
+    std::vector<std::shared_future<void>> Loaded(NumObjects);
+    unsigned NumLoading = 0;
+    std::mutex ProgressMutex;
+    std::condition_variable ProgressCondition;
+    unsigned NumAnalyzed = 0;
+    unsigned NumCloned = 0;
+
+    Pool.async([&] {
+      for (unsigned I = 0; I != NumObjects; ++I) {
+        {
+          std::unique_lock<std::mutex> Lock(ProgressMutex);
+          ProgressCondition.wait(Lock, [&] { return NumAnalyzed > I; });
+        }
+        cloneObject(*ObjectContexts[I]);
+        ObjectContexts[I].reset();
+        {
+          std::lock_guard<std::mutex> Lock(ProgressMutex);
+          ++NumCloned;
+        }
+        ProgressCondition.notify_all();
+      }
+    });
+
+    for (unsigned I = 0; I != NumObjects; ++I) {
+      for (; NumLoading != NumObjects && NumLoading <= I + Options.Threads;
+           ++NumLoading) {
+        LinkContext *Context = ObjectContexts[NumLoading].get();
+        Loaded[NumLoading] = Pool.async(
+            [this, Context, &Map] { loadObjectForLinking(*Context, Map); });
+      }
 
-    // Setup access to the debug info.
-    auto DwarfContext = DWARFContext::create(*ErrOrObj);
-    startDebugObject(*DwarfContext, *Obj);
-
-    // In a first phase, just read in the debug info and load all clang modules.
-    for (const auto &CU : DwarfContext->compile_units()) {
-      auto CUDie = CU->getUnitDIE(false);
-      if (Options.Verbose) {
-        outs() << "Input compilation unit:";
-        DIDumpOptions DumpOpts;
-        DumpOpts.Verbose = Options.Verbose;
-        CUDie.dump(outs(), 0, 0, DumpOpts);
+      // Bound the number of objects waiting to be cloned to limit the
+      // memory usage.
+      {
+        std::unique_lock<std::mutex> Lock(ProgressMutex);
+        ProgressCondition.wait(
+            Lock, [&] { return I < NumCloned + Options.Threads; });
       }
 
-      if (!registerModuleReference(CUDie, *CU, ModuleMap)) {
-        Units.push_back(llvm::make_unique<CompileUnit>(*CU, UnitID++,
-                                                       !Options.NoODR, ""));
-        maybeUpdateMaxDwarfVersion(CU->getVersion());
+      Loaded[I].wait();
+      analyzeObject(*ObjectContexts[I], ModuleMap);
+      {
+        std::lock_guard<std::mutex> Lock(ProgressMutex);
+        ++NumAnalyzed;
       }
+      ProgressCondition.notify_all();
     }
 
-    // Now build the DIE parent links that we will use during the next phase.
-    for (auto &CurrentUnit : Units)
-      analyzeContextInfo(CurrentUnit->getOrigUnit().getUnitDIE(), 0, *CurrentUnit,
-                         &ODRContexts.getRoot(), StringPool, ODRContexts);
-
-    // Then mark all the DIEs that need to be present in the linked
-    // output and collect some information about them. Note that this
-    // loop can not be merged with the previous one becaue cross-cu
-    // references require the ParentIdx to be setup for every CU in
-    // the object file before calling this.
-    for (auto &CurrentUnit : Units)
-      lookForDIEsToKeep(RelocMgr, CurrentUnit->getOrigUnit().getUnitDIE(), *Obj,
-                        *CurrentUnit, 0);
-
-    // The calls to applyValidRelocs inside cloneDIE will walk the
-    // reloc array again (in the same way findValidRelocsInDebugInfo()
-    // did). We need to reset the NextValidReloc index to the beginning.
-    RelocMgr.resetValidRelocs();
-    if (RelocMgr.hasValidRelocs())
-      DIECloner(*this, RelocMgr, DIEAlloc, Units, Options)
-          .cloneAllCompileUnits(*DwarfContext);
-    if (!Options.NoOutput && !Units.empty())
-      patchFrameInfoForObject(*Obj, *DwarfContext,
-                              Units[0]->getOrigUnit().getAddressByteSize());
-
-    // Clean-up before starting working on the next object.
-    endDebugObject();
+    Pool.wait();
   }
 
   // Emit everything that's global.
@@ -3540,6 +3759,7 @@ bool DwarfLinker::link(const DebugMap &Map) {
 /// can insert a new element or return the offset of a preexisitng
 /// one.
 uint32_t NonRelocatableStringpool::getStringOffset(StringRef S) {
+  std::lock_guard<std::mutex> Lock(Mutex);
   if (S.empty() && !Strings.empty())
     return 0;
 
@@ -3565,17 +3785,24 @@ uint32_t NonRelocatableStringpool::getStringOffset(StringRef S) {
 /// that go into the output section. A latter call to
 /// getStringOffset() with the same string will chain it though.
 StringRef NonRelocatableStringpool::internString(StringRef S) {
+  std::lock_guard<std::mutex> Lock(Mutex);
   std::pair<uint32_t, StringMapEntryBase *> Entry(0, nullptr);
   auto InsertResult = Strings.insert(std::make_pair(S, Entry));
   return InsertResult.first->getKey();
 }
 
+/// The diagnostics can be reported from several linking threads, make
+/// sure their lines don't get interleaved.
+static std::mutex DiagnosticsMutex;
+
 void warn(const Twine &Warning, const Twine &Context) {
+  std::lock_guard<std::mutex> Lock(DiagnosticsMutex);
   errs() << Twine("while processing ") + Context + ":\n";
   errs() << Twine("warning: ") + Warning + "\n";
 }
 
 bool error(const Twine &Error, const Twine &Context) {
+  std::lock_guard<std::mutex> Lock(DiagnosticsMutex);
   errs() << Twine("while processing ") + Context + ":\n";
   errs() << Twine("error: ") + Error + "\n";
   return false;
@@ -10,6 +10,7 @@
 #define LLVM_TOOLS_DSYMUTIL_NONRELOCATABLESTRINGPOOL_H
 
 #include "llvm/ADT/StringMap.h"
+#include <mutex>
 
 namespace llvm {
 namespace dsymutil {
@@ -20,6 +21,12 @@ namespace dsymutil {
 /// has relocation entries for every reference to it. This class
 /// provides this ablitity by just associating offsets with
 /// strings.
+///
+/// The pool can be shared by several threads: getStringOffset() and
+/// internString() can be called concurrently. The offsets are assigned
+/// in the order of the getStringOffset() calls though, so to get a
+/// deterministic output all those calls should come from a single
+/// thread.
 class NonRelocatableStringpool {
 public:
   /// \brief Entries are stored into the StringMap and simply linked
@@ -46,7 +53,8 @@ public:
   /// in place of \p S.
   StringRef internString(StringRef S);
 
-  // \brief Return the first entry of the string table.
+  // \brief Return the first entry of the string table. The entries must
+  // not be walked while strings are still being added to the pool.
   const MapTy::MapEntryTy *getFirstEntry() const {
     return getNextEntry(&Sentinel);
   }
@@ -60,6 +68,7 @@ public:
   uint64_t getSize() { return CurrentEndOffset; }
 
 private:
+  std::mutex Mutex;
   MapTy Strings;
   uint32_t CurrentEndOffset;
   MapTy::MapEntryTy Sentinel, *Last;
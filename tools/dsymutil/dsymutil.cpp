@@ -24,6 +24,7 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/thread.h"
 #include <cstdint>
 #include <string>
 
@@ -82,6 +83,17 @@ static opt<bool>
           desc("Do not use ODR (One Definition Rule) for type uniquing."),
           init(false), cat(DsymCategory));
 
+static opt<unsigned> NumThreads(
+    "num-threads",
+    desc("Specifies the maximum number (n) of simultaneous threads to use\n"
+         "while linking. The object files are loaded in parallel, and the\n"
+         "emission of each object overlaps with the analysis of the next\n"
+         "ones. The output doesn't depend on the number of threads.\n"
+         "0 means the number of available cores (default: 1)."),
+    value_desc("n"), init(1), cat(DsymCategory));
+static alias NumThreadsA("j", desc("Alias for --num-threads"),
+                         aliasopt(NumThreads));
+
 static opt<bool> DumpDebugMap(
     "dump-debug-map",
     desc("Parse and dump the debug map to standard output. Not DWARF link "
@@ -267,6 +279,12 @@ int main(int argc, char **argv) {
   Options.NoOutput = NoOutput;
   Options.NoODR = NoODR;
   Options.PrependPath = OsoPrependPath;
+  Options.Threads = NumThreads;
+  if (Options.Threads == 0)
+    Options.Threads = llvm::thread::hardware_concurrency();
+  // Keep the verbose output readable.
+  if (Verbose)
+    Options.Threads = 1;
 
   llvm::InitializeAllTargetInfos();
   llvm::InitializeAllTargetMCs();
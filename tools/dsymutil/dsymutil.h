@@ -28,9 +28,10 @@ struct LinkOptions {
   bool Verbose;  ///< Verbosity
   bool NoOutput; ///< Skip emitting output
   bool NoODR;    ///< Do not unique types according to ODR
+  unsigned Threads;        ///< Number of threads used for linking
   std::string PrependPath; ///< -oso-prepend-path
 
-  LinkOptions() : Verbose(false), NoOutput(false) {}
+  LinkOptions() : Verbose(false), NoOutput(false), Threads(1) {}
 };
 
 /// \brief Extract the DebugMaps from the given file.
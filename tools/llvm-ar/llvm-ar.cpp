@@ -30,6 +30,7 @@
 #include "llvm/Support/LineIterator.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
@@ -99,6 +100,20 @@ static cl::opt<Format>
                          clEnumValN(DARWIN, "darwin", "darwin"),
                          clEnumValN(BSD, "bsd", "bsd")));
 
+static cl::opt<bool>
+    InPlace("in-place", cl::init(false),
+            cl::desc("Update the archive in place, only writing the symbol "
+                     "table and the members that changed or moved. Not atomic: "
+                     "an interrupted update corrupts the archive"));
+
+static cl::opt<unsigned>
+    NumThreads("num-threads",
+               cl::desc("Maximum number of threads used to read the members "
+                        "when building the symbol table (0 = all cores)"),
+               cl::value_desc("n"), cl::init(1));
+static cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
+                             cl::aliasopt(NumThreads));
+
 static std::string Options;
 
 // Provide additional help output explaining the operations and modifiers of
@@ -683,7 +698,8 @@ performWriteOperation(ArchiveOperation Operation,
 
   std::error_code EC =
       writeArchive(ArchiveName, NewMembersP ? *NewMembersP : NewMembers, Symtab,
-                   Kind, Deterministic, Thin, std::move(OldArchiveBuf));
+                   Kind, Deterministic, Thin, std::move(OldArchiveBuf),
+                   InPlace);
   failIfError(EC, ArchiveName);
 }
 
@@ -870,6 +886,7 @@ int main(int argc, char **argv) {
     "LLVM Archiver (llvm-ar)\n\n"
     "  This program archives bitcode files into single libraries\n"
   );
+  parallel::setThreadCount(NumThreads);
 
   if (Stem.find("ranlib") != StringRef::npos)
     return ranlib_main();
@@ -23,6 +23,7 @@
 #include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
@@ -71,6 +72,14 @@ static opt<bool> Verify("verify", desc("Verify the DWARF debug info"),
                         cat(DwarfDumpCategory));
 static opt<bool> Quiet("quiet", desc("Use with -verify to not emit to STDOUT."),
                        cat(DwarfDumpCategory));
+static opt<unsigned>
+    NumThreads("num-threads",
+               desc("Specifies the maximum number (n) of simultaneous threads "
+                    "to use when extracting units and verifying "
+                    "(0 = all cores)."),
+               value_desc("n"), init(1), cat(DwarfDumpCategory));
+static alias NumThreadsAlias("j", desc("Alias for -num-threads"),
+                             aliasopt(NumThreads), cat(DwarfDumpCategory));
 static opt<bool> Verbose("verbose",
                          desc("Print more low-level encoding details"),
                          cat(DwarfDumpCategory));
@@ -90,6 +99,7 @@ static DIDumpOptions getDumpOpts() {
   DumpOpts.DumpType = DumpType;
   DumpOpts.SummarizeTypes = SummarizeTypes;
   DumpOpts.Verbose = Verbose;
+  DumpOpts.ParallelVerify = NumThreads != 1;
   return DumpOpts;
 }
 
@@ -204,6 +214,10 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  // Always set the count, so that the default of one thread also applies to
+  // unit extraction, which runs on the shared parallel executor.
+  parallel::setThreadCount(NumThreads);
+
   // Defaults to dumping all sections, unless brief mode is specified in which
   // case only the .debug_info section in dumped.
 #define HANDLE_DWARF_SECTION(ENUM_NAME, ELF_NAME, CMDLINE_NAME)                \
@@ -37,6 +37,7 @@
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Options.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
@@ -64,6 +65,17 @@ static opt<std::string> OutputFilename(Required, "o",
                                        value_desc("filename"),
                                        cat(DwpCategory));
 
+static opt<unsigned> NumThreads(
+    "num-threads",
+    desc("Specifies the maximum number (n) of simultaneous threads to use\n"
+         "while packaging. The inputs are read and decompressed in parallel\n"
+         "ahead of their emission, which stays in input order. The output\n"
+         "doesn't depend on the number of threads.\n"
+         "0 means the number of available cores (default: 1)."),
+    value_desc("n"), init(1), cat(DwpCategory));
+static alias NumThreadsA("j", desc("Alias for --num-threads"),
+                         aliasopt(NumThreads));
+
 static void writeStringsAndOffsets(MCStreamer &Out, DWPStringPool &Strings,
                                    MCSection *StrOffsetSection,
                                    StringRef CurStrSection,
@@ -388,41 +400,86 @@ handleCompressedSection(std::deque<SmallString<32>> &UncompressedSections,
   return Error::success();
 }
 
-static Error handleSection(
-    const StringMap<std::pair<MCSection *, DWARFSectionKind>> &KnownSections,
-    const MCSection *StrSection, const MCSection *StrOffsetSection,
-    const MCSection *TypesSection, const MCSection *CUIndexSection,
-    const MCSection *TUIndexSection, const SectionRef &Section, MCStreamer &Out,
-    std::deque<SmallString<32>> &UncompressedSections,
-    uint32_t (&ContributionOffsets)[8], UnitIndexEntry &CurEntry,
-    StringRef &CurStrSection, StringRef &CurStrOffsetSection,
-    std::vector<StringRef> &CurTypesSection, StringRef &InfoSection,
-    StringRef &AbbrevSection, StringRef &CurCUIndexSection,
-    StringRef &CurTUIndexSection) {
-  if (Section.isBSS())
-    return Error::success();
+/// A section of an input that is copied to the package.
+struct InputSection {
+  MCSection *OutSection;
+  DWARFSectionKind Kind;
+  StringRef Contents;
+};
 
-  if (Section.isVirtual())
-    return Error::success();
+/// An input file, read and decompressed ahead of its emission.
+struct LoadedInput {
+  LoadedInput(
+      StringRef Input,
+      const StringMap<std::pair<MCSection *, DWARFSectionKind>> &KnownSections)
+      : Err(load(Input, KnownSections)) {}
+  /// Inputs loaded past the first error are dropped without being emitted.
+  ~LoadedInput() { consumeError(std::move(Err)); }
+
+  OwningBinary<ObjectFile> Obj;
+  std::deque<SmallString<32>> UncompressedSections;
+  /// The known sections of the input, in section order.
+  std::vector<InputSection> Sections;
+  /// The result of loading the input. Declared last, as loading fills in the
+  /// members above.
+  Error Err;
+
+private:
+  Error load(StringRef Input,
+             const StringMap<std::pair<MCSection *, DWARFSectionKind>>
+                 &KnownSections);
+};
 
-  StringRef Name;
-  if (std::error_code Err = Section.getName(Name))
-    return errorCodeToError(Err);
+Error LoadedInput::load(
+    StringRef Input,
+    const StringMap<std::pair<MCSection *, DWARFSectionKind>> &KnownSections) {
+  auto ErrOrObj = object::ObjectFile::createObjectFile(Input);
+  if (!ErrOrObj)
+    return ErrOrObj.takeError();
+  Obj = std::move(*ErrOrObj);
 
-  StringRef Contents;
-  if (auto Err = Section.getContents(Contents))
-    return errorCodeToError(Err);
+  for (const auto &Section : Obj.getBinary()->sections()) {
+    if (Section.isBSS())
+      continue;
 
-  if (auto Err = handleCompressedSection(UncompressedSections, Name, Contents))
-    return Err;
+    if (Section.isVirtual())
+      continue;
 
-  Name = Name.substr(Name.find_first_not_of("._"));
+    StringRef Name;
+    if (std::error_code Err = Section.getName(Name))
+      return errorCodeToError(Err);
 
-  auto SectionPair = KnownSections.find(Name);
-  if (SectionPair == KnownSections.end())
-    return Error::success();
+    StringRef Contents;
+    if (auto Err = Section.getContents(Contents))
+      return errorCodeToError(Err);
 
-  if (DWARFSectionKind Kind = SectionPair->second.second) {
+    if (auto Err =
+            handleCompressedSection(UncompressedSections, Name, Contents))
+      return Err;
+
+    Name = Name.substr(Name.find_first_not_of("._"));
+
+    auto SectionPair = KnownSections.find(Name);
+    if (SectionPair == KnownSections.end())
+      continue;
+
+    Sections.push_back(
+        {SectionPair->second.first, SectionPair->second.second, Contents});
+  }
+  return Error::success();
+}
+
+static void handleSection(
+    const MCSection *StrSection, const MCSection *StrOffsetSection,
+    const MCSection *TypesSection, const MCSection *CUIndexSection,
+    const MCSection *TUIndexSection, const InputSection &Section,
+    MCStreamer &Out, uint32_t (&ContributionOffsets)[8],
+    UnitIndexEntry &CurEntry, StringRef &CurStrSection,
+    StringRef &CurStrOffsetSection, std::vector<StringRef> &CurTypesSection,
+    StringRef &InfoSection, StringRef &AbbrevSection,
+    StringRef &CurCUIndexSection, StringRef &CurTUIndexSection) {
+  StringRef Contents = Section.Contents;
+  if (DWARFSectionKind Kind = Section.Kind) {
     auto Index = Kind - DW_SECT_INFO;
     if (Kind != DW_SECT_TYPES) {
       CurEntry.Contributions[Index].Offset = ContributionOffsets[Index];
@@ -442,7 +499,7 @@ static Error handleSection(
     }
   }
 
-  MCSection *OutSection = SectionPair->second.first;
+  MCSection *OutSection = Section.OutSection;
   if (OutSection == StrOffsetSection)
     CurStrOffsetSection = Contents;
   else if (OutSection == StrSection)
@@ -457,7 +514,6 @@ static Error handleSection(
     Out.SwitchSection(OutSection);
     Out.EmitBytes(Contents);
   }
-  return Error::success();
 }
 
 static Error
@@ -524,18 +580,29 @@ static Error write(MCStreamer &Out, ArrayRef<std::string> Inputs) {
 
   DWPStringPool Strings(Out, StrSection);
 
-  SmallVector<OwningBinary<object::ObjectFile>, 128> Objects;
-  Objects.reserve(Inputs.size());
-
-  std::deque<SmallString<32>> UncompressedSections;
-
-  for (const auto &Input : Inputs) {
-    auto ErrOrObj = object::ObjectFile::createObjectFile(Input);
-    if (!ErrOrObj)
-      return ErrOrObj.takeError();
+  // Inputs are read and decompressed in parallel, a window at a time, and
+  // then emitted in order. Only the inputs of the current window are kept in
+  // memory: everything that outlives the emission of an input is copied.
+  const size_t WindowSize = 4 * parallel::getThreadCount();
+  std::vector<std::unique_ptr<LoadedInput>> Window;
+
+  for (size_t InputIndex = 0; InputIndex != Inputs.size(); ++InputIndex) {
+    size_t WindowIndex = InputIndex % WindowSize;
+    if (WindowIndex == 0) {
+      size_t Count = std::min(WindowSize, Inputs.size() - InputIndex);
+      Window.clear();
+      Window.resize(Count);
+      parallel::for_each_n(parallel::par, size_t(0), Count, [&](size_t I) {
+        Window[I] = llvm::make_unique<LoadedInput>(Inputs[InputIndex + I],
+                                                   KnownSections);
+      });
+    }
 
-    auto &Obj = *ErrOrObj->getBinary();
-    Objects.push_back(std::move(*ErrOrObj));
+    StringRef Input = Inputs[InputIndex];
+    LoadedInput &Loaded = *Window[WindowIndex];
+    if (Loaded.Err)
+      return std::move(Loaded.Err);
+    auto &Obj = *Loaded.Obj.getBinary();
 
     UnitIndexEntry CurEntry = {};
 
@@ -547,14 +614,12 @@ static Error write(MCStreamer &Out, ArrayRef<std::string> Inputs) {
     StringRef CurCUIndexSection;
     StringRef CurTUIndexSection;
 
-    for (const auto &Section : Obj.sections())
-      if (auto Err = handleSection(
-              KnownSections, StrSection, StrOffsetSection, TypesSection,
-              CUIndexSection, TUIndexSection, Section, Out,
-              UncompressedSections, ContributionOffsets, CurEntry,
-              CurStrSection, CurStrOffsetSection, CurTypesSection, InfoSection,
-              AbbrevSection, CurCUIndexSection, CurTUIndexSection))
-        return Err;
+    for (const InputSection &Section : Loaded.Sections)
+      handleSection(StrSection, StrOffsetSection, TypesSection, CUIndexSection,
+                    TUIndexSection, Section, Out, ContributionOffsets,
+                    CurEntry, CurStrSection, CurStrOffsetSection,
+                    CurTypesSection, InfoSection, AbbrevSection,
+                    CurCUIndexSection, CurTUIndexSection);
 
     if (InfoSection.empty())
       continue;
@@ -650,6 +715,8 @@ int main(int argc, char **argv) {
 
   ParseCommandLineOptions(argc, argv, "merge split dwarf (.dwo) files");
 
+  parallel::setThreadCount(NumThreads);
+
   llvm::InitializeAllTargetInfos();
   llvm::InitializeAllTargetMCs();
   llvm::InitializeAllTargets();
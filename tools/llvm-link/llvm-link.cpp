@@ -207,8 +207,10 @@ static void diagnosticHandler(const DiagnosticInfo &DI, void *C) {
 static bool importFunctions(const char *argv0, Module &DestModule) {
   if (SummaryIndex.empty())
     return true;
+  // Only the summaries of the imported values and their references are used,
+  // so decode them on demand.
   std::unique_ptr<ModuleSummaryIndex> Index =
-      ExitOnErr(llvm::getModuleSummaryIndexForFile(SummaryIndex));
+      ExitOnErr(llvm::getLazyModuleSummaryIndexForFile(SummaryIndex));
 
   // Map of Module -> List of globals to import from the Module
   FunctionImporter::ImportMapTy ImportList;
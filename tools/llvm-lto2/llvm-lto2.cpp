@@ -23,6 +23,7 @@
 #include "llvm/LTO/LTO.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/Threading.h"
 
@@ -68,6 +69,11 @@ static cl::opt<bool>
 static cl::opt<int> Threads("thinlto-threads",
                             cl::init(llvm::heavyweight_hardware_concurrency()));
 
+static cl::opt<unsigned>
+    Partitions("lto-partitions", cl::init(1),
+               cl::desc("Number of parallel code generation partitions for "
+                        "regular LTO"));
+
 static cl::list<std::string> SymbolResolutions(
     "r",
     cl::desc("Specify a symbol resolution: filename,symbolname,resolution\n"
@@ -246,7 +252,7 @@ static int run(int argc, char **argv) {
     Backend = createWriteIndexesThinBackend("", "", true, "");
   else
     Backend = createInProcessThinBackend(Threads);
-  LTO Lto(std::move(Conf), std::move(Backend));
+  LTO Lto(std::move(Conf), std::move(Backend), Partitions);
 
   bool HasErrors = false;
   for (std::string F : InputFilenames) {
@@ -380,6 +386,8 @@ static int dumpSymtab(int argc, char **argv) {
 }
 
 int main(int argc, char **argv) {
+  llvm_shutdown_obj Y; // Call llvm_shutdown() on exit.
+
   InitializeAllTargets();
   InitializeAllTargetMCs();
   InitializeAllAsmPrinters();
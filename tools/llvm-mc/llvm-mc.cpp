@@ -66,6 +66,21 @@ static cl::opt<DebugCompressionType> CompressDebugSections(
                clEnumValN(DebugCompressionType::GNU, "zlib-gnu",
                           "Use zlib-gnu compression (deprecated)")));
 
+static cl::opt<DebugCompressionLevel> CompressDebugSectionsLevel(
+    "debug-compression-level", cl::init(DebugCompressionLevel::Default),
+    cl::desc("Trade compression speed for size of DWARF debug sections:"),
+    cl::values(clEnumValN(DebugCompressionLevel::Speed, "speed",
+                          "Compress as fast as possible"),
+               clEnumValN(DebugCompressionLevel::Default, "default",
+                          "Balance speed and size"),
+               clEnumValN(DebugCompressionLevel::Size, "size",
+                          "Compress as much as possible")));
+
+static cl::opt<bool> ParallelDebugCompression(
+    "parallel-debug-compression",
+    cl::desc("Compress large DWARF debug sections in chunks on several "
+             "threads"));
+
 static cl::opt<bool>
 ShowInst("show-inst", cl::desc("Show internal instruction representation"));
 
@@ -489,6 +504,8 @@ int main(int argc, char **argv) {
       return 1;
     }
     MAI->setCompressDebugSections(CompressDebugSections);
+    MAI->setDebugCompressionLevel(CompressDebugSectionsLevel);
+    MAI->setParallelDebugCompression(ParallelDebugCompression);
   }
   MAI->setPreserveAsmComments(PreserveComments);
 
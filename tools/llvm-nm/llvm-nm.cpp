@@ -18,6 +18,7 @@
 
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/BinaryFormat/COFF.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Demangle/Demangle.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalAlias.h"
@@ -29,6 +30,7 @@
 #include "llvm/Object/COFFImportFile.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/IRObjectFile.h"
+#include "llvm/Object/IRSymtab.h"
 #include "llvm/Object/MachO.h"
 #include "llvm/Object/MachOUniversal.h"
 #include "llvm/Object/ObjectFile.h"
@@ -38,6 +40,7 @@
 #include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Signals.h"
@@ -186,6 +189,12 @@ cl::opt<bool> DyldInfoOnly("dyldinfo-only",
 cl::opt<bool> NoLLVMBitcode("no-llvm-bc",
                             cl::desc("Disable LLVM bitcode reader"));
 
+cl::opt<unsigned>
+    NumThreads("num-threads",
+               cl::desc("Maximum number of threads used to read the members "
+                        "of archives (0 = all cores)"),
+               cl::value_desc("n"), cl::init(1));
+
 bool PrintAddress = true;
 
 bool MultipleFiles = false;
@@ -266,7 +275,8 @@ struct NMSymbol {
   // for Mach-O when we are creating symbols from the dyld info the above
   // pointer is null as there is no native symbol.  In these cases the fields
   // below are filled in to represent what would have been a Mach-O nlist
-  // native symbol.
+  // native symbol.  Symbols read from the irsymtab of a bitcode file have no
+  // native symbol either, and only fill in SymFlags.
   uint32_t SymFlags;
   SectionRef Section;
   uint8_t NType;
@@ -276,9 +286,16 @@ struct NMSymbol {
 };
 } // anonymous namespace
 
+// Symbols that have no native symbol carry their flags in SymFlags.
+static uint32_t getSymbolFlags(const NMSymbol &S) {
+  if (S.Sym.getRawDataRefImpl().p)
+    return S.Sym.getFlags();
+  return S.SymFlags;
+}
+
 static bool compareSymbolAddress(const NMSymbol &A, const NMSymbol &B) {
-  bool ADefined = !(A.Sym.getFlags() & SymbolRef::SF_Undefined);
-  bool BDefined = !(B.Sym.getFlags() & SymbolRef::SF_Undefined);
+  bool ADefined = !(getSymbolFlags(A) & SymbolRef::SF_Undefined);
+  bool BDefined = !(getSymbolFlags(B) & SymbolRef::SF_Undefined);
   return std::make_tuple(ADefined, A.Address, A.Name, A.Size) <
          std::make_tuple(BDefined, B.Address, B.Name, B.Size);
 }
@@ -690,9 +707,14 @@ static bool symbolIsDefined(const NMSymbol &Sym) {
   return Sym.TypeChar != 'U' && Sym.TypeChar != 'w' && Sym.TypeChar != 'v';
 }
 
-static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
+// Obj is null if the symbols were read from an irsymtab.
+static void sortAndPrintSymbolList(SymbolicFile *Obj, bool Is64Bit,
+                                   bool printName,
                                    const std::string &ArchiveName,
                                    const std::string &ArchitectureName) {
+  bool IsIR = !Obj || Obj->isIR();
+  MachOObjectFile *MachO = dyn_cast_or_null<MachOObjectFile>(Obj);
+
   if (!NoSort) {
     std::function<bool(const NMSymbol &, const NMSymbol &)> Cmp;
     if (NumericSort)
@@ -714,7 +736,7 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
       outs() << "\n" << CurrentFilename << ":\n";
     } else if (OutputFormat == sysv) {
       outs() << "\n\nSymbols from " << CurrentFilename << ":\n\n";
-      if (isSymbolList64Bit(Obj))
+      if (Is64Bit)
         outs() << "Name                  Value           Class        Type"
                << "         Size             Line  Section\n";
       else
@@ -724,7 +746,7 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
   }
 
   const char *printBlanks, *printDashes, *printFormat;
-  if (isSymbolList64Bit(Obj)) {
+  if (Is64Bit) {
     printBlanks = "                ";
     printDashes = "----------------";
     switch (AddressRadix) {
@@ -754,17 +776,12 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
 
   for (SymbolListT::iterator I = SymbolList.begin(), E = SymbolList.end();
        I != E; ++I) {
-    uint32_t SymFlags;
     std::string Name = I->Name.str();
-    MachOObjectFile *MachO = dyn_cast<MachOObjectFile>(&Obj);
     if (Demangle) {
       if (Optional<std::string> Opt = demangle(I->Name, MachO))
         Name = *Opt;
     }
-    if (I->Sym.getRawDataRefImpl().p)
-      SymFlags = I->Sym.getFlags();
-    else
-      SymFlags = I->SymFlags;
+    uint32_t SymFlags = getSymbolFlags(*I);
 
     bool Undefined = SymFlags & SymbolRef::SF_Undefined;
     bool Global = SymFlags & SymbolRef::SF_Global;
@@ -807,7 +824,7 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
 
     // Otherwise, print the symbol address and size.
     if (symbolIsDefined(*I)) {
-      if (Obj.isIR())
+      if (IsIR)
         strcpy(SymbolAddrStr, printDashes);
       else if(MachO && I->TypeChar == 'I')
         strcpy(SymbolAddrStr, printBlanks);
@@ -822,8 +839,9 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
     // nm(1) -m output or hex, else if OutputFormat is darwin or we are
     // printing Mach-O symbols in hex and not a Mach-O object fall back to
     // OutputFormat bsd (see below).
-    if ((OutputFormat == darwin || FormatMachOasHex) && (MachO || Obj.isIR())) {
-      darwinPrintSymbol(Obj, I, SymbolAddrStr, printBlanks, printDashes,
+    if ((OutputFormat == darwin || FormatMachOasHex) && (MachO || IsIR)) {
+      assert(Obj && "irsymtab symbols can't be printed in the darwin format");
+      darwinPrintSymbol(*Obj, I, SymbolAddrStr, printBlanks, printDashes,
                         printFormat);
     } else if (OutputFormat == posix) {
       outs() << Name << " " << I->TypeChar << " ";
@@ -1580,7 +1598,158 @@ dumpSymbolNamesFromObject(SymbolicFile &Obj, bool printName,
   }
 
   CurrentFilename = Obj.getFileName();
-  sortAndPrintSymbolList(Obj, printName, ArchiveName, ArchitectureName);
+  sortAndPrintSymbolList(&Obj, isSymbolList64Bit(Obj), printName, ArchiveName,
+                         ArchitectureName);
+}
+
+// Whether the symbols of bitcode files can be read from their irsymtab. It
+// records less than an IRObjectFile provides, and in particular not which
+// symbols are constants, which only the Mach-O specific output uses.
+static bool canUseIRSymtab() {
+  return !NoLLVMBitcode && !DynamicSyms && OutputFormat != darwin &&
+         !FormatMachOasHex;
+}
+
+// Returns the irsymtab of Buf if it is a bitcode file whose symbols are
+// printed the same from its irsymtab as from an IRObjectFile. Reading the
+// irsymtab doesn't require parsing the module.
+static Optional<IRSymtabFile> readUsableIRSymtab(MemoryBufferRef Buf) {
+  if (!canUseIRSymtab() ||
+      identify_magic(Buf.getBuffer()) != file_magic::bitcode)
+    return None;
+  Expected<IRSymtabFile> FOrErr = readIRSymtab(Buf);
+  if (!FOrErr) {
+    // Leave it to the bitcode reader to report the error.
+    consumeError(FOrErr.takeError());
+    return None;
+  }
+  // The type of constants depends on SF_Const on Darwin.
+  if (Triple(FOrErr->TheReader.getTargetTriple()).isOSDarwin())
+    return None;
+  return std::move(*FOrErr);
+}
+
+// The flags ModuleSymbolTable would compute for Sym, except SF_Const.
+static uint32_t getIRSymtabSymbolFlags(const irsymtab::Symbol &Sym) {
+  uint32_t Flags = SymbolRef::SF_None;
+  if (Sym.isUndefined())
+    Flags |= SymbolRef::SF_Undefined;
+  else if (Sym.getVisibility() == GlobalValue::HiddenVisibility &&
+           Sym.isGlobal())
+    Flags |= SymbolRef::SF_Hidden;
+  if (Sym.isExecutable())
+    Flags |= SymbolRef::SF_Executable;
+  if (Sym.isIndirect())
+    Flags |= SymbolRef::SF_Indirect;
+  if (Sym.isFormatSpecific())
+    Flags |= SymbolRef::SF_FormatSpecific;
+  if (Sym.isGlobal())
+    Flags |= SymbolRef::SF_Global;
+  if (Sym.isCommon())
+    Flags |= SymbolRef::SF_Common;
+  if (Sym.isWeak())
+    Flags |= SymbolRef::SF_Weak;
+  return Flags;
+}
+
+// This is what getNMTypeChar returns for the symbols of an IRObjectFile that
+// isn't for Darwin.
+static char getIRSymtabNMTypeChar(uint32_t Symflags) {
+  if (Symflags & SymbolRef::SF_Weak)
+    return (Symflags & SymbolRef::SF_Undefined) ? 'w' : 'W';
+  if (Symflags & SymbolRef::SF_Undefined)
+    return 'U';
+  if (Symflags & SymbolRef::SF_Common)
+    return 'C';
+  char Ret = (Symflags & SymbolRef::SF_Executable) ? 't' : 'd';
+  if (Symflags & SymbolRef::SF_Global)
+    Ret = toupper(Ret);
+  return Ret;
+}
+
+static void
+dumpSymbolNamesFromIRSymtab(const irsymtab::Reader &Reader, StringRef FileName,
+                            bool printName,
+                            const std::string &ArchiveName = std::string()) {
+  for (const irsymtab::Reader::SymbolRef &Sym : Reader.symbols()) {
+    uint32_t SymFlags = getIRSymtabSymbolFlags(Sym);
+    if (!DebugSyms && (SymFlags & SymbolRef::SF_FormatSpecific))
+      continue;
+    if (WithoutAliases && (SymFlags & SymbolRef::SF_Indirect))
+      continue;
+    NMSymbol S;
+    memset(&S, '\0', sizeof(S));
+    S.TypeChar = getIRSymtabNMTypeChar(SymFlags);
+    S.Name = Sym.getName();
+    S.SymFlags = SymFlags;
+    SymbolList.push_back(S);
+  }
+
+  CurrentFilename = FileName;
+  sortAndPrintSymbolList(nullptr,
+                         Triple(Reader.getTargetTriple()).isArch64Bit(),
+                         printName, ArchiveName, std::string());
+}
+
+namespace {
+/// An archive member, read ahead of printing its symbols. Members are read in
+/// parallel, so each one owns everything needed to read it.
+struct LoadedMember {
+  LoadedMember(const Archive::Child &C) : Err(load(C)) {}
+  ~LoadedMember() { consumeError(std::move(Err)); }
+
+  std::unique_ptr<MemoryBuffer> ThinBuffer;
+  std::unique_ptr<LLVMContext> Context;
+  /// Set if the symbols are read from the irsymtab of the member.
+  Optional<IRSymtabFile> IRSymtab;
+  StringRef Name;
+  /// Set otherwise.
+  std::unique_ptr<Binary> Bin;
+  Error Err;
+
+private:
+  Error load(const Archive::Child &C);
+};
+} // anonymous namespace
+
+Error LoadedMember::load(const Archive::Child &C) {
+  Expected<StringRef> NameOrErr = C.getName();
+  if (!NameOrErr)
+    return NameOrErr.takeError();
+  Name = *NameOrErr;
+
+  StringRef Data;
+  if (C.getParent()->isThin()) {
+    // Child::getBuffer would keep the member in the archive, which isn't
+    // thread-safe. Map it here instead.
+    Expected<std::string> FullNameOrErr = C.getFullName();
+    if (!FullNameOrErr)
+      return FullNameOrErr.takeError();
+    ErrorOr<std::unique_ptr<MemoryBuffer>> BufOrErr =
+        MemoryBuffer::getFile(*FullNameOrErr);
+    if (std::error_code EC = BufOrErr.getError())
+      return errorCodeToError(EC);
+    ThinBuffer = std::move(*BufOrErr);
+    Data = ThinBuffer->getBuffer();
+  } else {
+    Expected<StringRef> DataOrErr = C.getBuffer();
+    if (!DataOrErr)
+      return DataOrErr.takeError();
+    Data = *DataOrErr;
+  }
+  MemoryBufferRef Buf(Data, Name);
+
+  IRSymtab = readUsableIRSymtab(Buf);
+  if (IRSymtab)
+    return Error::success();
+
+  Context = llvm::make_unique<LLVMContext>();
+  Expected<std::unique_ptr<Binary>> BinOrErr =
+      createBinary(Buf, Context.get());
+  if (!BinOrErr)
+    return BinOrErr.takeError();
+  Bin = std::move(*BinOrErr);
+  return Error::success();
 }
 
 // checkMachOAndArchFlags() checks to see if the SymbolicFile is a Mach-O file
@@ -1623,6 +1792,13 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
   if (error(BufferOrErr.getError(), Filename))
     return;
 
+  MemoryBufferRef Buffer = BufferOrErr.get()->getMemBufferRef();
+  if (Optional<IRSymtabFile> IRSymtab = readUsableIRSymtab(Buffer)) {
+    dumpSymbolNamesFromIRSymtab(IRSymtab->TheReader,
+                                Buffer.getBufferIdentifier(), true);
+    return;
+  }
+
   LLVMContext Context;
   Expected<std::unique_ptr<Binary>> BinaryOrErr = createBinary(
       BufferOrErr.get()->getMemBufferRef(), NoLLVMBitcode ? nullptr : &Context);
@@ -1656,21 +1832,47 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
 
     {
       Error Err = Error::success();
-      for (auto &C : A->children(Err)) {
-        Expected<std::unique_ptr<Binary>> ChildOrErr = C.getAsBinary(&Context);
-        if (!ChildOrErr) {
-          if (auto E = isNotObjectErrorInvalidFileType(ChildOrErr.takeError()))
-            error(std::move(E), Filename, C);
-          continue;
-        }
-        if (SymbolicFile *O = dyn_cast<SymbolicFile>(&*ChildOrErr.get())) {
+      std::vector<Archive::Child> Children;
+      for (auto &C : A->children(Err))
+        Children.push_back(C);
+
+      // The members are read in parallel, a window at a time, and their
+      // symbols are printed in order.
+      const size_t WindowSize = 4 * parallel::getThreadCount();
+      for (size_t Begin = 0; Begin < Children.size(); Begin += WindowSize) {
+        size_t Count = std::min(WindowSize, Children.size() - Begin);
+        std::vector<std::unique_ptr<LoadedMember>> Window(Count);
+        parallel::for_each_n(parallel::par, size_t(0), Count, [&](size_t I) {
+          Window[I] = llvm::make_unique<LoadedMember>(Children[Begin + I]);
+        });
+
+        for (size_t I = 0; I != Count; ++I) {
+          const Archive::Child &C = Children[Begin + I];
+          LoadedMember &M = *Window[I];
+          if (M.Err) {
+            if (auto E = isNotObjectErrorInvalidFileType(std::move(M.Err)))
+              error(std::move(E), Filename, C);
+            continue;
+          }
+          if (M.IRSymtab) {
+            if (!PrintFileName)
+              outs() << "\n" << M.Name << ":\n";
+            dumpSymbolNamesFromIRSymtab(M.IRSymtab->TheReader, M.Name, false,
+                                        Filename);
+            continue;
+          }
+          SymbolicFile *O = dyn_cast<SymbolicFile>(M.Bin.get());
+          if (!O)
+            continue;
           if (!MachOPrintSizeWarning && PrintSize &&  isa<MachOObjectFile>(O)) {
             errs() << ToolName << ": warning sizes with -print-size for Mach-O "
                       "files are always zero.\n";
             MachOPrintSizeWarning = true;
           }
-          if (!checkMachOAndArchFlags(O, Filename))
+          if (!checkMachOAndArchFlags(O, Filename)) {
+            consumeError(std::move(Err));
             return;
+          }
           if (!PrintFileName) {
             outs() << "\n";
             if (isa<MachOObjectFile>(O)) {
@@ -1924,6 +2126,7 @@ int main(int argc, char **argv) {
 
   llvm_shutdown_obj Y; // Call llvm_shutdown() on exit.
   cl::ParseCommandLineOptions(argc, argv, "llvm symbol table dumper\n");
+  parallel::setThreadCount(NumThreads);
 
   // llvm-nm only reads binary files.
   if (error(sys::ChangeStdinToBinary()))
@@ -8,11 +8,35 @@
 //===----------------------------------------------------------------------===//
 #include "Object.h"
 #include "llvm-objcopy.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Parallel.h"
 
 using namespace llvm;
 using namespace object;
 using namespace ELF;
 
+static cl::opt<unsigned>
+    CopyChunkSize("copy-chunk-size", cl::Hidden, cl::init(1 << 20),
+                  cl::desc("size of the chunks of a section or segment that "
+                           "are copied concurrently"));
+
+// Copies Contents, which is mapped from the input file, to Buf. Large
+// contents are split into chunks that are copied concurrently.
+static void copyContents(ArrayRef<uint8_t> Contents, uint8_t *Buf) {
+  const size_t ChunkSize = std::max<size_t>(1, CopyChunkSize);
+  size_t NumChunks = divideCeil(Contents.size(), ChunkSize);
+  if (NumChunks <= 1 || parallel::getThreadCount() == 1) {
+    std::copy(std::begin(Contents), std::end(Contents), Buf);
+    return;
+  }
+  parallel::for_each_n(parallel::par, size_t(0), NumChunks, [&](size_t I) {
+    ArrayRef<uint8_t> Chunk = Contents.slice(I * ChunkSize);
+    Chunk = Chunk.take_front(ChunkSize);
+    std::copy(std::begin(Chunk), std::end(Chunk), Buf + I * ChunkSize);
+  });
+}
+
 template <class ELFT> void Segment::writeHeader(FileOutputBuffer &Out) const {
   typedef typename ELFT::Ehdr Elf_Ehdr;
   typedef typename ELFT::Phdr Elf_Phdr;
@@ -46,7 +70,7 @@ void Segment::writeSegment(FileOutputBuffer &Out) const {
   uint8_t *Buf = Out.getBufferStart() + Offset;
   // We want to maintain segments' interstitial data and contents exactly.
   // This lets us just copy segments directly.
-  std::copy(std::begin(Contents), std::end(Contents), Buf);
+  copyContents(Contents, Buf);
 }
 
 void SectionBase::finalize() {}
@@ -72,7 +96,7 @@ void Section::writeSection(FileOutputBuffer &Out) const {
   if (Type == SHT_NOBITS)
     return;
   uint8_t *Buf = Out.getBufferStart() + Offset;
-  std::copy(std::begin(Contents), std::end(Contents), Buf);
+  copyContents(Contents, Buf);
 }
 
 void StringTableSection::addString(StringRef Name) {
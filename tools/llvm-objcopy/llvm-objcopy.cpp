@@ -10,6 +10,7 @@
 #include "Object.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileOutputBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/ToolOutputFile.h"
@@ -56,6 +57,11 @@ cl::opt<std::string> OutputFilename(cl::Positional, cl::desc("<output>"),
 cl::opt<std::string>
     OutputFormat("O", cl::desc("set output format to one of the following:"
                                "\n\tbinary"));
+cl::opt<unsigned>
+    NumThreads("num-threads",
+               cl::desc("maximum number of threads used to copy large "
+                        "sections (0 = all cores)"),
+               cl::value_desc("n"), cl::init(1));
 
 void CopyBinary(const ELFObjectFile<ELF64LE> &ObjFile) {
   std::unique_ptr<FileOutputBuffer> Buffer;
@@ -90,6 +96,7 @@ int main(int argc, char **argv) {
   llvm_shutdown_obj Y; // Call llvm_shutdown() on exit.
   cl::ParseCommandLineOptions(argc, argv, "llvm objcopy utility\n");
   ToolName = argv[0];
+  parallel::setThreadCount(NumThreads);
   if (InputFilename.empty()) {
     cl::PrintHelpMessage();
     return 2;
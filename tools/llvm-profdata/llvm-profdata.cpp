@@ -23,6 +23,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -32,6 +33,7 @@
 #include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <queue>
 
 using namespace llvm;
 
@@ -129,15 +131,17 @@ struct WriterContext {
         ErrLock(ErrLock), WriterErrorCodes(WriterErrorCodes) {}
 };
 
-/// Load an input into a writer context.
-static void loadInput(const WeightedFile &Input, WriterContext *WC) {
+/// Load an input into a writer context. Diagnostics refer to the input as
+/// \p Name.
+static void loadInput(const WeightedFile &Input, StringRef Name,
+                      WriterContext *WC) {
   std::unique_lock<std::mutex> CtxGuard{WC->Lock};
 
   // If there's a pending hard error, don't do more work.
   if (WC->Err)
     return;
 
-  WC->ErrWhence = Input.Filename;
+  WC->ErrWhence = Name;
 
   auto ReaderOrErr = InstrProfReader::create(Input.Filename);
   if (Error E = ReaderOrErr.takeError()) {
@@ -170,8 +174,8 @@ static void loadInput(const WeightedFile &Input, WriterContext *WC) {
       instrprof_error IPE = InstrProfError::take(std::move(E));
       std::unique_lock<std::mutex> ErrGuard{WC->ErrLock};
       bool firstTime = WC->WriterErrorCodes.insert(IPE).second;
-      handleMergeWriterError(make_error<InstrProfError>(IPE), Input.Filename,
-                             FuncName, firstTime);
+      handleMergeWriterError(make_error<InstrProfError>(IPE), Name, FuncName,
+                             firstTime);
     });
   }
   if (Reader->hasError())
@@ -180,6 +184,24 @@ static void loadInput(const WeightedFile &Input, WriterContext *WC) {
 
 /// Merge the \p Src writer context into \p Dst.
 static void mergeWriterContexts(WriterContext *Dst, WriterContext *Src) {
+  // If there's a pending hard error, don't do more work.
+  if (Dst->Err || Src->Err)
+    return;
+
+  // A context that only got empty profiles does not know the profile kind.
+  InstrProfWriter::ProfKind SrcKind = Src->Writer.getProfileKind();
+  if (SrcKind != InstrProfWriter::PF_Unknown) {
+    if (Error E = Dst->Writer.setIsIRLevelProfile(
+            SrcKind == InstrProfWriter::PF_IRLevel)) {
+      consumeError(std::move(E));
+      Dst->Err = make_error<StringError>(
+          "Merge IR generated profile with Clang generated profile.",
+          std::error_code());
+      Dst->ErrWhence = Src->ErrWhence;
+      return;
+    }
+  }
+
   bool Reported = false;
   Dst->Writer.mergeRecordsFromWriter(std::move(Src->Writer), [&](Error E) {
     if (Reported) {
@@ -191,24 +213,16 @@ static void mergeWriterContexts(WriterContext *Dst, WriterContext *Src) {
   });
 }
 
-static void mergeInstrProfile(const WeightedFileVector &Inputs,
-                              StringRef OutputFilename,
-                              ProfileFormat OutputFormat, bool OutputSparse,
-                              unsigned NumThreads) {
-  if (OutputFilename.compare("-") == 0)
-    exitWithError("Cannot write indexed profdata format to stdout.");
-
-  if (OutputFormat != PF_Binary && OutputFormat != PF_Text)
-    exitWithError("Unknown format is specified.");
-
-  std::error_code EC;
-  raw_fd_ostream Output(OutputFilename.data(), EC, sys::fs::F_None);
-  if (EC)
-    exitWithErrorCode(EC, OutputFilename);
-
-  std::mutex ErrorLock;
-  SmallSet<instrprof_error, 4> WriterErrorCodes;
-
+/// Load \p Inputs using up to \p NumThreads writer contexts and merge them
+/// together. Diagnostics refer to each input by its entry in \p Names.
+/// Returns the context holding the merged records. Hard errors encountered
+/// while loading or merging are fatal.
+static std::unique_ptr<WriterContext>
+loadAndMergeInputs(const WeightedFileVector &Inputs,
+                   ArrayRef<std::string> Names, bool OutputSparse,
+                   unsigned NumThreads, std::mutex &ErrorLock,
+                   SmallSet<instrprof_error, 4> &WriterErrorCodes) {
+  assert(Inputs.size() == Names.size() && "Expected a name for each input");
   // If NumThreads is not specified, auto-detect a good default.
   if (NumThreads == 0)
     NumThreads = std::max(1U, std::min(std::thread::hardware_concurrency(),
@@ -221,15 +235,16 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
         OutputSparse, ErrorLock, WriterErrorCodes));
 
   if (NumThreads == 1) {
-    for (const auto &Input : Inputs)
-      loadInput(Input, Contexts[0].get());
+    for (unsigned I = 0, E = Inputs.size(); I != E; ++I)
+      loadInput(Inputs[I], Names[I], Contexts[0].get());
   } else {
     ThreadPool Pool(NumThreads);
 
     // Load the inputs in parallel (N/NumThreads serial steps).
     unsigned Ctx = 0;
-    for (const auto &Input : Inputs) {
-      Pool.async(loadInput, Input, Contexts[Ctx].get());
+    for (unsigned I = 0, E = Inputs.size(); I != E; ++I) {
+      Pool.async(loadInput, Inputs[I], StringRef(Names[I]),
+                 Contexts[Ctx].get());
       Ctx = (Ctx + 1) % NumThreads;
     }
     Pool.wait();
@@ -258,7 +273,80 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
     if (WC->Err)
       exitWithError(std::move(WC->Err), WC->ErrWhence);
 
-  InstrProfWriter &Writer = Contexts[0]->Writer;
+  return std::move(Contexts[0]);
+}
+
+static void mergeInstrProfile(const WeightedFileVector &Inputs,
+                              StringRef OutputFilename,
+                              ProfileFormat OutputFormat, bool OutputSparse,
+                              unsigned NumThreads, unsigned BatchSize) {
+  if (OutputFilename.compare("-") == 0)
+    exitWithError("Cannot write indexed profdata format to stdout.");
+
+  if (OutputFormat != PF_Binary && OutputFormat != PF_Text)
+    exitWithError("Unknown format is specified.");
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputFilename.data(), EC, sys::fs::F_None);
+  if (EC)
+    exitWithErrorCode(EC, OutputFilename);
+
+  std::mutex ErrorLock;
+  SmallSet<instrprof_error, 4> WriterErrorCodes;
+
+  std::vector<std::string> Names;
+  for (const WeightedFile &Input : Inputs)
+    Names.push_back(Input.Filename);
+
+  std::unique_ptr<WriterContext> Merged;
+  if (BatchSize == 0 || Inputs.size() <= BatchSize) {
+    Merged = loadAndMergeInputs(Inputs, Names, OutputSparse, NumThreads,
+                                ErrorLock, WriterErrorCodes);
+  } else {
+    // Merge the inputs one batch at a time and spill each partial result to a
+    // temporary indexed profile, so that at most one batch worth of writer
+    // contexts is alive at a time. The partial results already carry the input
+    // weights and are then folded one by one into a single writer, which keeps
+    // peak memory independent of the number of inputs and threads.
+    WeightedFileVector Partials;
+    std::vector<std::string> PartialNames;
+    std::vector<std::unique_ptr<FileRemover>> PartialRemovers;
+    for (size_t Begin = 0, E = Inputs.size(); Begin < E; Begin += BatchSize) {
+      size_t End = std::min(E, Begin + BatchSize);
+      WeightedFileVector Batch(Inputs.begin() + Begin, Inputs.begin() + End);
+      std::unique_ptr<WriterContext> WC = loadAndMergeInputs(
+          Batch, makeArrayRef(Names).slice(Begin, End - Begin), OutputSparse,
+          NumThreads, ErrorLock, WriterErrorCodes);
+
+      // Only empty profiles were loaded: there is nothing to spill, and the
+      // profile kind is unknown.
+      if (WC->Writer.getProfileKind() == InstrProfWriter::PF_Unknown)
+        continue;
+
+      int FD;
+      SmallString<128> PartialPath;
+      if (std::error_code EC = sys::fs::createTemporaryFile(
+              "llvm-profdata-merge", "profdata", FD, PartialPath))
+        exitWithErrorCode(EC, "creating a temporary profile");
+      PartialRemovers.push_back(llvm::make_unique<FileRemover>(PartialPath));
+      {
+        raw_fd_ostream PartialOS(FD, /*shouldClose=*/true);
+        WC->Writer.write(PartialOS);
+      }
+      Partials.push_back({PartialPath.str(), 1});
+      // Name the partial profile after the inputs it was merged from.
+      if (Batch.size() == 1)
+        PartialNames.push_back(Batch[0].Filename);
+      else
+        PartialNames.push_back((Twine(Batch.front().Filename) + " (and " +
+                                Twine(Batch.size() - 1) + " more inputs)")
+                                   .str());
+    }
+    Merged = loadAndMergeInputs(Partials, PartialNames, OutputSparse,
+                                /*NumThreads=*/1, ErrorLock, WriterErrorCodes);
+  }
+
+  InstrProfWriter &Writer = Merged->Writer;
   if (OutputFormat == PF_Text) {
     if (Error E = Writer.writeText(Output))
       exitWithError(std::move(E));
@@ -428,6 +516,11 @@ static int merge_main(int argc, const char *argv[]) {
       cl::desc("Number of merge threads to use (default: autodetect)"));
   cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
                         cl::aliasopt(NumThreads));
+  cl::opt<unsigned> BatchSize(
+      "batch-size", cl::init(0),
+      cl::desc("Merge instrumentation profiles in batches of this many inputs, "
+               "spilling partial results to disk to bound memory use "
+               "(default: merge all inputs in memory)"));
 
   cl::ParseCommandLineOptions(argc, argv, "LLVM profile data merger\n");
 
@@ -454,7 +547,7 @@ static int merge_main(int argc, const char *argv[]) {
 
   if (ProfileKind == instr)
     mergeInstrProfile(WeightedInputs, OutputFilename, OutputFormat,
-                      OutputSparse, NumThreads);
+                      OutputSparse, NumThreads, BatchSize);
   else
     mergeSampleProfile(WeightedInputs, OutputFilename, OutputFormat);
 
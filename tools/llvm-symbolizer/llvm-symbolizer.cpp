@@ -26,6 +26,7 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cstdio>
 #include <cstring>
@@ -92,6 +93,21 @@ static cl::opt<int> ClPrintSourceContextLines(
 static cl::opt<bool> ClVerbose("verbose", cl::init(false),
                                cl::desc("Print verbose line info"));
 
+static cl::opt<unsigned long long> ClCacheSize(
+    "cache-size", cl::init(0),
+    cl::desc("Maximum size in bytes of the object files kept in the cache "
+             "(default: unbounded)"));
+
+static cl::opt<std::string> ClWriteLineIndex(
+    "write-line-index", cl::init(""),
+    cl::desc("Write the line index of the file given with -obj to <file> "
+             "and exit"),
+    cl::value_desc("file"));
+
+static cl::opt<bool> ClUseLineIndex(
+    "use-line-index", cl::init(false),
+    cl::desc("Use the line index in <binary>.lineidx when it is up to date"));
+
 template<typename T>
 static bool error(Expected<T> &ResOrErr) {
   if (ResOrErr)
@@ -144,6 +160,26 @@ static bool parseCommand(StringRef InputString, bool &IsData,
   return !StringRef(pos, offset_length).getAsInteger(0, ModuleOffset);
 }
 
+static int writeLineIndex(LLVMSymbolizer &Symbolizer) {
+  if (ClBinaryName.empty()) {
+    errs() << "llvm-symbolizer: -write-line-index requires -obj\n";
+    return 1;
+  }
+  std::error_code EC;
+  tool_output_file Out(ClWriteLineIndex, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "llvm-symbolizer: " << ClWriteLineIndex << ": " << EC.message()
+           << '\n';
+    return 1;
+  }
+  if (Error E = Symbolizer.writeLineIndex(ClBinaryName, Out.os(), ClDwpName)) {
+    logAllUnhandledErrors(std::move(E), errs(), "llvm-symbolizer: ");
+    return 1;
+  }
+  Out.keep();
+  return 0;
+}
+
 int main(int argc, char **argv) {
   // Print stack trace if we signal out.
   sys::PrintStackTraceOnErrorSignal(argv[0]);
@@ -153,8 +189,11 @@ int main(int argc, char **argv) {
   llvm::sys::InitializeCOMRAII COM(llvm::sys::COMThreadingMode::MultiThreaded);
 
   cl::ParseCommandLineOptions(argc, argv, "llvm-symbolizer\n");
+
   LLVMSymbolizer::Options Opts(ClPrintFunctions, ClUseSymbolTable, ClDemangle,
                                ClUseRelativeAddress, ClDefaultArch);
+  Opts.MaxCacheSize = ClCacheSize;
+  Opts.UseLineIndex = ClUseLineIndex;
 
   for (const auto &hint : ClDsymHint) {
     if (sys::path::extension(hint) == ".dSYM") {
@@ -165,6 +204,8 @@ int main(int argc, char **argv) {
     }
   }
   LLVMSymbolizer Symbolizer(Opts);
+  if (!ClWriteLineIndex.empty())
+    return writeLineIndex(Symbolizer);
 
   DIPrinter Printer(outs(), ClPrintFunctions != FunctionNameKind::None,
                     ClPrettyPrint, ClPrintSourceContextLines, ClVerbose);
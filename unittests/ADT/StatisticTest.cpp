@@ -0,0 +1,69 @@
+//===- llvm/unittest/ADT/StatisticTest.cpp - Statistic unit tests ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Config/llvm-config.h"
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "unittest"
+STATISTIC(Counter, "Counts things");
+STATISTIC(Counter2, "Counts other things");
+
+namespace {
+#if !defined(NDEBUG) || defined(LLVM_ENABLE_STATS)
+TEST(StatisticTest, Count) {
+  Counter = 0;
+  EXPECT_EQ(0u, Counter.getValue());
+  EXPECT_EQ(0u, Counter++);
+  ++Counter;
+  EXPECT_EQ(2u, Counter.getValue());
+  Counter += 5;
+  Counter -= 1;
+  EXPECT_EQ(6u, Counter--);
+  EXPECT_EQ(5u, Counter.getValue());
+
+  Counter = 3;
+  EXPECT_EQ(3u, Counter.getValue());
+  Counter.updateMax(2);
+  EXPECT_EQ(3u, Counter.getValue());
+  Counter.updateMax(7);
+  EXPECT_EQ(7u, Counter.getValue());
+}
+
+#if LLVM_ENABLE_THREADS
+TEST(StatisticTest, ConcurrentCount) {
+  Counter2 = 0;
+  auto Bump = [] {
+    for (int I = 0; I < 1000; ++I)
+      ++Counter2;
+  };
+  std::thread Thread(Bump);
+  Bump();
+  Thread.join();
+  // The counts of the thread that exited are kept.
+  EXPECT_EQ(2000u, Counter2.getValue());
+}
+
+TEST(StatisticTest, ManyThreads) {
+  Counter2 = 0;
+  // The counters of each thread are kept when it exits.
+  for (int I = 0; I < 16; ++I) {
+    std::thread([] { Counter2 += 10; }).join();
+    EXPECT_EQ(10u * (I + 1), Counter2.getValue());
+  }
+  Counter2 = 5;
+  std::thread([] { ++Counter2; }).join();
+  EXPECT_EQ(6u, Counter2.getValue());
+}
+#endif
+#endif
+} // end anonymous namespace
@@ -18,6 +18,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Error.h"
@@ -195,4 +196,179 @@ TEST(BitReaderTest, MaterializeFunctionsForBlockAddrInFunctionAfter) {
   EXPECT_FALSE(verifyModule(*M, &dbgs()));
 }
 
+
+// Build a combined index with functions, a COMDAT-like duplicate, a variable,
+// an alias and a promoted local, and write it to Mem.
+static void writeCombinedIndex(SmallVectorImpl<char> &Mem) {
+  ModuleSummaryIndex Index;
+  Index.addModule("a.o", 0);
+  Index.addModule("b.o", 1);
+  StringRef ModA = Index.modulePaths().find("a.o")->first();
+  StringRef ModB = Index.modulePaths().find("b.o")->first();
+
+  GlobalValueSummary::GVFlags Flags(GlobalValue::ExternalLinkage, false,
+                                    true);
+  GlobalValueSummary::GVFlags LocalFlags(GlobalValue::InternalLinkage, false,
+                                         true);
+  ValueInfo F = Index.getOrInsertValueInfo(GlobalValue::getGUID("f"));
+  ValueInfo G = Index.getOrInsertValueInfo(GlobalValue::getGUID("g"));
+  ValueInfo V = Index.getOrInsertValueInfo(GlobalValue::getGUID("v"));
+  ValueInfo L = Index.getOrInsertValueInfo(GlobalValue::getGUID("a.c:l"));
+
+  auto makeFunction = [&](StringRef Mod, unsigned InstCount,
+                          GlobalValueSummary::GVFlags Flags,
+                          std::vector<ValueInfo> Refs,
+                          std::vector<FunctionSummary::EdgeTy> Calls,
+                          std::vector<GlobalValue::GUID> TypeTests) {
+    auto FS = llvm::make_unique<FunctionSummary>(
+        Flags, InstCount, FunctionSummary::FFlags{}, std::move(Refs),
+        std::move(Calls), std::move(TypeTests),
+        std::vector<FunctionSummary::VFuncId>{},
+        std::vector<FunctionSummary::VFuncId>{},
+        std::vector<FunctionSummary::ConstVCall>{},
+        std::vector<FunctionSummary::ConstVCall>{});
+    FS->setModulePath(Mod);
+    return FS;
+  };
+  Index.addGlobalValueSummary(
+      F, makeFunction(ModA, 10, Flags, {V},
+                      {{G, CalleeInfo(CalleeInfo::HotnessType::Hot)},
+                       {L, CalleeInfo()}},
+                      {}));
+  Index.addGlobalValueSummary(G, makeFunction(ModA, 20, Flags, {}, {}, {}));
+  Index.addGlobalValueSummary(G, makeFunction(ModB, 21, Flags, {}, {}, {42}));
+  auto LS = makeFunction(ModA, 30, LocalFlags, {}, {}, {});
+  LS->setOriginalName(GlobalValue::getGUID("l"));
+  Index.addGlobalValueSummary(L, std::move(LS));
+
+  auto VS =
+      llvm::make_unique<GlobalVarSummary>(Flags, std::vector<ValueInfo>{F});
+  VS->setModulePath(ModB);
+  Index.addGlobalValueSummary(V, std::move(VS));
+
+  auto AS = llvm::make_unique<AliasSummary>(Flags);
+  AS->setModulePath(ModB);
+  AS->setAliasee(Index.findSummaryInModule(G.getGUID(), ModB));
+  Index.addGlobalValueSummary("a", std::move(AS));
+
+  raw_svector_ostream OS(Mem);
+  WriteIndexToFile(Index, OS);
+}
+
+static bool isMaterialized(const ModuleSummaryIndex &Index, StringRef Name) {
+  ValueInfo VI = Index.getValueInfo(GlobalValue::getGUID(Name));
+  return !VI.Ref->second.Materializer;
+}
+
+TEST(BitReaderTest, LazyCombinedSummary) {
+  SmallString<1024> Mem;
+  writeCombinedIndex(Mem);
+  MemoryBufferRef Buffer(Mem.str(), "index");
+  std::unique_ptr<ModuleSummaryIndex> Eager =
+      cantFail(getModuleSummaryIndex(Buffer));
+  std::unique_ptr<ModuleSummaryIndex> Lazy =
+      cantFail(getLazyModuleSummaryIndex(Buffer));
+  ASSERT_TRUE(Lazy->isMaterializable());
+  EXPECT_EQ(Eager->size(), Lazy->size());
+
+  // The original names are known before any summary is decoded.
+  EXPECT_EQ(GlobalValue::getGUID("a.c:l"),
+            Lazy->getGUIDFromOriginalID(GlobalValue::getGUID("l")));
+  for (StringRef Name : {"f", "g", "v", "a", "a.c:l"})
+    EXPECT_FALSE(isMaterialized(*Lazy, Name)) << Name;
+
+  // Looking up a summary only decodes the summaries of its GUID.
+  auto *F = dyn_cast_or_null<FunctionSummary>(
+      Lazy->findSummaryInModule(GlobalValue::getGUID("f"), "a.o"));
+  ASSERT_TRUE(F);
+  EXPECT_EQ(10u, F->instCount());
+  ASSERT_EQ(2u, F->calls().size());
+  EXPECT_EQ(GlobalValue::getGUID("g"), F->calls()[0].first.getGUID());
+  EXPECT_EQ(CalleeInfo::HotnessType::Hot, F->calls()[0].second.Hotness);
+  ASSERT_EQ(1u, F->refs().size());
+  EXPECT_EQ(GlobalValue::getGUID("v"), F->refs()[0].getGUID());
+  EXPECT_TRUE(isMaterialized(*Lazy, "f"));
+  EXPECT_FALSE(isMaterialized(*Lazy, "g"));
+  EXPECT_FALSE(isMaterialized(*Lazy, "v"));
+
+  // Decoding an alias decodes its aliasee, along with its type tests.
+  auto *A = dyn_cast_or_null<AliasSummary>(
+      Lazy->findSummaryInModule(GlobalValue::getGUID("a"), "b.o"));
+  ASSERT_TRUE(A);
+  EXPECT_TRUE(isMaterialized(*Lazy, "g"));
+  auto *G = dyn_cast<FunctionSummary>(&A->getAliasee());
+  EXPECT_EQ(21u, G->instCount());
+  ASSERT_EQ(1u, G->type_tests().size());
+  EXPECT_EQ(42u, G->type_tests()[0]);
+  EXPECT_EQ(2u, F->calls()[0].first.getSummaryList().size());
+
+  // Collecting the functions of a module only decodes that module.
+  GVSummaryMapTy EagerDefined, LazyDefined;
+  Eager->collectDefinedFunctionsForModule("a.o", EagerDefined);
+  Lazy->collectDefinedFunctionsForModule("a.o", LazyDefined);
+  EXPECT_EQ(EagerDefined.size(), LazyDefined.size());
+  EXPECT_EQ(3u, LazyDefined.size());
+  EXPECT_TRUE(isMaterialized(*Lazy, "a.c:l"));
+  EXPECT_EQ(GlobalValue::getGUID("l"),
+            LazyDefined[GlobalValue::getGUID("a.c:l")]->getOriginalName());
+  EXPECT_FALSE(isMaterialized(*Lazy, "v"));
+  EXPECT_TRUE(Lazy->isMaterializable());
+
+  // Iterating over the index decodes everything.
+  auto LazyI = Lazy->begin();
+  EXPECT_FALSE(Lazy->isMaterializable());
+  for (auto &EagerEntry : *Eager) {
+    ASSERT_EQ(EagerEntry.first, LazyI->first);
+    ASSERT_EQ(EagerEntry.second.SummaryList.size(),
+              LazyI->second.SummaryList.size());
+    for (unsigned I = 0; I != EagerEntry.second.SummaryList.size(); ++I) {
+      auto &EagerS = *EagerEntry.second.SummaryList[I];
+      auto &LazyS = *LazyI->second.SummaryList[I];
+      EXPECT_EQ(EagerS.getSummaryKind(), LazyS.getSummaryKind());
+      EXPECT_EQ(EagerS.modulePath(), LazyS.modulePath());
+      EXPECT_EQ(EagerS.getOriginalName(), LazyS.getOriginalName());
+      EXPECT_EQ(EagerS.refs().size(), LazyS.refs().size());
+    }
+    ++LazyI;
+  }
+  EXPECT_TRUE(LazyI == Lazy->end());
+}
+
+TEST(BitReaderTest, LazyCombinedSummaryMalformed) {
+  // An alias whose aliasee has no summary in the alias' module.
+  ModuleSummaryIndex Index;
+  Index.addModule("a.o", 0);
+  Index.addModule("b.o", 1);
+  StringRef ModA = Index.modulePaths().find("a.o")->first();
+  StringRef ModB = Index.modulePaths().find("b.o")->first();
+  GlobalValueSummary::GVFlags Flags(GlobalValue::ExternalLinkage, false,
+                                    true);
+  auto VS = llvm::make_unique<GlobalVarSummary>(Flags,
+                                                std::vector<ValueInfo>{});
+  VS->setModulePath(ModA);
+  Index.addGlobalValueSummary("v", std::move(VS));
+  auto AS = llvm::make_unique<AliasSummary>(Flags);
+  AS->setModulePath(ModB);
+  AS->setAliasee(Index.findSummaryInModule(GlobalValue::getGUID("v"), ModA));
+  Index.addGlobalValueSummary("a", std::move(AS));
+
+  SmallString<1024> Mem;
+  raw_svector_ostream OS(Mem);
+  WriteIndexToFile(Index, OS);
+  MemoryBufferRef Buffer(Mem.str(), "index");
+
+  // The lazy reader reports the error when loading the index, like the eager
+  // one, rather than when the alias is first used.
+  Expected<std::unique_ptr<ModuleSummaryIndex>> Eager =
+      getModuleSummaryIndex(Buffer);
+  ASSERT_FALSE(bool(Eager));
+  EXPECT_EQ("Alias expects aliasee summary to be parsed",
+            toString(Eager.takeError()));
+  Expected<std::unique_ptr<ModuleSummaryIndex>> Lazy =
+      getLazyModuleSummaryIndex(Buffer);
+  ASSERT_FALSE(bool(Lazy));
+  EXPECT_EQ("Alias expects aliasee summary to be parsed",
+            toString(Lazy.takeError()));
+}
+
 } // end namespace
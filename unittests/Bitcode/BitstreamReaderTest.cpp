@@ -140,6 +140,104 @@ TEST(BitstreamReaderTest, readRecordWithBlobWhileStreaming) {
   }
 }
 
+TEST(BitstreamReaderTest, readRecordArrays) {
+  // Values that need one to several chunks, at every field alignment.
+  SmallVector<uint64_t, 64> Values;
+  for (unsigned I = 0; I != 64; ++I)
+    Values.push_back((uint64_t(1) << I) + I);
+  std::string Chars =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._";
+
+  const unsigned BlockID = bitc::FIRST_APPLICATION_BLOCKID;
+  SmallVector<char, 1> Buffer;
+  unsigned FixedAbbrev, VBRAbbrev, Char6Abbrev, BlobAbbrev;
+  {
+    BitstreamWriter Stream(Buffer);
+    Stream.EnterSubblock(BlockID, 3);
+
+    auto Abbrev = std::make_shared<BitCodeAbbrev>();
+    Abbrev->Add(BitCodeAbbrevOp(1));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 5));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 13));
+    FixedAbbrev = Stream.EmitAbbrev(std::move(Abbrev));
+
+    Abbrev = std::make_shared<BitCodeAbbrev>();
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 4));
+    VBRAbbrev = Stream.EmitAbbrev(std::move(Abbrev));
+
+    Abbrev = std::make_shared<BitCodeAbbrev>();
+    Abbrev->Add(BitCodeAbbrevOp(3));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Char6));
+    Char6Abbrev = Stream.EmitAbbrev(std::move(Abbrev));
+
+    Abbrev = std::make_shared<BitCodeAbbrev>();
+    Abbrev->Add(BitCodeAbbrevOp(4));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+    BlobAbbrev = Stream.EmitAbbrev(std::move(Abbrev));
+
+    for (unsigned Size = 0; Size <= Values.size(); Size += 7) {
+      ArrayRef<uint64_t> Prefix = makeArrayRef(Values).take_front(Size);
+      SmallVector<uint64_t, 64> Fixed = {Size % 32};
+      for (uint64_t V : Prefix)
+        Fixed.push_back(V & 0x1fff);
+      Stream.EmitRecord(1, Fixed, FixedAbbrev);
+      Stream.EmitRecord(2, Prefix, VBRAbbrev);
+      SmallVector<uint64_t, 64> Char6(Chars.begin(), Chars.begin() + Size);
+      Stream.EmitRecord(3, Char6, Char6Abbrev);
+      Stream.EmitRecord(5, Prefix);
+      uint64_t Record[] = {4, Size};
+      Stream.EmitRecordWithBlob(BlobAbbrev, Record,
+                                StringRef(Chars).take_front(Size));
+    }
+    Stream.ExitBlock();
+  }
+
+  BitstreamCursor Stream(
+      ArrayRef<uint8_t>((const uint8_t *)Buffer.begin(), Buffer.size()));
+  BitstreamEntry Entry = Stream.advance();
+  ASSERT_EQ(BitstreamEntry::SubBlock, Entry.Kind);
+  ASSERT_FALSE(Stream.EnterSubBlock(BlockID));
+
+  auto readRecord = [&](SmallVectorImpl<uint64_t> &Record) {
+    Entry = Stream.advance();
+    EXPECT_EQ(BitstreamEntry::Record, Entry.Kind);
+    Record.clear();
+    return Stream.readRecord(Entry.ID, Record);
+  };
+
+  SmallVector<uint64_t, 64> Record;
+  for (unsigned Size = 0; Size <= Values.size(); Size += 7) {
+    ArrayRef<uint64_t> Prefix = makeArrayRef(Values).take_front(Size);
+    SmallVector<uint64_t, 64> Expected = {Size % 32};
+    for (uint64_t V : Prefix)
+      Expected.push_back(V & 0x1fff);
+    EXPECT_EQ(1u, readRecord(Record));
+    EXPECT_EQ(Expected, Record);
+
+    EXPECT_EQ(2u, readRecord(Record));
+    EXPECT_EQ(Prefix, makeArrayRef(Record));
+
+    EXPECT_EQ(3u, readRecord(Record));
+    EXPECT_EQ(Chars.substr(0, Size), std::string(Record.begin(), Record.end()));
+
+    EXPECT_EQ(5u, readRecord(Record));
+    EXPECT_EQ(Prefix, makeArrayRef(Record));
+
+    // A blob is unpacked into the record if it isn't asked for.
+    EXPECT_EQ(4u, readRecord(Record));
+    ASSERT_EQ(Size + 1, Record.size());
+    EXPECT_EQ(Size, Record[0]);
+    EXPECT_EQ(Chars.substr(0, Size),
+              std::string(Record.begin() + 1, Record.end()));
+  }
+  EXPECT_EQ(BitstreamEntry::EndBlock, Stream.advance().Kind);
+}
+
 TEST(BitstreamReaderTest, shortRead) {
   uint8_t Bytes[] = {8, 7, 6, 5, 4, 3, 2, 1};
   for (unsigned I = 1; I != 8; ++I) {
@@ -1094,6 +1094,51 @@ TEST(DWARFDebugInfo, TestDWARFDie) {
   EXPECT_FALSE(DefaultDie.getSibling().isValid());
 }
 
+TEST(DWARFDebugInfo, TestExtractAllDIEs) {
+  Triple Triple = getHostTripleForAddrSize(sizeof(void *));
+  if (!isConfigurationSupported(Triple))
+    return;
+
+  // Create several units of different sizes, so that they end up being
+  // extracted by different threads.
+  uint16_t Version = 4;
+  auto ExpectedDG = dwarfgen::Generator::create(Triple, Version);
+  ASSERT_THAT_EXPECTED(ExpectedDG, Succeeded());
+  dwarfgen::Generator *DG = ExpectedDG.get().get();
+  const unsigned NumUnits = 16;
+  for (unsigned I = 0; I < NumUnits; ++I) {
+    dwarfgen::DIE CUDie = DG->addCompileUnit().getUnitDIE();
+    for (unsigned J = 0; J < I; ++J)
+      CUDie.addChild(DW_TAG_base_type)
+          .addAttribute(DW_AT_byte_size, DW_FORM_data1, J);
+  }
+
+  MemoryBufferRef FileBuffer(DG->generate(), "dwarf");
+  auto Obj = object::ObjectFile::createObjectFile(FileBuffer);
+  EXPECT_TRUE((bool)Obj);
+  std::unique_ptr<DWARFContext> DwarfContext = DWARFContext::create(**Obj);
+  EXPECT_EQ(DwarfContext->getNumCompileUnits(), NumUnits);
+
+  // Only extract the unit DIE of the first unit, the rest must still be
+  // extracted afterwards.
+  EXPECT_TRUE(DwarfContext->getCompileUnitAtIndex(0)->getUnitDIE().isValid());
+  DwarfContext->extractAllDIEs();
+
+  for (unsigned I = 0; I < NumUnits; ++I) {
+    DWARFCompileUnit *U = DwarfContext->getCompileUnitAtIndex(I);
+    // The unit DIE, its children and the terminating NULL DIE.
+    EXPECT_EQ(U->getNumDIEs(), I ? I + 2 : 1u);
+    unsigned NumChildren = 0;
+    for (const DWARFDie &Child : U->getUnitDIE(false).children()) {
+      EXPECT_EQ(Child.getTag(), DW_TAG_base_type);
+      EXPECT_EQ(toUnsigned(Child.find(DW_AT_byte_size), ~0ULL), NumChildren);
+      EXPECT_EQ(DwarfContext->getDIEForOffset(Child.getOffset()), Child);
+      ++NumChildren;
+    }
+    EXPECT_EQ(NumChildren, I);
+  }
+}
+
 TEST(DWARFDebugInfo, TestChildIterators) {
   Triple Triple = getHostTripleForAddrSize(sizeof(void *));
   if (!isConfigurationSupported(Triple))
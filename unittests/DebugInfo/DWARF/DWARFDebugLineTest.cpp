@@ -0,0 +1,89 @@
+//===- llvm/unittest/DebugInfo/DWARFDebugLineTest.cpp ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DebugInfo/DWARF/DWARFDebugLine.h"
+#include "gtest/gtest.h"
+#include <vector>
+using namespace llvm;
+
+namespace {
+
+using Row = DWARFDebugLine::Row;
+using RowVector = DWARFDebugLine::RowVector;
+
+Row makeRow(unsigned I) {
+  Row R;
+  R.Address = 0x1000 + 4 * I;
+  R.Line = 1 + I * 7;
+  // Few distinct combinations of the other fields, as in real line tables.
+  R.Column = I % 3;
+  R.File = 1 + I % 2;
+  R.Discriminator = I % 5 == 0 ? I : 0;
+  R.Isa = I % 4 == 0;
+  R.IsStmt = I % 2;
+  R.BasicBlock = I % 3 == 0;
+  R.EndSequence = I % 7 == 6;
+  R.PrologueEnd = I % 11 == 0;
+  R.EpilogueBegin = I % 13 == 0;
+  return R;
+}
+
+void expectSameRow(const Row &Expected, const Row &Actual) {
+  EXPECT_EQ(Expected.Address, Actual.Address);
+  EXPECT_EQ(Expected.Line, Actual.Line);
+  EXPECT_EQ(Expected.Column, Actual.Column);
+  EXPECT_EQ(Expected.File, Actual.File);
+  EXPECT_EQ(Expected.Discriminator, Actual.Discriminator);
+  EXPECT_EQ(Expected.Isa, Actual.Isa);
+  EXPECT_EQ(Expected.IsStmt, Actual.IsStmt);
+  EXPECT_EQ(Expected.BasicBlock, Actual.BasicBlock);
+  EXPECT_EQ(Expected.EndSequence, Actual.EndSequence);
+  EXPECT_EQ(Expected.PrologueEnd, Actual.PrologueEnd);
+  EXPECT_EQ(Expected.EpilogueBegin, Actual.EpilogueBegin);
+}
+
+TEST(DWARFDebugLine, RowVectorRoundTrip) {
+  const unsigned NumRows = 100;
+  RowVector Rows;
+  EXPECT_TRUE(Rows.empty());
+  for (unsigned I = 0; I != NumRows / 2; ++I)
+    Rows.push_back(makeRow(I));
+  // Rows appended after finalize still share the existing attributes.
+  Rows.finalize();
+  for (unsigned I = NumRows / 2; I != NumRows; ++I)
+    Rows.push_back(makeRow(I));
+
+  ASSERT_EQ(NumRows, Rows.size());
+  for (unsigned I = 0; I != NumRows; ++I)
+    expectSameRow(makeRow(I), Rows[I]);
+  expectSameRow(makeRow(NumRows - 1), Rows.back());
+
+  unsigned I = 0;
+  for (RowVector::const_iterator It = Rows.begin(), E = Rows.end(); It != E;
+       ++It, ++I) {
+    expectSameRow(makeRow(I), *It);
+    EXPECT_EQ(makeRow(I).Line, It->Line);
+    EXPECT_EQ(makeRow(I).File, It->File);
+  }
+  EXPECT_EQ(NumRows, I);
+  EXPECT_EQ(std::ptrdiff_t(NumRows), Rows.end() - Rows.begin());
+  expectSameRow(makeRow(42), Rows.begin()[42]);
+
+  ArrayRef<uint64_t> Addresses = Rows.addresses();
+  ASSERT_EQ(NumRows, Addresses.size());
+  for (unsigned I = 0; I != NumRows; ++I)
+    EXPECT_EQ(makeRow(I).Address, Addresses[I]);
+
+  Rows.clear();
+  EXPECT_TRUE(Rows.empty());
+  Rows.push_back(makeRow(3));
+  expectSameRow(makeRow(3), Rows[0]);
+}
+
+} // end anonymous namespace
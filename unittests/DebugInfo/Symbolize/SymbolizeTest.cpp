@@ -0,0 +1,169 @@
+//===- llvm/unittest/DebugInfo/Symbolize/SymbolizeTest.cpp ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DebugInfo/Symbolize/Symbolize.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/FileSystem.h"
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace llvm;
+using namespace llvm::symbolize;
+
+extern const char *TestMainArgv0;
+
+// Functions to look up in the symbol table of the test executable.
+extern "C" LLVM_ATTRIBUTE_NOINLINE void symbolizeTestFunction1() {}
+extern "C" LLVM_ATTRIBUTE_NOINLINE void symbolizeTestFunction2() {}
+
+namespace {
+
+// Anchor for getMainExecutable.
+static int Anchor;
+
+class SymbolizeTest : public testing::Test {
+protected:
+  std::string Executable;
+  std::vector<uint64_t> Offsets;
+
+  void SetUp() override {
+    // Keep the functions alive through the linker's garbage collection.
+    ASSERT_NE(&symbolizeTestFunction1, &symbolizeTestFunction2);
+
+    Executable = sys::fs::getMainExecutable(TestMainArgv0, &Anchor);
+    auto ObjOrErr = object::ObjectFile::createObjectFile(Executable);
+    ASSERT_TRUE(bool(ObjOrErr));
+    uint64_t Address1 = 0, Address2 = 0;
+    for (const object::SymbolRef &Sym : ObjOrErr->getBinary()->symbols()) {
+      Expected<StringRef> Name = Sym.getName();
+      Expected<uint64_t> Address = Sym.getAddress();
+      if (!Name || !Address) {
+        consumeError(Name.takeError());
+        consumeError(Address.takeError());
+        continue;
+      }
+      if (Name->endswith("symbolizeTestFunction1"))
+        Address1 = *Address;
+      else if (Name->endswith("symbolizeTestFunction2"))
+        Address2 = *Address;
+    }
+    ASSERT_NE(0u, Address1);
+    ASSERT_NE(0u, Address2);
+    // Out of order, with duplicates.
+    Offsets = {Address2, Address1, Address2, Address1, Address1};
+  }
+
+  static void expectSameLineInfo(const DILineInfo &Expected,
+                                 const DILineInfo &Actual) {
+    EXPECT_EQ(Expected.FunctionName, Actual.FunctionName);
+    EXPECT_EQ(Expected.FileName, Actual.FileName);
+    EXPECT_EQ(Expected.Line, Actual.Line);
+    EXPECT_EQ(Expected.Column, Actual.Column);
+  }
+};
+
+TEST_F(SymbolizeTest, BatchedSymbolizeCode) {
+  LLVMSymbolizer Symbolizer;
+  auto BatchOrErr = Symbolizer.symbolizeCode(Executable, Offsets);
+  ASSERT_TRUE(bool(BatchOrErr));
+  ASSERT_EQ(Offsets.size(), BatchOrErr->size());
+  EXPECT_NE(StringRef::npos,
+            StringRef((*BatchOrErr)[0].FunctionName)
+                .find("symbolizeTestFunction2"));
+  EXPECT_NE(StringRef::npos,
+            StringRef((*BatchOrErr)[1].FunctionName)
+                .find("symbolizeTestFunction1"));
+  for (unsigned I = 0; I != Offsets.size(); ++I) {
+    auto LineInfoOrErr = Symbolizer.symbolizeCode(Executable, Offsets[I]);
+    ASSERT_TRUE(bool(LineInfoOrErr));
+    expectSameLineInfo(*LineInfoOrErr, (*BatchOrErr)[I]);
+  }
+
+  // A module that cannot be loaded reports an error once, and then gives
+  // empty results.
+  std::string Missing = Executable + ".missing";
+  auto MissingOrErr = Symbolizer.symbolizeCode(Missing, Offsets);
+  EXPECT_FALSE(bool(MissingOrErr));
+  consumeError(MissingOrErr.takeError());
+  MissingOrErr = Symbolizer.symbolizeCode(Missing, Offsets);
+  ASSERT_TRUE(bool(MissingOrErr));
+  EXPECT_EQ(Offsets.size(), MissingOrErr->size());
+}
+
+TEST_F(SymbolizeTest, FailedModuleIsNotEvicted) {
+  // A one byte cache evicts every module that is not in use.
+  LLVMSymbolizer::Options Opts;
+  Opts.MaxCacheSize = 1;
+  LLVMSymbolizer Symbolizer(Opts);
+  std::string Missing = Executable + ".missing";
+  auto MissingOrErr = Symbolizer.symbolizeCode(Missing, Offsets[0]);
+  EXPECT_FALSE(bool(MissingOrErr));
+  consumeError(MissingOrErr.takeError());
+
+  // Loading another module evicts everything that can be evicted, but the
+  // failed module stays cached, so its error is not reported again.
+  cantFail(Symbolizer.symbolizeCode(Executable, Offsets[0]));
+  MissingOrErr = Symbolizer.symbolizeCode(Missing, Offsets[0]);
+  EXPECT_TRUE(bool(MissingOrErr));
+
+  // Flushing the cache retries the load.
+  Symbolizer.flush();
+  MissingOrErr = Symbolizer.symbolizeCode(Missing, Offsets[0]);
+  EXPECT_FALSE(bool(MissingOrErr));
+  consumeError(MissingOrErr.takeError());
+}
+
+#if LLVM_ENABLE_THREADS
+TEST_F(SymbolizeTest, ConcurrentSymbolizeCode) {
+  std::vector<DILineInfo> Expected;
+  {
+    LLVMSymbolizer Symbolizer;
+    for (uint64_t Offset : Offsets)
+      Expected.push_back(
+          cantFail(Symbolizer.symbolizeCode(Executable, Offset)));
+  }
+
+  // A one byte cache evicts the module whenever no query uses it, so threads
+  // keep loading it while others query it.
+  LLVMSymbolizer::Options Opts;
+  Opts.MaxCacheSize = 1;
+  LLVMSymbolizer Symbolizer(Opts);
+  const unsigned NumThreads = 4;
+  std::vector<std::vector<DILineInfo>> Results(NumThreads);
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T != NumThreads; ++T)
+    Threads.emplace_back([&, T] {
+      for (unsigned N = 0; N != 4; ++N) {
+        if (T % 2) {
+          for (uint64_t Offset : Offsets)
+            Results[T].push_back(
+                cantFail(Symbolizer.symbolizeCode(Executable, Offset)));
+        } else {
+          std::vector<DILineInfo> Batch =
+              cantFail(Symbolizer.symbolizeCode(Executable, Offsets));
+          Results[T].insert(Results[T].end(), Batch.begin(), Batch.end());
+        }
+        if (T == 0)
+          Symbolizer.flush();
+      }
+    });
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  for (const std::vector<DILineInfo> &Result : Results) {
+    ASSERT_EQ(4 * Expected.size(), Result.size());
+    for (unsigned I = 0; I != Result.size(); ++I)
+      expectSameLineInfo(Expected[I % Expected.size()], Result[I]);
+  }
+}
+#endif
+
+} // end anonymous namespace
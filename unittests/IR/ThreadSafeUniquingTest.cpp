@@ -0,0 +1,153 @@
+//===- ThreadSafeUniquingTest.cpp - Thread-safe uniquing tests ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <thread>
+#include <vector>
+using namespace llvm;
+
+namespace {
+
+/// Get a mix of uniqued types, constants, metadata and attributes, and return
+/// them in a fixed order.
+std::vector<const void *> getUniqued(LLVMContext &C, GlobalVariable *GV,
+                                     unsigned I) {
+  std::vector<const void *> Result;
+  IntegerType *IntTy = IntegerType::get(C, 1 + I % 77);
+  Type *Int64Ty = Type::getInt64Ty(C);
+  PointerType *PtrTy = IntTy->getPointerTo(I % 3);
+  ArrayType *ArrTy = ArrayType::get(IntTy, I);
+  FunctionType *FnTy = FunctionType::get(IntTy, {PtrTy, ArrTy}, I % 2);
+  StructType *STy = StructType::get(C, {Int64Ty, IntTy, ArrTy});
+  Result.insert(Result.end(), {IntTy, PtrTy, ArrTy, FnTy, STy});
+
+  Constant *CI = ConstantInt::get(IntTy, I);
+  Constant *Expr = ConstantExpr::getAdd(
+      ConstantExpr::getPtrToInt(GV, Int64Ty), ConstantInt::get(Int64Ty, I));
+  Constant *CS = ConstantStruct::get(STy, {Expr, CI, UndefValue::get(ArrTy)});
+  Result.insert(Result.end(), {CI, Expr, CS, ConstantPointerNull::get(PtrTy)});
+
+  MDString *S = MDString::get(C, "string" + std::to_string(I));
+  MDTuple *Inner = MDTuple::get(C, {S});
+  Result.insert(Result.end(), {S, Inner, MDTuple::get(C, {Inner, S, nullptr})});
+
+  Attribute A = Attribute::get(C, "key", std::to_string(I));
+  AttributeSet AS = AttributeSet::get(
+      C, {A, Attribute::get(C, Attribute::NoUnwind),
+          Attribute::getWithAlignment(C, 1ull << (I % 8))});
+  AttributeList AL = AttributeList::get(C, AS, AttributeSet(), {AS});
+  Result.insert(Result.end(), {A.getRawPointer(), AL.getRawPointer()});
+  return Result;
+}
+
+TEST(ThreadSafeUniquingTest, enableThreadSafeUniquing) {
+  LLVMContext C;
+  Module M("M", C);
+  auto *GV = new GlobalVariable(M, Type::getInt8Ty(C), false,
+                                GlobalValue::ExternalLinkage, nullptr, "G");
+  EXPECT_FALSE(C.isThreadSafeUniquing());
+
+  // Everything created before the switch must still be found afterwards.
+  std::vector<std::vector<const void *>> Before;
+  for (unsigned I = 0; I != 64; ++I)
+    Before.push_back(getUniqued(C, GV, I));
+
+  C.enableThreadSafeUniquing();
+  EXPECT_TRUE(C.isThreadSafeUniquing());
+  for (unsigned I = 0; I != 64; ++I)
+    EXPECT_EQ(Before[I], getUniqued(C, GV, I));
+}
+
+#if LLVM_ENABLE_THREADS
+TEST(ThreadSafeUniquingTest, ConcurrentGets) {
+  const unsigned NumThreads = 4;
+  const unsigned NumIters = 256;
+
+  LLVMContext C;
+  Module M("M", C);
+  auto *GV = new GlobalVariable(M, Type::getInt8Ty(C), false,
+                                GlobalValue::ExternalLinkage, nullptr, "G");
+  C.enableThreadSafeUniquing();
+
+  // Each thread starts at a different offset, so that several threads race
+  // to create the same entries.
+  std::vector<std::vector<std::vector<const void *>>> Results(NumThreads);
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T != NumThreads; ++T)
+    Threads.emplace_back([&, T] {
+      Results[T].resize(NumIters);
+      for (unsigned N = 0; N != NumIters; ++N) {
+        unsigned I = (N + T * NumIters / NumThreads) % NumIters;
+        Results[T][I] = getUniqued(C, GV, I);
+      }
+    });
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  for (unsigned T = 1; T != NumThreads; ++T)
+    EXPECT_EQ(Results[0], Results[T]);
+  for (unsigned I = 0; I != NumIters; ++I)
+    EXPECT_EQ(Results[0][I], getUniqued(C, GV, I));
+}
+
+TEST(ThreadSafeUniquingTest, ConcurrentConstantUses) {
+  const unsigned NumThreads = 4;
+  const unsigned NumIters = 256;
+
+  LLVMContext C;
+  Module M("M", C);
+  auto *GV = new GlobalVariable(M, Type::getInt8Ty(C), false,
+                                GlobalValue::ExternalLinkage, nullptr, "G");
+  Type *Int64Ty = Type::getInt64Ty(C);
+  Constant *One = ConstantInt::get(Int64Ty, 1);
+  Constant *Expr = ConstantExpr::getPtrToInt(GV, Int64Ty);
+  unsigned NumGVUses = GV->getNumUses();
+  unsigned NumExprUses = Expr->getNumUses();
+  C.enableThreadSafeUniquing();
+
+  // Each thread creates constants using the shared ones, which land in
+  // different shards but update the same use lists. It also uniques nodes
+  // with the shared constants as operands, which tracks the references to
+  // them.
+  std::vector<std::vector<const void *>> Results(NumThreads);
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T != NumThreads; ++T)
+    Threads.emplace_back([&, T] {
+      Results[T].resize(3 * NumIters);
+      for (unsigned N = 0; N != NumIters; ++N) {
+        unsigned I = (N + T * NumIters / NumThreads) % NumIters;
+        Constant *Offset = ConstantInt::get(Int64Ty, I + 1);
+        Results[T][3 * I] = ConstantExpr::getAdd(Expr, Offset);
+        Results[T][3 * I + 1] = MDTuple::get(
+            C, {ConstantAsMetadata::get(Expr), ConstantAsMetadata::get(Offset),
+                ConstantAsMetadata::get(GV)});
+        Results[T][3 * I + 2] =
+            MetadataAsValue::get(C, ConstantAsMetadata::get(One));
+      }
+    });
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  for (unsigned T = 1; T != NumThreads; ++T)
+    EXPECT_EQ(Results[0], Results[T]);
+  EXPECT_EQ(NumGVUses, GV->getNumUses());
+  EXPECT_EQ(NumExprUses + NumIters, Expr->getNumUses());
+}
+#endif
+
+} // end anonymous namespace
@@ -9,6 +9,9 @@
 
 #include "llvm/Support/CachePruning.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -39,6 +42,12 @@ TEST(CachePruningPolicyParser, Expiration) {
   EXPECT_EQ(std::chrono::seconds(1), P->Expiration);
 }
 
+TEST(CachePruningPolicyParser, RescanInterval) {
+  auto P = parseCachePruningPolicy("rescan_interval=2h");
+  ASSERT_TRUE(bool(P));
+  EXPECT_EQ(std::chrono::hours(2), P->RescanInterval);
+}
+
 TEST(CachePruningPolicyParser, MaxSizePercentageOfAvailableSpace) {
   auto P = parseCachePruningPolicy("cache_size=100%");
   ASSERT_TRUE(bool(P));
@@ -95,3 +104,72 @@ TEST(CachePruningPolicyParser, Errors) {
   EXPECT_EQ("Unknown key: 'foo'",
             toString(parseCachePruningPolicy("foo=bar").takeError()));
 }
+
+static void writeCacheEntry(StringRef Dir, StringRef Name, size_t Size,
+                            unsigned Age = 0) {
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, Name);
+  int FD;
+  ASSERT_FALSE(sys::fs::openFileForWrite(Path, FD, sys::fs::F_None));
+  if (Age)
+    sys::fs::setLastModificationAndAccessTime(
+        FD, std::chrono::system_clock::now() - std::chrono::seconds(Age));
+  raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  OS << std::string(Size, 'x');
+}
+
+static bool hasCacheEntry(StringRef Dir, StringRef Name) {
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, Name);
+  return sys::fs::exists(Path);
+}
+
+TEST(CachePruning, Index) {
+  SmallString<128> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("cache-pruning-test", Dir));
+  writeCacheEntry(Dir, "llvmcache-a", 100);
+  writeCacheEntry(Dir, "llvmcache-b", 200);
+  writeCacheEntry(Dir, "llvmcache-c", 300);
+
+  CachePruningPolicy Policy;
+  Policy.Expiration = std::chrono::seconds(0);
+  Policy.MaxSizePercentageOfAvailableSpace = 0;
+  Policy.MaxSizeBytes = 1 << 20;
+
+  // The first pruning walks the directory and writes the index.
+  ASSERT_TRUE(pruneCache(Dir, Policy));
+  SmallString<128> IndexPath(Dir);
+  sys::path::append(IndexPath, "llvmcache.index");
+  ASSERT_TRUE(sys::fs::exists(IndexPath));
+
+  // Then the pruner only knows about what is recorded. Using "a" makes it the
+  // most recently used entry, the others are removed largest first.
+  recordCacheEntryAccess(Dir, "llvmcache-a", 100, /*IsNewEntry=*/false);
+  writeCacheEntry(Dir, "llvmcache-d", 400);
+  recordCacheEntryAccess(Dir, "llvmcache-d", 400, /*IsNewEntry=*/true);
+  writeCacheEntry(Dir, "llvmcache-e", 500, /*Age=*/3600);
+  Policy.MaxSizeBytes = 600;
+  ASSERT_TRUE(pruneCache(Dir, Policy));
+  EXPECT_TRUE(hasCacheEntry(Dir, "llvmcache-a"));
+  EXPECT_FALSE(hasCacheEntry(Dir, "llvmcache-b"));
+  EXPECT_FALSE(hasCacheEntry(Dir, "llvmcache-c"));
+  EXPECT_TRUE(hasCacheEntry(Dir, "llvmcache-d"));
+  EXPECT_TRUE(hasCacheEntry(Dir, "llvmcache-e"));
+
+  // A rescan finds the entry the index missed, even without an expiration,
+  // and removes it first as it is the least recently used.
+  Policy.MaxSizeBytes = 500;
+  Policy.RescanInterval = std::chrono::seconds(0);
+  ASSERT_TRUE(pruneCache(Dir, Policy));
+  EXPECT_TRUE(hasCacheEntry(Dir, "llvmcache-a"));
+  EXPECT_TRUE(hasCacheEntry(Dir, "llvmcache-d"));
+  EXPECT_FALSE(hasCacheEntry(Dir, "llvmcache-e"));
+
+  for (StringRef Name : {"llvmcache-a", "llvmcache-d", "llvmcache.index",
+                         "llvmcache.timestamp"}) {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Name);
+    sys::fs::remove(Path);
+  }
+  sys::fs::remove(Dir);
+}
@@ -66,6 +66,39 @@ TEST(CompressionTest, Zlib) {
   TestZlibCompression(BinaryDataStr, zlib::DefaultCompression);
 }
 
+TEST(CompressionTest, ZlibChunked) {
+  // Inputs that fit in a chunk are compressed as by compress().
+  SmallString<32> Chunked;
+  SmallString<32> Whole;
+  EXPECT_FALSE(zlib::compressChunked("hello, world!", Chunked,
+                                     zlib::DefaultCompression, 16));
+  EXPECT_FALSE(zlib::compress("hello, world!", Whole));
+  EXPECT_EQ(Whole, Chunked);
+  SmallString<32> Uncompressed;
+  EXPECT_FALSE(zlib::compressChunked("hello, world!", Chunked,
+                                     zlib::DefaultCompression, 1));
+  EXPECT_FALSE(zlib::uncompress(Chunked, Uncompressed, 13));
+  EXPECT_EQ("hello, world!", Uncompressed);
+
+  // Larger inputs must round-trip through uncompress(), whatever the level
+  // and however the input splits in chunks.
+  std::string Input;
+  for (unsigned I = 0; I != 20000; ++I)
+    Input += "line " + std::to_string(I * 7919 % 1000) + "\n";
+  for (size_t ChunkSize : {size_t(4096), size_t(40000), Input.size() - 1}) {
+    for (zlib::CompressionLevel Level :
+         {zlib::NoCompression, zlib::BestSpeedCompression,
+          zlib::DefaultCompression, zlib::BestSizeCompression}) {
+      SmallString<32> Compressed;
+      SmallString<32> Uncompressed;
+      EXPECT_FALSE(
+          zlib::compressChunked(Input, Compressed, Level, ChunkSize));
+      EXPECT_FALSE(zlib::uncompress(Compressed, Uncompressed, Input.size()));
+      EXPECT_EQ(Input, Uncompressed);
+    }
+  }
+}
+
 TEST(CompressionTest, ZlibCRC32) {
   EXPECT_EQ(
       0x414FA339U,
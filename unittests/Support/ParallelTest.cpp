@@ -15,6 +15,7 @@
 #include "llvm/Support/Parallel.h"
 #include "gtest/gtest.h"
 #include <array>
+#include <atomic>
 #include <random>
 
 uint32_t array[1024 * 1024];
@@ -50,4 +51,28 @@ TEST(Parallel, parallel_for) {
   ASSERT_EQ(range[2049], 1u);
 }
 
+TEST(Parallel, nested_for_each) {
+  // Every outer task waits for its inner tasks. This must not deadlock even
+  // when there are more outer tasks than threads.
+  std::atomic<uint32_t> Count(0);
+  for_each_n(parallel::par, 0, 64, [&Count](size_t) {
+    for_each_n(parallel::par, 0, 64, [&Count](size_t) { ++Count; });
+  });
+  ASSERT_EQ(Count, 64u * 64u);
+}
+
+#if LLVM_ENABLE_THREADS
+TEST(Parallel, many_small_tasks) {
+  std::atomic<uint32_t> Count(0);
+  {
+    parallel::detail::TaskGroup TG;
+    for (int I = 0; I < 100000; ++I)
+      TG.spawn([&Count] { ++Count; });
+  }
+  ASSERT_EQ(Count, 100000u);
+}
+#endif
+
+TEST(Parallel, thread_count) { ASSERT_GE(parallel::getThreadCount(), 1u); }
+
 #endif
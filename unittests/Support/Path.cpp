@@ -1190,6 +1190,33 @@ TEST_F(FileSystemTest, OpenFileForRead) {
   ::close(FileDescriptor);
 }
 
+TEST_F(FileSystemTest, OpenFileForReadWrite) {
+  SmallString<128> FilePathname(TestDirectory);
+  path::append(FilePathname, "test");
+  int FD;
+  ASSERT_EQ(fs::openFileForReadWrite(Twine(FilePathname), FD),
+            errc::no_such_file_or_directory);
+
+  {
+    std::error_code EC;
+    raw_fd_ostream File(FilePathname, EC, sys::fs::F_None);
+    ASSERT_NO_ERROR(EC);
+    File << "abcdef";
+  }
+
+  // The file is not truncated, and writes go where the stream is positioned.
+  ASSERT_NO_ERROR(fs::openFileForReadWrite(Twine(FilePathname), FD));
+  {
+    raw_fd_ostream File(FD, /*shouldClose=*/true);
+    File.seek(2);
+    File << "XY";
+  }
+  auto Buf = MemoryBuffer::getFile(FilePathname.str());
+  ASSERT_TRUE((bool)Buf);
+  EXPECT_EQ("abXYef", Buf.get()->getBuffer());
+  ASSERT_NO_ERROR(fs::remove(Twine(FilePathname)));
+}
+
 TEST_F(FileSystemTest, set_current_path) {
   SmallString<128> path;
 
@@ -164,3 +164,50 @@ TEST_F(ThreadPoolTest, PoolDestruction) {
   }
   ASSERT_EQ(5, checked_in);
 }
+
+TEST_F(ThreadPoolTest, Priority) {
+  CHECK_UNSUPPORTED();
+  // With a single thread, the queued tasks run by decreasing priority, and in
+  // submission order for the same priority.
+  ThreadPool Pool{1};
+  std::vector<int> Order;
+  Pool.async([this] { waitForMainThread(); });
+  Pool.asyncWithPriority(0, [&Order] { Order.push_back(0); });
+  Pool.asyncWithPriority(2, [&Order] { Order.push_back(2); });
+  Pool.asyncWithPriority(1, [&Order] { Order.push_back(1); });
+  Pool.asyncWithPriority(2, [&Order] { Order.push_back(3); });
+  setMainThreadReady();
+  Pool.wait();
+  ASSERT_EQ(std::vector<int>({2, 3, 1, 0}), Order);
+}
+
+TEST_F(ThreadPoolTest, TaskGroupWait) {
+  CHECK_UNSUPPORTED();
+  std::atomic_int checked_in{0};
+  ThreadPool Pool;
+  ThreadPoolTaskGroup Group(Pool);
+  for (size_t i = 0; i < 5; ++i)
+    Group.async([&checked_in] { ++checked_in; });
+  Group.wait();
+  ASSERT_EQ(5, checked_in);
+}
+
+TEST_F(ThreadPoolTest, TaskGroupCancel) {
+  CHECK_UNSUPPORTED();
+  // The first task cancels the group, the other ones must be skipped.
+  std::atomic_int checked_in{0};
+  ThreadPool Pool{1};
+  ThreadPoolTaskGroup Group(Pool);
+  Group.async([&] {
+    ++checked_in;
+    Group.cancel();
+  });
+  std::shared_future<void> Last;
+  for (size_t i = 0; i < 5; ++i)
+    Last = Group.async([&checked_in] { ++checked_in; });
+  Group.wait();
+  // The futures of the skipped tasks are ready.
+  Last.get();
+  ASSERT_TRUE(Group.isCancelled());
+  ASSERT_EQ(1, checked_in);
+}
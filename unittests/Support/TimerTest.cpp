@@ -8,7 +8,10 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/Timer.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
+#include <thread>
 
 #if LLVM_ON_WIN32
 #include <windows.h>
@@ -62,4 +65,54 @@ TEST(Timer, CheckIfTriggered) {
   EXPECT_FALSE(T1.hasTriggered());
 }
 
+#if LLVM_ENABLE_THREADS
+TEST(Timer, ConcurrentUse) {
+  Timer T1("T1", "T1");
+
+  auto Run = [&T1] {
+    for (int I = 0; I < 100; ++I) {
+      T1.startTimer();
+      T1.stopTimer();
+    }
+  };
+  std::thread Thread(Run);
+  Run();
+  Thread.join();
+
+  EXPECT_TRUE(T1.hasTriggered());
+  EXPECT_FALSE(T1.isRunning());
+}
+#endif
+
+TEST(Timer, TimeTrace) {
+  enableTimeTrace();
+  Timer T1("T1", "Timer \"one\"");
+  Timer T2("T2", "outer scope");
+  Timer T3("T3", "thread scope");
+  Timer T4("T4", "disabled scope");
+  {
+    TimeRegion Outer(T2);
+    TimeRegion Inner(T1);
+  }
+
+#if LLVM_ENABLE_THREADS
+  // The scopes of a thread that exited are kept.
+  std::thread([&] { TimeRegion Region(T3); }).join();
+#endif
+  disableTimeTrace();
+  { TimeRegion Region(T4); }
+
+  std::string Trace;
+  raw_string_ostream OS(Trace);
+  writeTimeTrace(OS);
+  OS.flush();
+  EXPECT_EQ(0u, StringRef(Trace).find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, Trace.find("\"name\":\"outer scope\""));
+  EXPECT_NE(std::string::npos, Trace.find("\"name\":\"Timer \\\"one\\\"\""));
+#if LLVM_ENABLE_THREADS
+  EXPECT_NE(std::string::npos, Trace.find("\"name\":\"thread scope\""));
+#endif
+  EXPECT_EQ(std::string::npos, Trace.find("disabled scope"));
+}
+
 } // end anon namespace
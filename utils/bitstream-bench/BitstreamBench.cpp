@@ -0,0 +1,220 @@
+//===- BitstreamBench - Benchmark bitstream record decoding ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program walks every block and record of the given bitcode files through
+// BitstreamCursor and outputs the run time, along with a checksum of the
+// record codes and values. For comparison, it can decode the records one field
+// at a time through the cursor, which is how readRecord used to work. Both
+// readers must print the same checksum.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitstreamReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+enum ReaderKind { Cached, PerField };
+}
+
+static cl::list<std::string> InputFiles(cl::Positional, cl::OneOrMore,
+                                        cl::desc("<input bitcode files>"));
+
+static cl::opt<ReaderKind> Reader(
+    "reader", cl::desc("How to decode the records:"),
+    cl::values(clEnumValN(Cached, "cached",
+                          "BitstreamCursor::readRecord"),
+               clEnumValN(PerField, "per-field",
+                          "One field at a time through the cursor")),
+    cl::init(Cached));
+
+static cl::opt<unsigned> Repeat("repeat", cl::desc("Number of runs"),
+                                cl::init(5));
+
+static uint64_t readField(BitstreamCursor &Stream, const BitCodeAbbrevOp &Op) {
+  switch (Op.getEncoding()) {
+  case BitCodeAbbrevOp::Fixed:
+    return Stream.Read((unsigned)Op.getEncodingData());
+  case BitCodeAbbrevOp::VBR:
+    return Stream.ReadVBR64((unsigned)Op.getEncodingData());
+  case BitCodeAbbrevOp::Char6:
+    return BitCodeAbbrevOp::DecodeChar6(Stream.Read(6));
+  default:
+    report_fatal_error("Invalid encoding");
+  }
+}
+
+/// Decode a record the way readRecord did before it cached the current word:
+/// every field, including array elements, is read through the cursor.
+static unsigned readRecordPerField(BitstreamCursor &Stream, unsigned AbbrevID,
+                                   SmallVectorImpl<uint64_t> &Vals) {
+  if (AbbrevID == bitc::UNABBREV_RECORD) {
+    unsigned Code = Stream.ReadVBR(6);
+    unsigned NumElts = Stream.ReadVBR(6);
+    for (unsigned I = 0; I != NumElts; ++I)
+      Vals.push_back(Stream.ReadVBR64(6));
+    return Code;
+  }
+
+  const BitCodeAbbrev *Abbv = Stream.getAbbrev(AbbrevID);
+  const BitCodeAbbrevOp &CodeOp = Abbv->getOperandInfo(0);
+  unsigned Code = CodeOp.isLiteral() ? CodeOp.getLiteralValue()
+                                     : readField(Stream, CodeOp);
+  for (unsigned I = 1, E = Abbv->getNumOperandInfos(); I != E; ++I) {
+    const BitCodeAbbrevOp &Op = Abbv->getOperandInfo(I);
+    if (Op.isLiteral()) {
+      Vals.push_back(Op.getLiteralValue());
+      continue;
+    }
+    if (Op.getEncoding() == BitCodeAbbrevOp::Array) {
+      unsigned NumElts = Stream.ReadVBR(6);
+      const BitCodeAbbrevOp &EltEnc = Abbv->getOperandInfo(++I);
+      for (; NumElts; --NumElts)
+        Vals.push_back(readField(Stream, EltEnc));
+      continue;
+    }
+    if (Op.getEncoding() != BitCodeAbbrevOp::Blob) {
+      Vals.push_back(readField(Stream, Op));
+      continue;
+    }
+
+    // Blobs are unpacked into the record, one byte per value.
+    unsigned NumBytes = Stream.ReadVBR(6);
+    uint64_t Start = alignTo(Stream.GetCurrentBitNo(), 32);
+    uint64_t End = Start + alignTo(NumBytes, 4) * 8;
+    if (!Stream.canSkipToPos(End / 8))
+      report_fatal_error("Blob extends past the end of the stream");
+    const uint8_t *Ptr = Stream.getPointerToByte(Start / 8, NumBytes);
+    Vals.append(Ptr, Ptr + NumBytes);
+    Stream.JumpToBit(End);
+  }
+  return Code;
+}
+
+namespace {
+/// Walks the blocks of one bitstream and checksums its records.
+class Walker {
+  BitstreamCursor Stream;
+  Optional<BitstreamBlockInfo> BlockInfo;
+  SmallVector<uint64_t, 64> Record;
+  uint64_t Checksum = 0;
+
+  void add(uint64_t V) { Checksum = (Checksum ^ V) * 0x100000001b3ULL; }
+
+  bool walkBlock() {
+    while (true) {
+      BitstreamEntry Entry = Stream.advance();
+      switch (Entry.Kind) {
+      case BitstreamEntry::Error:
+        return false;
+      case BitstreamEntry::EndBlock:
+        return true;
+      case BitstreamEntry::SubBlock:
+        if (Entry.ID == bitc::BLOCKINFO_BLOCK_ID) {
+          BlockInfo = Stream.ReadBlockInfoBlock();
+          if (!BlockInfo)
+            return false;
+          Stream.setBlockInfo(BlockInfo.getPointer());
+          break;
+        }
+        if (Stream.EnterSubBlock(Entry.ID) || !walkBlock())
+          return false;
+        break;
+      case BitstreamEntry::Record:
+        Record.clear();
+        add(Reader == Cached ? Stream.readRecord(Entry.ID, Record)
+                             : readRecordPerField(Stream, Entry.ID, Record));
+        for (uint64_t V : Record)
+          add(V);
+        break;
+      }
+    }
+  }
+
+public:
+  explicit Walker(StringRef Bitcode) : Stream(Bitcode) {}
+
+  /// Returns the checksum, or None if the stream is malformed.
+  Optional<uint64_t> walk() {
+    // Skip the magic number.
+    Stream.Read(32);
+    while (!Stream.AtEndOfStream()) {
+      if (Stream.ReadCode() != bitc::ENTER_SUBBLOCK)
+        return None;
+      unsigned BlockID = Stream.ReadSubBlockID();
+      if (BlockID == bitc::BLOCKINFO_BLOCK_ID) {
+        BlockInfo = Stream.ReadBlockInfoBlock();
+        if (!BlockInfo)
+          return None;
+        Stream.setBlockInfo(BlockInfo.getPointer());
+        continue;
+      }
+      if (Stream.EnterSubBlock(BlockID) || !walkBlock())
+        return None;
+    }
+    return Checksum;
+  }
+};
+} // end anonymous namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "bitstream decoding benchmark\n");
+
+  std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+  std::vector<StringRef> Streams;
+  for (const std::string &File : InputFiles) {
+    auto BufOrErr = MemoryBuffer::getFile(File);
+    if (!BufOrErr) {
+      errs() << File << ": " << BufOrErr.getError().message() << '\n';
+      return 1;
+    }
+    const unsigned char *Begin =
+        (const unsigned char *)(*BufOrErr)->getBufferStart();
+    const unsigned char *End =
+        (const unsigned char *)(*BufOrErr)->getBufferEnd();
+    if (!isBitcode(Begin, End) ||
+        (isBitcodeWrapper(Begin, End) &&
+         SkipBitcodeWrapperHeader(Begin, End, true))) {
+      errs() << File << ": not a bitcode file\n";
+      return 1;
+    }
+    Streams.push_back(StringRef((const char *)Begin, End - Begin));
+    Buffers.push_back(std::move(*BufOrErr));
+  }
+
+  for (unsigned R = 0; R != Repeat; ++R) {
+    double Start = TimeRecord::getCurrentTime(true).getWallTime();
+    uint64_t Checksum = 0;
+    for (unsigned I = 0, E = Streams.size(); I != E; ++I) {
+      Optional<uint64_t> StreamChecksum = Walker(Streams[I]).walk();
+      if (!StreamChecksum) {
+        errs() << InputFiles[I] << ": malformed bitstream\n";
+        return 1;
+      }
+      Checksum += *StreamChecksum;
+    }
+    double End = TimeRecord::getCurrentTime(false).getWallTime();
+    outs() << (Reader == Cached ? "cached" : "per-field")
+           << " files=" << Streams.size() << ": "
+           << format("%.4f", End - Start) << " s, checksum "
+           << format_hex(Checksum, 18) << '\n';
+  }
+  return 0;
+}
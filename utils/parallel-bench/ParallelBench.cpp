@@ -0,0 +1,170 @@
+//===- ParallelBench - Benchmark the parallel algorithms executor ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program runs many fine-grained tasks, optionally nested, through the
+// executor behind llvm/Support/Parallel.h and outputs the run time. For
+// comparison, it can run the same tasks on a single lock-protected stack
+// shared by all threads, which is how the executor used to work. Run it with
+// increasing -threads values to see how both scale.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stack>
+#include <thread>
+
+using namespace llvm;
+
+namespace {
+enum ExecutorKind { WorkStealing, SharedStack };
+}
+
+static cl::opt<ExecutorKind> Executor(
+    "executor", cl::desc("Executor to run the tasks on:"),
+    cl::values(clEnumValN(WorkStealing, "work-stealing",
+                          "The executor of the parallel algorithms"),
+               clEnumValN(SharedStack, "shared-stack",
+                          "A single stack shared by all threads")),
+    cl::init(WorkStealing));
+
+static cl::opt<unsigned> Threads("threads",
+                                 cl::desc("Number of threads (0 = all)"),
+                                 cl::init(0));
+
+static cl::opt<unsigned> Tasks("tasks", cl::desc("Number of outer tasks"),
+                               cl::init(100000));
+
+static cl::opt<unsigned>
+    NestedTasks("nested-tasks",
+                cl::desc("Number of tasks each outer task spawns and waits "
+                         "for"),
+                cl::init(0));
+
+static cl::opt<unsigned> Work("work",
+                              cl::desc("Loop iterations run by each task"),
+                              cl::init(100));
+
+static cl::opt<unsigned> Repeat("repeat", cl::desc("Number of runs"),
+                                cl::init(5));
+
+/// Do a bit of work that the optimizer cannot drop.
+static void doWork(std::atomic<uint64_t> &Sum) {
+  uint64_t X = 0;
+  for (unsigned I = 0; I != Work; ++I)
+    X = X * 6364136223846793005ULL + I;
+  Sum += X & 1;
+}
+
+#if LLVM_ENABLE_THREADS
+namespace {
+/// A single mutex-protected stack of tasks shared by all threads.
+class SharedStackExecutor {
+  std::mutex Mutex;
+  std::condition_variable Cond;
+  std::stack<std::function<void()>> Stack;
+
+public:
+  explicit SharedStackExecutor(unsigned ThreadCount) {
+    for (unsigned I = 0; I != ThreadCount; ++I)
+      std::thread([this] {
+        while (true) {
+          std::unique_lock<std::mutex> Lock(Mutex);
+          Cond.wait(Lock, [&] { return !Stack.empty(); });
+          auto Task = std::move(Stack.top());
+          Stack.pop();
+          Lock.unlock();
+          Task();
+        }
+      }).detach();
+  }
+
+  void add(std::function<void()> F) {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Stack.push(std::move(F));
+    }
+    Cond.notify_one();
+  }
+
+  /// Run \p Count tasks calling \p F and wait for them. Like the original
+  /// executor, the waiting thread just blocks.
+  void run(unsigned Count, std::function<void()> F) {
+    parallel::detail::Latch L;
+    for (unsigned I = 0; I != Count; ++I) {
+      L.inc();
+      add([&L, F] {
+        F();
+        L.dec();
+      });
+    }
+    L.sync();
+  }
+};
+} // end anonymous namespace
+
+static void runTasks(SharedStackExecutor *Shared, unsigned Count,
+                     std::function<void()> F) {
+  if (Shared) {
+    Shared->run(Count, F);
+    return;
+  }
+  parallel::detail::TaskGroup TG;
+  for (unsigned I = 0; I != Count; ++I)
+    TG.spawn(F);
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "parallel executor benchmark\n");
+  parallel::setThreadCount(Threads);
+  unsigned ThreadCount = parallel::getThreadCount();
+
+  // Like the executor of the parallel algorithms, this one is leaked, as its
+  // threads never stop.
+  SharedStackExecutor *Shared = nullptr;
+  if (Executor == SharedStack && NestedTasks) {
+    // Its threads block on nested tasks, which deadlocks as soon as there are
+    // more outer tasks than threads.
+    errs() << "-nested-tasks is not supported by the shared-stack executor\n";
+    return 1;
+  }
+  if (Executor == SharedStack)
+    Shared = new SharedStackExecutor(ThreadCount);
+
+  std::atomic<uint64_t> Sum(0);
+  for (unsigned R = 0; R != Repeat; ++R) {
+    double Start = TimeRecord::getCurrentTime(true).getWallTime();
+    runTasks(Shared, Tasks, [&] {
+      if (NestedTasks)
+        runTasks(Shared, NestedTasks, [&] { doWork(Sum); });
+      else
+        doWork(Sum);
+    });
+    double End = TimeRecord::getCurrentTime(false).getWallTime();
+    outs() << (Shared ? "shared-stack" : "work-stealing")
+           << " threads=" << ThreadCount << " tasks=" << Tasks
+           << " nested-tasks=" << NestedTasks << ": "
+           << format("%.4f", End - Start) << " s\n";
+  }
+  return 0;
+}
+#else
+int main(int argc, char **argv) {
+  errs() << "parallel-bench requires LLVM_ENABLE_THREADS\n";
+  return 1;
+}
+#endif